@@ -0,0 +1,124 @@
+#pragma once
+
+#include <OGDT/types.h>
+#include <cstddef>
+
+namespace OGDT
+{
+
+/*
+Class: Archive
+A read-only pak file: many files packed into one, mapped into memory.
+
+A pak file holds the files' contents, each aligned to 16 bytes and either
+stored as is or compressed with LZ4, followed by an index of their names.
+Opening an archive maps it and reads the index; stored files are then used
+in place, without a system call per file. Archives are written with
+<write_archive> and are usually mounted with <vfs_mount> rather than used
+directly.
+
+File names use forward slashes and are relative to the archive, like
+"textures/wall.png".
+*/
+class Archive
+{
+    struct _impl;
+    _impl* impl;
+
+    Archive (const Archive&);
+    Archive& operator= (const Archive&);
+
+public:
+
+    /*
+    Constructor: Archive
+    Construct a closed archive.
+    */
+    Archive ();
+
+    /*
+    Constructor: Archive
+    Open the given pak file; see <open>.
+    */
+    Archive (const char* path);
+
+    ~Archive ();
+
+    /*
+    Function: open
+    Map the given pak file and read its index, closing the current one.
+
+    An exception is thrown if the file cannot be opened or is not a valid
+    pak file.
+    */
+    void open (const char* path);
+
+    /*
+    Function: close
+    Unmap the pak file. Pointers returned by <data> become invalid.
+    */
+    void close ();
+
+    /*
+    Function: numEntries
+    Return the number of files in the archive.
+    */
+    unsigned numEntries () const;
+
+    /*
+    Function: name
+    Return the name of the given file.
+    */
+    const char* name (unsigned i) const;
+
+    /*
+    Function: find
+    Return the index of the file with the given name, or -1 if there is none.
+
+    The name is matched as stored; see <vfs_read> for path normalisation.
+    */
+    int find (const char* name) const;
+
+    /*
+    Function: size
+    Return the size of the given file, uncompressed.
+    */
+    size_t size (unsigned i) const;
+
+    /*
+    Function: compressed
+    Return true if the given file is stored compressed.
+    */
+    bool compressed (unsigned i) const;
+
+    /*
+    Function: data
+    Return the contents of the given file in place, or null if it is compressed.
+    */
+    const U8* data (unsigned i) const;
+
+    /*
+    Function: read
+    Copy or decompress the given file into a buffer of <size> bytes.
+
+    An exception is thrown if compressed data is corrupt.
+    */
+    void read (unsigned i, U8* out) const;
+};
+
+/*
+Function: write_archive
+Pack files from disk into a pak file.
+
+Parameters:
+
+path - The pak file to write.
+names - The names to store the files under.
+files - The paths of the files to read.
+n - The number of files.
+compress - Whether to compress files with LZ4. Files that do not shrink are stored as is.
+*/
+void write_archive (const char* path, const char* const* names, const char* const* files,
+                    unsigned n, bool compress = true);
+
+} // namespace OGDT
@@ -0,0 +1,141 @@
+#pragma once
+
+namespace OGDT
+{
+
+class Image;
+
+/*
+Class: Atlas
+Many small images packed into one, so that sprites and icons share a
+texture instead of binding one each.
+
+Images are packed with a bottom-left skyline packer, tallest first, into
+the smallest power-of-two image they fit in. Every image is surrounded by
+a gutter that repeats its edge pixels, so bilinear filtering does not
+bleed neighbours in. With an alignment of 2^k, images start on 2^k pixel
+boundaries and the first k mipmap levels never average two images
+together.
+
+Usage:
+
+(start code)
+Atlas atlas;
+for (const Image* icon : icons) atlas.add (*icon);
+atlas.build ();
+GLuint tex = create_texture (atlas.image());
+const Atlas::Region& r = atlas.region (0); // UVs of the first icon.
+(end)
+*/
+class Atlas
+{
+    struct _impl;
+    _impl* impl;
+
+    Atlas (const Atlas&);
+    Atlas& operator= (const Atlas&);
+
+public:
+
+    /*
+    Struct: Region
+    Where an image was placed in the atlas.
+
+    x, y - The image's first pixel in the atlas, gutter excluded.
+    width, height - The image's size.
+    u0, v0, u1, v1 - The image's texture coordinates. Row 0 of the atlas is
+    at v = 0, the way create_texture uploads images.
+    */
+    struct Region
+    {
+        int x, y;
+        int width, height;
+        float u0, v0, u1, v1;
+    };
+
+    /*
+    Constructor: Atlas
+    Construct an empty atlas.
+
+    Parameters:
+
+    padding - Width in pixels of the gutter around every image.
+    alignment - A power of two every image's cell, gutter included, is aligned to and padded to.
+    */
+    Atlas (int padding = 2, int alignment = 1);
+
+    ~Atlas ();
+
+    /*
+    Function: add
+    Add an image to the atlas and return its index.
+
+    All images must have the same number of components and data type. The
+    image must live until <build> returns.
+    */
+    unsigned add (const Image& image);
+
+    /*
+    Function: add
+    Add an empty rectangle of the given size and return its index.
+
+    Its region is reserved and cleared to zero when the atlas is built.
+    */
+    unsigned add (int width, int height);
+
+    /*
+    Function: pack
+    Place every rectangle without building the atlas image.
+
+    Regions and <width>, <height> and <occupancy> are valid afterwards. An
+    exception is thrown if the rectangles do not fit in max_size x max_size.
+    */
+    void pack (int max_size = 4096);
+
+    /*
+    Function: build
+    Pack the rectangles and copy the images into the atlas image.
+
+    Images are copied in parallel on <ThreadPool::global>. Parts of the
+    atlas not covered by an image or its gutter are zero.
+    */
+    void build (int max_size = 4096);
+
+    /*
+    Function: image
+    Return the atlas image. Empty until <build> is called.
+    */
+    const Image& image () const;
+
+    /*
+    Function: numRegions
+    Return the number of rectangles added.
+    */
+    unsigned numRegions () const;
+
+    /*
+    Function: region
+    Return the placement of the given rectangle.
+    */
+    const Region& region (unsigned i) const;
+
+    /*
+    Function: width
+    Return the width of the packed atlas.
+    */
+    int width () const;
+
+    /*
+    Function: height
+    Return the height of the packed atlas.
+    */
+    int height () const;
+
+    /*
+    Function: occupancy
+    Return the fraction of the atlas covered by images, gutters excluded.
+    */
+    float occupancy () const;
+};
+
+} // namespace OGDT
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <OGDT/types.h>
+#include <cstddef>
+
+namespace OGDT
+{
+
+class Image;
+
+/*
+Class: CompressedImage
+A block-compressed image and its stored mipmap levels.
+
+Images are read from DDS and KTX (version 1) containers and uploaded as
+they are with create_texture, so they take a quarter to an eighth of the
+memory of raw images and need no decoding. BC1 and BC3 images can also be
+encoded on the CPU with <encode> and saved with <write_dds> to convert
+assets offline.
+*/
+class CompressedImage
+{
+public:
+
+    /*
+    Enum: Format
+    Block compression formats.
+
+    Compressed_BC1 - DXT1. RGB with 1-bit alpha, 8 bytes per 4x4 block.
+    Compressed_BC3 - DXT5. RGBA, 16 bytes per 4x4 block.
+    Compressed_BC7 - BPTC. RGBA, 16 bytes per 4x4 block. Cannot be encoded, decoded or flipped on the CPU.
+    */
+    enum Format
+    {
+        Compressed_BC1,
+        Compressed_BC3,
+        Compressed_BC7
+    };
+
+private:
+
+    struct _impl;
+    _impl* impl;
+
+    CompressedImage (const CompressedImage&);
+    CompressedImage& operator= (const CompressedImage&);
+
+public:
+
+    /*
+    Constructor: CompressedImage
+    Construct an empty image.
+    */
+    CompressedImage ();
+
+    ~CompressedImage ();
+
+    /*
+    Function: is_container
+    Return true if the given path names a DDS or KTX file, judging by its extension.
+    */
+    static bool is_container (const char* path);
+
+    /*
+    Function: from_file
+    Read a DDS or KTX file, through <vfs>.
+
+    Only 2D images in one of the <Format>s are supported. An exception is
+    thrown otherwise.
+    */
+    static void from_file (const char* path, CompressedImage&);
+
+    /*
+    Function: from_mem
+    Read a DDS or KTX file from memory. The container is told by its magic number.
+    */
+    static void from_mem (const U8* data, int n, CompressedImage&);
+
+    /*
+    Function: encode
+    Encode an 8-bit image with 1 to 4 components.
+
+    Blocks are encoded in parallel on <ThreadPool::global>. Images without an
+    alpha channel are opaque. With BC1, pixels with alpha below 128 become
+    transparent.
+
+    Parameters:
+
+    image - The image to encode.
+    format - Compressed_BC1 or Compressed_BC3.
+    out - Receives the encoded image.
+    mipmaps - Whether to encode a full mipmap chain, built with <MipChain>.
+    */
+    static void encode (const Image& image, Format format, CompressedImage& out, bool mipmaps = true);
+
+    /*
+    Function: decode
+    Decode the given BC1 or BC3 level into levelWidth(i) * levelHeight(i) RGBA pixels.
+    */
+    void decode (unsigned level, U8* rgba) const;
+
+    /*
+    Function: canFlip
+    Return true if <flipVertically> can flip the image.
+
+    BC1 and BC3 images can be flipped if the height of every level is either
+    a multiple of 4 or less than 4.
+    */
+    bool canFlip () const;
+
+    /*
+    Function: flipVertically
+    Flip every level vertically by reordering blocks, without re-encoding.
+
+    Throws if <canFlip> is false.
+    */
+    void flipVertically ();
+
+    /*
+    Function: format
+    Return the image's compression format.
+    */
+    Format format () const;
+
+    /*
+    Function: width
+    Return the width of level 0.
+    */
+    int width () const;
+
+    /*
+    Function: height
+    Return the height of level 0.
+    */
+    int height () const;
+
+    /*
+    Function: numLevels
+    Return the number of stored mipmap levels.
+    */
+    unsigned numLevels () const;
+
+    /*
+    Function: levelWidth
+    Return the width of the given level.
+    */
+    int levelWidth (unsigned level) const;
+
+    /*
+    Function: levelHeight
+    Return the height of the given level.
+    */
+    int levelHeight (unsigned level) const;
+
+    /*
+    Function: levelData
+    Return the blocks of the given level, in row order.
+    */
+    const U8* levelData (unsigned level) const;
+
+    /*
+    Function: levelSize
+    Return the size in bytes of the given level.
+    */
+    size_t levelSize (unsigned level) const;
+};
+
+/*
+Function: write_dds
+Save the given image and all its levels to a DDS file.
+
+BC1 and BC3 images are written with the legacy DXT1/DXT5 headers and BC7
+images with a DX10 header.
+*/
+void write_dds (const CompressedImage& image, const char* file);
+
+} // namespace OGDT
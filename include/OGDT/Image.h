@@ -1,6 +1,7 @@
 #pragma once
 
 #include <OGDT/types.h>
+#include <cstddef>
 
 namespace OGDT
 {
@@ -8,6 +9,9 @@ namespace OGDT
 /*
 Class: TImage
 A type-safe front-end to an image.
+
+Rows may be padded, as in a sub-image <ImageView>; pixels are addressed
+through the row stride.
 */
 template <class T, int components>
 class TImage
@@ -15,11 +19,17 @@ class TImage
     T* p;
     int w;
     int h;
+    size_t s; // Bytes between the starts of consecutive rows.
 
     friend class Image;
+    friend class ImageView;
+
+    TImage (T* _p, int _w, int _h, size_t _stride)
+        : p (_p), w (_w), h (_h), s (_stride) {}
 
-    TImage (T* _p, int _w, int _h)
-        : p (_p), w (_w), h (_h) {}
+    T* at (int row, int col) const {
+        return (T*) ((U8*) p + row * s) + col * components;
+    }
 
 public:
 
@@ -31,6 +41,30 @@ public:
         return h;
     }
 
+    /*
+    Function: stride
+    Return the number of bytes between the starts of consecutive rows.
+    */
+    size_t stride () const {
+        return s;
+    }
+
+    /*
+    Function: row
+    Return a pointer to the first component of the given row.
+    */
+    T* row (int y) {
+        return at (y, 0);
+    }
+
+    const T* row (int y) const {
+        return at (y, 0);
+    }
+
+    /*
+    Operator: []
+    Return the ith component, counting from the first. Rows must not be padded.
+    */
     T& operator[] (int i) {
         return *(p+i);
     }
@@ -40,46 +74,77 @@ public:
     }
 
     T& operator() (int row, int col) {
-        return *(p + (row*w + col * components));
+        return *at (row, col);
     }
 
     T operator() (int row, int col) const {
-        return *(p + (row*w + col * components));
+        return *at (row, col);
     }
 
     T& r (int row, int col) {
-        return *(p + (row*w + col * components));
+        return at (row, col)[0];
     }
 
     T r (int row, int col) const {
-        return *(p + (row*w + col * components));
+        return at (row, col)[0];
     }
 
     T& g (int row, int col) {
-        return *(p + (row*w + col * components + 1));
+        return at (row, col)[1];
     }
 
     T g (int row, int col) const {
-        return *(p + (row*w + col * components + 1));
+        return at (row, col)[1];
     }
 
     T& b (int row, int col) {
-        return *(p + (row*w + col * components + 2));
+        return at (row, col)[2];
     }
 
     T b (int row, int col) const {
-        return *(p + (row*w + col * components + 2));
+        return at (row, col)[2];
     }
 
     T& a (int row, int col) {
-        return *(p + (row*w + col * components + 3));
+        return at (row, col)[3];
     }
 
     T a (int row, int col) const {
-        return *(p + (row*w + col * components + 3));
+        return at (row, col)[3];
     }
 };
 
+class ImageView;
+
+/*
+Class: ImageAllocator
+Supplies the pixel buffers of images.
+
+Once set with <Image::setAllocator>, every pixel buffer comes from it: those
+of constructed images, mipmap levels and atlases, and those of decoded
+files, stb_image's working buffers included. Implementations must be safe
+to call from several threads, as images are decoded on <ThreadPool>
+workers. See <ImagePool> for one that recycles buffers.
+*/
+class ImageAllocator
+{
+public:
+
+    virtual ~ImageAllocator () {}
+
+    /*
+    Function: allocate
+    Return a block of at least the given size, aligned to 16 bytes, or null if out of memory.
+    */
+    virtual void* allocate (size_t size) = 0;
+
+    /*
+    Function: deallocate
+    Take back a block returned by <allocate>, along with the size asked for.
+    */
+    virtual void deallocate (void* block, size_t size) = 0;
+};
+
 /*
 Class: Image
 */
@@ -102,9 +167,15 @@ private:
     DataType t;
     U8* pixels;
 
+    struct mapping;
+    mapping* map; // Set when the pixels are a view of a mapped file.
+
     Image (const Image&);
     Image& operator= (const Image&);
 
+    static void from_pnm (const char* path, const U8* data, size_t n, Image&, bool flip);
+    void release ();
+
 public:
 
     /*
@@ -123,44 +194,111 @@ public:
     Function: from_file
     Read an image from the specified file path.
 
-    File formats supported:
+    The file is read through <vfs>, so it may be in a mounted archive.
+    Formats are told by their contents. File formats supported:
 
     - Those by stbi_image.
-    - Binary/ascii ppm/pgm.
+    - Binary/ascii ppm/pgm, 8 or 16 bits per sample. Samples are scaled to 8 bits.
+    - Grayscale/RGB pfm (Pf/PF) of either byte order, as <Image_F32>.
+
+    If flip is true, the image is returned bottom row first, as GL expects
+    textures. ppm/pgm/pfm rows are copied straight to their place; other
+    formats are flipped in place right after decoding, without another
+    allocation. pfm files, which store the bottom row first, are read in
+    the same top-first order as other images unless flip is true.
     */
-    static void from_file (const char* path, Image&);
+    static void from_file (const char* path, Image&, bool flip = false);
 
     /*
     Function: from_mem
-    Read an image from memory.
+    Read an image from memory. If flip is true, the image is returned bottom row first.
+
+    ppm, pgm and pfm data is recognised by its magic number.
     */
-    static void from_mem (const U8* data, int n, Image&);
+    static void from_mem (const U8* data, int n, Image&, bool flip = false);
+
+    /*
+    Function: map_file
+    Map a ppm, pgm or pfm file into memory and view its pixels in place.
+
+    Nothing is copied when the pixels can be used as stored: binary 8-bit
+    ppm/pgm, and pfm with a scale of 1 or -1 in the machine's byte order.
+    Other files are read as by <from_file>. The mapping is copy-on-write,
+    so the image may be modified without changing the file. Use this for
+    large heightmaps and lightmaps that are only read.
+
+    As with <from_file>, flip asks for the bottom row first. pfm files are
+    stored that way, so they are only mapped in place when flip is true.
+    */
+    static void map_file (const char* path, Image&, bool flip = false);
+
+    /*
+    Function: setAllocator
+    Set the allocator pixel buffers are taken from; null for malloc.
+
+    Buffers are returned to the allocator they came from, so the allocator
+    may be changed at any time, but it must outlive every image it allocated.
+    */
+    static void setAllocator (ImageAllocator* allocator);
+
+    /*
+    Function: allocator
+    Return the allocator set with <setAllocator>, or null.
+    */
+    static ImageAllocator* allocator ();
+
+    /*
+    Function: mapped
+    Return true if the image is a view of a mapped file.
+    */
+    bool mapped () const { return map != nullptr; }
 
     ~Image ();
 
     /*
     Function: flipVertically
-    Flip the image vertically.
+    Flip the image vertically, in place.
+
+    Rows are swapped pairwise without allocating. Prefer the flip argument
+    of <from_file> when loading.
     */
     void flipVertically ();
 
     template <class T, int components>
     TImage<T,components> coerce () {
-        return TImage<T,components> ((T*) pixels, w, h);
+        return TImage<T,components> ((T*) pixels, w, h, (size_t) w * c * s);
     }
 
     template <class T, int components>
     const TImage<T,components> coerce () const {
-        return TImage<T,components> ((T*) pixels, w, h);
+        return TImage<T,components> ((T*) pixels, w, h, (size_t) w * c * s);
     }
 
+    /*
+    Function: view
+    Return a view of the whole image.
+    */
+    ImageView view ();
+
+    const ImageView view () const;
+
+    /*
+    Function: view
+    Return a view of the given rectangle of the image, sharing its pixels.
+
+    An exception is thrown if the rectangle is not within the image.
+    */
+    ImageView view (int x, int y, int width, int height);
+
+    const ImageView view (int x, int y, int width, int height) const;
+
     /*
     Operator: ()
     Return a mutable reference to the value at the given position.
     */
     template <class T>
     T& elem (int row, int col) {
-        return (T&) pixels [(row*w + col) * sizeof(T)];
+        return (T&) pixels [((row*w + col) * c) * sizeof(T)];
     }
 
     /*
@@ -169,7 +307,7 @@ public:
     */
     template <class T>
     T elem (int row, int col) const {
-        return (T) pixels [(row*w + col) * sizeof(T)];
+        return *(const T*) &pixels[((row*w + col) * c) * sizeof(T)];
     }
 
     /*
@@ -187,7 +325,7 @@ public:
     */
     template <class T>
     T ith (int i) const {
-        return (T) pixels [i * sizeof(T)];
+        return *(const T*) &pixels[i * sizeof(T)];
     }
 
     /*
@@ -205,7 +343,7 @@ public:
     */
     template <class T>
     T r (int row, int col) const {
-        return (T) pixels[((row*w + col) * c) * sizeof(T)];
+        return *(const T*) &pixels[((row*w + col) * c) * sizeof(T)];
     }
 
     /*
@@ -223,7 +361,7 @@ public:
     */
     template <class T>
     T g (int row, int col) const {
-        return (T) pixels[((row*w + col) * c + 1) * sizeof(T)];
+        return *(const T*) &pixels[((row*w + col) * c + 1) * sizeof(T)];
     }
 
     /*
@@ -241,7 +379,7 @@ public:
     */
     template <class T>
     T b (int row, int col) const {
-        return (T) pixels[((row*w + col) * c + 2) * sizeof(T)];
+        return *(const T*) &pixels[((row*w + col) * c + 2) * sizeof(T)];
     }
 
     /*
@@ -259,7 +397,7 @@ public:
     */
     template <class T>
     T a (int row, int col) const {
-        return (T) pixels[((row*w + col) * c + 3) * sizeof(T)];
+        return *(const T*) &pixels[((row*w + col) * c + 3) * sizeof(T)];
     }
 
     /*
@@ -299,13 +437,166 @@ public:
     DataType dataType () const { return t; }
 };
 
+/*
+Class: ImageView
+A rectangle of pixels in memory, with an explicit row stride.
+
+Views do not own their pixels; they are cheap to copy and must not outlive
+the memory they point to. A view of part of an image, such as a tile of an
+atlas, addresses the image's pixels in place. Rows are contiguous, so
+kernels in <image_ops> can process them one at a time through <row> and
+<stride>.
+*/
+class ImageView
+{
+    U8* p;
+    int w;
+    int h;
+    int c;
+    Image::DataType t;
+    size_t s; // Bytes between the starts of consecutive rows.
+
+public:
+
+    /*
+    Constructor: ImageView
+    Construct an empty view.
+    */
+    ImageView ()
+        : p (nullptr), w (0), h (0), c (0), t (Image::Image_U8), s (0) {}
+
+    /*
+    Constructor: ImageView
+    View the given pixels.
+
+    Parameters:
+
+    data - The first pixel of the first row.
+    width - Width in pixels.
+    height - Height in pixels.
+    num_components - Number of components per pixel.
+    data_type - The type of the components.
+    stride - Bytes between the starts of consecutive rows; 0 for tightly packed rows.
+    */
+    ImageView (U8* data, int width, int height, int num_components,
+               Image::DataType data_type, size_t stride = 0)
+        : p (data), w (width), h (height), c (num_components), t (data_type), s (stride) {
+        if (!s) s = rowSize();
+    }
+
+    /*
+    Function: sub
+    Return a view of the given rectangle of this view.
+
+    An exception is thrown if the rectangle is not within the view.
+    */
+    ImageView sub (int x, int y, int width, int height) const;
+
+    /*
+    Function: copyTo
+    Copy this view's pixels into another view of the same size and format, row by row.
+    */
+    void copyTo (const ImageView& dst) const;
+
+    int width () const { return w; }
+
+    int height () const { return h; }
+
+    int numComponents () const { return c; }
+
+    Image::DataType dataType () const { return t; }
+
+    /*
+    Function: dataSize
+    Return the size of a pixel component.
+    */
+    int dataSize () const { return t == Image::Image_F32 ? 4 : 1; }
+
+    /*
+    Function: stride
+    Return the number of bytes between the starts of consecutive rows.
+    */
+    size_t stride () const { return s; }
+
+    /*
+    Function: rowSize
+    Return the number of bytes of pixels in a row, padding excluded.
+    */
+    size_t rowSize () const { return (size_t) w * c * dataSize(); }
+
+    /*
+    Function: contiguous
+    Return true if the rows are not padded, so the pixels form one block.
+    */
+    bool contiguous () const { return s == rowSize(); }
+
+    /*
+    Function: row
+    Return a pointer to the given row.
+    */
+    U8* row (int y) { return p + y * s; }
+
+    const U8* row (int y) const { return p + y * s; }
+
+    /*
+    Function: pixel
+    Return a pointer to the first component of the given pixel.
+    */
+    template <class T>
+    T* pixel (int row, int col) {
+        return (T*) (p + row * s) + col * c;
+    }
+
+    template <class T>
+    const T* pixel (int row, int col) const {
+        return (const T*) (p + row * s) + col * c;
+    }
+
+    template <class T, int components>
+    TImage<T,components> coerce () {
+        return TImage<T,components> ((T*) p, w, h, s);
+    }
+
+    template <class T, int components>
+    const TImage<T,components> coerce () const {
+        return TImage<T,components> ((T*) p, w, h, s);
+    }
+
+    /*
+    Function: forEachRow
+    Call f (row, y) for every row, where row points to the row's first byte.
+    */
+    template <class F>
+    void forEachRow (F f) const {
+        for (int y = 0; y < h; ++y) f (p + y * s, y);
+    }
+
+    /*
+    Function: forEachSpan
+    Call f (data, bytes) for every contiguous run of pixel bytes: once for
+    unpadded views, once per row otherwise.
+    */
+    template <class F>
+    void forEachSpan (F f) const {
+        if (contiguous ()) {
+            if (h > 0) f (p, rowSize() * h);
+        }
+        else {
+            for (int y = 0; y < h; ++y) f (p + y * s, rowSize());
+        }
+    }
+};
+
 /*
 Function: write_ppm
-Save the given image to a file.
+Save the given image to a binary ppm file.
 
-The given image must have 3 bytes per pixel.
+The given image must have at least 3 components; the first 3 are written.
 
-If the given image is of type float, the values are assumed to be in the range [0,1].
+If the given image is of type float, the values are clamped to the range [0,1].
+
+Rows are converted into a staging buffer and written in large blocks, so
+dumping many images is bound by the disk rather than by calls to fwrite.
 
 Parameters:
 
@@ -314,4 +605,33 @@ file - The file where the image should be written.
 */
 void write_ppm (const Image& image, const char* file);
 
+/*
+Function: write_pgm
+Save the first component of the given image to a binary pgm file.
+
+Float values are clamped to the range [0,1], as with <write_ppm>.
+*/
+void write_pgm (const Image& image, const char* file);
+
+/*
+Function: write_pfm
+Save the given image to a pfm file, in the machine's byte order.
+
+Images with 3 or more components are written as RGB (PF), others as
+grayscale (Pf) from the first component. 8-bit values are scaled to the
+range [0,1].
+*/
+void write_pfm (const Image& image, const char* file);
+
+/*
+Function: write_tga
+Save the given image to an uncompressed tga file.
+
+Images with 3 or 4 components are written as true colour, others as
+grayscale from the first component. Float values are clamped to the
+range [0,1], as with <write_ppm>. Throws if either dimension exceeds
+65535, the largest a TGA header holds.
+*/
+void write_tga (const Image& image, const char* file);
+
 } // namespace OGDT
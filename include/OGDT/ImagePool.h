@@ -0,0 +1,86 @@
+#pragma once
+
+#include <OGDT/Image.h>
+#include <cstddef>
+
+namespace OGDT
+{
+
+/*
+Class: ImagePool
+An <ImageAllocator> that keeps freed pixel buffers for reuse.
+
+Loading textures in a batch decodes hundreds of images of a few sizes,
+uploads each and throws it away. With a pool set as the allocator, the
+buffer of a discarded image is handed to the next image of about the same
+size instead of going back to malloc.
+
+Sizes are rounded up to classes at most a quarter apart, and a freed buffer
+is only reused for its class. Blocks under min_block bytes, such as the
+decoders' small working buffers, go straight to malloc. Thread-safe.
+
+Usage:
+
+(start code)
+ImagePool pool;
+Image::setAllocator (&pool);
+for (const char* path : paths) textures.push_back (load_texture (path));
+Image::setAllocator (nullptr);
+(end)
+*/
+class ImagePool : public ImageAllocator
+{
+    struct _impl;
+    _impl* impl;
+
+    ImagePool (const ImagePool&);
+    ImagePool& operator= (const ImagePool&);
+
+public:
+
+    /*
+    Constructor: ImagePool
+
+    Parameters:
+
+    max_cached - Most bytes kept in free buffers; buffers freed beyond it go back to the system.
+    min_block - Blocks smaller than this are not pooled.
+    */
+    ImagePool (size_t max_cached = 256 << 20, size_t min_block = 64 << 10);
+
+    /*
+    Destructor: ~ImagePool
+    Free the cached buffers. Images allocated from the pool must be destroyed first.
+    */
+    ~ImagePool ();
+
+    void* allocate (size_t size);
+
+    void deallocate (void* block, size_t size);
+
+    /*
+    Function: trim
+    Free every cached buffer.
+    */
+    void trim ();
+
+    /*
+    Function: cachedBytes
+    Return the number of bytes held in free buffers.
+    */
+    size_t cachedBytes () const;
+
+    /*
+    Function: hits
+    Return the number of pooled allocations served from a cached buffer.
+    */
+    size_t hits () const;
+
+    /*
+    Function: misses
+    Return the number of pooled allocations that had to call malloc.
+    */
+    size_t misses () const;
+};
+
+} // namespace OGDT
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <OGDT/model.h>
+#include <cstddef>
+#include <memory>
+
+namespace OGDT
+{
+
+class Loader;
+struct load_request;
+
+/*
+Class: AsyncModel
+A handle to a model being loaded in the background.
+
+Handles are cheap to copy; copies refer to the same request.
+*/
+class AsyncModel
+{
+    friend class Loader;
+    std::shared_ptr<load_request> req;
+
+public:
+
+    /*
+    Function: isReady
+    Return true if the request has completed, successfully or not.
+    */
+    bool isReady () const;
+
+    /*
+    Function: get
+    Take ownership of the loaded model.
+
+    Returns null if the request has not completed yet or if the model has
+    already been taken.
+
+    Throws:
+
+    OGDT::Exception - The model failed to load.
+    */
+    Model* get ();
+};
+
+/*
+Class: AsyncTexture
+A handle to a texture being loaded in the background.
+
+Handles are cheap to copy; copies refer to the same request.
+*/
+class AsyncTexture
+{
+    friend class Loader;
+    std::shared_ptr<load_request> req;
+
+public:
+
+    /*
+    Function: isReady
+    Return true if the request has completed, successfully or not.
+    */
+    bool isReady () const;
+
+    /*
+    Function: get
+    Return the OpenGL texture identifier, or 0 if the request has not completed yet.
+
+    The caller is responsible for deleting the texture.
+
+    Throws:
+
+    OGDT::Exception - The texture failed to load.
+    */
+    unsigned get () const;
+};
+
+/*
+Class: Loader
+Loads models and textures on a pool of worker threads.
+
+File I/O and decoding happen on the workers. The remaining OpenGL work is
+queued and performed by <update> or <finish>, which must be called from the
+thread that owns the OpenGL context.
+
+By default <update> uploads whole textures, which can stall a frame for a
+large one. With an upload budget, textures are streamed instead: every
+update uploads at most that many bytes of rows, staged through a ring of
+persistently mapped pixel buffers so the copies do not wait on the GPU.
+Loading a level in the background then costs a bounded amount of every
+frame.
+
+(start code)
+Loader loader;
+loader.setUploadBudget (4 << 20);
+AsyncTexture tex = loader.loadTexture ("grass.png");
+...
+loader.update (); // Once per frame.
+if (tex.isReady()) ...
+(end)
+*/
+class Loader
+{
+    struct _impl;
+    _impl* impl;
+
+    Loader (const Loader&);
+    Loader& operator= (const Loader&);
+
+public:
+
+    /*
+    Constructor: Loader
+
+    Parameters:
+
+    num_threads - Number of worker threads; 0 for one per hardware thread.
+    */
+    Loader (unsigned num_threads = 0);
+
+    /*
+    Destructor: ~Loader
+    Wait for the workers and discard any request that was not uploaded.
+
+    If textures were streamed, the OpenGL context must still be current: the
+    pixel buffers and partly uploaded textures are deleted.
+    */
+    ~Loader ();
+
+    /*
+    Function: loadModel
+    Queue the model at the given file path for loading.
+
+    The preset and flags are as in <Model::Model>.
+    */
+    AsyncModel loadModel (const char* path, ImportPreset preset = Import_Quality, unsigned flags = 0);
+
+    /*
+    Function: loadTexture
+    Queue the texture at the given file path for loading.
+
+    The texture is flipped vertically as done by load_texture.
+    */
+    AsyncTexture loadTexture (const char* path);
+
+    /*
+    Function: setUploadBudget
+    Set the number of texture bytes <update> uploads per call; 0, the
+    default, uploads whole textures.
+
+    Textures are uploaded by whole rows, and rows of 4x4 blocks for
+    compressed images. A texture only becomes ready once all of its levels
+    are uploaded. Models are uploaded whole regardless of the budget.
+
+    Uses ARB_buffer_storage and ARB_sync when available, and uploads from
+    client memory otherwise. Must be called from the OpenGL thread.
+    */
+    void setUploadBudget (size_t bytes);
+
+    /*
+    Function: update
+    Upload decoded requests to OpenGL.
+
+    Call once per frame from the OpenGL thread.
+
+    Parameters:
+
+    max_uploads - Maximum number of requests to complete in this call; 0 for no limit.
+    */
+    void update (unsigned max_uploads = 0);
+
+    /*
+    Function: finish
+    Block until every queued request has completed, uploading as they become ready.
+
+    Must be called from the OpenGL thread.
+    */
+    void finish ();
+
+    /*
+    Function: numPending
+    Return the number of requests that have not completed yet.
+    */
+    unsigned numPending () const;
+};
+
+} // namespace OGDT
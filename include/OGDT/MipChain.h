@@ -0,0 +1,77 @@
+#pragma once
+
+namespace OGDT
+{
+
+class Image;
+
+/*
+Class: MipChain
+The mipmap pyramid of an image, built on the CPU.
+
+Each level halves the previous one, rounding down, until a 1x1 level.
+Levels are built in parallel on <ThreadPool::global>, so a chain can be
+built on a worker thread while the GL thread only uploads it; see
+create_texture.
+*/
+class MipChain
+{
+    struct _impl;
+    _impl* impl;
+
+    MipChain (const MipChain&);
+    MipChain& operator= (const MipChain&);
+
+public:
+
+    /*
+    Enum: Filter
+    The filter used to shrink each level into the next.
+
+    Mip_Box - Average of 2x2 pixels. The fastest.
+    Mip_Kaiser - An 8-tap Kaiser-windowed sinc. Sharper, with less aliasing.
+    */
+    enum Filter
+    {
+        Mip_Box,
+        Mip_Kaiser
+    };
+
+    /*
+    Constructor: MipChain
+    Construct an empty chain.
+    */
+    MipChain ();
+
+    /*
+    Constructor: MipChain
+    Build the chain of the given image; see <build>.
+    */
+    MipChain (const Image& base, Filter filter = Mip_Box);
+
+    ~MipChain ();
+
+    /*
+    Function: build
+    Build the chain of the given image.
+
+    Levels have the base image's type. Image_F32 levels are filtered in
+    floating point without clamping, so HDR images keep their range. The
+    image serves as level 0 and must outlive the chain.
+    */
+    void build (const Image& base, Filter filter = Mip_Box);
+
+    /*
+    Function: numLevels
+    Return the number of levels, level 0 included; 0 if the chain is empty.
+    */
+    unsigned numLevels () const;
+
+    /*
+    Function: level
+    Return the given level.
+    */
+    const Image& level (unsigned i) const;
+};
+
+} // namespace OGDT
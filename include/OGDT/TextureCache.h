@@ -0,0 +1,109 @@
+#pragma once
+
+#include <OGDT/gl.h>
+
+namespace OGDT
+{
+
+struct texture_entry;
+
+/*
+Class: TextureCache
+A reference-counted cache of textures keyed by canonical file path.
+
+Every model referencing the same image file shares one decoded image and one
+OpenGL texture. Decoding is split from uploading so that it can run on a
+worker thread, as done by <Loader>. Images are flipped vertically as done by
+load_texture, and their mipmaps are built when they are decoded.
+*/
+class TextureCache
+{
+    struct _impl;
+    _impl* impl;
+
+    TextureCache (const TextureCache&);
+    TextureCache& operator= (const TextureCache&);
+
+public:
+
+    /*
+    Constructor: TextureCache
+    Create an empty cache.
+    */
+    TextureCache ();
+
+    /*
+    Destructor: ~TextureCache
+    Free the decoded images still held by the cache.
+
+    Textures are not deleted since the GL context may be gone by then;
+    release every entry beforehand.
+    */
+    ~TextureCache ();
+
+    /*
+    Function: decode
+    Return a reference to the entry for the image at the given path, decoding
+    the image if it is not cached yet.
+
+    Thread safe and does not touch OpenGL. Concurrent requests for the same
+    image decode it once. Throws if the image cannot be read.
+    */
+    texture_entry* decode (const char* path);
+
+    /*
+    Function: upload
+    Return the entry's texture, creating it on first call.
+
+    Must be called on the GL thread.
+    */
+    GLuint upload (texture_entry*);
+
+    /*
+    Function: release
+    Drop a reference obtained from <decode>. The texture is deleted when its
+    last reference is released.
+
+    Must be called on the GL thread.
+    */
+    void release (texture_entry*);
+
+    /*
+    Function: setContentHashing
+    Also match images by a hash of their file contents, so identical files
+    under different paths share a texture. Disabled by default.
+    */
+    void setContentHashing (bool enable);
+
+    /*
+    Function: hits
+    Return the number of <decode> calls served from the cache.
+    */
+    unsigned hits () const;
+
+    /*
+    Function: misses
+    Return the number of <decode> calls that decoded an image.
+    */
+    unsigned misses () const;
+
+    /*
+    Function: size
+    Return the number of images currently cached.
+    */
+    unsigned size () const;
+
+    /*
+    Function: resetCounters
+    Reset the hit and miss counters to 0.
+    */
+    void resetCounters ();
+
+    /*
+    Function: global
+    Return the library-wide cache used by <Model>, creating it on first use.
+    */
+    static TextureCache& global ();
+};
+
+} // namespace OGDT
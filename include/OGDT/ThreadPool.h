@@ -0,0 +1,84 @@
+#pragma once
+
+#include <functional>
+
+namespace OGDT
+{
+
+/*
+Class: ThreadPool
+A fixed-size pool of worker threads.
+*/
+class ThreadPool
+{
+    struct _impl;
+    _impl* impl;
+
+    ThreadPool (const ThreadPool&);
+    ThreadPool& operator= (const ThreadPool&);
+
+public:
+
+    /*
+    Typedef: Task
+    A unit of work.
+    */
+    typedef std::function<void ()> Task;
+
+    /*
+    Typedef: RangeTask
+    A unit of work over the half-open index range [begin, end).
+    */
+    typedef std::function<void (unsigned begin, unsigned end)> RangeTask;
+
+    /*
+    Constructor: ThreadPool
+    Create a pool with the given number of worker threads.
+
+    If num_threads is 0, one thread per hardware thread is created.
+    */
+    ThreadPool (unsigned num_threads = 0);
+
+    /*
+    Destructor: ~ThreadPool
+    Finish all queued tasks and join the worker threads.
+    */
+    ~ThreadPool ();
+
+    /*
+    Function: submit
+    Queue a task for execution on a worker thread.
+    */
+    void submit (const Task& task);
+
+    /*
+    Function: wait
+    Block until every queued task has finished.
+
+    Must not be called from a worker thread.
+    */
+    void wait ();
+
+    /*
+    Function: parallel_for
+    Run the given task over [0, n) split into chunks of at least grain indices.
+
+    The calling thread takes part in the work, so this is safe to call from
+    within a task running on this same pool. Returns when all chunks are done.
+    */
+    void parallel_for (unsigned n, const RangeTask& task, unsigned grain = 1);
+
+    /*
+    Function: numThreads
+    Return the number of worker threads.
+    */
+    unsigned numThreads () const;
+
+    /*
+    Function: global
+    Return the library-wide pool, creating it on first use.
+    */
+    static ThreadPool& global ();
+};
+
+} // namespace OGDT
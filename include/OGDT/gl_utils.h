@@ -3,6 +3,8 @@
 #include <OGDT/gl.h>
 #include <OGDT/Exception.h>
 
+namespace OGDT { class Image; class ImageView; class MipChain; class CompressedImage; }
+
 /*
 File: gl_utils
 */
@@ -22,6 +24,10 @@ A compiled OpenGL shader.
 */
 GLuint create_shader (const char* code, GLenum shader_type);
 
+/*
+Function: create_shader_from_file
+Create a shader from the given source file, read through <vfs>.
+*/
 GLuint create_shader_from_file (const char* path, GLenum shader_type);
 
 /*
@@ -56,7 +62,12 @@ GLuint create_program_from_files (const char* vertex_shader, const char* fragmen
 
 /*
 Function: load_texture
-Load the texture from the specified file path.
+Load the texture from the specified file path, read through <vfs>.
+
+DDS and KTX files are loaded as <CompressedImage>s and keep their stored
+mipmaps. Like other images they are flipped vertically, except BC7 images
+and BC1/BC3 images whose heights are not multiples of 4, which cannot be
+flipped without re-encoding and are uploaded as stored.
 
 Returns:
 
@@ -64,6 +75,87 @@ An OpenGL texture identifier.
 */
 GLuint load_texture (const char* path);
 
+/*
+Function: load_textures
+Load the textures from the given file paths.
+
+Images are decoded and their mipmaps built in parallel on
+<ThreadPool::global>; only the uploads run on the calling thread. Throws if
+any image cannot be read, in which case no texture is created.
+
+Parameters:
+
+paths - The file paths.
+n - Number of paths.
+textures - Receives one OpenGL texture identifier per path.
+*/
+void load_textures (const char* const* paths, unsigned n, GLuint* textures);
+
+/*
+Function: create_texture
+Create a mipmapped texture from the given image.
+
+Unlike load_texture, the image is uploaded as is and is not flipped.
+This only touches OpenGL, so the image can be decoded on another thread.
+
+Mipmaps are built with a box filter by <MipChain>. Images whose sides are
+not powers of two are rescaled by gluBuild2DMipmaps if the context lacks
+ARB_texture_non_power_of_two.
+
+Image_F32 images, such as pfm lightmaps, are uploaded as floats and stored
+as half floats if the context has ARB_texture_float.
+
+Returns:
+
+An OpenGL texture identifier.
+*/
+GLuint create_texture (const OGDT::Image& image);
+
+/*
+Function: create_texture
+Create a texture from the given mipmap chain, uploading each level as is.
+
+Like the above, this only touches OpenGL, so the chain can be built on
+another thread.
+
+Returns:
+
+An OpenGL texture identifier.
+*/
+GLuint create_texture (const OGDT::MipChain& mips);
+
+/*
+Function: create_texture
+Create a texture from the given compressed image, uploading each stored
+level with glCompressedTexImage2D.
+
+BC1 and BC3 images are decompressed on the CPU if the context lacks
+EXT_texture_compression_s3tc. BC7 images need ARB_texture_compression_bptc;
+an exception is thrown otherwise.
+
+Returns:
+
+An OpenGL texture identifier.
+*/
+GLuint create_texture (const OGDT::CompressedImage& image);
+
+/*
+Function: update_texture
+Replace a rectangle of a 2D texture level with the pixels of the given view.
+
+Views of part of a larger image, such as a tile of an atlas, are uploaded
+in place with GL_UNPACK_ROW_LENGTH, without copying them out first.
+
+Parameters:
+
+texture - The texture to update.
+level - The mipmap level to update.
+x - Left edge of the rectangle in the texture.
+y - Bottom edge of the rectangle in the texture.
+pixels - The new pixels; the rectangle has the view's size.
+*/
+void update_texture (GLuint texture, int level, int x, int y, const OGDT::ImageView& pixels);
+
 /*
 Function: get_uniform
 Get the location of the specified uniform.
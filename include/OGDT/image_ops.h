@@ -0,0 +1,103 @@
+#pragma once
+
+#include <OGDT/types.h>
+#include <cstddef>
+
+/*
+File: image_ops
+Whole-image pixel conversions, vectorised with SSE2 where available.
+
+Every kernel works on rows of pixels with an explicit stride, the distance
+in bytes between the starts of consecutive rows. Tightly packed images have
+a stride of width * components * component size; larger strides address a
+sub-rectangle of a larger image. Source and destination must not overlap
+unless a kernel works in place.
+
+Kernels run on the calling thread; split large images by rows to run them
+on <ThreadPool::global>.
+*/
+
+namespace OGDT
+{
+
+/*
+Function: rgb_to_rgba
+Expand 8-bit RGB pixels to RGBA with the given alpha.
+*/
+void rgb_to_rgba (const U8* src, size_t src_stride, U8* dst, size_t dst_stride,
+                  int width, int height, U8 alpha = 255);
+
+/*
+Function: u8_to_f32
+Convert 8-bit samples to floats in the range [0,1].
+
+Parameters:
+
+components - Number of samples per pixel; all are converted.
+*/
+void u8_to_f32 (const U8* src, size_t src_stride, float* dst, size_t dst_stride,
+                int width, int height, int components);
+
+/*
+Function: f32_to_u8
+Convert floats to 8-bit samples, clamping to [0,1] and rounding. NaNs become 0.
+*/
+void f32_to_u8 (const float* src, size_t src_stride, U8* dst, size_t dst_stride,
+                int width, int height, int components);
+
+/*
+Function: premultiply_alpha
+Multiply the colour of 8-bit RGBA pixels by their alpha, in place, with exact rounding.
+*/
+void premultiply_alpha (U8* pixels, size_t stride, int width, int height);
+
+/*
+Function: swizzle
+Reorder the channels of 8-bit RGBA pixels.
+
+Output channel k is read from input channel order[k], so order {2,1,0,3}
+converts between RGBA and BGRA. src may equal dst.
+*/
+void swizzle (const U8* src, size_t src_stride, U8* dst, size_t dst_stride,
+              int width, int height, const int order[4]);
+
+/*
+Function: srgb_to_linear
+Decode 8-bit sRGB samples to linear floats.
+
+If components is 4, the last channel is alpha and is only scaled to [0,1].
+*/
+void srgb_to_linear (const U8* src, size_t src_stride, float* dst, size_t dst_stride,
+                     int width, int height, int components);
+
+/*
+Function: linear_to_srgb
+Encode linear floats to 8-bit sRGB samples, clamping to [0,1].
+
+Each value gets its nearest sRGB code, found through a table rather than
+a pow per sample. If components is 4, the last channel is alpha and is
+converted as by <f32_to_u8>.
+*/
+void linear_to_srgb (const float* src, size_t src_stride, U8* dst, size_t dst_stride,
+                     int width, int height, int components);
+
+/*
+Function: downscale2
+Halve an 8-bit image by averaging 2x2 blocks, with rounding.
+
+The destination is max(1, width/2) by max(1, height/2). An odd last row
+or column of the source is dropped, and single rows or columns are
+averaged in the other direction only. <MipChain> builds its box levels
+with this.
+*/
+void downscale2 (const U8* src, size_t src_stride, U8* dst, size_t dst_stride,
+                 int width, int height, int components);
+
+/*
+Function: downscale2
+Halve a float image by averaging 2x2 blocks.
+*/
+void downscale2 (const float* src, size_t src_stride, float* dst, size_t dst_stride,
+                 int width, int height, int components);
+
+} // namespace OGDT
@@ -31,8 +31,55 @@ struct Animation
     */
     const unsigned id;
 
-    Animation (const char* _name, float d, const unsigned _id)
-        : name (_name), duration (d), id (_id) {}
+    /*
+    Variable: start
+    The animation's first frame.
+    */
+    const unsigned start;
+
+    Animation (const char* _name, float d, const unsigned _id, const unsigned _start = 0)
+        : name (_name), duration (d), id (_id), start (_start) {}
+};
+
+/*
+Struct: FramePair
+The two frames to interpolate between when rendering an animated model.
+*/
+struct FramePair
+{
+    /*
+    Variable: frame1
+    The frame being interpolated from.
+    */
+    unsigned frame1;
+
+    /*
+    Variable: frame2
+    The frame being interpolated to.
+    */
+    unsigned frame2;
+
+    /*
+    Variable: p
+    The interpolation factor in [0,1).
+    */
+    float p;
+};
+
+/*
+Enum: ImportPreset
+How much post-processing to run when importing a model through assimp.
+MD2 models are not affected.
+
+Import_Fast - Only what rendering needs: triangulate, generate missing normals and split meshes by primitive type. Suited to assets optimised offline.
+Import_Quality - aiProcessPreset_TargetRealtime_MaxQuality. The default.
+Import_Custom - Run exactly the given aiPostProcessSteps flags.
+*/
+enum ImportPreset
+{
+    Import_Fast,
+    Import_Quality,
+    Import_Custom
 };
 
 /*
@@ -47,13 +94,32 @@ class Model
     Model (const Model&);
     Model& operator= (const Model&);
 
+    friend class Loader;
+
+    // Construct an empty model to be filled in by decode() and upload().
+    Model ();
+
+    // Read and decode the model and its textures. Does not touch OpenGL.
+    void decode (const char* path, ImportPreset preset, unsigned flags);
+
+    // Create the model's OpenGL resources. Must run on the GL thread.
+    void upload ();
+
 public:
 
     /*
      Constructor: Model
      Load a model from the specified file path.
+
+     See <Loader> to load models in the background.
+
+     Parameters:
+
+     path - The model's file path.
+     preset - Post-processing to run on models imported through assimp.
+     flags - aiPostProcessSteps flags; only used with Import_Custom.
     */
-    Model (const char* path);
+    Model (const char* path, ImportPreset preset = Import_Quality, unsigned flags = 0);
 
     ~Model ();
 
@@ -65,8 +131,115 @@ public:
     
     t - Animation time.
     anim - Animation to display.
+    lod - Level of detail; see <buildLods>.
+    */
+    void render (float t = 0.0f, const Animation* anim = nullptr, unsigned lod = 0) const;
+
+    /*
+    Function: render
+    Render the model blending two animation states.
+
+    Both states are evaluated and mixed in a single pass over the vertices.
+
+    Parameters:
+
+    t1 - Time into the first animation.
+    anim1 - First animation; null for the model's first frame.
+    t2 - Time into the second animation.
+    anim2 - Second animation; null for the model's first frame.
+    w - Blend weight in [0,1]; 0 shows only the first state, 1 only the second.
+    lod - Level of detail; see <buildLods>.
     */
-    void render (float t = 0.0f, const Animation* anim = nullptr) const;
+    void render (float t1, const Animation* anim1, float t2, const Animation* anim2, float w, unsigned lod = 0) const;
+
+    /*
+    Function: renderFrames
+    Render the model interpolated between two frames.
+
+    Parameters:
+
+    frame1 - The frame to interpolate from.
+    frame2 - The frame to interpolate to.
+    p - Interpolation factor.
+    lod - Level of detail; see <buildLods>.
+    */
+    void renderFrames (unsigned frame1, unsigned frame2, float p, unsigned lod = 0) const;
+
+    /*
+    Function: renderInstanced
+    Render many instances of the model.
+
+    Animated models are drawn with a single instanced draw call when the
+    context supports OpenGL 3.3. Every frame is then kept in a buffer on the
+    GPU; it is built on the first call and rebuilt after the model is
+    transformed. Otherwise each instance is rendered in turn.
+
+    Parameters:
+
+    transforms - One column-major 4x4 matrix per instance, applied on top of the current modelview matrix.
+    frames - One frame pair per instance, such as <InstancePool::frames>; null to render frame 0.
+    count - Number of instances.
+    lod - Level of detail of every instance; see <buildLods>.
+    */
+    void renderInstanced (const float* transforms, const FramePair* frames, unsigned count, unsigned lod = 0) const;
+
+    /*
+    Function: buildLods
+    Build up to the given number of coarser levels of detail.
+
+    Each level has about half the triangles of the previous one and is made
+    by quadric-error edge collapses. Texture seams and mesh borders are
+    kept. Animated models share one set of levels across all their frames,
+    with collapse costs measured over a sample of the frames. Levels only
+    index the model's vertices, so they cost no extra vertex memory.
+
+    Levels that would barely simplify the previous one are dropped; see
+    <numLods>. Must be called on the GL thread.
+
+    Parameters:
+
+    levels - Number of levels besides the full model, up to 3.
+    */
+    void buildLods (unsigned levels = 3);
+
+    /*
+    Function: numLods
+    Return the number of levels of detail, the full model included.
+    */
+    unsigned numLods () const;
+
+    /*
+    Function: setLodThreshold
+    Set the screen size used by <selectLod>.
+
+    Level 0 is used while the model's bounding sphere covers at least the
+    given diameter in pixels, level 1 down to half of it, level 2 down to a
+    quarter, and so on. Defaults to 256.
+    */
+    void setLodThreshold (float pixels);
+
+    /*
+    Function: selectLod
+    Return the level of detail to render the model with under the current
+    modelview and projection matrices and viewport.
+    */
+    unsigned selectLod () const;
+
+    /*
+    Function: setHardwareMorphing
+    Enable or disable interpolating animation frames in a vertex shader.
+
+    Disabled by default; it takes effect when the context supports OpenGL 2.0.
+    Every frame is then uploaded once and rendering costs the CPU the same
+    regardless of the model's vertex count.
+
+    The shader only approximates the fixed-function pipeline: it applies the
+    current colour, texture unit 0 and light 0 as a directional light, and
+    ignores materials, specular lighting, fog and texture environments. It
+    also replaces any program of your own for the duration of the draw; the
+    previously bound program is restored afterwards.
+    */
+    void setHardwareMorphing (bool enable);
 
     /*
     Function: isAnimated
@@ -77,6 +250,10 @@ public:
     /*
     Function: getAnimation
     Return the animation specified by the given name if it exists, null otherwise.
+
+    Lookups go through a hash index built at load time. The returned pointer
+    stays valid for the model's lifetime, so it can be kept as a handle and
+    passed to <ModelInstance::setAnimation> to skip the lookup altogether.
     */
     const Animation* getAnimation (const char* name) const;
 
@@ -137,8 +314,31 @@ public:
     /*
      * Function: computeAABB
      * Compute the given frame's AABB.
+     *
+     * Models loaded through assimp have a single frame. Their world-space
+     * bounds, node transforms included, are computed once at load time.
      */
     void computeAABB (float& xmin, float& xmax, float& ymin, float& ymax, float& zmin, float& zmax, unsigned frame = 0) const;
+
+    /*
+     * Function: numNodes
+     * Return the number of nodes of a model loaded through assimp; 0 otherwise.
+     */
+    unsigned numNodes () const;
+
+    /*
+     * Function: computeNodeAABB
+     * Get the world-space AABB of the given node and its descendants.
+     *
+     * Nodes are numbered depth first from the root, node 0. The node's
+     * descendants are numbered from node+1 up to the returned value, so a
+     * culling pass can skip a whole subtree whose bounds are out of view.
+     * Bounds of subtrees without geometry have xmin > xmax.
+     *
+     * Throws if node is not below <numNodes>, as for any model loaded from an
+     * MD2 file.
+     */
+    unsigned computeNodeAABB (unsigned node, float& xmin, float& xmax, float& ymin, float& ymax, float& zmin, float& zmax) const;
 };
 
 /*
@@ -180,6 +380,44 @@ public:
      */
     void setAnimation (const char* name, bool loop = true);
 
+    /*
+     * Function: setAnimation
+     * Set the current animation to the given one, as returned by <Model::getAnimation>.
+     *
+     * Parameters:
+     *
+     * anim - The animation to play. Must belong to this instance's model.
+     * loop - Whether the animation should play in a loop.
+     */
+    void setAnimation (const Animation& anim, bool loop = true);
+
+    /*
+     * Function: crossFade
+     * Fade from the current animation into the one specified by the given name.
+     *
+     * The current animation keeps playing while it fades out. If no animation
+     * is being played this is the same as setAnimation.
+     *
+     * Parameters:
+     *
+     * name - The animation to fade into.
+     * duration - Duration of the fade, in the same units as update's dt.
+     * loop - Whether the new animation should play in a loop.
+     */
+    void crossFade (const char* name, float duration, bool loop = true);
+
+    /*
+     * Function: crossFade
+     * Fade from the current animation into the given one, as returned by <Model::getAnimation>.
+     */
+    void crossFade (const Animation& anim, float duration, bool loop = true);
+
+    /*
+     * Function: isFading
+     * Return true if a cross fade is in progress.
+     */
+    bool isFading () const;
+
     /*
      * Function: getAnimation
      * Get the current animation's name, or an empty string if no animation is being played.
@@ -209,9 +447,108 @@ public:
 
     /*
      * Function: render
-     * Render the model.
+     * Render the model at the level of detail given by <Model::selectLod>.
      */
     void render () const;
 };
 
+/*
+Class: InstancePool
+Animation state for many instances of one Model, stored as parallel arrays.
+
+All instances are advanced by a single <update> call. Its output is one
+<FramePair> per instance, ready to be rendered or uploaded for instancing.
+
+Instances are addressed by index. Removing an instance moves the last
+instance into the freed index.
+*/
+class InstancePool
+{
+    struct _impl;
+    _impl* impl;
+
+    InstancePool (const InstancePool&);
+    InstancePool& operator= (const InstancePool&);
+
+public:
+
+    /*
+    Constructor: InstancePool
+    Construct an empty pool of instances of the given model.
+
+    Parameters:
+
+    model - The model shared by every instance.
+    capacity - Number of instances to reserve space for.
+    */
+    InstancePool (const Model& model, unsigned capacity = 0);
+
+    ~InstancePool ();
+
+    /*
+    Function: add
+    Add an instance that plays no animation and return its index.
+    */
+    unsigned add ();
+
+    /*
+    Function: remove
+    Remove the instance at the given index.
+
+    The last instance is moved into the index, unless it was the one removed.
+    */
+    void remove (unsigned i);
+
+    /*
+    Function: size
+    Return the number of instances.
+    */
+    unsigned size () const;
+
+    /*
+    Function: setAnimation
+    Set the given instance's animation, as returned by <Model::getAnimation>.
+    */
+    void setAnimation (unsigned i, const Animation& anim, bool loop = true);
+
+    /*
+    Function: setAnimationSpeed
+    Set the given instance's animation speed.
+
+    Negative speeds play the animation backwards. Animations that do not
+    loop then stop at their first frame.
+    */
+    void setAnimationSpeed (unsigned i, float speed);
+
+    /*
+    Function: getAnimation
+    Return the given instance's animation, or null if it plays none.
+    */
+    const Animation* getAnimation (unsigned i) const;
+
+    /*
+    Function: isAnimationDone
+    Return true if the given instance's animation is done or it plays none.
+    */
+    bool isAnimationDone (unsigned i) const;
+
+    /*
+    Function: update
+    Advance every instance's animation and recompute its frames.
+    */
+    void update (float dt);
+
+    /*
+    Function: frames
+    Return the frames computed by the last <update>, one per instance.
+    */
+    const FramePair* frames () const;
+
+    /*
+    Function: render
+    Render the given instance using the frames computed by the last <update>.
+    */
+    void render (unsigned i) const;
+};
+
 } // namespace OGDT
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <OGDT/types.h>
+#include <cstddef>
+
+/*
+File: vfs
+A virtual file layer over mounted archives and the disk.
+
+Paths are looked up in the mounted <Archive>s, the last mounted first, and
+then on disk. Image::from_file, CompressedImage::from_file, load_texture,
+Model and create_shader_from_file all read through it, so mounting a pak
+file redirects an application's loads into it without other changes.
+
+Paths are normalised before lookup: backslashes become slashes, and "."
+and ".." components are resolved, so "data/models/../textures/a.png"
+finds "data/textures/a.png".
+*/
+
+namespace OGDT
+{
+
+/*
+Class: FileData
+The contents of a file read with <vfs_read>.
+
+Stored archive entries and disk files of 64 KB or more are viewed in place,
+mapped into memory. Compressed entries are decompressed, and smaller disk
+files read, into a buffer the object owns.
+The data stays valid while the object lives, even if its archive is
+unmounted meanwhile.
+*/
+class FileData
+{
+    struct _impl;
+    _impl* impl;
+
+    FileData (const FileData&);
+    FileData& operator= (const FileData&);
+
+    friend bool vfs_read (const char* path, FileData& file);
+
+public:
+
+    FileData ();
+
+    ~FileData ();
+
+    /*
+    Function: data
+    Return the file's contents; null if the file is empty.
+    */
+    const U8* data () const;
+
+    /*
+    Function: size
+    Return the size of the file in bytes.
+    */
+    size_t size () const;
+
+    /*
+    Function: clear
+    Release the contents.
+    */
+    void clear ();
+};
+
+/*
+Function: vfs_mount
+Open a pak file and make its files visible under the given directory.
+
+With a mount point of "data", the archive's "textures/a.png" is read as
+"data/textures/a.png". The default mounts the archive at the root. An
+exception is thrown if the archive cannot be opened.
+
+Mounting is safe while other threads read files.
+*/
+void vfs_mount (const char* archive, const char* mount_point = "");
+
+/*
+Function: vfs_unmount
+Unmount every mount of the given pak file.
+*/
+void vfs_unmount (const char* archive);
+
+/*
+Function: vfs_unmount_all
+Unmount every archive.
+*/
+void vfs_unmount_all ();
+
+/*
+Function: vfs_exists
+Return true if the given path names a file in a mounted archive or on disk.
+*/
+bool vfs_exists (const char* path);
+
+/*
+Function: vfs_read
+Read the file at the given path from a mounted archive, or from disk.
+
+Returns false if the file is found in neither. An exception is thrown if
+an archived file is corrupt.
+*/
+bool vfs_read (const char* path, FileData& file);
+
+} // namespace OGDT
@@ -0,0 +1,251 @@
+#include <OGDT/Archive.h>
+#include <OGDT/Exception.h>
+#include "lz4.h"
+#include "mapped_file.h"
+#include "pak.h"
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+using namespace OGDT;
+using namespace std;
+
+namespace {
+
+U32 get_u32 (const U8* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((U32) p[3] << 24);
+}
+
+U64 get_u64 (const U8* p) {
+    return get_u32 (p) | ((U64) get_u32 (p + 4) << 32);
+}
+
+void put_u32 (vector<U8>& out, U32 v) {
+    for (int i = 0; i < 4; ++i) out.push_back ((U8) (v >> (8*i)));
+}
+
+void put_u64 (vector<U8>& out, U64 v) {
+    for (int i = 0; i < 8; ++i) out.push_back ((U8) (v >> (8*i)));
+}
+
+struct pak_entry
+{
+    string name;
+    U64 offset;
+    U64 stored;
+    U64 size;
+    U32 flags;
+};
+
+void pak_error (const char* path, const char* what) {
+    ostringstream os;
+    os << "Failed reading archive " << path << ": " << what;
+    throw EXCEPTION (os);
+}
+
+void write_error (const char* path) {
+    ostringstream os;
+    os << "Failed writing archive " << path;
+    throw EXCEPTION (os);
+}
+
+} // namespace
+
+string normalize_path (const char* path) {
+    vector<string> parts;
+    string part;
+    bool absolute = *path == '/' || *path == '\\';
+    for (const char* p = path; ; ++p) {
+        if (*p && *p != '/' && *p != '\\') {
+            part += *p;
+            continue;
+        }
+        if (part == "..") {
+            if (!parts.empty() && parts.back() != "..") parts.pop_back ();
+            else if (!absolute) parts.push_back (part);
+        }
+        else if (!part.empty() && part != ".") parts.push_back (part);
+        part.clear ();
+        if (!*p) break;
+    }
+    string out = absolute ? "/" : "";
+    for (size_t i = 0; i < parts.size(); ++i) {
+        if (i) out += '/';
+        out += parts[i];
+    }
+    return out;
+}
+
+struct Archive::_impl
+{
+    mapped_file file;
+    vector<pak_entry> entries;
+    unordered_map<string, unsigned> by_name;
+};
+
+Archive::Archive () : impl (new _impl) {}
+
+Archive::Archive (const char* path) : impl (new _impl) {
+    try {
+        open (path);
+    }
+    catch (...) {
+        delete impl;
+        throw;
+    }
+}
+
+Archive::~Archive () {
+    delete impl;
+}
+
+void Archive::open (const char* path) {
+    close ();
+    mapped_file& file = impl->file;
+    if (!file.open (path)) pak_error (path, "cannot open file");
+    try {
+        const U8* data = file.data;
+        if (file.size < pak_header_size || memcmp (data, pak_magic, 8) != 0) pak_error (path, "not a pak file");
+        if (get_u32 (data + 8) != pak_version) pak_error (path, "unsupported version");
+        U32 count = get_u32 (data + 12);
+        U64 index = get_u64 (data + 16);
+        U64 index_size = get_u64 (data + 24);
+        if (index > file.size || index_size > file.size - index) pak_error (path, "index out of bounds");
+        if (count > index_size / 32) pak_error (path, "truncated index");
+
+        const U8* p = data + index;
+        const U8* end = p + index_size;
+        impl->entries.resize (count);
+        for (U32 i = 0; i < count; ++i) {
+            if (end - p < 32) pak_error (path, "truncated index");
+            pak_entry& e = impl->entries[i];
+            e.offset = get_u64 (p);
+            e.stored = get_u64 (p + 8);
+            e.size = get_u64 (p + 16);
+            e.flags = get_u32 (p + 24);
+            U32 len = get_u32 (p + 28);
+            p += 32;
+            if ((U64) (end - p) < len) pak_error (path, "truncated index");
+            e.name.assign ((const char*) p, len);
+            p += len;
+            if (e.offset > file.size || e.stored > file.size - e.offset) pak_error (path, "file out of bounds");
+            if (!(e.flags & pak_lz4) && e.stored != e.size) pak_error (path, "bad file size");
+            impl->by_name[e.name] = i;
+        }
+    }
+    catch (...) {
+        close ();
+        throw;
+    }
+}
+
+void Archive::close () {
+    impl->file.close ();
+    impl->entries.clear ();
+    impl->by_name.clear ();
+}
+
+unsigned Archive::numEntries () const {
+    return impl->entries.size();
+}
+
+const char* Archive::name (unsigned i) const {
+    return impl->entries[i].name.c_str();
+}
+
+int Archive::find (const char* name) const {
+    auto it = impl->by_name.find (name);
+    return it == impl->by_name.end() ? -1 : (int) it->second;
+}
+
+size_t Archive::size (unsigned i) const {
+    return impl->entries[i].size;
+}
+
+bool Archive::compressed (unsigned i) const {
+    return (impl->entries[i].flags & pak_lz4) != 0;
+}
+
+const U8* Archive::data (unsigned i) const {
+    const pak_entry& e = impl->entries[i];
+    return (e.flags & pak_lz4) ? nullptr : impl->file.data + e.offset;
+}
+
+void Archive::read (unsigned i, U8* out) const {
+    const pak_entry& e = impl->entries[i];
+    const U8* src = impl->file.data + e.offset;
+    if (!(e.flags & pak_lz4)) {
+        memcpy (out, src, e.size);
+    }
+    else if (!lz4_decompress (src, e.stored, out, e.size)) {
+        ostringstream os;
+        os << "Failed reading archive: corrupt data in " << e.name;
+        throw EXCEPTION (os);
+    }
+}
+
+void OGDT::write_archive (const char* path, const char* const* names, const char* const* files,
+                          unsigned n, bool compress) {
+    FILE* f = fopen (path, "wb");
+    if (!f) write_error (path);
+    try {
+        vector<U8> index;
+        vector<U8> buffer;
+        U64 offset = pak_header_size;
+        static const U8 zeros[pak_alignment] = { 0 };
+        U8 header[pak_header_size] = { 0 };
+        if (fwrite (header, 1, pak_header_size, f) != pak_header_size) write_error (path);
+
+        for (unsigned i = 0; i < n; ++i) {
+            mapped_file in;
+            if (!in.open (files[i])) {
+                ostringstream os;
+                os << "Failed writing archive " << path << ": cannot open " << files[i];
+                throw EXCEPTION (os);
+            }
+            const U8* data = in.data;
+            size_t stored = in.size;
+            U32 flags = 0;
+            if (compress && in.size > 0) {
+                buffer.resize (lz4_bound (in.size));
+                size_t c = lz4_compress (in.data, in.size, &buffer[0], buffer.size());
+                if (c && c < in.size) {
+                    data = &buffer[0];
+                    stored = c;
+                    flags = pak_lz4;
+                }
+            }
+            size_t pad = (pak_alignment - offset % pak_alignment) % pak_alignment;
+            if (fwrite (zeros, 1, pad, f) != pad) write_error (path);
+            offset += pad;
+            if (stored && fwrite (data, 1, stored, f) != stored) write_error (path);
+
+            string name = normalize_path (names[i]);
+            put_u64 (index, offset);
+            put_u64 (index, stored);
+            put_u64 (index, in.size);
+            put_u32 (index, flags);
+            put_u32 (index, name.size());
+            index.insert (index.end(), name.begin(), name.end());
+            offset += stored;
+        }
+        if (!index.empty() && fwrite (&index[0], 1, index.size(), f) != index.size()) write_error (path);
+
+        vector<U8> h (pak_magic, pak_magic + 8);
+        put_u32 (h, pak_version);
+        put_u32 (h, n);
+        put_u64 (h, offset);
+        put_u64 (h, index.size());
+        if (fseek (f, 0, SEEK_SET) != 0 || fwrite (&h[0], 1, h.size(), f) != h.size()) write_error (path);
+        FILE* done = f;
+        f = nullptr;
+        if (fclose (done) != 0) write_error (path);
+    }
+    catch (...) {
+        if (f) fclose (f);
+        remove (path);
+        throw;
+    }
+}
@@ -0,0 +1,290 @@
+#include <OGDT/Atlas.h>
+#include <OGDT/Exception.h>
+#include <OGDT/Image.h>
+#include <OGDT/ThreadPool.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+using namespace OGDT;
+using namespace std;
+
+namespace {
+
+struct skyline_node
+{
+    int x, y, w;
+};
+
+// Bottom-left skyline packer. The skyline is the top edge of the packed
+// rectangles, as a list of horizontal segments in left to right order.
+class skyline
+{
+    int W, H;
+    vector<skyline_node> nodes;
+
+    // Return the lowest y at which a w x h rectangle fits with its left edge
+    // at node i, or -1 if it does not fit there.
+    int fit (size_t i, int w, int h) const {
+        int x = nodes[i].x;
+        if (x + w > W) return -1;
+        int y = 0;
+        for (size_t j = i; j < nodes.size() && nodes[j].x < x + w; ++j) {
+            y = max (y, nodes[j].y);
+            if (y + h > H) return -1;
+        }
+        return y;
+    }
+
+public:
+
+    skyline (int width, int height) : W (width), H (height) {
+        skyline_node root = { 0, 0, width };
+        nodes.push_back (root);
+    }
+
+    bool insert (int w, int h, int& x, int& y) {
+        size_t best = nodes.size();
+        int best_top = INT_MAX;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            int fy = fit (i, w, h);
+            if (fy >= 0 && fy + h < best_top) {
+                best = i;
+                best_top = fy + h;
+                y = fy;
+            }
+        }
+        if (best == nodes.size()) return false;
+        x = nodes[best].x;
+
+        // Replace the segments under the rectangle by its top edge.
+        size_t j = best;
+        while (j < nodes.size() && nodes[j].x < x + w) {
+            int right = nodes[j].x + nodes[j].w;
+            if (right > x + w) {
+                nodes[j].w = right - (x + w);
+                nodes[j].x = x + w;
+                break;
+            }
+            ++j;
+        }
+        skyline_node top = { x, y + h, w };
+        nodes.erase (nodes.begin() + best, nodes.begin() + j);
+        nodes.insert (nodes.begin() + best, top);
+
+        if (best + 1 < nodes.size() && nodes[best+1].y == top.y) {
+            nodes[best].w += nodes[best+1].w;
+            nodes.erase (nodes.begin() + best + 1);
+        }
+        if (best > 0 && nodes[best-1].y == top.y) {
+            nodes[best-1].w += nodes[best].w;
+            nodes.erase (nodes.begin() + best);
+        }
+        return true;
+    }
+};
+
+int next_pow2 (int x) {
+    int p = 1;
+    while (p < x) p <<= 1;
+    return p;
+}
+
+int align_up (int x, int alignment) {
+    return (x + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+struct Atlas::_impl
+{
+    struct entry
+    {
+        const Image* image; // Null for empty rectangles.
+        int w, h;
+        int cx, cy, cw, ch; // The cell: the image, its gutter and its alignment padding.
+    };
+
+    int padding;
+    int alignment;
+    int components;
+    Image::DataType type;
+    vector<entry> entries;
+    vector<Region> regions;
+    int W, H;
+    Image* atlas;
+
+    _impl (int p, int a)
+        : padding (p), alignment (a), components (0), type (Image::Image_U8),
+          W (0), H (0), atlas (new Image) {}
+
+    ~_impl () {
+        delete atlas;
+    }
+
+    unsigned add (const Image* image, int w, int h) {
+        if (w <= 0 || h <= 0) {
+            ostringstream os;
+            os << "Atlas::add: invalid size " << w << "x" << h;
+            throw EXCEPTION (os);
+        }
+        entry e = { image, w, h, 0, 0, align_up (w + 2*padding, alignment), align_up (h + 2*padding, alignment) };
+        entries.push_back (e);
+        return entries.size() - 1;
+    }
+
+    bool try_pack (const vector<unsigned>& order, int width, int height) {
+        skyline sky (width, height);
+        for (unsigned i : order) {
+            entry& e = entries[i];
+            if (!sky.insert (e.cw, e.ch, e.cx, e.cy)) return false;
+        }
+        return true;
+    }
+
+    void copy (const entry& e) {
+        size_t ps = (size_t) components * atlas->dataSize();
+        ImageView cell = atlas->view (e.cx, e.cy, e.cw, e.ch);
+        const ImageView src = e.image->view ();
+        int right = e.cw - padding - e.w; // Right gutter and alignment padding.
+        for (int y = 0; y < e.h; ++y) {
+            U8* row = cell.row (padding + y);
+            const U8* s = src.row (y);
+            for (int x = 0; x < padding; ++x) memcpy (row + x * ps, s, ps);
+            memcpy (row + padding * ps, s, src.rowSize());
+            U8* last = row + (padding + e.w - 1) * ps;
+            for (int x = 1; x <= right; ++x) memcpy (last + x * ps, last, ps);
+        }
+        size_t n = cell.rowSize();
+        for (int y = 0; y < padding; ++y) memcpy (cell.row (y), cell.row (padding), n);
+        for (int y = padding + e.h; y < e.ch; ++y) memcpy (cell.row (y), cell.row (padding + e.h - 1), n);
+    }
+};
+
+Atlas::Atlas (int padding, int alignment) : impl (new _impl (padding, alignment)) {
+    if (padding < 0 || alignment < 1 || (alignment & (alignment - 1))) {
+        delete impl;
+        ostringstream os;
+        os << "Atlas: invalid padding " << padding << " or alignment " << alignment;
+        throw EXCEPTION (os);
+    }
+}
+
+Atlas::~Atlas () {
+    delete impl;
+}
+
+unsigned Atlas::add (const Image& image) {
+    if (impl->components == 0) {
+        impl->components = image.numComponents();
+        impl->type = image.dataType();
+    }
+    else if (image.numComponents() != impl->components || image.dataType() != impl->type) {
+        throw EXCEPTION ("Atlas::add: all images must have the same number of components and data type");
+    }
+    return impl->add (&image, image.width(), image.height());
+}
+
+unsigned Atlas::add (int width, int height) {
+    return impl->add (nullptr, width, height);
+}
+
+void Atlas::pack (int max_size) {
+    vector<_impl::entry>& entries = impl->entries;
+    // Tallest first, then widest, packs the skyline tightest.
+    vector<unsigned> order (entries.size());
+    size_t area = 0;
+    int min_w = 1, min_h = 1;
+    for (unsigned i = 0; i < entries.size(); ++i) {
+        order[i] = i;
+        area += (size_t) entries[i].cw * entries[i].ch;
+        min_w = max (min_w, entries[i].cw);
+        min_h = max (min_h, entries[i].ch);
+    }
+    sort (order.begin(), order.end(), [&] (unsigned a, unsigned b) {
+        if (entries[a].ch != entries[b].ch) return entries[a].ch > entries[b].ch;
+        return entries[a].cw > entries[b].cw;
+    });
+
+    // Start from the smallest power-of-two size that holds the total area
+    // and grow the shorter side until everything fits.
+    int w = next_pow2 (max (min_w, (int) ceil (sqrt ((double) area))));
+    int h = next_pow2 (max (min_h, (int) ((area + w - 1) / w)));
+    while (!impl->try_pack (order, w, h)) {
+        if (h < w) h *= 2;
+        else w *= 2;
+        if (w > max_size || h > max_size) {
+            ostringstream os;
+            os << "Atlas::pack: " << entries.size() << " images do not fit in "
+               << max_size << "x" << max_size;
+            throw EXCEPTION (os);
+        }
+    }
+    if (w > max_size || h > max_size) {
+        ostringstream os;
+        os << "Atlas::pack: an image does not fit in " << max_size << "x" << max_size;
+        throw EXCEPTION (os);
+    }
+
+    impl->W = w;
+    impl->H = h;
+    impl->regions.resize (entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const _impl::entry& e = entries[i];
+        Region& r = impl->regions[i];
+        r.x = e.cx + impl->padding;
+        r.y = e.cy + impl->padding;
+        r.width = e.w;
+        r.height = e.h;
+        r.u0 = (float) r.x / w;
+        r.v0 = (float) r.y / h;
+        r.u1 = (float) (r.x + r.width) / w;
+        r.v1 = (float) (r.y + r.height) / h;
+    }
+}
+
+void Atlas::build (int max_size) {
+    pack (max_size);
+    int c = impl->components ? impl->components : 4;
+    Image* atlas = new Image (impl->W, impl->H, c, impl->type);
+    delete impl->atlas;
+    impl->atlas = atlas;
+    ImageView all = impl->atlas->view ();
+    all.forEachSpan ([] (U8* p, size_t n) { memset (p, 0, n); });
+    _impl* im = impl;
+    ThreadPool::global().parallel_for (impl->entries.size(), [im] (unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; ++i) {
+            if (im->entries[i].image) im->copy (im->entries[i]);
+        }
+    }, 16);
+}
+
+const Image& Atlas::image () const {
+    return *impl->atlas;
+}
+
+unsigned Atlas::numRegions () const {
+    return impl->entries.size();
+}
+
+const Atlas::Region& Atlas::region (unsigned i) const {
+    return impl->regions[i];
+}
+
+int Atlas::width () const {
+    return impl->W;
+}
+
+int Atlas::height () const {
+    return impl->H;
+}
+
+float Atlas::occupancy () const {
+    if (impl->W == 0) return 0.0f;
+    size_t used = 0;
+    for (const _impl::entry& e : impl->entries) used += (size_t) e.w * e.h;
+    return (float) used / ((float) impl->W * impl->H);
+}
@@ -0,0 +1,402 @@
+#include <OGDT/CompressedImage.h>
+#include <OGDT/Exception.h>
+#include <OGDT/Image.h>
+#include <OGDT/MipChain.h>
+#include <OGDT/ThreadPool.h>
+#include <OGDT/vfs.h>
+#include "bcn.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+using namespace OGDT;
+using namespace std;
+
+namespace {
+
+// DDS header fields and flags.
+const U32 DDSD_MIPMAPCOUNT  = 0x20000;
+const U32 DDSD_REQUIRED     = 0x1 | 0x2 | 0x4 | 0x1000; // Caps, height, width, pixel format.
+const U32 DDSD_LINEARSIZE   = 0x80000;
+const U32 DDSD_DEPTH        = 0x800000;
+const U32 DDPF_FOURCC       = 0x4;
+const U32 DDSCAPS_COMPLEX   = 0x8;
+const U32 DDSCAPS_TEXTURE   = 0x1000;
+const U32 DDSCAPS_MIPMAP    = 0x400000;
+const U32 DDSCAPS2_CUBEMAP  = 0x200;
+const U32 DDS_DIMENSION_2D  = 3;
+const size_t DDS_HEADER     = 128; // Magic included.
+const size_t DDS_DX10       = 20;
+
+// DXGI formats.
+const U32 DXGI_BC1_UNORM      = 71;
+const U32 DXGI_BC1_UNORM_SRGB = 72;
+const U32 DXGI_BC3_UNORM      = 77;
+const U32 DXGI_BC3_UNORM_SRGB = 78;
+const U32 DXGI_BC7_UNORM      = 98;
+const U32 DXGI_BC7_UNORM_SRGB = 99;
+
+// OpenGL internal formats, as stored in KTX files.
+const U32 KTX_RGB_DXT1    = 0x83F0;
+const U32 KTX_RGBA_DXT1   = 0x83F1;
+const U32 KTX_RGBA_DXT5   = 0x83F3;
+const U32 KTX_RGBA_BPTC  = 0x8E8C;
+
+const U8 KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+const size_t KTX_HEADER = 64;
+
+U32 fourcc (const char* s) {
+    return (U32) s[0] | ((U32) s[1] << 8) | ((U32) s[2] << 16) | ((U32) s[3] << 24);
+}
+
+U32 read_u32 (const U8* p) {
+    return (U32) p[0] | ((U32) p[1] << 8) | ((U32) p[2] << 16) | ((U32) p[3] << 24);
+}
+
+U32 swap_u32 (U32 x) {
+    return (x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24);
+}
+
+void write_u32 (U8* p, U32 x) {
+    p[0] = x; p[1] = x >> 8; p[2] = x >> 16; p[3] = x >> 24;
+}
+
+int block_bytes (CompressedImage::Format format) {
+    return format == CompressedImage::Compressed_BC1 ? 8 : 16;
+}
+
+size_t level_size (CompressedImage::Format format, int w, int h) {
+    return (size_t) ((w + 3) / 4) * ((h + 3) / 4) * block_bytes (format);
+}
+
+Exception bad_file (const char* what) {
+    ostringstream os;
+    os << "Failed reading compressed image: " << what;
+    return EXCEPTION (os);
+}
+
+} // namespace
+
+struct CompressedImage::_impl
+{
+    Format format;
+    int w;
+    int h;
+    vector<U8> data;
+    vector<size_t> offsets; // One per level, plus the end.
+
+    _impl () : format (Compressed_BC1), w (0), h (0) {}
+
+    int width (unsigned level) const { return max (1, w >> level); }
+    int height (unsigned level) const { return max (1, h >> level); }
+
+    // Lay out 'levels' levels of the given size.
+    void reset (Format _format, int _w, int _h, unsigned levels) {
+        if (_w <= 0 || _h <= 0 || _w > 65536 || _h > 65536) throw bad_file ("bad image size");
+        unsigned full = 1;
+        while ((max (_w, _h) >> full) > 0) full++;
+        if (levels > full) throw bad_file ("too many mipmap levels");
+        format = _format;
+        w = _w;
+        h = _h;
+        offsets.assign (1, 0);
+        for (unsigned i = 0; i < levels; ++i) {
+            offsets.push_back (offsets.back() + level_size (format, width(i), height(i)));
+        }
+        data.resize (offsets.back());
+    }
+
+    unsigned num_levels () const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+};
+
+static void read_dds (const U8* p, size_t n, CompressedImage::Format& format, int& w, int& h,
+                      unsigned& levels, size_t& offset) {
+    if (n < DDS_HEADER || read_u32 (p + 4) != 124) throw bad_file ("bad DDS header");
+    U32 flags = read_u32 (p + 8);
+    h = read_u32 (p + 12);
+    w = read_u32 (p + 16);
+    levels = (flags & DDSD_MIPMAPCOUNT) ? max (1u, read_u32 (p + 28)) : 1;
+    if ((flags & DDSD_DEPTH) && read_u32 (p + 24) > 1) throw bad_file ("volume textures are not supported");
+    if (read_u32 (p + 112) & DDSCAPS2_CUBEMAP) throw bad_file ("cube maps are not supported");
+    if (!(read_u32 (p + 80) & DDPF_FOURCC)) throw bad_file ("uncompressed DDS files are not supported");
+
+    U32 code = read_u32 (p + 84);
+    offset = DDS_HEADER;
+    if (code == fourcc ("DXT1")) format = CompressedImage::Compressed_BC1;
+    else if (code == fourcc ("DXT5")) format = CompressedImage::Compressed_BC3;
+    else if (code == fourcc ("DX10")) {
+        if (n < DDS_HEADER + DDS_DX10) throw bad_file ("bad DX10 header");
+        const U8* dx10 = p + DDS_HEADER;
+        U32 dxgi = read_u32 (dx10);
+        if (read_u32 (dx10 + 4) != DDS_DIMENSION_2D || read_u32 (dx10 + 12) > 1) {
+            throw bad_file ("only single 2D textures are supported");
+        }
+        switch (dxgi) {
+        case DXGI_BC1_UNORM: case DXGI_BC1_UNORM_SRGB: format = CompressedImage::Compressed_BC1; break;
+        case DXGI_BC3_UNORM: case DXGI_BC3_UNORM_SRGB: format = CompressedImage::Compressed_BC3; break;
+        case DXGI_BC7_UNORM: case DXGI_BC7_UNORM_SRGB: format = CompressedImage::Compressed_BC7; break;
+        default: throw bad_file ("unsupported DXGI format");
+        }
+        offset += DDS_DX10;
+    }
+    else throw bad_file ("unsupported DDS pixel format");
+}
+
+void CompressedImage::from_mem (const U8* p, int n, CompressedImage& image) {
+    _impl* impl = image.impl;
+    size_t size = n;
+    if (size >= 4 && memcmp (p, "DDS ", 4) == 0) {
+        Format format;
+        int w, h;
+        unsigned levels;
+        size_t offset;
+        read_dds (p, size, format, w, h, levels, offset);
+        impl->reset (format, w, h, levels);
+        if (offset + impl->data.size() > size) throw bad_file ("truncated DDS file");
+        memcpy (&impl->data[0], p + offset, impl->data.size());
+    }
+    else if (size >= KTX_HEADER && memcmp (p, KTX_IDENTIFIER, 12) == 0) {
+        U32 header[13];
+        for (int i = 0; i < 13; ++i) header[i] = read_u32 (p + 12 + 4*i);
+        bool swap = header[0] == 0x01020304;
+        if (swap) {
+            for (int i = 0; i < 13; ++i) header[i] = swap_u32 (header[i]);
+        }
+        if (header[0] != 0x04030201) throw bad_file ("bad KTX endianness");
+        if (header[1] != 0) throw bad_file ("uncompressed KTX files are not supported");
+        if (header[7] == 0 || header[8] > 1 || header[9] > 0 || header[10] != 1) {
+            throw bad_file ("only single 2D textures are supported");
+        }
+        Format format;
+        switch (header[4]) {
+        case KTX_RGB_DXT1: case KTX_RGBA_DXT1: format = Compressed_BC1; break;
+        case KTX_RGBA_DXT5: format = Compressed_BC3; break;
+        case KTX_RGBA_BPTC: format = Compressed_BC7; break;
+        default: throw bad_file ("unsupported KTX internal format");
+        }
+        impl->reset (format, header[6], header[7], max (1u, header[11]));
+
+        size_t offset = KTX_HEADER + header[12];
+        for (unsigned i = 0; i < impl->num_levels(); ++i) {
+            if (offset + 4 > size) throw bad_file ("truncated KTX file");
+            U32 level_bytes = read_u32 (p + offset);
+            if (swap) level_bytes = swap_u32 (level_bytes);
+            size_t expected = impl->offsets[i+1] - impl->offsets[i];
+            if (level_bytes != expected) throw bad_file ("bad KTX level size");
+            offset += 4;
+            if (offset + expected > size) throw bad_file ("truncated KTX file");
+            memcpy (&impl->data[impl->offsets[i]], p + offset, expected);
+            offset += (expected + 3) & ~(size_t) 3;
+        }
+    }
+    else throw bad_file ("unknown container");
+}
+
+bool CompressedImage::is_container (const char* path) {
+    const char* ext = strrchr (path, '.');
+    if (!ext) return false;
+    ext++;
+    return strcmp (ext, "dds") == 0 || strcmp (ext, "DDS") == 0
+        || strcmp (ext, "ktx") == 0 || strcmp (ext, "KTX") == 0;
+}
+
+void CompressedImage::from_file (const char* path, CompressedImage& image) {
+    FileData file;
+    if (!vfs_read (path, file)) {
+        ostringstream os;
+        os << "Error opening file: " << path;
+        throw EXCEPTION (os);
+    }
+    try {
+        from_mem (file.data(), (int) file.size(), image);
+    }
+    catch (const exception& e) {
+        ostringstream os;
+        os << e.what() << "; " << path;
+        throw EXCEPTION (os);
+    }
+}
+
+// Gather the 4x4 block at (bx,by) as RGBA, repeating the last row and
+// column past the image's edges.
+static void gather_block (const Image& image, int bx, int by, U8* rgba) {
+    int w = image.width(), h = image.height(), c = image.numComponents();
+    const U8* pixels = image;
+    for (int i = 0; i < 16; ++i) {
+        int x = min (4*bx + i%4, w-1);
+        int y = min (4*by + i/4, h-1);
+        const U8* p = pixels + ((size_t) y * w + x) * c;
+        U8* q = rgba + 4*i;
+        switch (c) {
+        case 1: q[0] = q[1] = q[2] = p[0]; q[3] = 255; break;
+        case 2: q[0] = q[1] = q[2] = p[0]; q[3] = p[1]; break;
+        case 3: q[0] = p[0]; q[1] = p[1]; q[2] = p[2]; q[3] = 255; break;
+        default: q[0] = p[0]; q[1] = p[1]; q[2] = p[2]; q[3] = p[3]; break;
+        }
+    }
+}
+
+void CompressedImage::encode (const Image& image, Format format, CompressedImage& out, bool mipmaps) {
+    if (format == Compressed_BC7) throw EXCEPTION ("CompressedImage::encode: BC7 is not supported");
+    if (image.dataType() != Image::Image_U8 || image.numComponents() < 1 || image.numComponents() > 4) {
+        throw EXCEPTION ("CompressedImage::encode: only 8-bit images with 1 to 4 components are supported");
+    }
+    MipChain chain;
+    if (mipmaps) chain.build (image);
+    unsigned levels = mipmaps ? chain.numLevels() : 1;
+    _impl* impl = out.impl;
+    impl->reset (format, image.width(), image.height(), levels);
+
+    int bytes = block_bytes (format);
+    for (unsigned l = 0; l < levels; ++l) {
+        const Image& level = mipmaps ? chain.level(l) : image;
+        int bw = (level.width() + 3) / 4;
+        int bh = (level.height() + 3) / 4;
+        U8* dst = &impl->data[impl->offsets[l]];
+        ThreadPool::global().parallel_for (bh, [&] (unsigned begin, unsigned end) {
+            U8 rgba[64];
+            for (unsigned by = begin; by < end; ++by) {
+                for (int bx = 0; bx < bw; ++bx) {
+                    gather_block (level, bx, by, rgba);
+                    U8* block = dst + ((size_t) by * bw + bx) * bytes;
+                    if (format == Compressed_BC1) bc1_encode_block (rgba, block, true);
+                    else bc3_encode_block (rgba, block);
+                }
+            }
+        }, max (1, 256 / bw));
+    }
+}
+
+void CompressedImage::decode (unsigned level, U8* rgba) const {
+    if (impl->format == Compressed_BC7) throw EXCEPTION ("CompressedImage::decode: BC7 is not supported");
+    int w = impl->width (level), h = impl->height (level);
+    int bw = (w + 3) / 4, bh = (h + 3) / 4;
+    int bytes = block_bytes (impl->format);
+    const U8* src = levelData (level);
+    U8 block[64];
+    for (int by = 0; by < bh; ++by) {
+        for (int bx = 0; bx < bw; ++bx) {
+            const U8* in = src + ((size_t) by * bw + bx) * bytes;
+            if (impl->format == Compressed_BC1) bc1_decode_block (in, block);
+            else bc3_decode_block (in, block);
+            for (int i = 0; i < 16; ++i) {
+                int x = 4*bx + i%4, y = 4*by + i/4;
+                if (x < w && y < h) memcpy (rgba + ((size_t) y * w + x) * 4, block + 4*i, 4);
+            }
+        }
+    }
+}
+
+bool CompressedImage::canFlip () const {
+    if (impl->format == Compressed_BC7) return false;
+    for (unsigned l = 0; l < impl->num_levels(); ++l) {
+        int h = impl->height (l);
+        if (h >= 4 && h % 4 != 0) return false;
+    }
+    return true;
+}
+
+void CompressedImage::flipVertically () {
+    if (!canFlip()) throw EXCEPTION ("CompressedImage::flipVertically: the image cannot be flipped without re-encoding");
+    int bytes = block_bytes (impl->format);
+    for (unsigned l = 0; l < impl->num_levels(); ++l) {
+        int h = impl->height (l);
+        int rows = min (h, 4);
+        size_t row_bytes = (size_t) ((impl->width (l) + 3) / 4) * bytes;
+        int bh = (h + 3) / 4;
+        U8* data = &impl->data[impl->offsets[l]];
+        for (int top = 0, bot = bh-1; top < bot; ++top, --bot) {
+            swap_ranges (data + top * row_bytes, data + (top+1) * row_bytes, data + bot * row_bytes);
+        }
+        for (size_t i = 0; i < bh * row_bytes; i += bytes) {
+            if (impl->format == Compressed_BC1) bc1_flip_block (data + i, rows);
+            else bc3_flip_block (data + i, rows);
+        }
+    }
+}
+
+CompressedImage::CompressedImage () : impl (new _impl) {}
+
+CompressedImage::~CompressedImage () {
+    delete impl;
+}
+
+CompressedImage::Format CompressedImage::format () const {
+    return impl->format;
+}
+
+int CompressedImage::width () const {
+    return impl->w;
+}
+
+int CompressedImage::height () const {
+    return impl->h;
+}
+
+unsigned CompressedImage::numLevels () const {
+    return impl->num_levels();
+}
+
+int CompressedImage::levelWidth (unsigned level) const {
+    return impl->width (level);
+}
+
+int CompressedImage::levelHeight (unsigned level) const {
+    return impl->height (level);
+}
+
+const U8* CompressedImage::levelData (unsigned level) const {
+    return &impl->data[impl->offsets[level]];
+}
+
+size_t CompressedImage::levelSize (unsigned level) const {
+    return impl->offsets[level+1] - impl->offsets[level];
+}
+
+void OGDT::write_dds (const CompressedImage& image, const char* file) {
+    U8 header[DDS_HEADER + DDS_DX10];
+    memset (header, 0, sizeof(header));
+    unsigned levels = image.numLevels();
+    bool dx10 = image.format() == CompressedImage::Compressed_BC7;
+    memcpy (header, "DDS ", 4);
+    write_u32 (header + 4, 124);
+    write_u32 (header + 8, DDSD_REQUIRED | DDSD_LINEARSIZE | (levels > 1 ? DDSD_MIPMAPCOUNT : 0));
+    write_u32 (header + 12, image.height());
+    write_u32 (header + 16, image.width());
+    write_u32 (header + 20, levels ? image.levelSize(0) : 0);
+    write_u32 (header + 28, levels);
+    write_u32 (header + 76, 32);
+    write_u32 (header + 80, DDPF_FOURCC);
+    switch (image.format()) {
+    case CompressedImage::Compressed_BC1: write_u32 (header + 84, fourcc ("DXT1")); break;
+    case CompressedImage::Compressed_BC3: write_u32 (header + 84, fourcc ("DXT5")); break;
+    case CompressedImage::Compressed_BC7: write_u32 (header + 84, fourcc ("DX10")); break;
+    }
+    write_u32 (header + 108, DDSCAPS_TEXTURE | (levels > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0));
+    if (dx10) {
+        write_u32 (header + DDS_HEADER, DXGI_BC7_UNORM);
+        write_u32 (header + DDS_HEADER + 4, DDS_DIMENSION_2D);
+        write_u32 (header + DDS_HEADER + 12, 1);
+    }
+
+    FILE* f = fopen (file, "wb");
+    if (!f) {
+        ostringstream os;
+        os << "Failed opening " << file << " for writing";
+        throw EXCEPTION (os);
+    }
+    bool ok = fwrite (header, 1, DDS_HEADER + (dx10 ? DDS_DX10 : 0), f) > 0;
+    for (unsigned l = 0; l < levels && ok; ++l) {
+        ok = fwrite (image.levelData(l), 1, image.levelSize(l), f) == image.levelSize(l);
+    }
+    fclose (f);
+    if (!ok) {
+        ostringstream os;
+        os << "Failed writing " << file;
+        throw EXCEPTION (os);
+    }
+}
@@ -1,26 +1,355 @@
 #include <OGDT/Image.h>
 #include <OGDT/Exception.h>
+#include <OGDT/vfs.h>
+#include <atomic>
+
+// Pixel buffers, stb_image's own included, come from the current allocator.
+static void* image_alloc (size_t size);
+static void* image_realloc (void* p, size_t size);
+static void image_free (void* p);
+#define STBI_MALLOC(sz)     image_alloc (sz)
+#define STBI_REALLOC(p,sz)  image_realloc (p, sz)
+#define STBI_FREE(p)        image_free (p)
+
 #include "stb_image.c"
+#include "mapped_file.h"
+#include "simd.h"
+#include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <sstream>
 
 using namespace OGDT;
 
-U8* read_ppm
-(const char* path, FILE* file, int* width, int* height, int* components);
+struct Image::mapping
+{
+    mapped_file file;
+};
 
-const char* get_extension (const char* file)
+static std::atomic<ImageAllocator*> current_allocator (nullptr);
+
+// Every buffer starts with a header naming the allocator it came from, so
+// it goes back there however the current allocator changes meanwhile.
+struct block_header
 {
-    size_t n = strlen (file);
-    const char* p = file + n - 1;
-    while (p >= file && *p != '.') --p;
-    if (p == file) return nullptr;
-    else return p+1;
+    ImageAllocator* allocator; // Null for malloc.
+    size_t size;               // Header included.
+};
+
+static const size_t header_size = 16; // Keeps the pixels 16-byte aligned.
+
+static void* image_alloc (size_t size) {
+    ImageAllocator* allocator = current_allocator.load ();
+    size_t n = size + header_size;
+    block_header* block = (block_header*) (allocator ? allocator->allocate (n) : malloc (n));
+    if (!block) return nullptr;
+    block->allocator = allocator;
+    block->size = n;
+    return (U8*) block + header_size;
+}
+
+static void image_free (void* p) {
+    if (!p) return;
+    block_header* block = (block_header*) ((U8*) p - header_size);
+    if (block->allocator) block->allocator->deallocate (block, block->size);
+    else free (block);
+}
+
+static void* image_realloc (void* p, size_t size) {
+    if (!p) return image_alloc (size);
+    block_header* block = (block_header*) ((U8*) p - header_size);
+    if (!block->allocator) {
+        block = (block_header*) realloc (block, size + header_size);
+        if (!block) return nullptr;
+        block->size = size + header_size;
+        return (U8*) block + header_size;
+    }
+    void* q = image_alloc (size);
+    if (!q) return nullptr;
+    memcpy (q, p, std::min (block->size - header_size, size));
+    image_free (p);
+    return q;
+}
+
+// Header of a ppm, pgm or pfm file.
+struct pnm_header
+{
+    int w, h, c;
+    int maxval;    // Largest sample value; 0 for pfm.
+    float scale;   // pfm only. Negative for little-endian data; the magnitude scales the samples.
+    bool ascii;
+    size_t offset; // Start of the pixel data.
+};
+
+// Swap two rows of n bytes in place.
+static void swap_rows (U8* a, U8* b, size_t n)
+{
+    size_t i = 0;
+#ifdef OGDT_SSE2
+    for (; i + 64 <= n; i += 64) {
+        __m128i a0 = _mm_loadu_si128 ((const __m128i*) (a + i));
+        __m128i a1 = _mm_loadu_si128 ((const __m128i*) (a + i + 16));
+        __m128i a2 = _mm_loadu_si128 ((const __m128i*) (a + i + 32));
+        __m128i a3 = _mm_loadu_si128 ((const __m128i*) (a + i + 48));
+        __m128i b0 = _mm_loadu_si128 ((const __m128i*) (b + i));
+        __m128i b1 = _mm_loadu_si128 ((const __m128i*) (b + i + 16));
+        __m128i b2 = _mm_loadu_si128 ((const __m128i*) (b + i + 32));
+        __m128i b3 = _mm_loadu_si128 ((const __m128i*) (b + i + 48));
+        _mm_storeu_si128 ((__m128i*) (a + i),      b0);
+        _mm_storeu_si128 ((__m128i*) (a + i + 16), b1);
+        _mm_storeu_si128 ((__m128i*) (a + i + 32), b2);
+        _mm_storeu_si128 ((__m128i*) (a + i + 48), b3);
+        _mm_storeu_si128 ((__m128i*) (b + i),      a0);
+        _mm_storeu_si128 ((__m128i*) (b + i + 16), a1);
+        _mm_storeu_si128 ((__m128i*) (b + i + 32), a2);
+        _mm_storeu_si128 ((__m128i*) (b + i + 48), a3);
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128 ((const __m128i*) (a + i));
+        __m128i y = _mm_loadu_si128 ((const __m128i*) (b + i));
+        _mm_storeu_si128 ((__m128i*) (a + i), y);
+        _mm_storeu_si128 ((__m128i*) (b + i), x);
+    }
+#endif
+    for (; i < n; ++i) {
+        U8 t = a[i];
+        a[i] = b[i];
+        b[i] = t;
+    }
+}
+
+// Reverse the order of the given rows in place.
+static void flip_rows (U8* pixels, int rows, size_t row_size)
+{
+    if (!pixels || rows < 2) return;
+    U8* top = pixels;
+    U8* bot = pixels + (size_t) (rows-1) * row_size;
+    for (; top < bot; top += row_size, bot -= row_size) {
+        swap_rows (top, bot, row_size);
+    }
+}
+
+static void pnm_error (const char* path, const char* what)
+{
+    std::ostringstream os;
+    os << "Failed reading ppm file: " << what << "; " << path;
+    throw EXCEPTION (os);
+}
+
+static bool is_space (U8 c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+// Skip whitespace and comments.
+static const U8* skip_space (const U8* p, const U8* end)
+{
+    while (p < end) {
+        if (*p == '#') while (p < end && *p != '\n') ++p;
+        else if (is_space (*p)) ++p;
+        else break;
+    }
+    return p;
+}
+
+// Parse an unsigned decimal number. Return null if there is none.
+static const U8* parse_uint (const U8* p, const U8* end, unsigned* value)
+{
+    p = skip_space (p, end);
+    if (p == end || *p < '0' || *p > '9') return nullptr;
+    unsigned v = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        if (v > 100000000) return nullptr;
+        v = v*10 + (*p - '0');
+    }
+    *value = v;
+    return p;
+}
+
+// Parse a floating point number. Return null if there is none.
+static const U8* parse_float (const U8* p, const U8* end, float* value)
+{
+    p = skip_space (p, end);
+    char token[32];
+    size_t n = 0;
+    while (p + n < end && n < sizeof(token) - 1 && !is_space (p[n])) {
+        token[n] = (char) p[n];
+        n++;
+    }
+    token[n] = 0;
+    char* last;
+    *value = strtof (token, &last);
+    if (n == 0 || last != token + n) return nullptr;
+    return p + n;
+}
+
+static bool little_endian ()
+{
+    const U16 one = 1;
+    return *(const U8*) &one == 1;
+}
+
+static size_t sample_size (const pnm_header& hdr)
+{
+    return hdr.maxval == 0 ? 4 : hdr.maxval > 255 ? 2 : 1;
+}
+
+static bool is_pnm (const U8* data, size_t n)
+{
+    return n >= 2 && data[0] == 'P' && data[1] && strchr ("2356fF", data[1]);
+}
+
+static void parse_pnm_header (const char* path, const U8* data, size_t n, pnm_header& hdr)
+{
+    if (n < 2 || data[0] != 'P') pnm_error (path, "magic mismatch");
+    switch (data[1]) {
+    case '2': hdr.c = 1; hdr.ascii = true;  break;
+    case '3': hdr.c = 3; hdr.ascii = true;  break;
+    case '5': hdr.c = 1; hdr.ascii = false; break;
+    case '6': hdr.c = 3; hdr.ascii = false; break;
+    case 'f': hdr.c = 1; hdr.ascii = false; break;
+    case 'F': hdr.c = 3; hdr.ascii = false; break;
+    default: pnm_error (path, "unsupported ppm format");
+    }
+    const U8* end = data + n;
+    const U8* p = data + 2;
+    unsigned w, h;
+    if (!(p = parse_uint (p, end, &w)) || !(p = parse_uint (p, end, &h)) || w == 0 || h == 0) {
+        pnm_error (path, "bad image size");
+    }
+    if ((U64) w * h > (1u << 28)) pnm_error (path, "image too large");
+    hdr.w = w;
+    hdr.h = h;
+    if (data[1] == 'f' || data[1] == 'F') {
+        hdr.maxval = 0;
+        if (!(p = parse_float (p, end, &hdr.scale)) || hdr.scale == 0.0f) {
+            pnm_error (path, "bad pfm scale");
+        }
+    }
+    else {
+        unsigned maxval;
+        if (!(p = parse_uint (p, end, &maxval)) || maxval == 0 || maxval > 65535) {
+            pnm_error (path, "bad maximum value");
+        }
+        hdr.maxval = maxval;
+        hdr.scale = 1.0f;
+    }
+    // A single whitespace character separates the header from the pixels.
+    if (p == end || !is_space (*p)) pnm_error (path, "truncated header");
+    hdr.offset = p + 1 - data;
+    if (!hdr.ascii && n - hdr.offset < (size_t) hdr.w * hdr.h * hdr.c * sample_size (hdr)) {
+        pnm_error (path, "truncated pixel data");
+    }
+}
+
+// Whether pfm data is in the opposite byte order to the machine's.
+static bool pfm_swapped (const pnm_header& hdr)
+{
+    return (hdr.scale < 0.0f) != little_endian ();
+}
+
+// pfm files store their rows bottom first, the other formats top first.
+static bool rows_reversed (const pnm_header& hdr, bool flip)
+{
+    return hdr.maxval == 0 ? !flip : flip;
+}
+
+// Whether the file's pixels can be used as they are.
+static bool pnm_zero_copy (const pnm_header& hdr, bool flip)
+{
+    if (hdr.ascii || rows_reversed (hdr, flip)) return false;
+    if (hdr.maxval == 0) {
+        return !pfm_swapped (hdr) && fabs (hdr.scale) == 1.0f && hdr.offset % 4 == 0;
+    }
+    return hdr.maxval == 255;
+}
+
+// Copy n 32-bit words, reversing the bytes of each.
+static void byteswap32 (const U8* src, U8* dst, size_t n)
+{
+    size_t i = 0;
+#ifdef OGDT_SSE2
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128 ((const __m128i*) (src + 4*i));
+        x = _mm_shufflelo_epi16 (x, _MM_SHUFFLE(2,3,0,1));
+        x = _mm_shufflehi_epi16 (x, _MM_SHUFFLE(2,3,0,1));
+        x = _mm_or_si128 (_mm_slli_epi16 (x, 8), _mm_srli_epi16 (x, 8));
+        _mm_storeu_si128 ((__m128i*) (dst + 4*i), x);
+    }
+#endif
+    for (; i < n; ++i) {
+        const U8* a = src + 4*i;
+        U8* b = dst + 4*i;
+        U8 t0 = a[0], t1 = a[1];
+        b[0] = a[3];
+        b[1] = a[2];
+        b[2] = t1;
+        b[3] = t0;
+    }
+}
+
+// Read the pixels of a ppm, pgm or pfm file into a new buffer. Integer
+// samples are scaled to 8 bits and pfm samples converted to the machine's
+// byte order. Rows are stored last first if 'flip' is true.
+static U8* read_pnm (const char* path, const U8* data, size_t n, const pnm_header& hdr, bool flip)
+{
+    size_t samples = (size_t) hdr.w * hdr.c;
+    size_t row_size = samples * (hdr.maxval == 0 ? 4 : 1);
+    U8* pixels = (U8*) image_alloc (row_size * hdr.h);
+    if (!pixels) pnm_error (path, "out of memory");
+
+    U8 table[256];
+    for (int v = 0; v < 256; ++v) {
+        table[v] = hdr.maxval ? (U8) ((std::min (v, hdr.maxval) * 255 + hdr.maxval/2) / hdr.maxval) : 0;
+    }
+
+    const U8* src = data + hdr.offset;
+    const U8* end = data + n;
+    for (int y = 0; y < hdr.h; ++y) {
+        U8* out = pixels + (size_t) (rows_reversed (hdr, flip) ? hdr.h-1-y : y) * row_size;
+        if (hdr.ascii) {
+            for (size_t i = 0; i < samples; ++i) {
+                unsigned v;
+                if (!(src = parse_uint (src, end, &v))) {
+                    image_free (pixels);
+                    pnm_error (path, "truncated or malformed ascii pixel data");
+                }
+                v = std::min (v, (unsigned) hdr.maxval);
+                out[i] = hdr.maxval == 255 ? v : (U8) ((v * 255 + hdr.maxval/2) / hdr.maxval);
+            }
+        }
+        else if (hdr.maxval == 0) {
+            if (pfm_swapped (hdr)) byteswap32 (src, out, samples);
+            else memcpy (out, src, row_size);
+            float scale = fabs (hdr.scale);
+            if (scale != 1.0f) {
+                float* f = (float*) out;
+                for (size_t i = 0; i < samples; ++i) f[i] *= scale;
+            }
+            src += row_size;
+        }
+        else if (hdr.maxval == 255) {
+            memcpy (out, src, row_size);
+            src += row_size;
+        }
+        else if (hdr.maxval < 256) {
+            for (size_t i = 0; i < samples; ++i) out[i] = table[src[i]];
+            src += samples;
+        }
+        else { // 16-bit big-endian samples.
+            for (size_t i = 0; i < samples; ++i) {
+                unsigned v = std::min ((src[2*i] << 8) | src[2*i + 1], hdr.maxval);
+                out[i] = (U8) ((v * 255 + hdr.maxval/2) / hdr.maxval);
+            }
+            src += 2 * samples;
+        }
+    }
+    return pixels;
 }
 
 Image::Image ()
-    : w(0), h(0), c(0), s(0), t((Image::DataType)0), pixels(nullptr) {}
+    : w(0), h(0), c(0), s(0), t((Image::DataType)0), pixels(nullptr), map(nullptr) {}
 
 Image::Image (int width, int height, int num_components, DataType data_type) {
     w = width;
@@ -31,177 +360,147 @@ Image::Image (int width, int height, int num_components, DataType data_type) {
     case Image_F32: s = 4; break;
     }
     t = data_type;
-    pixels = (U8*) malloc (w*h*c*s);
+    pixels = (U8*) image_alloc ((size_t) w * h * c * s);
+    map = nullptr;
 }
 
-void Image::from_file (const char* path, Image& img) {
-    const char* ext = get_extension (path);
-    if (!ext) {
+void Image::from_file (const char* path, Image& img, bool flip) {
+    FileData file;
+    if (!vfs_read (path, file)) {
         std::ostringstream os;
-        os << "Failed loading image file: file must have an extension; " << path;
+        os << "Error opening file: " << path;
         throw EXCEPTION (os);
     }
-    FILE* file = fopen (path, "rb");
-    if (!file) {
+    if (is_pnm (file.data(), file.size())) {
+        from_pnm (path, file.data(), file.size(), img, flip);
+        return;
+    }
+    img.release ();
+    img.pixels = stbi_load_from_memory (file.data(), (int) file.size(), &img.w, &img.h, &img.c, 0);
+    if (!img.pixels) {
         std::ostringstream os;
-        os << "Error opening file: " << file;
+        os << "Failed loading image file: " << stbi_failure_reason () << "; " << path;
         throw EXCEPTION (os);
     }
-    if (img.pixels) stbi_image_free (img.pixels);
-    if    (strcmp(ext, "ppm") == 0
-        || strcmp(ext, "pgm") == 0
-        || strcmp(ext, "pfm") == 0) {
-        img.pixels = read_ppm (path, file, &img.w, &img.h, &img.c);
-    }
-    else {
-        img.pixels = stbi_load_from_file (file, &img.w, &img.h, &img.c, 0);
-    }
-    fclose (file);
+    if (flip) flip_rows (img.pixels, img.h, (size_t) img.w * img.c);
     img.s = 1;
     img.t = Image_U8;
 }
 
-void Image::from_mem (const U8* data, int n, Image& img) {
-    if (img.pixels) stbi_image_free (img.pixels);
+void Image::from_mem (const U8* data, int n, Image& img, bool flip) {
+    if (is_pnm (data, n)) {
+        from_pnm ("<memory>", data, n, img, flip);
+        return;
+    }
+    img.release ();
     img.pixels = stbi_load_from_memory
         ((const unsigned char*)data, n, &img.w, &img.h, &img.c, 0);
+    if (!img.pixels) {
+        std::ostringstream os;
+        os << "Failed loading image from memory: " << stbi_failure_reason ();
+        throw EXCEPTION (os);
+    }
+    if (flip) flip_rows (img.pixels, img.h, (size_t) img.w * img.c);
     img.s = 1;
     img.t = Image_U8;
 }
 
+void Image::map_file (const char* path, Image& img, bool flip) {
+    mapping* m = new mapping;
+    try {
+        if (!m->file.open (path, true)) {
+            std::ostringstream os;
+            os << "Error opening file: " << path;
+            throw EXCEPTION (os);
+        }
+        pnm_header hdr;
+        parse_pnm_header (path, m->file.data, m->file.size, hdr);
+        if (!pnm_zero_copy (hdr, flip)) {
+            from_pnm (path, m->file.data, m->file.size, img, flip);
+            delete m;
+            return;
+        }
+        img.release ();
+        img.pixels = m->file.data + hdr.offset;
+        img.map = m;
+        img.w = hdr.w;
+        img.h = hdr.h;
+        img.c = hdr.c;
+        img.s = hdr.maxval == 0 ? 4 : 1;
+        img.t = hdr.maxval == 0 ? Image_F32 : Image_U8;
+    }
+    catch (...) {
+        delete m;
+        throw;
+    }
+}
+
+void Image::from_pnm (const char* path, const U8* data, size_t n, Image& img, bool flip) {
+    pnm_header hdr;
+    parse_pnm_header (path, data, n, hdr);
+    U8* pixels = read_pnm (path, data, n, hdr, flip);
+    img.release ();
+    img.pixels = pixels;
+    img.w = hdr.w;
+    img.h = hdr.h;
+    img.c = hdr.c;
+    img.s = hdr.maxval == 0 ? 4 : 1;
+    img.t = hdr.maxval == 0 ? Image_F32 : Image_U8;
+}
+
+void Image::release () {
+    if (map) delete map;
+    else image_free (pixels);
+    map = nullptr;
+    pixels = nullptr;
+}
+
 Image::~Image () {
-    if (pixels) stbi_image_free (pixels);
+    release ();
+}
+
+void Image::setAllocator (ImageAllocator* allocator) {
+    current_allocator.store (allocator);
+}
+
+ImageAllocator* Image::allocator () {
+    return current_allocator.load ();
 }
 
 void Image::flipVertically () {
-    int img_size = w * h * c;
-    int line_size = w * c;
-    
-    unsigned char* top = pixels;
-    unsigned char* bot = &pixels[img_size - line_size];
-    unsigned char* tmp = new unsigned char[line_size];
-    
-    while (top < bot) {
-        memcpy(tmp, top, line_size);
-        memcpy(top, bot, line_size);
-        memcpy(bot, tmp, line_size);
-        
-        top += line_size;
-        bot -= line_size;
-    }
-    
-    delete tmp;
-}
-
-void OGDT::write_ppm (const Image& image, const char* file) {
-    int w = image.width();
-    int h = image.height();
-    
-    FILE* f = fopen (file, "w");
-    fprintf (f, "P6 %d %d 255\n", w, h);
-    
-    const U8* p = image;
-    size_t n = w*h;
-    size_t stride = image.numComponents() * image.dataSize();
-    Image::DataType data_type = image.dataType();
-    
-    for (size_t i = 0; i < n; ++i, p += stride) {
-        switch (data_type) {
-            case Image::Image_U8: fwrite (p, 1, 3, f); break;
-            case Image::Image_F32: {
-                U8 bytes[3];
-                for (size_t j = 0; j < 3; ++j)
-                {
-                    bytes[j] = (U8) (*(((float*)p)+j) * 255.0f);
-                }
-                fwrite (bytes, 1, 3, f);
-                break;
-            }
-        }
-    }
-    
-    fclose (f);
+    flip_rows (pixels, h, (size_t) w * c * s);
+}
+
+ImageView Image::view () {
+    return ImageView (pixels, w, h, c, t);
 }
 
-U8* read_ppm
-(const char* path, FILE* file, int* width, int* height, int* components) {
-    int magic1 = fgetc (file);
-    int magic2 = fgetc (file);
+const ImageView Image::view () const {
+    return ImageView (pixels, w, h, c, t);
+}
 
-    if (magic1 != 'P') {
+ImageView Image::view (int x, int y, int width, int height) {
+    return view().sub (x, y, width, height);
+}
+
+const ImageView Image::view (int x, int y, int width, int height) const {
+    return view().sub (x, y, width, height);
+}
+
+ImageView ImageView::sub (int x, int y, int width, int height) const {
+    if (x < 0 || y < 0 || width < 0 || height < 0 || x + width > w || y + height > h) {
         std::ostringstream os;
-        os << "Failed reading ppm file: magic mismatch; " << path;
+        os << "ImageView::sub: rectangle " << x << "," << y << " " << width << "x" << height
+           << " is outside the " << w << "x" << h << " view";
         throw EXCEPTION (os);
     }
-    
-    I32 w, h;
-    fscanf (file, "%d %d", &w, &h);
-
-    I32 max_value;
-    float scale;
-
-    if (magic2 == 'f' || magic2 == 'F') fscanf (file, "%f", &scale);
-    else fscanf (file, "%f", &scale);
-    
-    U8 c;
-    do fread (&c, 1, 1, file);
-    while (c == ' ' || c == '\r' || c == '\n');
-    fseek (file, -1, SEEK_CUR);
-    
-    U8* pixels;
-    U8 r, g, b;
-    
-    if (magic2 == '6') { // Binary ppm
-        I32 n = w*h*3;
-        pixels = (U8*) malloc (n);
-        *components = 3;
-        fread (pixels, sizeof(U8), n, file);
-    }
-    else if (magic2 == '3') { // Ascii ppm
-        I32 n = w*h*3;
-        pixels = (U8*) malloc (n);
-        *components = 3;
-        for (int i = 0; i < n; i += 3)
-        {
-            fscanf (file, "%c %c %c", &r, &g, &b);
-            pixels[i]   = r;
-            pixels[i+1] = g;
-            pixels[i+2] = b;
-        }
-    }
-    else if (magic2 == '5') { // Binary pgm
-        I32 n = w*h;
-        pixels = (U8*) malloc (n);
-        *components = 1;
-        fread (pixels, sizeof(U8), n, file);
-    }
-    else if (magic2 == '2') { // Ascii pgm
-        I32 n = w*h;
-        pixels = (U8*) malloc (n);
-        *components = 3;
-        for (int i = 0; i < n; ++i)
-        {
-            fscanf (file, "%c", &r);
-            pixels[i] = r;
-        }
-    }
-    else if (magic2 == 'f') { // Grayscale pfm
-        I32 n = w*h;
-        pixels = (U8*) malloc (n * sizeof(float));
-        *components = 1;
-        fread (pixels, sizeof(float), n, file);
-        float* p = (float*) pixels;
-        for (int i = 0; i < n; ++i) *p++ *= scale;
-    }
-    else {
-        std::ostringstream os;
-        os << "Failed reading ppm file: unsupported ppm format: P"
-           << magic2 << "; " << path;
-        throw EXCEPTION (os);
+    return ImageView (p + y * s + (size_t) x * c * dataSize(), width, height, c, t, s);
+}
+
+void ImageView::copyTo (const ImageView& dst) const {
+    if (dst.w != w || dst.h != h || dst.c != c || dst.t != t) {
+        throw EXCEPTION ("ImageView::copyTo: the views differ in size or format");
     }
-    
-    *width = w;
-    *height = h;
-    
-    return pixels;
+    size_t n = rowSize();
+    for (int y = 0; y < h; ++y) memmove (dst.p + y * dst.s, p + y * s, n);
 }
@@ -0,0 +1,102 @@
+#include <OGDT/ImagePool.h>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace OGDT;
+using namespace std;
+
+// Round a size up to its class: a multiple of a quarter of the largest
+// power of two not above it, so classes waste at most a quarter.
+static size_t size_class (size_t size) {
+    size_t top = 1;
+    while (top <= size / 2) top <<= 1;
+    size_t step = top >= 4 ? top / 4 : 1;
+    return (size + step - 1) / step * step;
+}
+
+struct ImagePool::_impl
+{
+    size_t max_cached;
+    size_t min_block;
+    mutable mutex m;
+    map<size_t, vector<void*>> free_blocks; // By size class.
+    size_t cached;
+    size_t hits;
+    size_t misses;
+
+    _impl (size_t max, size_t min)
+        : max_cached (max), min_block (min), cached (0), hits (0), misses (0) {}
+
+    void trim () {
+        for (auto& blocks : free_blocks) {
+            for (void* block : blocks.second) free (block);
+        }
+        free_blocks.clear ();
+        cached = 0;
+    }
+};
+
+ImagePool::ImagePool (size_t max_cached, size_t min_block)
+    : impl (new _impl (max_cached, min_block)) {}
+
+ImagePool::~ImagePool () {
+    impl->trim ();
+    delete impl;
+}
+
+void* ImagePool::allocate (size_t size) {
+    if (size < impl->min_block) return malloc (size);
+    size_t n = size_class (size);
+    {
+        lock_guard<mutex> lock (impl->m);
+        auto it = impl->free_blocks.find (n);
+        if (it != impl->free_blocks.end() && !it->second.empty()) {
+            void* block = it->second.back ();
+            it->second.pop_back ();
+            impl->cached -= n;
+            impl->hits++;
+            return block;
+        }
+        impl->misses++;
+    }
+    return malloc (n);
+}
+
+void ImagePool::deallocate (void* block, size_t size) {
+    if (size < impl->min_block) {
+        free (block);
+        return;
+    }
+    size_t n = size_class (size);
+    {
+        lock_guard<mutex> lock (impl->m);
+        if (impl->cached + n <= impl->max_cached) {
+            impl->free_blocks[n].push_back (block);
+            impl->cached += n;
+            return;
+        }
+    }
+    free (block);
+}
+
+void ImagePool::trim () {
+    lock_guard<mutex> lock (impl->m);
+    impl->trim ();
+}
+
+size_t ImagePool::cachedBytes () const {
+    lock_guard<mutex> lock (impl->m);
+    return impl->cached;
+}
+
+size_t ImagePool::hits () const {
+    lock_guard<mutex> lock (impl->m);
+    return impl->hits;
+}
+
+size_t ImagePool::misses () const {
+    lock_guard<mutex> lock (impl->m);
+    return impl->misses;
+}
@@ -0,0 +1,256 @@
+#include <OGDT/Loader.h>
+#include <OGDT/Exception.h>
+#include <OGDT/ThreadPool.h>
+#include <OGDT/gl_utils.h>
+#include <OGDT/model.h>
+#include "texture_data.h"
+#include "upload_ring.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+
+using namespace OGDT;
+using namespace std;
+
+namespace OGDT
+{
+
+struct load_request
+{
+    enum status
+    {
+        Pending, // Queued or being decoded.
+        Decoded, // Waiting for upload.
+        Ready,
+        Failed
+    };
+
+    atomic<int> state;
+    string path;
+    string error;
+    Model* model;  // Owned until taken by AsyncModel::get.
+    texture_data image; // Freed once uploaded.
+    GLuint texture;
+
+    load_request (const char* _path)
+        : state (Pending), path (_path), model (nullptr), texture (0) {}
+
+    ~load_request () {
+        if (model) delete model;
+    }
+
+    void fail (const char* what) {
+        if (model) { delete model; model = nullptr; }
+        image.clear ();
+        error = what;
+    }
+
+    void check () const {
+        if (state == Failed) {
+            ostringstream os;
+            os << "Failed loading " << path << ": " << error;
+            throw EXCEPTION (os);
+        }
+    }
+};
+
+} // namespace OGDT
+
+typedef shared_ptr<load_request> request_ptr;
+
+struct Loader::_impl
+{
+    mutex m;
+    condition_variable decoded;
+    deque<request_ptr> uploads;
+    atomic<unsigned> pending;
+    size_t budget;     // Bytes uploaded per update; 0 for whole textures.
+    upload_ring* ring; // Created by the first streamed update.
+    ThreadPool pool; // Declared last so workers are joined before the queue goes away.
+
+    _impl (unsigned num_threads) : pending (0), budget (0), ring (nullptr), pool (num_threads) {}
+
+    void push (const request_ptr& req) {
+        {
+            lock_guard<mutex> lock (m);
+            uploads.push_back (req);
+        }
+        decoded.notify_one();
+    }
+
+    void upload (load_request& req) {
+        if (req.error.empty()) {
+            try {
+                if (req.model) req.model->upload();
+                else {
+                    // Start over if streaming was switched off halfway.
+                    if (req.image.texture) glDeleteTextures (1, &req.image.texture);
+                    req.texture = req.image.upload ();
+                    req.image.clear ();
+                }
+                req.state = load_request::Ready;
+            }
+            catch (const exception& e) {
+                req.fail (e.what());
+                req.state = load_request::Failed;
+            }
+        }
+        else req.state = load_request::Failed;
+        pending--;
+    }
+
+    // Upload the next part of the request at the front of the queue and
+    // return true if it completed.
+    bool stream (load_request& req, size_t& left, bool first) {
+        if (req.model || !req.error.empty()) {
+            upload (req);
+            return true;
+        }
+        try {
+            if (!req.image.upload_part (*ring, left, first)) return false;
+            req.texture = req.image.texture;
+            req.image.clear ();
+            req.state = load_request::Ready;
+        }
+        catch (const exception& e) {
+            if (req.image.texture) glDeleteTextures (1, &req.image.texture);
+            req.fail (e.what());
+            req.state = load_request::Failed;
+        }
+        pending--;
+        return true;
+    }
+
+    void stream (unsigned max_uploads) {
+        if (!ring) ring = new upload_ring (budget);
+        size_t left = budget;
+        ring->begin ();
+        for (unsigned n = 0; (max_uploads == 0 || n < max_uploads) && left > 0; ++n) {
+            request_ptr req;
+            {
+                lock_guard<mutex> lock (m);
+                if (uploads.empty()) break;
+                req = uploads.front();
+            }
+            if (!stream (*req, left, left == budget)) break;
+            lock_guard<mutex> lock (m);
+            uploads.pop_front();
+        }
+        ring->end ();
+    }
+};
+
+bool AsyncModel::isReady () const {
+    int s = req->state;
+    return s == load_request::Ready || s == load_request::Failed;
+}
+
+Model* AsyncModel::get () {
+    if (!isReady()) return nullptr;
+    req->check();
+    Model* model = req->model;
+    req->model = nullptr;
+    return model;
+}
+
+bool AsyncTexture::isReady () const {
+    int s = req->state;
+    return s == load_request::Ready || s == load_request::Failed;
+}
+
+unsigned AsyncTexture::get () const {
+    if (!isReady()) return 0;
+    req->check();
+    return req->texture;
+}
+
+Loader::Loader (unsigned num_threads) : impl (new _impl (num_threads)) {}
+
+Loader::~Loader () {
+    // Free textures left half-streamed, even if streaming was switched off.
+    impl->pool.wait ();
+    for (const request_ptr& req : impl->uploads) {
+        if (req->image.texture) glDeleteTextures (1, &req->image.texture);
+    }
+    if (impl->ring) delete impl->ring;
+    delete impl;
+}
+
+AsyncModel Loader::loadModel (const char* path, ImportPreset preset, unsigned flags) {
+    request_ptr req (new load_request (path));
+    _impl* my = impl;
+    my->pending++;
+    my->pool.submit ([my, req, preset, flags] () {
+        try {
+            req->model = new Model;
+            req->model->decode (req->path.c_str(), preset, flags);
+        }
+        catch (const exception& e) {
+            req->fail (e.what());
+        }
+        req->state = load_request::Decoded;
+        my->push (req);
+    });
+    AsyncModel handle;
+    handle.req = req;
+    return handle;
+}
+
+AsyncTexture Loader::loadTexture (const char* path) {
+    request_ptr req (new load_request (path));
+    _impl* my = impl;
+    my->pending++;
+    my->pool.submit ([my, req] () {
+        try {
+            req->image.decode (req->path.c_str());
+        }
+        catch (const exception& e) {
+            req->fail (e.what());
+        }
+        req->state = load_request::Decoded;
+        my->push (req);
+    });
+    AsyncTexture handle;
+    handle.req = req;
+    return handle;
+}
+
+void Loader::setUploadBudget (size_t bytes) {
+    if (bytes == impl->budget) return;
+    delete impl->ring;
+    impl->ring = nullptr;
+    impl->budget = bytes;
+}
+
+void Loader::update (unsigned max_uploads) {
+    if (impl->budget) {
+        impl->stream (max_uploads);
+        return;
+    }
+    for (unsigned n = 0; max_uploads == 0 || n < max_uploads; ++n) {
+        request_ptr req;
+        {
+            lock_guard<mutex> lock (impl->m);
+            if (impl->uploads.empty()) return;
+            req = impl->uploads.front();
+            impl->uploads.pop_front();
+        }
+        impl->upload (*req);
+    }
+}
+
+void Loader::finish () {
+    while (impl->pending > 0) {
+        {
+            unique_lock<mutex> lock (impl->m);
+            while (impl->uploads.empty()) impl->decoded.wait (lock);
+        }
+        update ();
+    }
+}
+
+unsigned Loader::numPending () const {
+    return impl->pending;
+}
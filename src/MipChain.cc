@@ -0,0 +1,190 @@
+#include <OGDT/MipChain.h>
+#include <OGDT/Image.h>
+#include <OGDT/image_ops.h>
+#include <OGDT/ThreadPool.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace OGDT;
+using namespace std;
+
+namespace {
+
+// Pixels per parallel chunk; smaller levels are built on the calling thread.
+const unsigned chunk_pixels = 16384;
+
+// Kaiser-windowed sinc taps for halving, centred between source pixels
+// 2i and 2i+1: tap k reads pixel 2i + k - 3.
+const int kaiser_taps = 8;
+const float kaiser_alpha = 4.0f;
+
+// Modified Bessel function of the first kind, order 0.
+double bessel_i0 (double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2*k)) * (x / (2*k));
+        sum += term;
+    }
+    return sum;
+}
+
+struct kaiser_kernel
+{
+    float w[kaiser_taps];
+
+    kaiser_kernel () {
+        const double pi = 3.14159265358979323846;
+        const double radius = kaiser_taps / 2;
+        double sum = 0.0;
+        for (int k = 0; k < kaiser_taps; ++k) {
+            double d = k - 3.5; // Distance to the output pixel's centre, in source pixels.
+            double x = 0.5 * d; // Halving scales the sinc by 1/2.
+            double sinc = sin (pi * x) / (pi * x);
+            double r = d / radius;
+            double window = bessel_i0 (kaiser_alpha * sqrt (max (0.0, 1.0 - r*r))) / bessel_i0 (kaiser_alpha);
+            w[k] = (float) (sinc * window);
+            sum += w[k];
+        }
+        for (int k = 0; k < kaiser_taps; ++k) w[k] = (float) (w[k] / sum);
+    }
+};
+
+template <class T>
+void box_level (const Image& src, Image& dst) {
+    int sw = src.width(), sh = src.height();
+    int dw = dst.width(), dh = dst.height();
+    int c = src.numComponents();
+    const U8* s = src;
+    U8* d = &dst.ith<U8>(0);
+    size_t src_stride = (size_t) sw * c * sizeof(T);
+    size_t dst_stride = (size_t) dw * c * sizeof(T);
+    unsigned grain = max (1u, chunk_pixels / dw);
+    ThreadPool::global().parallel_for (dh, [=] (unsigned begin, unsigned end) {
+        // Output rows [begin, end) read source rows from 2*begin on.
+        const T* from = (const T*) (s + 2 * (size_t) begin * src_stride);
+        T* to = (T*) (d + (size_t) begin * dst_stride);
+        int rows = sh == 1 ? 1 : min (sh - 2*(int)begin, 2*(int)(end - begin));
+        downscale2 (from, src_stride, to, dst_stride, sw, rows, c);
+    }, grain);
+}
+
+void store (float v, U8* out) {
+    *out = (U8) min (255.0f, max (0.0f, v + 0.5f));
+}
+
+void store (float v, float* out) {
+    *out = v;
+}
+
+// Filter rows horizontally into 'tmp', then columns into the destination.
+template <class T>
+void kaiser_level (const Image& src, Image& dst) {
+    static const kaiser_kernel kernel;
+    int sw = src.width(), sh = src.height();
+    int dw = dst.width(), dh = dst.height();
+    int c = src.numComponents();
+    const T* s = (const T*) (const U8*) src;
+    T* d = &dst.ith<T>(0);
+    vector<float> tmp ((size_t) sh * dw * c);
+    float* t = &tmp[0];
+
+    unsigned grain = max (1u, chunk_pixels / dw);
+    ThreadPool::global().parallel_for (sh, [=] (unsigned begin, unsigned end) {
+        for (unsigned y = begin; y < end; ++y) {
+            const T* row = s + (size_t) y * sw * c;
+            float* out = t + (size_t) y * dw * c;
+            for (int x = 0; x < dw; ++x) {
+                for (int k = 0; k < c; ++k) out[x*c + k] = 0.0f;
+                for (int i = 0; i < kaiser_taps; ++i) {
+                    int sx = sw == 1 ? 0 : min (max (2*x + i - 3, 0), sw-1);
+                    float w = sw == 1 ? (i == 3) : kernel.w[i];
+                    for (int k = 0; k < c; ++k) out[x*c + k] += w * row[sx*c + k];
+                }
+            }
+        }
+    }, grain);
+
+    ThreadPool::global().parallel_for (dh, [=] (unsigned begin, unsigned end) {
+        size_t n = (size_t) dw * c;
+        vector<float> acc (n);
+        for (unsigned y = begin; y < end; ++y) {
+            fill (acc.begin(), acc.end(), 0.0f);
+            for (int i = 0; i < kaiser_taps; ++i) {
+                int sy = sh == 1 ? 0 : min (max (2*(int)y + i - 3, 0), sh-1);
+                float w = sh == 1 ? (i == 3) : kernel.w[i];
+                const float* row = t + (size_t) sy * n;
+                for (size_t j = 0; j < n; ++j) acc[j] += w * row[j];
+            }
+            T* out = d + (size_t) y * n;
+            for (size_t j = 0; j < n; ++j) store (acc[j], out + j);
+        }
+    }, grain);
+}
+
+} // namespace
+
+struct MipChain::_impl
+{
+    const Image* base;
+    vector<Image*> levels; // Levels 1 and up.
+
+    _impl () : base (nullptr) {}
+
+    void clear () {
+        for (Image* level : levels) delete level;
+        levels.clear ();
+        base = nullptr;
+    }
+
+    ~_impl () {
+        clear ();
+    }
+};
+
+MipChain::MipChain () : impl (new _impl) {}
+
+MipChain::MipChain (const Image& base, Filter filter) : impl (new _impl) {
+    try {
+        build (base, filter);
+    }
+    catch (...) {
+        delete impl;
+        throw;
+    }
+}
+
+MipChain::~MipChain () {
+    delete impl;
+}
+
+void MipChain::build (const Image& base, Filter filter) {
+    impl->clear ();
+    impl->base = &base;
+    const Image* prev = &base;
+    int c = base.numComponents();
+    bool f32 = base.dataType() == Image::Image_F32;
+    while (prev->width() > 1 || prev->height() > 1) {
+        int w = max (1, prev->width() / 2);
+        int h = max (1, prev->height() / 2);
+        Image* level = new Image (w, h, c, base.dataType());
+        impl->levels.push_back (level);
+        if (filter == Mip_Kaiser) {
+            if (f32) kaiser_level<float> (*prev, *level);
+            else kaiser_level<U8> (*prev, *level);
+        }
+        else {
+            if (f32) box_level<float> (*prev, *level);
+            else box_level<U8> (*prev, *level);
+        }
+        prev = level;
+    }
+}
+
+unsigned MipChain::numLevels () const {
+    return impl->base ? impl->levels.size() + 1 : 0;
+}
+
+const Image& MipChain::level (unsigned i) const {
+    return i == 0 ? *impl->base : *impl->levels[i-1];
+}
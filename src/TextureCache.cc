@@ -0,0 +1,264 @@
+#include <OGDT/TextureCache.h>
+#include <OGDT/Exception.h>
+#include <OGDT/types.h>
+#include <OGDT/vfs.h>
+#include "pak.h"
+#include "texture_data.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace OGDT
+{
+
+struct texture_entry
+{
+    vector<string> paths; // Canonical paths mapping to this entry.
+    U64 hash;             // Hash of the file contents, if hashed.
+    bool hashed;
+    bool linked;          // Whether the cache's maps point to this entry.
+    unsigned refs;        // Guarded by the cache's lock.
+
+    mutex lock;           // Held while the image is decoded.
+    bool failed;
+    string error;
+    texture_data data;    // Freed once uploaded.
+    bool decoded;
+    GLuint texture;
+
+    texture_entry ()
+        : hash (0), hashed (false), linked (true), refs (1), failed (false)
+        , decoded (false), texture (0) {}
+};
+
+} // namespace OGDT
+
+using namespace OGDT;
+
+struct TextureCache::_impl
+{
+    mutable mutex lock;
+    unordered_map<string, texture_entry*> by_path;
+    unordered_map<U64, texture_entry*> by_hash;
+    unsigned count; // Number of linked entries.
+    bool hash_contents;
+    atomic<unsigned> hits;
+    atomic<unsigned> misses;
+
+    _impl () : count (0), hash_contents (false), hits (0), misses (0) {}
+
+    // Remove the entry from the maps. Must be called with the lock held.
+    void unlink (texture_entry* e) {
+        if (!e->linked) return;
+        e->linked = false;
+        count--;
+        for (const string& path : e->paths) {
+            auto it = by_path.find (path);
+            if (it != by_path.end() && it->second == e) by_path.erase (it);
+        }
+        if (e->hashed) {
+            auto it = by_hash.find (e->hash);
+            if (it != by_hash.end() && it->second == e) by_hash.erase (it);
+        }
+    }
+
+    // Drop a reference. Return true if it was the last one; the entry is
+    // then unlinked and must be freed by the caller.
+    bool unref (texture_entry* e) {
+        lock_guard<mutex> guard (lock);
+        if (--e->refs == 0) {
+            unlink (e);
+            return true;
+        }
+        return false;
+    }
+};
+
+static string canonical_path (const char* path) {
+#ifdef WIN32
+    char buf[_MAX_PATH];
+    if (_fullpath (buf, path, _MAX_PATH)) return buf;
+#else
+    char* real = realpath (path, nullptr);
+    if (real) {
+        string s = real;
+        free (real);
+        return s;
+    }
+#endif
+    // Not on disk; perhaps in a mounted archive.
+    return normalize_path (path);
+}
+
+// FNV-1a over the file's contents.
+static U64 hash_file (const char* path) {
+    FileData file;
+    if (!vfs_read (path, file)) {
+        ostringstream os;
+        os << "Failed reading " << path;
+        throw EXCEPTION (os);
+    }
+    U64 h = 14695981039346656037ull;
+    const U8* p = file.data();
+    for (size_t i = 0; i < file.size(); ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+TextureCache::TextureCache () : impl (new _impl) {}
+
+TextureCache::~TextureCache () {
+    // Several paths may map to the same entry.
+    vector<texture_entry*> entries;
+    for (auto& it : impl->by_path) entries.push_back (it.second);
+    sort (entries.begin(), entries.end());
+    entries.erase (unique (entries.begin(), entries.end()), entries.end());
+    for (texture_entry* e : entries) delete e;
+    delete impl;
+}
+
+texture_entry* TextureCache::decode (const char* path) {
+    string key = canonical_path (path);
+    texture_entry* e = nullptr;
+    bool miss = false;
+    bool hashed;
+    {
+        lock_guard<mutex> guard (impl->lock);
+        hashed = impl->hash_contents;
+        auto it = impl->by_path.find (key);
+        if (it != impl->by_path.end()) {
+            e = it->second;
+            e->refs++;
+        }
+    }
+
+    if (!e) {
+        // Hash outside the lock; it reads the whole file. Files are read by
+        // the path given rather than the key, which mounted archives may not match.
+        U64 hash = hashed ? hash_file (path) : 0;
+
+        // The new entry's lock is held until it is decoded, so that
+        // concurrent requests wait for it. It is taken before the cache's
+        // lock so the two are never acquired in the opposite order.
+        texture_entry* fresh = new texture_entry;
+        fresh->lock.lock ();
+        {
+            lock_guard<mutex> guard (impl->lock);
+            auto it = impl->by_path.find (key);
+            if (it != impl->by_path.end()) e = it->second;
+            else if (hashed) {
+                auto h = impl->by_hash.find (hash);
+                if (h != impl->by_hash.end()) {
+                    e = h->second;
+                    e->paths.push_back (key);
+                    impl->by_path[key] = e;
+                }
+            }
+            if (e) e->refs++;
+            else {
+                e = fresh;
+                e->paths.push_back (key);
+                e->hash = hash;
+                e->hashed = hashed;
+                impl->by_path[key] = e;
+                if (hashed) impl->by_hash[hash] = e;
+                impl->count++;
+                miss = true;
+            }
+        }
+        if (!miss) {
+            fresh->lock.unlock ();
+            delete fresh;
+        }
+    }
+
+    if (miss) {
+        impl->misses++;
+        try {
+            e->data.decode (path);
+            e->decoded = true;
+        }
+        catch (const exception& ex) {
+            e->failed = true;
+            e->error = ex.what();
+            e->lock.unlock ();
+            // Let later requests retry.
+            {
+                lock_guard<mutex> guard (impl->lock);
+                impl->unlink (e);
+            }
+            if (impl->unref (e)) delete e;
+            throw;
+        }
+        e->lock.unlock ();
+    }
+    else {
+        impl->hits++;
+        // Wait for the image if it is still being decoded.
+        e->lock.lock ();
+        bool failed = e->failed;
+        string error = e->error;
+        e->lock.unlock ();
+        if (failed) {
+            if (impl->unref (e)) delete e;
+            ostringstream os;
+            os << "Failed loading " << path << ": " << error;
+            throw EXCEPTION (os);
+        }
+    }
+    return e;
+}
+
+GLuint TextureCache::upload (texture_entry* e) {
+    lock_guard<mutex> guard (e->lock);
+    if (!e->texture && e->decoded) {
+        e->texture = e->data.upload ();
+        e->data.clear ();
+    }
+    return e->texture;
+}
+
+void TextureCache::release (texture_entry* e) {
+    if (impl->unref (e)) {
+        if (e->texture) glDeleteTextures (1, &e->texture);
+        delete e;
+    }
+}
+
+void TextureCache::setContentHashing (bool enable) {
+    lock_guard<mutex> guard (impl->lock);
+    impl->hash_contents = enable;
+}
+
+unsigned TextureCache::hits () const {
+    return impl->hits;
+}
+
+unsigned TextureCache::misses () const {
+    return impl->misses;
+}
+
+unsigned TextureCache::size () const {
+    lock_guard<mutex> guard (impl->lock);
+    return impl->count;
+}
+
+void TextureCache::resetCounters () {
+    impl->hits = 0;
+    impl->misses = 0;
+}
+
+TextureCache& TextureCache::global () {
+    static TextureCache cache;
+    return cache;
+}
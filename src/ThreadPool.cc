@@ -0,0 +1,141 @@
+#include <OGDT/ThreadPool.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace OGDT;
+using namespace std;
+
+struct ThreadPool::_impl
+{
+    vector<thread> workers;
+    deque<Task> tasks;
+    mutex m;
+    condition_variable task_ready;
+    condition_variable idle;
+    unsigned busy;
+    bool quit;
+
+    _impl () : busy (0), quit (false) {}
+
+    void run () {
+        for (;;) {
+            Task task;
+            {
+                unique_lock<mutex> lock (m);
+                while (!quit && tasks.empty()) task_ready.wait (lock);
+                if (tasks.empty()) return;
+                task = tasks.front();
+                tasks.pop_front();
+                busy++;
+            }
+            try { task (); }
+            catch (...) {}
+            {
+                lock_guard<mutex> lock (m);
+                busy--;
+                if (busy == 0 && tasks.empty()) idle.notify_all();
+            }
+        }
+    }
+};
+
+// Shared between the caller of parallel_for and the helpers it submits.
+struct range_job
+{
+    ThreadPool::RangeTask task;
+    unsigned n;
+    unsigned grain;
+    unsigned chunks;
+    atomic<unsigned> next;
+    atomic<unsigned> done;
+    exception_ptr error;
+    mutex m;
+    condition_variable finished;
+
+    range_job (const ThreadPool::RangeTask& t, unsigned _n, unsigned _grain)
+        : task (t), n (_n), grain (_grain), chunks ((_n + _grain - 1) / _grain)
+        , next (0), done (0) {}
+
+    void work () {
+        unsigned c;
+        while ((c = next++) < chunks) {
+            unsigned begin = c * grain;
+            unsigned end = begin + grain < n ? begin + grain : n;
+            try { task (begin, end); }
+            catch (...) {
+                lock_guard<mutex> lock (m);
+                if (!error) error = current_exception();
+            }
+            if (++done == chunks) {
+                lock_guard<mutex> lock (m);
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+ThreadPool::ThreadPool (unsigned num_threads) : impl (new _impl) {
+    if (num_threads == 0) num_threads = thread::hardware_concurrency();
+    if (num_threads == 0) num_threads = 1;
+    impl->workers.reserve (num_threads);
+    for (unsigned i = 0; i < num_threads; ++i) {
+        impl->workers.push_back (thread (&_impl::run, impl));
+    }
+}
+
+ThreadPool::~ThreadPool () {
+    {
+        lock_guard<mutex> lock (impl->m);
+        impl->quit = true;
+    }
+    impl->task_ready.notify_all();
+    for (thread& t : impl->workers) t.join();
+    delete impl;
+}
+
+void ThreadPool::submit (const Task& task) {
+    {
+        lock_guard<mutex> lock (impl->m);
+        impl->tasks.push_back (task);
+    }
+    impl->task_ready.notify_one();
+}
+
+void ThreadPool::wait () {
+    unique_lock<mutex> lock (impl->m);
+    while (impl->busy > 0 || !impl->tasks.empty()) impl->idle.wait (lock);
+}
+
+void ThreadPool::parallel_for (unsigned n, const RangeTask& task, unsigned grain) {
+    if (n == 0) return;
+    if (grain == 0) grain = 1;
+    shared_ptr<range_job> job (new range_job (task, n, grain));
+
+    // Helpers that start after the caller has drained every chunk simply
+    // find nothing left to do, so nested calls cannot deadlock the pool.
+    unsigned helpers = job->chunks - 1;
+    if (helpers > numThreads()) helpers = numThreads();
+    for (unsigned i = 0; i < helpers; ++i) {
+        submit ([job] () { job->work(); });
+    }
+    job->work();
+
+    unique_lock<mutex> lock (job->m);
+    while (job->done < job->chunks) job->finished.wait (lock);
+    if (job->error) rethrow_exception (job->error);
+}
+
+unsigned ThreadPool::numThreads () const {
+    return impl->workers.size();
+}
+
+ThreadPool& ThreadPool::global () {
+    static ThreadPool pool;
+    return pool;
+}
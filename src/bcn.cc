@@ -0,0 +1,291 @@
+#include "bcn.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+U16 pack565 (const float* c) {
+    int r = (int) (c[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int) (c[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int) (c[2] * 31.0f / 255.0f + 0.5f);
+    r = min (max (r, 0), 31);
+    g = min (max (g, 0), 63);
+    b = min (max (b, 0), 31);
+    return (U16) ((r << 11) | (g << 5) | b);
+}
+
+void unpack565 (U16 v, int* c) {
+    int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+// The colours of a BC1 block. Index 3 is transparent black in three-colour mode.
+void palette (U16 c0, U16 c1, bool four, int pal[4][3]) {
+    unpack565 (c0, pal[0]);
+    unpack565 (c1, pal[1]);
+    for (int k = 0; k < 3; ++k) {
+        if (four) {
+            pal[2][k] = (2*pal[0][k] + pal[1][k]) / 3;
+            pal[3][k] = (pal[0][k] + 2*pal[1][k]) / 3;
+        }
+        else {
+            pal[2][k] = (pal[0][k] + pal[1][k]) / 2;
+            pal[3][k] = 0;
+        }
+    }
+}
+
+int dist2 (const U8* p, const int* c) {
+    int dr = p[0] - c[0], dg = p[1] - c[1], db = p[2] - c[2];
+    return dr*dr + dg*dg + db*db;
+}
+
+struct color_block
+{
+    U16 c0, c1;
+    U8 idx[16];
+    bool four;
+    unsigned error;
+};
+
+// Order the endpoints for the wanted mode and pick the nearest colour for
+// every pixel. Transparent pixels need three-colour mode.
+void evaluate (U16 a, U16 b, bool three, const U8* rgba, const bool* transparent, color_block& r) {
+    r.c0 = three ? min (a, b) : max (a, b);
+    r.c1 = three ? max (a, b) : min (a, b);
+    r.four = r.c0 > r.c1;
+    int pal[4][3];
+    palette (r.c0, r.c1, r.four, pal);
+    int count = r.four ? 4 : 3;
+    r.error = 0;
+    for (int i = 0; i < 16; ++i) {
+        if (transparent[i]) {
+            r.idx[i] = 3;
+            continue;
+        }
+        int best = 0, best_d = dist2 (rgba + 4*i, pal[0]);
+        for (int j = 1; j < count; ++j) {
+            int d = dist2 (rgba + 4*i, pal[j]);
+            if (d < best_d) { best = j; best_d = d; }
+        }
+        r.idx[i] = best;
+        r.error += best_d;
+    }
+}
+
+// Solve for the endpoints that best fit the block's current indices.
+bool refine (const U8* rgba, const bool* transparent, const color_block& r, U16& a, U16& b) {
+    static const float w4[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+    static const float w3[4] = { 1.0f, 0.0f, 0.5f, 0.0f };
+    const float* w = r.four ? w4 : w3;
+    float aa = 0, ab = 0, bb = 0;
+    float ap[3] = { 0, 0, 0 }, bp[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; ++i) {
+        if (transparent[i]) continue;
+        float s = w[r.idx[i]], t = 1.0f - s;
+        aa += s*s; ab += s*t; bb += t*t;
+        for (int k = 0; k < 3; ++k) {
+            ap[k] += s * rgba[4*i + k];
+            bp[k] += t * rgba[4*i + k];
+        }
+    }
+    float det = aa*bb - ab*ab;
+    if (fabs (det) < 1e-6f) return false;
+    float e0[3], e1[3];
+    for (int k = 0; k < 3; ++k) {
+        e0[k] = (bb*ap[k] - ab*bp[k]) / det;
+        e1[k] = (aa*bp[k] - ab*ap[k]) / det;
+    }
+    a = pack565 (e0);
+    b = pack565 (e1);
+    return true;
+}
+
+void encode_color (const U8* rgba, const bool* transparent, bool three, U8* out) {
+    // Endpoints along the principal axis of the opaque pixels.
+    float mean[3] = { 0, 0, 0 };
+    int n = 0;
+    for (int i = 0; i < 16; ++i) {
+        if (transparent[i]) continue;
+        for (int k = 0; k < 3; ++k) mean[k] += rgba[4*i + k];
+        n++;
+    }
+    color_block best;
+    if (n == 0) {
+        evaluate (0, 0, true, rgba, transparent, best);
+    }
+    else {
+        for (int k = 0; k < 3; ++k) mean[k] /= n;
+        float cov[6] = { 0, 0, 0, 0, 0, 0 };
+        float lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; ++i) {
+            if (transparent[i]) continue;
+            float d[3];
+            for (int k = 0; k < 3; ++k) {
+                d[k] = rgba[4*i + k] - mean[k];
+                lo[k] = min (lo[k], (float) rgba[4*i + k]);
+                hi[k] = max (hi[k], (float) rgba[4*i + k]);
+            }
+            cov[0] += d[0]*d[0]; cov[1] += d[0]*d[1]; cov[2] += d[0]*d[2];
+            cov[3] += d[1]*d[1]; cov[4] += d[1]*d[2]; cov[5] += d[2]*d[2];
+        }
+        float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+        for (int iter = 0; iter < 4; ++iter) {
+            float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+            float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+            float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+            float len = max (fabs (x), max (fabs (y), fabs (z)));
+            if (len == 0.0f) break;
+            axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+        }
+        float tmin = 0.0f, tmax = 0.0f;
+        float len2 = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+        if (len2 > 0.0f) {
+            tmin = tmax = 0.0f;
+            bool first = true;
+            for (int i = 0; i < 16; ++i) {
+                if (transparent[i]) continue;
+                float t = 0.0f;
+                for (int k = 0; k < 3; ++k) t += (rgba[4*i + k] - mean[k]) * axis[k];
+                t /= len2;
+                if (first || t < tmin) tmin = t;
+                if (first || t > tmax) tmax = t;
+                first = false;
+            }
+            // Inset the endpoints a little; the extremes are rarely hit exactly.
+            float inset = (tmax - tmin) / 16.0f;
+            tmin += inset;
+            tmax -= inset;
+        }
+        float e0[3], e1[3];
+        for (int k = 0; k < 3; ++k) {
+            e0[k] = mean[k] + axis[k] * tmax;
+            e1[k] = mean[k] + axis[k] * tmin;
+        }
+        evaluate (pack565 (e0), pack565 (e1), three, rgba, transparent, best);
+
+        for (int iter = 0; iter < 2 && best.error > 0; ++iter) {
+            U16 a, b;
+            if (!refine (rgba, transparent, best, a, b)) break;
+            color_block r;
+            evaluate (a, b, three, rgba, transparent, r);
+            if (r.error >= best.error) break;
+            best = r;
+        }
+    }
+
+    out[0] = best.c0 & 0xFF;
+    out[1] = best.c0 >> 8;
+    out[2] = best.c1 & 0xFF;
+    out[3] = best.c1 >> 8;
+    for (int row = 0; row < 4; ++row) {
+        const U8* idx = best.idx + 4*row;
+        out[4 + row] = idx[0] | (idx[1] << 2) | (idx[2] << 4) | (idx[3] << 6);
+    }
+}
+
+void decode_color (const U8* in, U8* rgba, bool force_four) {
+    U16 c0 = in[0] | (in[1] << 8);
+    U16 c1 = in[2] | (in[3] << 8);
+    bool four = force_four || c0 > c1;
+    int pal[4][3];
+    palette (c0, c1, four, pal);
+    for (int i = 0; i < 16; ++i) {
+        int idx = (in[4 + i/4] >> (2 * (i%4))) & 3;
+        for (int k = 0; k < 3; ++k) rgba[4*i + k] = pal[idx][k];
+        rgba[4*i + 3] = (!four && idx == 3) ? 0 : 255;
+    }
+}
+
+// The alpha values of a BC3 block.
+void alpha_palette (int a0, int a1, int* pal) {
+    pal[0] = a0;
+    pal[1] = a1;
+    if (a0 > a1) {
+        for (int i = 2; i < 8; ++i) pal[i] = ((8-i)*a0 + (i-1)*a1) / 7;
+    }
+    else {
+        for (int i = 2; i < 6; ++i) pal[i] = ((6-i)*a0 + (i-1)*a1) / 5;
+        pal[6] = 0;
+        pal[7] = 255;
+    }
+}
+
+void encode_alpha (const U8* rgba, U8* out) {
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; ++i) {
+        a0 = max (a0, (int) rgba[4*i + 3]);
+        a1 = min (a1, (int) rgba[4*i + 3]);
+    }
+    int pal[8];
+    alpha_palette (a0, a1, pal);
+    U64 bits = 0;
+    for (int i = 0; i < 16; ++i) {
+        int a = rgba[4*i + 3];
+        int best = 0;
+        for (int j = 1; j < 8; ++j) {
+            if (abs (pal[j] - a) < abs (pal[best] - a)) best = j;
+        }
+        bits |= (U64) best << (3*i);
+    }
+    out[0] = a0;
+    out[1] = a1;
+    for (int k = 0; k < 6; ++k) out[2 + k] = (U8) (bits >> (8*k));
+}
+
+void decode_alpha (const U8* in, U8* rgba) {
+    int pal[8];
+    alpha_palette (in[0], in[1], pal);
+    U64 bits = 0;
+    for (int k = 0; k < 6; ++k) bits |= (U64) in[2 + k] << (8*k);
+    for (int i = 0; i < 16; ++i) rgba[4*i + 3] = pal[(bits >> (3*i)) & 7];
+}
+
+} // namespace
+
+void bc1_encode_block (const U8* rgba, U8* out, bool alpha) {
+    bool transparent[16];
+    bool any = false;
+    for (int i = 0; i < 16; ++i) {
+        transparent[i] = alpha && rgba[4*i + 3] < 128;
+        any = any || transparent[i];
+    }
+    encode_color (rgba, transparent, any, out);
+}
+
+void bc3_encode_block (const U8* rgba, U8* out) {
+    bool transparent[16] = { false };
+    encode_alpha (rgba, out);
+    encode_color (rgba, transparent, false, out + 8);
+}
+
+void bc1_decode_block (const U8* in, U8* rgba) {
+    decode_color (in, rgba, false);
+}
+
+void bc3_decode_block (const U8* in, U8* rgba) {
+    decode_color (in + 8, rgba, true);
+    decode_alpha (in, rgba);
+}
+
+void bc1_flip_block (U8* block, int rows) {
+    reverse (block + 4, block + 4 + rows);
+}
+
+void bc3_flip_block (U8* block, int rows) {
+    U64 bits = 0;
+    for (int k = 0; k < 6; ++k) bits |= (U64) block[2 + k] << (8*k);
+    U64 flipped = bits;
+    for (int row = 0; row < rows; ++row) {
+        U64 line = (bits >> (12*row)) & 0xFFF;
+        int to = rows - 1 - row;
+        flipped &= ~((U64) 0xFFF << (12*to));
+        flipped |= line << (12*to);
+    }
+    for (int k = 0; k < 6; ++k) block[2 + k] = (U8) (flipped >> (8*k));
+    bc1_flip_block (block + 8, rows);
+}
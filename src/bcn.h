@@ -0,0 +1,28 @@
+#ifndef _OGDT_BCN_H
+#define _OGDT_BCN_H
+
+#include <OGDT/types.h>
+
+// Encoding, decoding and flipping of single BC1 and BC3 blocks. Blocks
+// cover 4x4 pixels, given as 16 RGBA quadruples in row order.
+
+/// Encode a block into 8 bytes of BC1. If 'alpha' is true, pixels with
+/// alpha below 128 are encoded as transparent.
+void bc1_encode_block (const U8* rgba, U8* out, bool alpha);
+
+/// Encode a block into 16 bytes of BC3.
+void bc3_encode_block (const U8* rgba, U8* out);
+
+/// Decode 8 bytes of BC1 into a block.
+void bc1_decode_block (const U8* in, U8* rgba);
+
+/// Decode 16 bytes of BC3 into a block.
+void bc3_decode_block (const U8* in, U8* rgba);
+
+/// Reverse the first 'rows' rows of a BC1 block in place.
+void bc1_flip_block (U8* block, int rows);
+
+/// Reverse the first 'rows' rows of a BC3 block in place.
+void bc3_flip_block (U8* block, int rows);
+
+#endif // _OGDT_BCN_H
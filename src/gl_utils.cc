@@ -1,11 +1,20 @@
 #include <OGDT/gl_utils.h>
+#include <OGDT/CompressedImage.h>
 #include <OGDT/Exception.h>
 #include <OGDT/Image.h>
+#include <OGDT/MipChain.h>
+#include <OGDT/ThreadPool.h>
+#include <OGDT/vfs.h>
+#include "texture_data.h"
+#include "texture_formats.h"
 #include <cstdio>
 #include <cstring>
+#include <memory>
 #include <sstream>
+#include <vector>
 
 using namespace OGDT;
+using namespace std;
 
 char* copy_string (const char* str) {
     size_t n = strlen (str);
@@ -38,31 +47,21 @@ GLuint create_shader (const char* code, GLenum shader_type) {
 }
 
 GLuint create_shader_from_file (const char* path, GLenum shader_type) {
-    FILE* f = fopen (path, "r");
-    if (!f) {
+    FileData file;
+    if (!vfs_read (path, file)) {
         std::ostringstream os;
         os << "Failed opening shader file: " << path;
         throw EXCEPTION (os);
     }
-    
-    fseek (f, 0, SEEK_END);
-    int len = ftell (f);
-    fseek (f, 0, SEEK_SET);
-    char* code = new char [len];
-    if (fread (code, len, 1, f) != 1) {
-        std::ostringstream os;
-        os << "Failed reading shader file: " << path;
-        throw EXCEPTION (os);
-    }
-    fclose (f);
-    
+    const char* code = file.size() ? (const char*) file.data() : "";
+    GLint len = (GLint) file.size();
+
     const GLuint shader = glCreateShader (shader_type);
     if (shader) {
         const GLchar* shader_code[] = {code};
         const GLint lengths[] = {len};
         glShaderSource (shader, 1, shader_code, lengths);
         glCompileShader (shader);
-        delete[] code;
         GLint result;
         glGetShaderiv (shader, GL_COMPILE_STATUS, &result);
         if (result == GL_FALSE) {
@@ -110,39 +109,187 @@ GLuint create_program (GLuint vertex_shader, GLuint fragment_shader) {
 }
 
 GLuint load_texture (const char* path) {
-    Image image;
-    Image::from_file(path, image);
-    image.flipVertically ();
-    unsigned w = image.width();
-    unsigned h = image.height();
-    unsigned c = image.numComponents();
-    GLenum format;
+    texture_data data;
+    data.decode (path);
+    return data.upload ();
+}
+
+void load_textures (const char* const* paths, unsigned n, GLuint* textures) {
+    // Decode and build mipmaps in parallel, then upload on this thread.
+    unique_ptr<texture_data[]> data (new texture_data[n]);
+    ThreadPool::global().parallel_for (n, [&] (unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; ++i) data[i].decode (paths[i]);
+    });
+    for (unsigned i = 0; i < n; ++i) textures[i] = data[i].upload ();
+}
+
+GLenum texture_format (int components) {
+    switch (components) {
+    case 1:  return GL_LUMINANCE;
+    case 2:  return GL_LUMINANCE_ALPHA;
+    case 3:  return GL_RGB;
+    default: return GL_RGBA;
+    }
+}
+
+// Float images are stored as half floats when the context can, which keeps
+// HDR range at half the memory of single floats.
+GLint texture_internal_format (const Image& image) {
+    int c = image.numComponents();
+    if (image.dataType() != Image::Image_F32 || !GLEW_ARB_texture_float) return c;
     switch (c) {
-    case 1:  format = GL_DEPTH; break;
-    case 3:  format = GL_RGB;   break;
-    default: format = GL_RGBA;  break;
+    case 1:  return GL_LUMINANCE16F_ARB;
+    case 2:  return GL_LUMINANCE_ALPHA16F_ARB;
+    case 3:  return GL_RGB16F_ARB;
+    default: return GL_RGBA16F_ARB;
     }
-    GLuint tex;
-    glGenTextures (1, &tex);
-    glBindTexture (GL_TEXTURE_2D, tex);
+}
+
+GLenum texture_type (Image::DataType type) {
+    return type == Image::Image_F32 ? GL_FLOAT : GL_UNSIGNED_BYTE;
+}
+
+static GLenum texture_type (const Image& image) {
+    return texture_type (image.dataType());
+}
+
+void set_texture_filtering () {
     if (GLEW_EXT_texture_filter_anisotropic) {
         GLfloat ani;
         glGetFloatv (GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &ani);
-        gluBuild2DMipmaps (GL_TEXTURE_2D, c, w, h, format, GL_UNSIGNED_BYTE, image);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, ani);
     }
     else {
-        gluBuild2DMipmaps (GL_TEXTURE_2D, c, w, h, format, GL_UNSIGNED_BYTE, image);
         glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
         glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-        //glTexImage2D (GL_TEXTURE_2D, 0, 4, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.getPixelsPtr());
-        //glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        //glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     }
+}
+
+static bool is_power_of_two (int x) {
+    return x > 0 && (x & (x-1)) == 0;
+}
+
+GLuint create_texture (const Image& image) {
+    unsigned w = image.width();
+    unsigned h = image.height();
+    unsigned c = image.numComponents();
+    bool npot = !is_power_of_two (w) || !is_power_of_two (h);
+    if (!npot || GLEW_ARB_texture_non_power_of_two) {
+        MipChain mips (image);
+        return create_texture (mips);
+    }
+    // Without NPOT textures the image must be rescaled first.
+    GLuint tex;
+    glGenTextures (1, &tex);
+    glBindTexture (GL_TEXTURE_2D, tex);
+    gluBuild2DMipmaps (GL_TEXTURE_2D, texture_internal_format (image), w, h,
+                       texture_format (c), texture_type (image), image);
+    set_texture_filtering ();
+    glBindTexture (GL_TEXTURE_2D, 0);
+    return tex;
+}
+
+GLuint create_texture (const MipChain& mips) {
+    unsigned n = mips.numLevels();
+    int c = n ? mips.level(0).numComponents() : 4;
+    GLenum format = texture_format (c);
+    GLint internal = n ? texture_internal_format (mips.level(0)) : c;
+    GLenum type = n ? texture_type (mips.level(0)) : GL_UNSIGNED_BYTE;
+    GLuint tex;
+    glGenTextures (1, &tex);
+    glBindTexture (GL_TEXTURE_2D, tex);
+    GLint alignment;
+    glGetIntegerv (GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned i = 0; i < n; ++i) {
+        const Image& level = mips.level(i);
+        glTexImage2D (GL_TEXTURE_2D, i, internal, level.width(), level.height(), 0,
+                      format, type, (const U8*) level);
+    }
+    glPixelStorei (GL_UNPACK_ALIGNMENT, alignment);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, n ? n-1 : 0);
+    set_texture_filtering ();
+    glBindTexture (GL_TEXTURE_2D, 0);
+    return tex;
+}
+
+GLenum compressed_texture_format (CompressedImage::Format format, bool& supported) {
+    switch (format) {
+    case CompressedImage::Compressed_BC1:
+        supported = GLEW_EXT_texture_compression_s3tc;
+        return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case CompressedImage::Compressed_BC3:
+        supported = GLEW_EXT_texture_compression_s3tc;
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default:
+        supported = GLEW_ARB_texture_compression_bptc;
+        return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+}
+
+GLuint create_texture (const CompressedImage& image) {
+    bool supported;
+    GLenum format = compressed_texture_format (image.format(), supported);
+    if (!supported && image.format() == CompressedImage::Compressed_BC7) {
+        throw EXCEPTION ("create_texture: BC7 textures need ARB_texture_compression_bptc");
+    }
+
+    unsigned n = image.numLevels();
+    GLuint tex;
+    glGenTextures (1, &tex);
+    glBindTexture (GL_TEXTURE_2D, tex);
+    vector<U8> rgba;
+    GLint alignment;
+    glGetIntegerv (GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned i = 0; i < n; ++i) {
+        int w = image.levelWidth(i), h = image.levelHeight(i);
+        if (supported) {
+            glCompressedTexImage2D (GL_TEXTURE_2D, i, format, w, h, 0, image.levelSize(i), image.levelData(i));
+        }
+        else {
+            // Decompress on the CPU when the context cannot sample S3TC.
+            rgba.resize ((size_t) w * h * 4);
+            image.decode (i, &rgba[0]);
+            glTexImage2D (GL_TEXTURE_2D, i, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+        }
+    }
+    glPixelStorei (GL_UNPACK_ALIGNMENT, alignment);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, n ? n-1 : 0);
+    set_texture_filtering ();
     glBindTexture (GL_TEXTURE_2D, 0);
     return tex;
 }
 
+void update_texture (GLuint texture, int level, int x, int y, const ImageView& pixels) {
+    int w = pixels.width();
+    int h = pixels.height();
+    if (w == 0 || h == 0) return;
+    GLenum format = texture_format (pixels.numComponents());
+    GLenum type = texture_type (pixels.dataType());
+    size_t pixel_size = (size_t) pixels.numComponents() * pixels.dataSize();
+    glBindTexture (GL_TEXTURE_2D, texture);
+    GLint alignment, row_length;
+    glGetIntegerv (GL_UNPACK_ALIGNMENT, &alignment);
+    glGetIntegerv (GL_UNPACK_ROW_LENGTH, &row_length);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    if (pixels.stride() % pixel_size == 0) {
+        glPixelStorei (GL_UNPACK_ROW_LENGTH, (GLint) (pixels.stride() / pixel_size));
+        glTexSubImage2D (GL_TEXTURE_2D, level, x, y, w, h, format, type, pixels.row(0));
+    }
+    else {
+        // A stride that is not a whole number of pixels cannot be described
+        // to OpenGL; upload the rows one by one.
+        glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+        for (int row = 0; row < h; ++row) {
+            glTexSubImage2D (GL_TEXTURE_2D, level, x, y + row, w, 1, format, type, pixels.row(row));
+        }
+    }
+    glPixelStorei (GL_UNPACK_ROW_LENGTH, row_length);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, alignment);
+    glBindTexture (GL_TEXTURE_2D, 0);
+}
+
 GLuint create_program_from_files (const char* vertex_shader, const char* fragment_shader) {
     GLuint vs = create_shader_from_file (vertex_shader, GL_VERTEX_SHADER);
     GLuint fs = create_shader_from_file (fragment_shader, GL_FRAGMENT_SHADER);
@@ -0,0 +1,333 @@
+#include <OGDT/image_ops.h>
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace OGDT;
+using namespace std;
+
+namespace {
+
+template <class T>
+const T* row_at (const T* p, size_t stride, int y) {
+    return (const T*) ((const U8*) p + y * stride);
+}
+
+template <class T>
+T* row_at (T* p, size_t stride, int y) {
+    return (T*) ((U8*) p + y * stride);
+}
+
+void u8_to_f32_row (const U8* src, float* dst, size_t n) {
+    size_t i = 0;
+#ifdef OGDT_SSE2
+    const __m128 scale = _mm_set1_ps (255.0f);
+    const __m128i zero = _mm_setzero_si128 ();
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128 ((const __m128i*) (src + i));
+        __m128i lo = _mm_unpacklo_epi8 (x, zero);
+        __m128i hi = _mm_unpackhi_epi8 (x, zero);
+        // Dividing rather than multiplying by 1/255 gives the same results as the scalar path.
+        _mm_storeu_ps (dst + i,      _mm_div_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (lo, zero)), scale));
+        _mm_storeu_ps (dst + i + 4,  _mm_div_ps (_mm_cvtepi32_ps (_mm_unpackhi_epi16 (lo, zero)), scale));
+        _mm_storeu_ps (dst + i + 8,  _mm_div_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (hi, zero)), scale));
+        _mm_storeu_ps (dst + i + 12, _mm_div_ps (_mm_cvtepi32_ps (_mm_unpackhi_epi16 (hi, zero)), scale));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = src[i] / 255.0f;
+}
+
+float clamp01 (float v) {
+    return v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f; // NaNs fail the first test.
+}
+
+void f32_to_u8_row (const float* src, U8* dst, size_t n) {
+    size_t i = 0;
+#ifdef OGDT_SSE2
+    const __m128 zero = _mm_setzero_ps ();
+    const __m128 one = _mm_set1_ps (1.0f);
+    const __m128 scale = _mm_set1_ps (255.0f);
+    const __m128 half = _mm_set1_ps (0.5f);
+    for (; i + 16 <= n; i += 16) {
+        __m128i q[4];
+        for (int k = 0; k < 4; ++k) {
+            __m128 v = _mm_loadu_ps (src + i + 4*k);
+            v = _mm_min_ps (_mm_max_ps (v, zero), one); // max() returns zero for NaNs.
+            q[k] = _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (v, scale), half));
+        }
+        __m128i lo = _mm_packs_epi32 (q[0], q[1]);
+        __m128i hi = _mm_packs_epi32 (q[2], q[3]);
+        _mm_storeu_si128 ((__m128i*) (dst + i), _mm_packus_epi16 (lo, hi));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = (U8) (clamp01 (src[i]) * 255.0f + 0.5f);
+}
+
+// x * a / 255, rounded to nearest, for x, a in [0,255].
+inline unsigned mul255 (unsigned x, unsigned a) {
+    unsigned t = x * a + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+double srgb_decode (double v) {
+    return v <= 0.04045 ? v / 12.92 : pow ((v + 0.055) / 1.055, 2.4);
+}
+
+struct srgb_tables
+{
+    float decode[256];     // Linear value of each code.
+    float threshold[255];  // Linear value halfway between codes i and i+1, in sRGB space.
+    U8 coarse[4097];       // Code of i/4096, rounded down to a threshold.
+
+    srgb_tables () {
+        for (int i = 0; i < 256; ++i) decode[i] = (float) srgb_decode (i / 255.0);
+        for (int i = 0; i < 255; ++i) threshold[i] = (float) srgb_decode ((i + 0.5) / 255.0);
+        int code = 0;
+        for (int i = 0; i <= 4096; ++i) {
+            float v = i / 4096.0f;
+            while (code < 255 && v >= threshold[code]) code++;
+            coarse[i] = (U8) code;
+        }
+    }
+
+    U8 encode (float v) const {
+        v = clamp01 (v);
+        int code = coarse[(int) (v * 4096.0f)];
+        while (code < 255 && v >= threshold[code]) code++;
+        return (U8) code;
+    }
+};
+
+const srgb_tables& srgb () {
+    static const srgb_tables tables;
+    return tables;
+}
+
+// Average the 2x2 blocks under one output row. r1 may equal r0 for
+// single-row sources; sw is the source width in pixels.
+void box_row (const U8* r0, const U8* r1, U8* out, int sw, int dw, int c) {
+    int x = 0;
+    if (sw == 1) {
+        // A single column: average vertically only.
+        for (int k = 0; k < c; ++k) out[k] = (U8) ((r0[k] + r1[k] + 1) >> 1);
+        return;
+    }
+#ifdef OGDT_SSE2
+    const __m128i two = _mm_set1_epi16 (2);
+    const __m128i zero = _mm_setzero_si128 ();
+    if (c == 4) {
+        // 4 source pixels per row make 2 output pixels.
+        for (; x + 2 <= dw; x += 2) {
+            __m128i a = _mm_loadu_si128 ((const __m128i*) (r0 + 8*x));
+            __m128i b = _mm_loadu_si128 ((const __m128i*) (r1 + 8*x));
+            __m128i lo = _mm_add_epi16 (_mm_unpacklo_epi8 (a, zero), _mm_unpacklo_epi8 (b, zero)); // p0 p1
+            __m128i hi = _mm_add_epi16 (_mm_unpackhi_epi8 (a, zero), _mm_unpackhi_epi8 (b, zero)); // p2 p3
+            __m128i sum = _mm_add_epi16 (_mm_unpacklo_epi64 (lo, hi), _mm_unpackhi_epi64 (lo, hi));
+            sum = _mm_srli_epi16 (_mm_add_epi16 (sum, two), 2);
+            _mm_storel_epi64 ((__m128i*) (out + 4*x), _mm_packus_epi16 (sum, sum));
+        }
+    }
+    else if (c == 1) {
+        // 16 source pixels per row make 8 output pixels.
+        const __m128i even = _mm_set1_epi16 (0xFF);
+        for (; x + 8 <= dw; x += 8) {
+            __m128i a = _mm_loadu_si128 ((const __m128i*) (r0 + 2*x));
+            __m128i b = _mm_loadu_si128 ((const __m128i*) (r1 + 2*x));
+            __m128i sa = _mm_add_epi16 (_mm_and_si128 (a, even), _mm_srli_epi16 (a, 8));
+            __m128i sb = _mm_add_epi16 (_mm_and_si128 (b, even), _mm_srli_epi16 (b, 8));
+            __m128i sum = _mm_srli_epi16 (_mm_add_epi16 (_mm_add_epi16 (sa, sb), two), 2);
+            _mm_storel_epi64 ((__m128i*) (out + x), _mm_packus_epi16 (sum, sum));
+        }
+    }
+#endif
+    for (; x < dw; ++x) {
+        const U8* a = r0 + 2*x*c;
+        const U8* b = r1 + 2*x*c;
+        for (int k = 0; k < c; ++k) {
+            out[x*c + k] = (U8) ((a[k] + a[c+k] + b[k] + b[c+k] + 2) >> 2);
+        }
+    }
+}
+
+// Float levels are averaged without rounding.
+void box_row (const float* r0, const float* r1, float* out, int sw, int dw, int c) {
+    if (sw == 1) {
+        for (int k = 0; k < c; ++k) out[k] = 0.5f * (r0[k] + r1[k]);
+        return;
+    }
+    int x = 0;
+#ifdef OGDT_SSE2
+    if (c == 4) {
+        const __m128 quarter = _mm_set1_ps (0.25f);
+        for (; x < dw; ++x) {
+            __m128 a = _mm_add_ps (_mm_loadu_ps (r0 + 8*x), _mm_loadu_ps (r0 + 8*x + 4));
+            __m128 b = _mm_add_ps (_mm_loadu_ps (r1 + 8*x), _mm_loadu_ps (r1 + 8*x + 4));
+            _mm_storeu_ps (out + 4*x, _mm_mul_ps (_mm_add_ps (a, b), quarter));
+        }
+    }
+#endif
+    for (; x < dw; ++x) {
+        const float* a = r0 + 2*x*c;
+        const float* b = r1 + 2*x*c;
+        for (int k = 0; k < c; ++k) {
+            out[x*c + k] = 0.25f * (a[k] + a[c+k] + b[k] + b[c+k]);
+        }
+    }
+}
+
+} // namespace
+
+void OGDT::rgb_to_rgba (const U8* src, size_t src_stride, U8* dst, size_t dst_stride,
+                        int width, int height, U8 alpha) {
+    for (int y = 0; y < height; ++y) {
+        const U8* s = row_at (src, src_stride, y);
+        U8* d = row_at (dst, dst_stride, y);
+        int x = 0;
+#ifdef OGDT_SSE2
+        // Spread 4 RGB pixels into 32-bit lanes with byte shifts. Each load
+        // reads 16 bytes for 12, so stop while 6 pixels remain.
+        const __m128i rgb = _mm_set1_epi32 (0x00FFFFFF);
+        const __m128i a = _mm_set1_epi32 ((int) ((U32) alpha << 24));
+        for (; x + 6 <= width; x += 4) {
+            __m128i p = _mm_loadu_si128 ((const __m128i*) (s + 3*x));
+            __m128i p01 = _mm_unpacklo_epi32 (p, _mm_srli_si128 (p, 3));
+            __m128i p23 = _mm_unpacklo_epi32 (_mm_srli_si128 (p, 6), _mm_srli_si128 (p, 9));
+            __m128i q = _mm_unpacklo_epi64 (p01, p23);
+            _mm_storeu_si128 ((__m128i*) (d + 4*x), _mm_or_si128 (_mm_and_si128 (q, rgb), a));
+        }
+#endif
+        for (; x < width; ++x) {
+            d[4*x]     = s[3*x];
+            d[4*x + 1] = s[3*x + 1];
+            d[4*x + 2] = s[3*x + 2];
+            d[4*x + 3] = alpha;
+        }
+    }
+}
+
+void OGDT::u8_to_f32 (const U8* src, size_t src_stride, float* dst, size_t dst_stride,
+                      int width, int height, int components) {
+    for (int y = 0; y < height; ++y) {
+        u8_to_f32_row (row_at (src, src_stride, y), row_at (dst, dst_stride, y), (size_t) width * components);
+    }
+}
+
+void OGDT::f32_to_u8 (const float* src, size_t src_stride, U8* dst, size_t dst_stride,
+                      int width, int height, int components) {
+    for (int y = 0; y < height; ++y) {
+        f32_to_u8_row (row_at (src, src_stride, y), row_at (dst, dst_stride, y), (size_t) width * components);
+    }
+}
+
+void OGDT::premultiply_alpha (U8* pixels, size_t stride, int width, int height) {
+    for (int y = 0; y < height; ++y) {
+        U8* p = row_at (pixels, stride, y);
+        int x = 0;
+#ifdef OGDT_SSE2
+        const __m128i zero = _mm_setzero_si128 ();
+        const __m128i round = _mm_set1_epi16 (128);
+        const __m128i alpha = _mm_set1_epi32 ((int) 0xFF000000);
+        for (; x + 4 <= width; x += 4) {
+            __m128i v = _mm_loadu_si128 ((const __m128i*) (p + 4*x));
+            __m128i r[2];
+            for (int k = 0; k < 2; ++k) {
+                __m128i c = k ? _mm_unpackhi_epi8 (v, zero) : _mm_unpacklo_epi8 (v, zero);
+                __m128i a = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (c, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+                __m128i t = _mm_add_epi16 (_mm_mullo_epi16 (c, a), round);
+                r[k] = _mm_srli_epi16 (_mm_add_epi16 (t, _mm_srli_epi16 (t, 8)), 8);
+            }
+            __m128i out = _mm_packus_epi16 (r[0], r[1]);
+            out = _mm_or_si128 (_mm_andnot_si128 (alpha, out), _mm_and_si128 (alpha, v));
+            _mm_storeu_si128 ((__m128i*) (p + 4*x), out);
+        }
+#endif
+        for (; x < width; ++x) {
+            U8* q = p + 4*x;
+            for (int k = 0; k < 3; ++k) q[k] = (U8) mul255 (q[k], q[3]);
+        }
+    }
+}
+
+void OGDT::swizzle (const U8* src, size_t src_stride, U8* dst, size_t dst_stride,
+                    int width, int height, const int order[4]) {
+    for (int y = 0; y < height; ++y) {
+        const U8* s = row_at (src, src_stride, y);
+        U8* d = row_at (dst, dst_stride, y);
+        int x = 0;
+#ifdef OGDT_SSE2
+        // Move each channel to its place within the pixel's 32-bit lane.
+        __m128i left[4], right[4], mask[4];
+        for (int k = 0; k < 4; ++k) {
+            int shift = 8 * (order[k] - k);
+            right[k] = _mm_cvtsi32_si128 (shift > 0 ? shift : 0);
+            left[k] = _mm_cvtsi32_si128 (shift < 0 ? -shift : 0);
+            mask[k] = _mm_set1_epi32 (0xFF << (8*k));
+        }
+        for (; x + 4 <= width; x += 4) {
+            __m128i v = _mm_loadu_si128 ((const __m128i*) (s + 4*x));
+            __m128i out = _mm_setzero_si128 ();
+            for (int k = 0; k < 4; ++k) {
+                __m128i c = _mm_sll_epi32 (_mm_srl_epi32 (v, right[k]), left[k]);
+                out = _mm_or_si128 (out, _mm_and_si128 (c, mask[k]));
+            }
+            _mm_storeu_si128 ((__m128i*) (d + 4*x), out);
+        }
+#endif
+        for (; x < width; ++x) {
+            U8 p[4];
+            memcpy (p, s + 4*x, 4);
+            for (int k = 0; k < 4; ++k) d[4*x + k] = p[order[k]];
+        }
+    }
+}
+
+void OGDT::srgb_to_linear (const U8* src, size_t src_stride, float* dst, size_t dst_stride,
+                           int width, int height, int components) {
+    const float* decode = srgb().decode;
+    bool alpha = components == 4;
+    for (int y = 0; y < height; ++y) {
+        const U8* s = row_at (src, src_stride, y);
+        float* d = row_at (dst, dst_stride, y);
+        size_t n = (size_t) width * components;
+        for (size_t i = 0; i < n; ++i) d[i] = decode[s[i]];
+        if (alpha) {
+            for (int x = 0; x < width; ++x) d[4*x + 3] = s[4*x + 3] / 255.0f;
+        }
+    }
+}
+
+void OGDT::linear_to_srgb (const float* src, size_t src_stride, U8* dst, size_t dst_stride,
+                           int width, int height, int components) {
+    const srgb_tables& tables = srgb();
+    bool alpha = components == 4;
+    for (int y = 0; y < height; ++y) {
+        const float* s = row_at (src, src_stride, y);
+        U8* d = row_at (dst, dst_stride, y);
+        size_t n = (size_t) width * components;
+        for (size_t i = 0; i < n; ++i) d[i] = tables.encode (s[i]);
+        if (alpha) {
+            for (int x = 0; x < width; ++x) d[4*x + 3] = (U8) (clamp01 (s[4*x + 3]) * 255.0f + 0.5f);
+        }
+    }
+}
+
+void OGDT::downscale2 (const U8* src, size_t src_stride, U8* dst, size_t dst_stride,
+                       int width, int height, int components) {
+    int dw = max (1, width / 2), dh = max (1, height / 2);
+    for (int y = 0; y < dh; ++y) {
+        const U8* r0 = row_at (src, src_stride, min (2*y, height-1));
+        const U8* r1 = row_at (src, src_stride, min (2*y + 1, height-1));
+        box_row (r0, r1, row_at (dst, dst_stride, y), width, dw, components);
+    }
+}
+
+void OGDT::downscale2 (const float* src, size_t src_stride, float* dst, size_t dst_stride,
+                       int width, int height, int components) {
+    int dw = max (1, width / 2), dh = max (1, height / 2);
+    for (int y = 0; y < dh; ++y) {
+        const float* r0 = row_at (src, src_stride, min (2*y, height-1));
+        const float* r1 = row_at (src, src_stride, min (2*y + 1, height-1));
+        box_row (r0, r1, row_at (dst, dst_stride, y), width, dw, components);
+    }
+}
@@ -0,0 +1,199 @@
+#include <OGDT/Image.h>
+#include <OGDT/Exception.h>
+#include <OGDT/image_ops.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+using namespace OGDT;
+using namespace std;
+
+namespace {
+
+// Bytes gathered before each fwrite.
+const size_t block_size = 1 << 18;
+
+// Writes rows through a staging buffer in large blocks.
+class block_writer
+{
+    FILE* f;
+    const char* path;
+    vector<U8> buf;
+    size_t used;
+
+    block_writer (const block_writer&);
+    block_writer& operator= (const block_writer&);
+
+    void fail (const char* what) {
+        ostringstream os;
+        os << "Failed writing image file: " << what << "; " << path;
+        throw EXCEPTION (os);
+    }
+
+public:
+
+    block_writer (const char* file) : path (file), used (0) {
+        f = fopen (file, "wb");
+        if (!f) fail ("cannot open the file");
+    }
+
+    ~block_writer () {
+        if (f) fclose (f);
+    }
+
+    /// Return space for n more bytes.
+    U8* reserve (size_t n) {
+        if (used + n > buf.size()) {
+            flush ();
+            if (n > buf.size()) buf.resize (max (n, block_size));
+        }
+        U8* p = &buf[used];
+        used += n;
+        return p;
+    }
+
+    void write (const void* data, size_t n) {
+        memcpy (reserve (n), data, n);
+    }
+
+    void flush () {
+        if (used && fwrite (&buf[0], 1, used, f) != used) fail ("write error");
+        used = 0;
+    }
+
+    void close () {
+        flush ();
+        FILE* file = f;
+        f = nullptr;
+        if (fclose (file) != 0) fail ("write error");
+    }
+};
+
+// Copy the given channels of each pixel, in the given order.
+template <class T>
+void select_channels (const T* src, int w, int c, const int* order, int n, T* dst) {
+    bool identity = c == n;
+    for (int k = 0; k < n; ++k) identity = identity && order[k] == k;
+    if (identity) {
+        memcpy (dst, src, (size_t) w * c * sizeof(T));
+        return;
+    }
+    for (int x = 0; x < w; ++x, src += c, dst += n) {
+        for (int k = 0; k < n; ++k) dst[k] = src[order[k]];
+    }
+}
+
+// Write the image's rows as 8-bit pixels made of the given channels.
+// Rows are written bottom first if 'bottom_up' is true.
+void write_u8_rows (block_writer& out, const Image& image, const int* order, int n, bool bottom_up) {
+    int w = image.width(), h = image.height(), c = image.numComponents();
+    size_t row_size = (size_t) w * c * image.dataSize();
+    bool f32 = image.dataType() == Image::Image_F32;
+    vector<U8> scratch (f32 ? (size_t) w * c : 0);
+    for (int i = 0; i < h; ++i) {
+        int y = bottom_up ? h-1-i : i;
+        const U8* row = (const U8*) image + y * row_size;
+        if (f32) {
+            f32_to_u8 ((const float*) row, 0, &scratch[0], 0, w, 1, c);
+            row = &scratch[0];
+        }
+        select_channels (row, w, c, order, n, out.reserve ((size_t) w * n));
+    }
+}
+
+// Write the image's rows as floats made of the given channels, bottom first.
+// Rows are assembled in an aligned buffer first: the header leaves the
+// writer's buffer at an arbitrary offset, unfit for storing floats.
+void write_f32_rows (block_writer& out, const Image& image, const int* order, int n) {
+    int w = image.width(), h = image.height(), c = image.numComponents();
+    size_t row_size = (size_t) w * c * image.dataSize();
+    bool u8 = image.dataType() == Image::Image_U8;
+    vector<float> scratch (u8 ? (size_t) w * c : 0);
+    vector<float> packed ((size_t) w * n);
+    for (int y = h-1; y >= 0; --y) {
+        const float* row = (const float*) ((const U8*) image + y * row_size);
+        if (u8) {
+            u8_to_f32 ((const U8*) row, 0, &scratch[0], 0, w, 1, c);
+            row = &scratch[0];
+        }
+        select_channels (row, w, c, order, n, &packed[0]);
+        out.write (&packed[0], packed.size() * sizeof(float));
+    }
+}
+
+void check_components (const Image& image, int min_components, const char* file) {
+    if (image.numComponents() < min_components) {
+        ostringstream os;
+        os << "Failed writing image file: the image needs at least " << min_components
+           << " components; " << file;
+        throw EXCEPTION (os);
+    }
+}
+
+} // namespace
+
+void OGDT::write_ppm (const Image& image, const char* file) {
+    check_components (image, 3, file);
+    block_writer out (file);
+    char header[64];
+    int n = sprintf (header, "P6 %d %d 255\n", image.width(), image.height());
+    out.write (header, n);
+    const int rgb[] = { 0, 1, 2 };
+    write_u8_rows (out, image, rgb, 3, false);
+    out.close ();
+}
+
+void OGDT::write_pgm (const Image& image, const char* file) {
+    check_components (image, 1, file);
+    block_writer out (file);
+    char header[64];
+    int n = sprintf (header, "P5 %d %d 255\n", image.width(), image.height());
+    out.write (header, n);
+    const int gray[] = { 0 };
+    write_u8_rows (out, image, gray, 1, false);
+    out.close ();
+}
+
+void OGDT::write_pfm (const Image& image, const char* file) {
+    check_components (image, 1, file);
+    int n = image.numComponents() >= 3 ? 3 : 1;
+    const U16 one = 1;
+    bool little = *(const U8*) &one == 1;
+    block_writer out (file);
+    char header[64];
+    int size = sprintf (header, "P%c\n%d %d\n%s\n", n == 3 ? 'F' : 'f',
+                        image.width(), image.height(), little ? "-1.0" : "1.0");
+    out.write (header, size);
+    const int rgb[] = { 0, 1, 2 };
+    write_f32_rows (out, image, rgb, n);
+    out.close ();
+}
+
+void OGDT::write_tga (const Image& image, const char* file) {
+    check_components (image, 1, file);
+    if (image.width() > 0xFFFF || image.height() > 0xFFFF) {
+        ostringstream os;
+        os << "Failed writing image file: TGA images are at most 65535 pixels across, not "
+           << image.width() << "x" << image.height() << "; " << file;
+        throw EXCEPTION (os);
+    }
+    int c = image.numComponents();
+    int n = c >= 3 ? c : 1;
+    if (n > 4) n = 4;
+    U8 header[18] = { 0 };
+    header[2] = n == 1 ? 3 : 2; // Uncompressed grayscale or true colour.
+    header[12] = (U8) image.width();
+    header[13] = (U8) (image.width() >> 8);
+    header[14] = (U8) image.height();
+    header[15] = (U8) (image.height() >> 8);
+    header[16] = (U8) (8 * n);
+    header[17] = 0x20 | (n == 4 ? 8 : 0); // Top row first; 8 alpha bits.
+    block_writer out (file);
+    out.write (header, sizeof(header));
+    const int bgra[] = { 2, 1, 0, 3 };
+    const int gray[] = { 0 };
+    write_u8_rows (out, image, n == 1 ? gray : bgra, n, false);
+    out.close ();
+}
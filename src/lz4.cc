@@ -0,0 +1,132 @@
+#include "lz4.h"
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const size_t min_match = 4;
+const size_t last_literals = 5; // The last 5 bytes are always literals.
+const size_t match_limit = 12;  // The last match starts at least 12 bytes before the end.
+const size_t max_offset = 65535;
+const int hash_bits = 16;
+
+U32 read32 (const U8* p) {
+    U32 v;
+    memcpy (&v, p, 4);
+    return v;
+}
+
+U32 hash (U32 v) {
+    return (v * 2654435761u) >> (32 - hash_bits);
+}
+
+// Write a length's continuation bytes, after the 15 in its token.
+U8* put_length (U8* op, size_t n) {
+    for (; n >= 255; n -= 255) *op++ = 255;
+    *op++ = (U8) n;
+    return op;
+}
+
+// Append a sequence of literals and, unless it is the last, a match.
+U8* put_sequence (U8* op, U8* oend, const U8* literals, size_t lit, size_t offset, size_t match) {
+    size_t need = 1 + lit / 255 + 1 + lit + (offset ? 2 + match / 255 + 1 : 0);
+    if (need > (size_t) (oend - op)) return nullptr;
+    U8* token = op++;
+    *token = (U8) ((lit < 15 ? lit : 15) << 4);
+    if (lit >= 15) op = put_length (op, lit - 15);
+    memcpy (op, literals, lit);
+    op += lit;
+    if (offset) {
+        *op++ = (U8) offset;
+        *op++ = (U8) (offset >> 8);
+        size_t m = match - min_match;
+        *token |= (U8) (m < 15 ? m : 15);
+        if (m >= 15) op = put_length (op, m - 15);
+    }
+    return op;
+}
+
+// Read a length's continuation bytes.
+bool get_length (const U8*& ip, const U8* iend, size_t& n) {
+    U8 b;
+    do {
+        if (ip >= iend) return false;
+        b = *ip++;
+        n += b;
+    } while (b == 255);
+    return true;
+}
+
+} // namespace
+
+size_t lz4_bound (size_t n) {
+    return n + n / 255 + 16;
+}
+
+size_t lz4_compress (const U8* src, size_t n, U8* dst, size_t capacity) {
+    U8* op = dst;
+    U8* oend = dst + capacity;
+    const U8* anchor = src;
+    const U8* iend = src + n;
+
+    if (n > match_limit) {
+        // Positions plus one, so zero means empty.
+        std::vector<U32> table ((size_t) 1 << hash_bits, 0);
+        const U8* ip = src;
+        const U8* mflimit = iend - match_limit;
+        const U8* mend = iend - last_literals;
+        unsigned misses = 0; // Incompressible data is skipped over faster and faster.
+        while (ip < mflimit) {
+            U32 seq = read32 (ip);
+            U32& slot = table[hash (seq)];
+            const U8* ref = slot ? src + slot - 1 : nullptr;
+            slot = (U32) (ip - src) + 1;
+            if (!ref || (size_t) (ip - ref) > max_offset || read32 (ref) != seq) {
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            // Extend the match backwards over pending literals, then forwards.
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) { --ip; --ref; }
+            const U8* p = ip + min_match;
+            const U8* q = ref + min_match;
+            while (p < mend && *p == *q) { ++p; ++q; }
+            op = put_sequence (op, oend, anchor, ip - anchor, ip - ref, p - ip);
+            if (!op) return 0;
+            ip = anchor = p;
+        }
+    }
+    op = put_sequence (op, oend, anchor, iend - anchor, 0, 0);
+    return op ? op - dst : 0;
+}
+
+bool lz4_decompress (const U8* src, size_t n, U8* dst, size_t size) {
+    const U8* ip = src;
+    const U8* iend = src + n;
+    U8* op = dst;
+    U8* oend = dst + size;
+    while (ip < iend) {
+        U8 token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15 && !get_length (ip, iend, lit)) return false;
+        if (lit > (size_t) (iend - ip) || lit > (size_t) (oend - op)) return false;
+        memcpy (op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == iend) break; // The last sequence has no match.
+
+        if (iend - ip < 2) return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t) (op - dst)) return false;
+        size_t match = token & 15;
+        if (match == 15 && !get_length (ip, iend, match)) return false;
+        match += min_match;
+        if (match > (size_t) (oend - op)) return false;
+        const U8* m = op - offset;
+        if (offset >= match) memcpy (op, m, match);
+        else for (size_t i = 0; i < match; ++i) op[i] = m[i]; // Overlapping: repeats the last 'offset' bytes.
+        op += match;
+    }
+    return op == oend;
+}
@@ -0,0 +1,22 @@
+#ifndef _OGDT_LZ4_H
+#define _OGDT_LZ4_H
+
+#include <OGDT/types.h>
+#include <cstddef>
+
+// LZ4 block format, as written by the reference implementation's
+// LZ4_compress_default and read by LZ4_decompress_safe.
+
+/// Return the largest compressed size of n bytes.
+size_t lz4_bound (size_t n);
+
+/// Compress n bytes into dst, which holds capacity bytes. Returns the
+/// compressed size, or 0 if it does not fit.
+size_t lz4_compress (const U8* src, size_t n, U8* dst, size_t capacity);
+
+/// Decompress n bytes of a block into exactly 'size' bytes of dst. Returns
+/// false if the block is malformed or does not decompress to that size;
+/// never reads or writes out of bounds.
+bool lz4_decompress (const U8* src, size_t n, U8* dst, size_t size);
+
+#endif // _OGDT_LZ4_H
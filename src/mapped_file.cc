@@ -0,0 +1,93 @@
+#include "mapped_file.h"
+
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <Windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#ifdef WIN32
+
+mapped_file::mapped_file () : data (nullptr), size (0), file (nullptr), mapping (nullptr) {}
+
+bool mapped_file::open (const char* path, bool writable) {
+    close ();
+    HANDLE f = CreateFileA (path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (f == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER n;
+    if (!GetFileSizeEx (f, &n)) {
+        CloseHandle (f);
+        return false;
+    }
+    file = f;
+    size = (size_t) n.QuadPart;
+    if (size == 0) return true;
+    HANDLE m = CreateFileMappingA (f, NULL, writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+    if (!m) {
+        close ();
+        return false;
+    }
+    mapping = m;
+    data = (U8*) MapViewOfFile (m, writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        close ();
+        return false;
+    }
+    return true;
+}
+
+void mapped_file::close () {
+    if (data) UnmapViewOfFile (data);
+    if (mapping) CloseHandle ((HANDLE) mapping);
+    if (file) CloseHandle ((HANDLE) file);
+    data = nullptr;
+    size = 0;
+    mapping = nullptr;
+    file = nullptr;
+}
+
+#else // POSIX
+
+mapped_file::mapped_file () : data (nullptr), size (0) {}
+
+bool mapped_file::open (const char* path, bool writable) {
+    close ();
+    int fd = ::open (path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode)) {
+        ::close (fd);
+        return false;
+    }
+    size = (size_t) st.st_size;
+    if (size == 0) {
+        ::close (fd);
+        return true;
+    }
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* p = mmap (nullptr, size, prot, MAP_PRIVATE, fd, 0);
+    ::close (fd); // The mapping keeps the file open.
+    if (p == MAP_FAILED) {
+        size = 0;
+        return false;
+    }
+    data = (U8*) p;
+    return true;
+}
+
+void mapped_file::close () {
+    if (data) munmap (data, size);
+    data = nullptr;
+    size = 0;
+}
+
+#endif
+
+mapped_file::~mapped_file () {
+    close ();
+}
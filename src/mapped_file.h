@@ -0,0 +1,37 @@
+#ifndef _OGDT_MAPPED_FILE_H
+#define _OGDT_MAPPED_FILE_H
+
+#include <OGDT/types.h>
+#include <cstddef>
+
+/// A whole file mapped into memory.
+///
+/// Writable mappings are copy-on-write: pages written to are copied and the
+/// file itself never changes.
+struct mapped_file
+{
+    U8* data;
+    size_t size;
+
+    mapped_file ();
+    ~mapped_file ();
+
+    /// Map the given file, unmapping the current one. Returns false if the
+    /// file cannot be opened or mapped. Empty files map to a null 'data'.
+    bool open (const char* path, bool writable = false);
+
+    /// Unmap the file.
+    void close ();
+
+private:
+
+#ifdef WIN32
+    void* file;
+    void* mapping;
+#endif
+
+    mapped_file (const mapped_file&);
+    mapped_file& operator= (const mapped_file&);
+};
+
+#endif // _OGDT_MAPPED_FILE_H
@@ -0,0 +1,219 @@
+#include <OGDT/model.h>
+#include <OGDT/types.h>
+#include "../simd.h"
+#include <algorithm>
+#include <vector>
+
+using namespace OGDT;
+using namespace std;
+
+// Bound on the number of durations wrapped in one update, keeping the
+// conversion to int in range.
+static const float wrap_limit = 1 << 30;
+
+struct InstancePool::_impl
+{
+    const Model& model;
+
+    // One entry per instance. Flags are 0 or all bits set so they can be
+    // used directly as SIMD masks.
+    vector<const Animation*> anim;
+    vector<float> t;
+    vector<float> speed;
+    vector<float> duration;
+    vector<U32> start;  // First frame of the animation.
+    vector<U32> last;   // Last frame of the animation.
+    vector<U32> loop;
+    vector<U32> active;
+    vector<FramePair> frames;
+
+    _impl (const Model& _model) : model (_model) {}
+
+    void reserve (unsigned n) {
+        anim.reserve (n);
+        t.reserve (n);
+        speed.reserve (n);
+        duration.reserve (n);
+        start.reserve (n);
+        last.reserve (n);
+        loop.reserve (n);
+        active.reserve (n);
+        frames.reserve (n);
+    }
+
+    // Advance instance i; the scalar counterpart of the SIMD loop in update,
+    // performing the same float operations so both give the same frames.
+    void step (unsigned i, float dt) {
+        if (active[i]) {
+            float d = duration[i];
+            t[i] += dt * speed[i];
+            if (loop[i]) {
+                // Wrap by whole durations, so large steps and negative
+                // speeds land in [0, d) too.
+                float q = min (max (t[i] / d, -wrap_limit), wrap_limit);
+                float w = (float) (int) q;
+                if (w > q) w -= 1.0f;
+                t[i] -= w * d;
+                if (!(t[i] >= 0.0f && t[i] < d)) t[i] = 0.0f;
+            }
+            else if (t[i] > d - 1) {
+                t[i] = d - 1;
+                active[i] = 0;
+            }
+            else if (t[i] < 0.0f) {
+                t[i] = 0.0f;
+                active[i] = 0;
+            }
+        }
+        FramePair& f = frames[i];
+        U32 whole = (U32) t[i];
+        f.frame1 = min (start[i] + whole, last[i]);
+        f.frame2 = f.frame1 == last[i] ? start[i] : f.frame1 + 1;
+        f.p = t[i] - (float) whole;
+    }
+};
+
+InstancePool::InstancePool (const Model& model, unsigned capacity)
+    : impl (new _impl (model)) {
+    impl->reserve (capacity);
+}
+
+InstancePool::~InstancePool () {
+    delete impl;
+}
+
+unsigned InstancePool::add () {
+    impl->anim.push_back (nullptr);
+    impl->t.push_back (0.0f);
+    impl->speed.push_back (1.0f);
+    impl->duration.push_back (1.0f);
+    impl->start.push_back (0);
+    impl->last.push_back (0);
+    impl->loop.push_back (0);
+    impl->active.push_back (0);
+    FramePair f = { 0, 0, 0.0f };
+    impl->frames.push_back (f);
+    return impl->anim.size() - 1;
+}
+
+template <class T>
+static void swap_remove (vector<T>& v, unsigned i) {
+    v[i] = v.back();
+    v.pop_back();
+}
+
+void InstancePool::remove (unsigned i) {
+    swap_remove (impl->anim, i);
+    swap_remove (impl->t, i);
+    swap_remove (impl->speed, i);
+    swap_remove (impl->duration, i);
+    swap_remove (impl->start, i);
+    swap_remove (impl->last, i);
+    swap_remove (impl->loop, i);
+    swap_remove (impl->active, i);
+    swap_remove (impl->frames, i);
+}
+
+unsigned InstancePool::size () const {
+    return impl->anim.size();
+}
+
+void InstancePool::setAnimation (unsigned i, const Animation& anim, bool loop) {
+    impl->anim[i] = &anim;
+    impl->t[i] = 0.0f;
+    impl->duration[i] = anim.duration;
+    impl->start[i] = anim.start;
+    impl->last[i] = anim.start + (U32) anim.duration - 1;
+    impl->loop[i] = loop ? ~0u : 0u;
+    impl->active[i] = ~0u;
+}
+
+void InstancePool::setAnimationSpeed (unsigned i, float speed) {
+    impl->speed[i] = speed;
+}
+
+const Animation* InstancePool::getAnimation (unsigned i) const {
+    return impl->anim[i];
+}
+
+bool InstancePool::isAnimationDone (unsigned i) const {
+    return !impl->active[i];
+}
+
+void InstancePool::update (float dt) {
+    unsigned n = impl->anim.size();
+    unsigned i = 0;
+#ifdef OGDT_SSE2
+    const __m128 vdt = _mm_set1_ps (dt);
+    const __m128 one = _mm_set1_ps (1.0f);
+    const __m128 zero = _mm_setzero_ps ();
+    const __m128i ione = _mm_set1_epi32 (1);
+    for (; i + 4 <= n; i += 4) {
+        __m128 t = _mm_loadu_ps (&impl->t[i]);
+        __m128 speed = _mm_loadu_ps (&impl->speed[i]);
+        __m128 dur = _mm_loadu_ps (&impl->duration[i]);
+        __m128 active = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i*) &impl->active[i]));
+        __m128 loop = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i*) &impl->loop[i]));
+
+        t = _mm_add_ps (t, _mm_and_ps (active, _mm_mul_ps (vdt, speed)));
+
+        // Looping animations wrap by whole durations.
+        __m128 q = _mm_min_ps (_mm_max_ps (_mm_div_ps (t, dur), _mm_set1_ps (-wrap_limit)),
+                               _mm_set1_ps (wrap_limit));
+        __m128 w = _mm_cvtepi32_ps (_mm_cvttps_epi32 (q));
+        w = _mm_sub_ps (w, _mm_and_ps (_mm_cmpgt_ps (w, q), one));
+        __m128 wrapped = _mm_sub_ps (t, _mm_mul_ps (w, dur));
+        __m128 in_range = _mm_and_ps (_mm_cmpge_ps (wrapped, zero), _mm_cmplt_ps (wrapped, dur));
+        wrapped = _mm_and_ps (in_range, wrapped);
+        __m128 wrap = _mm_and_ps (active, loop);
+        t = _mm_or_ps (_mm_andnot_ps (wrap, t), _mm_and_ps (wrap, wrapped));
+
+        // Others stop at their first or last frame.
+        __m128 end = _mm_sub_ps (dur, one);
+        __m128 once = _mm_andnot_ps (loop, active);
+        __m128 past = _mm_and_ps (once, _mm_cmpgt_ps (t, end));
+        __m128 before = _mm_andnot_ps (past, _mm_and_ps (once, _mm_cmplt_ps (t, zero)));
+        t = _mm_or_ps (_mm_andnot_ps (past, t), _mm_and_ps (past, end));
+        t = _mm_andnot_ps (before, t);
+        active = _mm_andnot_ps (_mm_or_ps (past, before), active);
+
+        _mm_storeu_ps (&impl->t[i], t);
+        _mm_storeu_si128 ((__m128i*) &impl->active[i], _mm_castps_si128 (active));
+
+        // Frames to interpolate. Frame indices are far below 2^31, so signed
+        // compares do.
+        __m128i whole = _mm_cvttps_epi32 (t);
+        __m128 p = _mm_sub_ps (t, _mm_cvtepi32_ps (whole));
+        __m128i start = _mm_loadu_si128 ((const __m128i*) &impl->start[i]);
+        __m128i last = _mm_loadu_si128 ((const __m128i*) &impl->last[i]);
+        __m128i f1 = _mm_add_epi32 (start, whole);
+        __m128i over = _mm_cmpgt_epi32 (f1, last);
+        f1 = _mm_or_si128 (_mm_andnot_si128 (over, f1), _mm_and_si128 (over, last));
+        __m128i at_end = _mm_cmpeq_epi32 (f1, last);
+        __m128i f2 = _mm_or_si128 (_mm_and_si128 (at_end, start),
+                                   _mm_andnot_si128 (at_end, _mm_add_epi32 (f1, ione)));
+
+        U32 f1s[4], f2s[4];
+        float ps[4];
+        _mm_storeu_si128 ((__m128i*) f1s, f1);
+        _mm_storeu_si128 ((__m128i*) f2s, f2);
+        _mm_storeu_ps (ps, p);
+        FramePair* out = &impl->frames[i];
+        for (unsigned k = 0; k < 4; ++k) {
+            out[k].frame1 = f1s[k];
+            out[k].frame2 = f2s[k];
+            out[k].p = ps[k];
+        }
+    }
+#endif
+    for (; i < n; ++i) impl->step (i, dt);
+}
+
+const FramePair* InstancePool::frames () const {
+    return impl->frames.empty() ? nullptr : &impl->frames[0];
+}
+
+void InstancePool::render (unsigned i) const {
+    const FramePair& f = impl->frames[i];
+    impl->model.renderFrames (f.frame1, f.frame2, f.p);
+}
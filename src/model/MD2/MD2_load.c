@@ -1,4 +1,7 @@
 #include "MD2_load.h"
+#include "../../parallel.h"
+#include "../../simd.h"
+#include <stddef.h> // offsetof
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h> // malloc
@@ -151,8 +154,25 @@ static void normal_map_insert (normal_map* m, vec3* vec, vec3 normal)
 static void compute_normals (normal_map* m, char left_handed)
 {
     vec3* n = m->normals;
-    unsigned int i;
-    for (i = 0; i < m->N; ++i)
+    unsigned int i = 0;
+#ifdef OGDT_SSE2
+    // Normalise 4 normals at a time. The sign flip is folded into the scale.
+    const __m128 zero = _mm_setzero_ps ();
+    const __m128 one  = _mm_set1_ps (1.0f);
+    const __m128 sign = _mm_set1_ps (left_handed ? 1.0f : -1.0f);
+    for (; i + 4 <= m->N; i += 4)
+    {
+        __m128 x, y, z, mag, is_zero, s;
+        simd_load_xyz4 ((const float*) n, &x, &y, &z);
+        mag = _mm_sqrt_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (x, x), _mm_mul_ps (y, y)), _mm_mul_ps (z, z)));
+        is_zero = _mm_cmpeq_ps (mag, zero);
+        mag = _mm_or_ps (_mm_andnot_ps (is_zero, mag), _mm_and_ps (is_zero, one));
+        s = _mm_div_ps (sign, mag);
+        simd_store_xyz4 ((float*) n, _mm_mul_ps (x, s), _mm_mul_ps (y, s), _mm_mul_ps (z, s));
+        n += 4;
+    }
+#endif
+    for (; i < m->N; ++i)
     {
         if (!left_handed)
         {
@@ -166,6 +186,65 @@ static void compute_normals (normal_map* m, char left_handed)
 }
 
 
+/// Per-frame normal generation, shared by every worker.
+typedef struct
+{
+    const triangle* triangles;
+    vec3* vertices;
+    vec3* normals;
+    unsigned numVertices;
+    unsigned numTriangles;
+    char clockwise;
+    char left_handed;
+}
+normal_job;
+
+
+/// Compute smooth normals for frames [begin, end).
+/// Each frame only writes its own slice of the normals array.
+static void compute_frame_normals (void* data, unsigned begin, unsigned end)
+{
+    const normal_job* job = (const normal_job*) data;
+    normal_map map;
+    vec3 n;
+    unsigned f, i;
+
+    normal_map_initialise (&map, job->numVertices);
+
+    for (f = begin; f < end; ++f)
+    {
+        // Set a pointer to the triangle array.
+        const triangle* t = job->triangles;
+
+        // Set a pointer to the vertex array at the appropiate position.
+        vec3* vertex_array = job->vertices + job->numVertices * f;
+
+        // Set a pointer to the normals array at the appropiate position.
+        vec3* normals_ptr = job->normals + job->numVertices * f;
+
+        normal_map_clear (&map, normals_ptr, vertex_array);
+
+        for (i = 0; i < job->numTriangles; ++i)
+        {
+            // Compute face normal.
+            vec3* v0 = &vertex_array[t->vertexIndices[0]];
+            vec3* v1 = &vertex_array[t->vertexIndices[1]];
+            vec3* v2 = &vertex_array[t->vertexIndices[2]];
+            normal (job->clockwise, v0, v1, v2, &n);
+
+            // Add face normal to each of the face's vertices.
+            normal_map_insert (&map, v0, n);
+            normal_map_insert (&map, v1, n);
+            normal_map_insert (&map, v2, n);
+
+            t++;
+        }
+
+        compute_normals (&map, job->left_handed);
+    }
+}
+
+
 static void safe_free (void* ptr)
 {
     if (ptr) free (ptr);
@@ -213,12 +292,43 @@ static void animation_remove_numbers (char* name)
 }
 
 
-Model_error_code MD2_load (const char* filename, char clockwise, char left_handed, MorphModel* model)
+// Return true if every array the header points to lies within the buffer.
+static int md2_array_valid (size_t size, I32 offset, I32 count, size_t element_size)
 {
-    long int fileSize;
-    md2Header_t* header;
-    int magic;
-    FILE*       filePtr;
+    return offset >= 0 && count >= 0 && (size_t) offset <= size
+        && (size_t) count <= (size - (size_t) offset) / element_size;
+}
+
+
+static int md2_header_valid (const md2Header_t* header, size_t size)
+{
+    if (header->numFrames <= 0 || header->numVertices < 0 || header->numVertices > 65536) return 0;
+    if (header->frameSize < (I32) offsetof(frame_t, vertices) + 4 * header->numVertices) return 0;
+    return md2_array_valid (size, header->offsetFrames, header->numFrames, header->frameSize)
+        && md2_array_valid (size, header->offsetTriangles, header->numTriangles, sizeof(triangle))
+        && md2_array_valid (size, header->offsetTexCoords, header->numTexCoords, sizeof(texCoord_t))
+        && md2_array_valid (size, header->offsetSkins, header->numSkins, sizeof(skin));
+}
+
+
+// Return true if every triangle indexes existing vertices and texture coordinates.
+static int md2_triangles_valid (const triangle* t, int n, int numVertices, int numTexCoords)
+{
+    int i, k;
+    for (i = 0; i < n; ++i)
+    {
+        for (k = 0; k < 3; ++k)
+        {
+            if (t[i].vertexIndices[k] >= numVertices || t[i].textureIndices[k] >= numTexCoords) return 0;
+        }
+    }
+    return 1;
+}
+
+
+Model_error_code MD2_load_mem (const char* buffer, size_t size, char clockwise, char left_handed, MorphModel* model)
+{
+    const md2Header_t* header;
     vec3*       vertices;
     vec3*       normals;
     texCoord*   texCoords;
@@ -226,60 +336,24 @@ Model_error_code MD2_load (const char* filename, char clockwise, char left_hande
     skin*       skins;
     animation* animations;
     animation* currentAnimation;
-    vec3 n;
-    normal_map map;
+    normal_job job;
     const skin* s;
     float sw;
     float sh;
     texCoord_t* texc;
     triangle* t;
     frame_t* frame;
-    char* buffer;
     unsigned start;
     unsigned numAnimations = 1;
     int currentFrame;
     const I8* name = 0;
     int i;
 
-    // Open the file for reading.
-    filePtr = fopen(filename, "rb");
-    if (!filePtr) return Model_File_Not_Found;
-
     // Make sure it is an MD2 file.
-    if ((fread(&magic, 4, 1, filePtr)) != 1)
-    {
-        fclose(filePtr);
-        return Model_Read_Error;
-    }
-
-    if (magic != MD2_ID) return Model_File_Mismatch;
-
-    // Find out the file size.
-    fseek(filePtr, 0, SEEK_END);
-    fileSize = ftell(filePtr);
-    fseek(filePtr, 0, SEEK_SET);
-
-    // Allocate a chunk of data to store the file in.
-    buffer = (char*) malloc(fileSize);
-    if (!buffer)
-    {
-        fclose(filePtr);
-        return Model_Memory_Allocation_Error;
-    }
-
-    // Read the entire file into memory.
-    if ((fread(buffer, 1, fileSize, filePtr)) != (unsigned int)fileSize)
-    {
-        fclose(filePtr);
-        free(buffer);
-        return Model_Read_Error;
-    }
-
-    // File stream is no longer needed.
-    fclose(filePtr);
-
-    // Set a pointer to the header for parsing.
-    header = (md2Header_t*) buffer;
+    if (size < sizeof(md2Header_t)) return Model_Read_Error;
+    header = (const md2Header_t*) buffer;
+    if (header->magic != MD2_ID) return Model_File_Mismatch;
+    if (!md2_header_valid (header, size)) return Model_Read_Error;
 
     // Compute the number of animations.
     for (currentFrame = 0; currentFrame < header->numFrames; ++currentFrame)
@@ -296,6 +370,12 @@ Model_error_code MD2_load (const char* filename, char clockwise, char left_hande
         }
     }
 
+    if (!md2_triangles_valid ((const triangle*) &buffer[header->offsetTriangles], header->numTriangles,
+                              header->numVertices, header->numTexCoords))
+    {
+        return Model_Read_Error;
+    }
+
     // Allocate memory for arrays.
     vertices   = (vec3*) malloc(sizeof(vec3) * header->numVertices * header->numFrames);
     normals    = (vec3*) malloc(sizeof(vec3) * header->numVertices * header->numFrames);
@@ -312,7 +392,6 @@ Model_error_code MD2_load (const char* filename, char clockwise, char left_hande
         safe_free (texCoords);
         safe_free (normals);
         safe_free (vertices);
-        free (buffer);
         return Model_Memory_Allocation_Error;
     }
 
@@ -380,40 +459,17 @@ Model_error_code MD2_load (const char* filename, char clockwise, char left_hande
         texc++;
     }
 
-    // Iterate over every frame and compute normals for every triangle.
-    normal_map_initialise (&map, header->numVertices);
-
-    for (currentFrame = 0; currentFrame < header->numFrames; ++currentFrame)
-    {
-        // Set a pointer to the triangle array.
-        triangle* t = triangles;
-
-        // Set a pointer to the vertex array at the appropiate position.
-        vec3* vertex_array = vertices + header->numVertices * currentFrame;
-
-        // Set a pointer to the normals array at the appropiate position.
-        vec3* normals_ptr = normals + header->numVertices * currentFrame;
-
-        normal_map_clear (&map, normals_ptr, vertex_array);
-
-        for (i = 0; i < header->numTriangles; ++i)
-        {
-            // Compute face normal.
-            vec3* v0 = &vertex_array[t->vertexIndices[0]];
-            vec3* v1 = &vertex_array[t->vertexIndices[1]];
-            vec3* v2 = &vertex_array[t->vertexIndices[2]];
-            normal (clockwise, v0, v1, v2, &n);
-
-            // Add face normal to each of the face's vertices.
-            normal_map_insert (&map, v0, n);
-            normal_map_insert (&map, v1, n);
-            normal_map_insert (&map, v2, n);
-
-            t++;
-        }
-
-        compute_normals (&map, left_handed);
-    }
+    // Compute normals for every frame. Frames are independent, so they are
+    // spread over the thread pool in chunks of roughly equal triangle count.
+    job.triangles    = triangles;
+    job.vertices     = vertices;
+    job.normals      = normals;
+    job.numVertices  = header->numVertices;
+    job.numTriangles = header->numTriangles;
+    job.clockwise    = clockwise;
+    job.left_handed  = left_handed;
+    pool_parallel_for (header->numFrames, 1 + 8192 / (header->numTriangles + 1),
+                       compute_frame_normals, &job);
 
     // Load the model's skins.
     s = (const skin*) &buffer[header->offsetSkins];
@@ -471,7 +527,56 @@ Model_error_code MD2_load (const char* filename, char clockwise, char left_hande
     model->numSkins      = header->numSkins;
     model->numAnimations = numAnimations;
 
-    free(buffer);
+    model->animationIndex     = 0;
+    model->animationIndexSize = 0;
+    model_index_animations (model);
+
+    memset (model->lods, 0, sizeof(model->lods));
+    memset (model->lodTriangles, 0, sizeof(model->lodTriangles));
+    model->lods[0]         = triangles;
+    model->lodTriangles[0] = header->numTriangles;
+    model->numLods         = 1;
 
     return Model_Success;
 }
+
+
+Model_error_code MD2_load (const char* filename, char clockwise, char left_handed, MorphModel* model)
+{
+    long int fileSize;
+    FILE* filePtr;
+    char* buffer;
+    Model_error_code result;
+
+    // Open the file for reading.
+    filePtr = fopen(filename, "rb");
+    if (!filePtr) return Model_File_Not_Found;
+
+    // Find out the file size.
+    fseek(filePtr, 0, SEEK_END);
+    fileSize = ftell(filePtr);
+    fseek(filePtr, 0, SEEK_SET);
+
+    // Allocate a chunk of data to store the file in.
+    buffer = (char*) malloc(fileSize > 0 ? fileSize : 1);
+    if (!buffer)
+    {
+        fclose(filePtr);
+        return Model_Memory_Allocation_Error;
+    }
+
+    // Read the entire file into memory.
+    if (fileSize < 0 || (fread(buffer, 1, fileSize, filePtr)) != (unsigned long)fileSize)
+    {
+        fclose(filePtr);
+        free(buffer);
+        return Model_Read_Error;
+    }
+
+    // File stream is no longer needed.
+    fclose(filePtr);
+
+    result = MD2_load_mem(buffer, fileSize, clockwise, left_handed, model);
+    free(buffer);
+    return result;
+}
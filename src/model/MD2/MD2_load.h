@@ -3,6 +3,7 @@
 
 #include "../MorphModel.h"
 #include "../Model_error_code.h"
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -13,6 +14,10 @@ extern "C" {
 /// 'smooth_normals' should be 1 if you want the loader to compute smooth normals, 0 otherwise.
 Model_error_code MD2_load (const char* filename, char clockwise, char left_handed, MorphModel* model);
 
+/// Loads an MD2 model from the 'size' bytes of a file in memory. The buffer
+/// is only read, and may be released once the function returns.
+Model_error_code MD2_load_mem (const char* buffer, size_t size, char clockwise, char left_handed, MorphModel* model);
+
 #ifdef __cplusplus
 }
 #endif
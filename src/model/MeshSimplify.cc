@@ -0,0 +1,328 @@
+#include "MeshSimplify.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// Frames sampled to measure the error of a collapse.
+const unsigned max_sampled_frames = 8;
+
+struct quadric
+{
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+    quadric () : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0) {}
+
+    // Add the plane a*x + b*y + c*z + d = 0 with the given weight.
+    void add_plane (double a, double b, double c, double d, double w) {
+        a2 += w*a*a; ab += w*a*b; ac += w*a*c; ad += w*a*d;
+        b2 += w*b*b; bc += w*b*c; bd += w*b*d;
+        c2 += w*c*c; cd += w*c*d;
+        d2 += w*d*d;
+    }
+
+    void operator+= (const quadric& q) {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+    }
+
+    double eval (const float* p) const {
+        double x = p[0], y = p[1], z = p[2];
+        return a2*x*x + 2*ab*x*y + 2*ac*x*z + 2*ad*x
+             + b2*y*y + 2*bc*y*z + 2*bd*y
+             + c2*z*z + 2*cd*z
+             + d2;
+    }
+};
+
+void cross (const float* a, const float* b, const float* c, float* n) {
+    float u[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
+    float v[3] = { c[0]-a[0], c[1]-a[1], c[2]-a[2] };
+    n[0] = u[1]*v[2] - u[2]*v[1];
+    n[1] = u[2]*v[0] - u[0]*v[2];
+    n[2] = u[0]*v[1] - u[1]*v[0];
+}
+
+struct candidate
+{
+    double cost;
+    U32 pos;
+    U32 version;
+
+    bool operator< (const candidate& c) const { return cost > c.cost; }
+};
+
+struct simplifier
+{
+    const simplify_mesh& mesh;
+    vector<unsigned> frames;       // Sampled frames.
+    vector<U32> tris;              // Three corners per triangle.
+    vector<U8> alive;              // Per triangle.
+    vector<vector<U32> > adj;      // Triangles around each position; may hold dead ones.
+    vector<U8> locked;             // Per position.
+    vector<U8> removed;            // Per position.
+    vector<U32> version;           // Per position, bumped when its neighbourhood changes.
+    vector<quadric> quadrics;      // frames.size() per position.
+    priority_queue<candidate> heap;
+    unsigned live;
+
+    simplifier (const simplify_mesh& _mesh) : mesh (_mesh), live (0) {}
+
+    const float* pos (U32 p, unsigned s) const {
+        return mesh.positions + 3 * ((size_t) frames[s] * mesh.numPositions + p);
+    }
+
+    U32 position (U32 corner) const {
+        return mesh.cornerPositions[corner];
+    }
+
+    bool has_position (U32 t, U32 p) const {
+        return position (tris[3*t]) == p || position (tris[3*t+1]) == p || position (tris[3*t+2]) == p;
+    }
+
+    void init () {
+        unsigned nf = mesh.numFrames ? mesh.numFrames : 1;
+        unsigned ns = min (nf, max_sampled_frames);
+        for (unsigned s = 0; s < ns; ++s) frames.push_back (s * nf / ns);
+
+        unsigned np = mesh.numPositions;
+        unsigned nt = mesh.numTriangles;
+        tris.assign (mesh.triangles, mesh.triangles + 3 * nt);
+        alive.assign (nt, 0);
+        adj.resize (np);
+        locked.assign (np, 0);
+        removed.assign (np, 0);
+        version.assign (np, 0);
+        quadrics.resize ((size_t) np * ns);
+
+        if (mesh.locked) {
+            for (U32 p = 0; p < np; ++p) locked[p] = mesh.locked[p];
+        }
+
+        // Positions with several corners lie on seams.
+        vector<U32> corner_of (np, ~0u);
+        for (U32 c = 0; c < mesh.numCorners; ++c) {
+            U32 p = position (c);
+            if (corner_of[p] == ~0u) corner_of[p] = c;
+            else if (corner_of[p] != c) locked[p] = 1;
+        }
+
+        // Edges not shared by exactly two triangles lie on borders or are
+        // non-manifold; keep their ends.
+        vector<pair<U32,U32> > edges;
+        for (U32 t = 0; t < nt; ++t) {
+            U32 p[3] = { position (tris[3*t]), position (tris[3*t+1]), position (tris[3*t+2]) };
+            if (p[0] == p[1] || p[1] == p[2] || p[2] == p[0]) continue;
+            alive[t] = 1;
+            live++;
+            for (int j = 0; j < 3; ++j) {
+                adj[p[j]].push_back (t);
+                U32 a = p[j], b = p[(j+1)%3];
+                edges.push_back (make_pair (min (a, b), max (a, b)));
+            }
+        }
+        sort (edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size(); ) {
+            size_t j = i + 1;
+            while (j < edges.size() && edges[j] == edges[i]) ++j;
+            if (j - i != 2) locked[edges[i].first] = locked[edges[i].second] = 1;
+            i = j;
+        }
+
+        // Plane quadrics weighted by triangle area.
+        for (U32 t = 0; t < nt; ++t) {
+            if (!alive[t]) continue;
+            for (unsigned s = 0; s < ns; ++s) {
+                const float* a = pos (position (tris[3*t]), s);
+                const float* b = pos (position (tris[3*t+1]), s);
+                const float* c = pos (position (tris[3*t+2]), s);
+                float n[3];
+                cross (a, b, c, n);
+                double len = sqrt ((double) n[0]*n[0] + (double) n[1]*n[1] + (double) n[2]*n[2]);
+                if (len <= 0.0) continue;
+                double nx = n[0]/len, ny = n[1]/len, nz = n[2]/len;
+                double d = -(nx*a[0] + ny*a[1] + nz*a[2]);
+                for (int j = 0; j < 3; ++j) {
+                    quadrics[(size_t) position (tris[3*t+j]) * ns + s].add_plane (nx, ny, nz, d, 0.5 * len);
+                }
+            }
+        }
+
+        for (U32 p = 0; p < np; ++p) push (p);
+    }
+
+    double cost (U32 u, U32 v) const {
+        unsigned ns = frames.size();
+        double e = 0.0;
+        for (unsigned s = 0; s < ns; ++s) e += quadrics[(size_t) u * ns + s].eval (pos (v, s));
+        return e;
+    }
+
+    // Positions sharing a live triangle with p.
+    void neighbours (U32 p, vector<U32>& out) const {
+        out.clear ();
+        for (U32 t : adj[p]) {
+            if (!alive[t]) continue;
+            for (int j = 0; j < 3; ++j) {
+                U32 q = position (tris[3*t+j]);
+                if (q != p) out.push_back (q);
+            }
+        }
+        sort (out.begin(), out.end());
+        out.erase (unique (out.begin(), out.end()), out.end());
+    }
+
+    void push (U32 u) {
+        if (locked[u] || removed[u]) return;
+        vector<U32> ns;
+        neighbours (u, ns);
+        if (ns.empty()) return;
+        double best = -1.0;
+        for (U32 v : ns) {
+            double c = cost (u, v);
+            if (best < 0.0 || c < best) best = c;
+        }
+        candidate cand = { best, u, version[u] };
+        heap.push (cand);
+    }
+
+    // Check that u can collapse onto v. Return the corner v takes in u's
+    // triangles, or ~0 if the collapse is not allowed.
+    U32 check (U32 u, U32 v, const vector<U32>& nu) const {
+        U32 cv = ~0u;
+        unsigned shared = 0;
+        vector<U32> opposite;
+        for (U32 t : adj[u]) {
+            if (!alive[t] || !has_position (t, v)) continue;
+            shared++;
+            for (int j = 0; j < 3; ++j) {
+                U32 c = tris[3*t+j];
+                U32 p = position (c);
+                if (p == v) {
+                    if (cv != ~0u && cv != c) return ~0u;
+                    cv = c;
+                }
+                else if (p != u) opposite.push_back (p);
+            }
+        }
+        if (cv == ~0u) return ~0u;
+
+        // Link condition: the only common neighbours are the vertices
+        // opposite the collapsed edge, or the surface would pinch.
+        vector<U32> nv;
+        neighbours (v, nv);
+        unsigned common = 0;
+        for (U32 p : nu) {
+            if (binary_search (nv.begin(), nv.end(), p)) common++;
+        }
+        if (common != opposite.size() || shared != opposite.size()) return ~0u;
+
+        // No remaining triangle may flip or degenerate in any sampled frame.
+        for (U32 t : adj[u]) {
+            if (!alive[t] || has_position (t, v)) continue;
+            for (unsigned s = 0; s < frames.size(); ++s) {
+                const float* p[3];
+                const float* q[3];
+                for (int j = 0; j < 3; ++j) {
+                    U32 pj = position (tris[3*t+j]);
+                    p[j] = pos (pj, s);
+                    q[j] = pj == u ? pos (v, s) : p[j];
+                }
+                float n0[3], n1[3];
+                cross (p[0], p[1], p[2], n0);
+                cross (q[0], q[1], q[2], n1);
+                float d = n0[0]*n1[0] + n0[1]*n1[1] + n0[2]*n1[2];
+                if (d <= 0.0f) return ~0u;
+            }
+        }
+        return cv;
+    }
+
+    void collapse (U32 u, U32 v, U32 cv) {
+        for (U32 t : adj[u]) {
+            if (!alive[t]) continue;
+            if (has_position (t, v)) {
+                alive[t] = 0;
+                live--;
+            }
+            else {
+                for (int j = 0; j < 3; ++j) {
+                    if (position (tris[3*t+j]) == u) tris[3*t+j] = cv;
+                }
+                adj[v].push_back (t);
+            }
+        }
+        adj[u].clear ();
+        removed[u] = 1;
+
+        unsigned ns = frames.size();
+        for (unsigned s = 0; s < ns; ++s) quadrics[(size_t) v * ns + s] += quadrics[(size_t) u * ns + s];
+
+        // Drop dead triangles from v's list and requeue the neighbourhood.
+        vector<U32>& av = adj[v];
+        av.erase (remove_if (av.begin(), av.end(), [this] (U32 t) { return !alive[t]; }), av.end());
+        vector<U32> nv;
+        neighbours (v, nv);
+        nv.push_back (v);
+        for (U32 p : nv) {
+            version[p]++;
+            push (p);
+        }
+    }
+
+    // Collapse the cheapest allowed edge. Return false if none is left.
+    bool step () {
+        vector<U32> nu;
+        while (!heap.empty()) {
+            candidate c = heap.top();
+            heap.pop ();
+            U32 u = c.pos;
+            if (removed[u] || c.version != version[u]) continue;
+
+            neighbours (u, nu);
+            vector<pair<double,U32> > options;
+            for (U32 v : nu) options.push_back (make_pair (cost (u, v), v));
+            sort (options.begin(), options.end());
+            for (const auto& o : options) {
+                U32 cv = check (u, o.second, nu);
+                if (cv == ~0u) continue;
+                // A pricier collapse than queued waits for its turn.
+                if (o.first > c.cost && !heap.empty() && o.first > heap.top().cost) {
+                    candidate again = { o.first, u, version[u] };
+                    heap.push (again);
+                    break;
+                }
+                collapse (u, o.second, cv);
+                return true;
+            }
+            // No collapse allowed until the neighbourhood changes.
+        }
+        return false;
+    }
+
+    void emit (vector<U32>& out) const {
+        out.clear ();
+        for (U32 t = 0; t < alive.size(); ++t) {
+            if (alive[t]) out.insert (out.end(), &tris[3*t], &tris[3*t] + 3);
+        }
+    }
+};
+
+} // namespace
+
+void mesh_simplify
+(const simplify_mesh& mesh, const unsigned* targets, unsigned numLevels, vector<U32>* levels) {
+    simplifier s (mesh);
+    s.init ();
+    bool more = true;
+    for (unsigned i = 0; i < numLevels; ++i) {
+        while (more && s.live > targets[i]) more = s.step ();
+        s.emit (levels[i]);
+    }
+}
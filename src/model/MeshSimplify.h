@@ -0,0 +1,38 @@
+#ifndef _MESHSIMPLIFY_H
+#define _MESHSIMPLIFY_H
+
+#include <OGDT/types.h>
+#include <vector>
+
+/// A triangle mesh to simplify, possibly animated by morphing.
+///
+/// Corners are the mesh's distinct combinations of vertex attributes.
+/// Several corners may share a position, as along texture seams; such
+/// positions are never removed so that seams do not open.
+typedef struct
+{
+    const float* positions;     // numFrames arrays of numPositions xyz triples.
+    unsigned numPositions;
+    unsigned numFrames;
+    const U32* cornerPositions; // The position of each corner.
+    unsigned numCorners;
+    const U32* triangles;       // Three corners per triangle.
+    unsigned numTriangles;
+    const U8* locked;           // Positions that must be kept; null for none.
+}
+simplify_mesh;
+
+/// Simplify the mesh by quadric-error half-edge collapses.
+///
+/// Every collapse moves a position onto one of its neighbours, so no new
+/// vertices are made: each level is a list of corners of the original mesh
+/// and stays valid in every frame. Errors are summed over a sample of the
+/// frames so that collapses suit the whole animation.
+///
+/// 'targets' holds decreasing triangle counts, one per level. levels[i]
+/// receives the corners of level i, three per triangle. A level may keep
+/// more triangles than its target if no further collapse is allowed.
+void mesh_simplify
+(const simplify_mesh&, const unsigned* targets, unsigned numLevels, std::vector<U32>* levels);
+
+#endif // _MESHSIMPLIFY_H
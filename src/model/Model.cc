@@ -1,14 +1,25 @@
 #include <OGDT/model.h>
 #include "MorphModel.h"
 #include "MorphModel_render.h"
+#include "MorphModel_gpu.h"
+#include "MorphModel_lod.h"
+#include "StaticModel.h"
 #include "MD2/MD2_load.h"
 #include <OGDT/Exception.h>
-#include <OGDT/gl_utils.h>
+#include <OGDT/TextureCache.h>
+#include <OGDT/ThreadPool.h>
+#include <OGDT/vfs.h>
 #include <assimp/DefaultLogger.hpp>
 #include <assimp/Importer.hpp>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
 #include <assimp/postprocess.h>
-#include <assimp/matrix4x4.h>
 #include <assimp/scene.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
 #include <vector>
 
 using namespace OGDT;
@@ -26,18 +37,84 @@ public:
 
     bool clean;
 
-    Assimp::Importer* importer;
-    const aiScene* scene;
     MorphModel* morph_model;
-    vector<GLuint> textures;
+    MorphModel_gpu* gpu; // Created on first GPU render.
+    StaticModel* static_model; // Batched geometry of assimp scenes.
+    bool hw_morphing;
+    vector<texture_entry*> texture_refs; // Cached textures, one per material; null if none.
+    vector<GLuint> textures; // One per material; 0 if the material has none.
     vector<Animation> animations;
+    float lod_threshold; // Screen diameter in pixels below which level 1 is used.
+    float sphere[4];     // Bounding sphere over every frame: centre and radius.
+    bool has_sphere;
 
     _impl ()
-        : clean (true), importer (nullptr), scene (nullptr)
-        , morph_model (nullptr) {}
+        : clean (true), morph_model (nullptr), gpu (nullptr), static_model (nullptr), hw_morphing (false)
+        , lod_threshold (256.0f), has_sphere (false) {}
+
+    MorphModel_gpu* get_gpu () {
+        if (!gpu) {
+            gpu = new MorphModel_gpu;
+            MorphModel_gpu_create (morph_model, gpu);
+        }
+        return gpu;
+    }
+
+    // Render the morph model blending 'count' frames, on the GPU if possible.
+    void render_frames (const unsigned* frames, const float* weights, unsigned count, unsigned lod) {
+        if (hw_morphing && MorphModel_gpu_morphing_supported ()) {
+            MorphModel_gpu_render (get_gpu(), frames, weights, count, lod);
+        }
+        else if (count == 2 && weights[1] == 0.0f) MorphModel_render_static (morph_model, frames[0], lod);
+        else MorphModel_render_frames (morph_model, frames, weights, count, lod);
+    }
+
+    // Return the bounding sphere of the model over all its frames.
+    const float* get_sphere () {
+        if (!has_sphere) {
+            float aabb[6] = { FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX };
+            if (static_model) StaticModel_aabb (static_model, 0, aabb);
+            else {
+                for (unsigned f = 0; f < morph_model->numFrames; ++f) {
+                    float b[6];
+                    model_compute_aabb (morph_model, f, &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]);
+                    for (int k = 0; k < 6; k += 2) {
+                        aabb[k]   = min (aabb[k], b[k]);
+                        aabb[k+1] = max (aabb[k+1], b[k+1]);
+                    }
+                }
+            }
+            float r2 = 0.0f;
+            for (int k = 0; k < 3; ++k) {
+                float h = aabb[2*k+1] > aabb[2*k] ? 0.5f * (aabb[2*k+1] - aabb[2*k]) : 0.0f;
+                sphere[k] = 0.5f * (aabb[2*k] + aabb[2*k+1]);
+                r2 += h*h;
+            }
+            sphere[3] = sqrt (r2);
+            has_sphere = true;
+        }
+        return sphere;
+    }
+
+    // Drop the GPU copy after the CPU data changes; it is rebuilt on demand.
+    void invalidate () {
+        has_sphere = false;
+        if (gpu) {
+            MorphModel_gpu_free (gpu);
+            delete gpu;
+            gpu = nullptr;
+        }
+    }
 
     ~_impl () {
-        if (importer) delete importer;
+        invalidate ();
+        if (static_model) {
+            StaticModel_free (static_model);
+            delete static_model;
+        }
+        for (texture_entry* tex : texture_refs) {
+            if (tex) TextureCache::global().release (tex);
+        }
         if (clean && morph_model) {
             model_free (morph_model);
             delete morph_model;
@@ -62,41 +139,157 @@ std::string get_dir (const std::string& path) {
     return path.substr (0, i);
 }
 
+unsigned import_flags (ImportPreset preset, unsigned flags) {
+    switch (preset) {
+    case Import_Fast: return aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_SortByPType;
+    case Import_Custom: return flags;
+    default: return aiProcessPreset_TargetRealtime_MaxQuality;
+    }
+}
+
+// A read-only view of a file read through the vfs.
+class vfs_stream : public IOStream
+{
+    FileData file;
+    size_t pos;
+
+public:
+
+    vfs_stream () : pos (0) {}
+
+    bool open (const char* path) {
+        return vfs_read (path, file);
+    }
+
+    size_t Read (void* buffer, size_t size, size_t count) {
+        if (size == 0) return 0;
+        size_t n = std::min (count, (file.size() - pos) / size);
+        memcpy (buffer, file.data() + pos, n * size);
+        pos += n * size;
+        return n;
+    }
+
+    size_t Write (const void*, size_t, size_t) {
+        return 0;
+    }
+
+    // Offsets from the current position or the end may be negative; they
+    // arrive as size_t and are read back as signed.
+    aiReturn Seek (size_t offset, aiOrigin origin) {
+        size_t base = origin == aiOrigin_SET ? 0 : origin == aiOrigin_CUR ? pos : file.size();
+        ptrdiff_t delta = (ptrdiff_t) offset;
+        if (origin != aiOrigin_SET && delta < 0) {
+            if ((size_t) -delta > base) return aiReturn_FAILURE;
+            pos = base - (size_t) -delta;
+            return aiReturn_SUCCESS;
+        }
+        if (offset > file.size() - base) return aiReturn_FAILURE;
+        pos = base + offset;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell () const {
+        return pos;
+    }
+
+    size_t FileSize () const {
+        return file.size();
+    }
+
+    void Flush () {}
+};
+
+// Lets assimp read models, and the files they reference, through the vfs.
+class vfs_io_system : public IOSystem
+{
+public:
+
+    bool Exists (const char* path) const {
+        return vfs_exists (path);
+    }
+
+    char getOsSeparator () const {
+        return '/';
+    }
+
+    IOStream* Open (const char* path, const char* mode) {
+        if (strchr (mode, 'w') || strchr (mode, 'a')) return nullptr;
+        vfs_stream* stream = new vfs_stream;
+        if (!stream->open (path)) {
+            delete stream;
+            return nullptr;
+        }
+        return stream;
+    }
+
+    void Close (IOStream* stream) {
+        delete stream;
+    }
+};
+
+// Load the scene, convert it into a StaticModel and decode its textures.
+// The scene is released when the importer goes out of scope.
 void assimp_load
-(const char* path, Assimp::Importer*& importer
-,const aiScene*& scene, std::vector<GLuint>& textures) {
+(const char* path, unsigned flags, StaticModel* model, std::vector<texture_entry*>& textures) {
     // Load scene.
-    importer = new Assimp::Importer;
-    scene = importer->ReadFile (path, aiProcessPreset_TargetRealtime_MaxQuality);
+    Assimp::Importer importer;
+    importer.SetIOHandler (new vfs_io_system);
+    const aiScene* scene = importer.ReadFile (path, flags);
     if (!scene) {
-        const char* err = importer->GetErrorString();
+        const char* err = importer.GetErrorString();
         DefaultLogger::get()->error (err);
         throw EXCEPTION (err);
     }
 
-    // Load textures.
+    StaticModel_build (scene, model);
+
+    // Decode textures through the cache, in parallel. They are uploaded
+    // later by upload_textures.
     unsigned nmat = scene->mNumMaterials;
-    textures.reserve (nmat);
+    textures.assign (nmat, nullptr);
     std::string dir = get_dir (path);
+    std::vector<std::string> files (nmat);
 
     for (unsigned i = 0; i < nmat; ++i) {
         const aiMaterial* mat = scene->mMaterials[i];
         aiString path;
         if (mat->GetTexture (aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS) {
-            std::string file = dir;
-            file += '/';
-            file += path.C_Str();
-            GLuint tex = load_texture (file.c_str());
-            textures.push_back (tex);
+            files[i] = dir;
+            files[i] += '/';
+            files[i] += path.C_Str();
+        }
+    }
+
+    // Textures decoded before a failure are released along with the model.
+    ThreadPool::global().parallel_for (nmat, [&] (unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; ++i) {
+            if (!files[i].empty()) textures[i] = TextureCache::global().decode (files[i].c_str());
         }
+    });
+}
+
+void upload_textures
+(const std::vector<texture_entry*>& refs, std::vector<GLuint>& textures) {
+    textures.assign (refs.size(), 0);
+    for (size_t i = 0; i < refs.size(); ++i) {
+        if (refs[i]) textures[i] = TextureCache::global().upload (refs[i]);
     }
 }
 
 void load_md2 (const char* path, MorphModel*& model) {
     ostringstream os;
     os << "Failed loading " << path << ": ";
-    model = new MorphModel;
-    Model_error_code result = MD2_load (path, false, false, model);
+    // Zeroed, so that a model the loader gave up on is safe to free.
+    model = new MorphModel ();
+    FileData file;
+    Model_error_code result = vfs_read (path, file)
+        ? MD2_load_mem ((const char*) file.data(), file.size(), false, false, model)
+        : Model_File_Not_Found;
+    if (result != Model_Success) {
+        model_free (model);
+        delete model;
+        model = nullptr;
+    }
     switch (result) {
     case Model_Success:break;
     case Model_Read_Error: os << "read error"; throw EXCEPTION (os);
@@ -107,70 +300,20 @@ void load_md2 (const char* path, MorphModel*& model) {
     }
 }
 
-void render
-(const aiScene* scene, const vector<GLuint>& textures, const aiMesh* mesh) {
-    unsigned tex = mesh->mMaterialIndex;
-    glBindTexture (GL_TEXTURE_2D, textures[tex]);
-
-    for (unsigned f = 0; f < mesh->mNumFaces; ++f) {
-        const aiFace& face = mesh->mFaces[f];
-        GLenum face_mode;
-        switch (face.mNumIndices) {
-        case 1:  face_mode = GL_POINTS; break;
-        case 2:  face_mode = GL_LINES; break;
-        case 3:  face_mode = GL_TRIANGLES; break;
-        case 4:  face_mode = GL_QUADS; break;
-        default: face_mode = GL_POLYGON; break;
-        }
+Model::Model () : impl (new _impl) {}
 
-        glBegin (face_mode);
-        for (unsigned i = 0; i < face.mNumIndices; ++i) {
-            unsigned j = face.mIndices[i];
-            if (mesh->HasVertexColors(0)) glColor4fv ((GLfloat*) &mesh->mColors[0][j]);
-            if (mesh->HasTextureCoords(0)) glTexCoord2fv ((GLfloat*) &mesh->mTextureCoords[0][j]);
-            if (mesh->HasNormals()) glNormal3fv ((GLfloat*) &mesh->mNormals[j].x);
-            glVertex3fv (&mesh->mVertices[j].x);
-        }
-        glEnd ();
+Model::Model (const char* path, ImportPreset preset, unsigned flags) : impl (new _impl) {
+    try {
+        decode (path, preset, flags);
+        upload ();
     }
-}
-
-void render
-(const aiScene* scene, const vector<GLuint>& textures, const aiNode* node) {
-    // Apply the node's transform.
-    aiMatrix4x4 transf = node->mTransformation;
-    transf.Transpose();
-    glPushMatrix ();
-    glMultMatrixf ((float*) &transf);
-
-    // Draw meshes in this node.
-    //glPushMatrix ();
-    //glScalef (t.sx, t.sy, t.sz);
-    for (unsigned i = 0; i < node->mNumMeshes; ++i) {
-        const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        render (scene, textures, mesh);
-    }
-    //glPopMatrix ();
-
-    // Render children.
-    for (unsigned i = 0; i < node->mNumChildren; ++i) {
-        render (scene, textures, node->mChildren[i]);
-    }
-
-    glPopMatrix ();
-}
-
-void render (const aiScene* scene, const vector<GLuint>& textures)
-{
-    const aiNode* root = scene->mRootNode;
-    if (root)
-    {
-        ::render (scene, textures, root);
-        glBindTexture (GL_TEXTURE_2D, 0);
+    catch (...) {
+        delete impl;
+        throw;
     }
 }
 
-Model::Model (const char* path) : impl (new _impl) {
+void Model::decode (const char* path, ImportPreset preset, unsigned flags) {
     std::string ext = get_extension (path);
     if (ext == "md2" ||ext == "MD2") {
         load_md2 (path, impl->morph_model);
@@ -182,94 +325,186 @@ Model::Model (const char* path) : impl (new _impl) {
 
         for (unsigned i = 0; i < n; ++i) {
             animation* anim = &anims[i];
-            Animation a (anim->name, anim->end - anim->start + 1, i);
+            Animation a (anim->name, anim->end - anim->start + 1, i, anim->start);
             impl->animations.push_back (a);
         }
     }
-    else assimp_load (path, impl->importer, impl->scene, impl->textures);
+    else {
+        impl->static_model = new StaticModel;
+        assimp_load (path, import_flags (preset, flags), impl->static_model, impl->texture_refs);
+    }
+}
+
+void Model::upload () {
+    upload_textures (impl->texture_refs, impl->textures);
+    if (impl->static_model) StaticModel_upload (impl->static_model);
 }
 
 Model::~Model () {
-    for (GLuint& tex : impl->textures) {
-        glDeleteTextures (impl->textures.size(), &tex);
-    }
     delete impl;
 }
 
-void Model::render (float t, const Animation* anim) const {
-    if (impl->scene) ::render (impl->scene, impl->textures);
+// Find the two frames to interpolate at time t of the given animation.
+void anim_frames
+(const MorphModel* model, const Animation* anim, float t
+,unsigned& f1, unsigned& f2, float& p) {
+    if (anim) {
+        const animation* a = &model->animations[anim->id];
+        f1 = a->start + (unsigned) t;
+        f2 = f1 == a->end ? a->start : f1 + 1;
+        p = t - (unsigned) t;
+    }
+    else {
+        f1 = f2 = 0;
+        p = 0.0f;
+    }
+}
+
+void Model::render (float t, const Animation* anim, unsigned lod) const {
+    if (impl->static_model) StaticModel_render (impl->static_model, impl->textures, lod);
+    else {
+        unsigned f1, f2;
+        float p;
+        anim_frames (impl->morph_model, anim, t, f1, f2, p);
+        renderFrames (f1, f2, p, lod);
+    }
+}
+
+void Model::renderFrames (unsigned frame1, unsigned frame2, float p, unsigned lod) const {
+    if (impl->static_model) StaticModel_render (impl->static_model, impl->textures, lod);
     else {
-        if (anim) {
-            unsigned i = anim->id;
-            animation* a = &impl->morph_model->animations[i];
-            unsigned f1 = a->start + (unsigned) t;
-            unsigned f2 = f1 == a->end ? a->start : f1 + 1;
-            float p = t - (unsigned) t;
-            MorphModel_render (impl->morph_model, f1, f2, p);
+        unsigned frames[2] = { frame1, frame2 };
+        float weights[2] = { 1.0f - p, p };
+        impl->render_frames (frames, weights, 2, lod);
+    }
+}
+
+void Model::renderInstanced
+(const float* transforms, const FramePair* frames, unsigned count, unsigned lod) const {
+    // Check the context first: building the GPU copy is wasted without 3.3.
+    if (impl->morph_model && GLEW_VERSION_3_3) {
+        if (MorphModel_gpu_instancing_supported (impl->get_gpu())) {
+            MorphModel_gpu_render_instanced (impl->gpu, transforms, frames, count, lod);
+            return;
         }
-        else MorphModel_render_static (impl->morph_model, 0);
+    }
+    // Fall back to one draw per instance.
+    for (unsigned i = 0; i < count; ++i) {
+        glPushMatrix ();
+        glMultMatrixf (transforms + 16*i);
+        if (frames) renderFrames (frames[i].frame1, frames[i].frame2, frames[i].p, lod);
+        else render (0.0f, nullptr, lod);
+        glPopMatrix ();
+    }
+}
+
+void Model::render
+(float t1, const Animation* anim1, float t2, const Animation* anim2, float w, unsigned lod) const {
+    if (impl->static_model) StaticModel_render (impl->static_model, impl->textures, lod);
+    else {
+        unsigned a1, a2, b1, b2;
+        float p, q;
+        anim_frames (impl->morph_model, anim1, t1, a1, a2, p);
+        anim_frames (impl->morph_model, anim2, t2, b1, b2, q);
+        unsigned frames[4] = { a1, a2, b1, b2 };
+        float weights[4] = { (1.0f - w) * (1.0f - p), (1.0f - w) * p, w * (1.0f - q), w * q };
+        impl->render_frames (frames, weights, 4, lod);
     }
 }
 
+void Model::buildLods (unsigned levels) {
+    if (impl->static_model) StaticModel_build_lods (impl->static_model, levels);
+    else {
+        MorphModel_build_lods (impl->morph_model, levels);
+        impl->invalidate ();
+    }
+}
+
+unsigned Model::numLods () const {
+    if (impl->static_model) return impl->static_model->lods.size() + 1;
+    else return impl->morph_model->numLods;
+}
+
+void Model::setLodThreshold (float pixels) {
+    impl->lod_threshold = pixels;
+}
+
+unsigned Model::selectLod () const {
+    unsigned n = numLods ();
+    if (n == 1) return 0;
+
+    GLfloat mv[16], proj[16];
+    GLint viewport[4];
+    glGetFloatv (GL_MODELVIEW_MATRIX, mv);
+    glGetFloatv (GL_PROJECTION_MATRIX, proj);
+    glGetIntegerv (GL_VIEWPORT, viewport);
+
+    // Bounding sphere in eye space. The radius grows with the largest scale
+    // of the modelview matrix.
+    const float* s = impl->get_sphere ();
+    float z = mv[2]*s[0] + mv[6]*s[1] + mv[10]*s[2] + mv[14];
+    float scale = 0.0f;
+    for (int c = 0; c < 3; ++c) {
+        scale = max (scale, mv[4*c]*mv[4*c] + mv[4*c+1]*mv[4*c+1] + mv[4*c+2]*mv[4*c+2]);
+    }
+    float r = s[3] * sqrt (scale);
+
+    // Projected diameter in pixels, with perspective or orthographic projections.
+    float pixels = r * proj[5] * viewport[3];
+    if (proj[15] == 0.0f) {
+        if (-z <= r) return 0; // The viewer is inside the sphere.
+        pixels /= -z;
+    }
+
+    unsigned lod = 0;
+    float threshold = impl->lod_threshold;
+    while (lod + 1 < n && pixels < threshold) {
+        lod++;
+        threshold *= 0.5f;
+    }
+    return lod;
+}
+
+void Model::setHardwareMorphing (bool enable) {
+    impl->hw_morphing = enable;
+}
+
 bool Model::isAnimated () const {
     if (impl->morph_model) return impl->morph_model->numFrames > 1;
     else return false;
 }
 
 const Animation* Model::getAnimation (const char* name) const {
-    for (size_t i = 0; i < impl->animations.size(); ++i) {
-        if (strcmp (impl->animations[i].name, name) == 0) {
-            return &impl->animations[i];
-        }
-    }
-    return nullptr;
+    if (!impl->morph_model) return nullptr;
+    const animation* anim = model_find_animation (impl->morph_model, name);
+    if (anim) return &impl->animations[anim - impl->morph_model->animations];
+    else return nullptr;
 }
 
 void Model::scale (float sx, float sy, float sz) {
     if (impl->morph_model) model_scale (impl->morph_model, sx, sy, sz);
+    impl->invalidate ();
 }
 
 
 void Model::pitch (float angle) {
     if (impl->morph_model) model_pitch (impl->morph_model, angle);
+    impl->invalidate ();
 }
 
 void Model::yaw (float angle) {
     if (impl->morph_model) model_yaw (impl->morph_model, angle);
+    impl->invalidate ();
 }
 
 void Model::roll (float angle) {
     if (impl->morph_model) model_roll (impl->morph_model, angle);
+    impl->invalidate ();
 }
 
 void Model::toGround () {
     if (impl->morph_model) model_to_ground (impl->morph_model);
-}
-
-void computeAABB
-(const aiScene* scene, unsigned frame, float& xmin, float& xmax
-,float& ymin, float& ymax, float& zmin, float& zmax) {
-    bool init = true;
-    for (unsigned i = 0; i < scene->mNumMeshes; ++i) {
-        const aiMesh* mesh = scene->mMeshes[i];
-        for (unsigned v = 0; v < mesh->mNumVertices; ++v) {
-            const aiVector3D& p = mesh->mVertices[v];
-            if (init) {
-                xmin = xmax = p.x;
-                ymin = ymax = p.y;
-                zmin = zmax = p.z;
-                init = false;
-            }
-            else {
-                xmin = min (xmin, p.x);
-                xmax = max (xmax, p.x);
-                ymin = min (ymin, p.y);
-                ymax = max (ymax, p.y);
-                zmin = min (zmin, p.z);
-                zmax = max (zmax, p.z);
-            }
-        }
-    }
+    impl->invalidate ();
 }
 
 void Model::computeAABB
@@ -284,6 +519,32 @@ void Model::computeAABB
 void Model::computeAABB
 (float& xmin, float& xmax, float& ymin, float& ymax
 ,float& zmin, float& zmax, unsigned frame) const {
-    if (impl->scene) ::computeAABB (impl->scene, frame, xmin, xmax, ymin, ymax, zmin, zmax);
+    if (impl->static_model) {
+        float aabb[6] = { 0, 0, 0, 0, 0, 0 };
+        StaticModel_aabb (impl->static_model, 0, aabb);
+        xmin = aabb[0]; xmax = aabb[1];
+        ymin = aabb[2]; ymax = aabb[3];
+        zmin = aabb[4]; zmax = aabb[5];
+    }
     else model_compute_aabb (impl->morph_model, frame, &xmin, &xmax, &ymin, &ymax, &zmin, &zmax);
 }
+
+unsigned Model::numNodes () const {
+    if (impl->static_model) return impl->static_model->nodes.size();
+    else return 0;
+}
+
+unsigned Model::computeNodeAABB
+(unsigned node, float& xmin, float& xmax, float& ymin, float& ymax
+,float& zmin, float& zmax) const {
+    if (node >= numNodes ()) {
+        ostringstream os;
+        os << "Model::computeNodeAABB: node " << node << " out of range; the model has " << numNodes () << " nodes";
+        throw EXCEPTION (os);
+    }
+    const static_node& n = impl->static_model->nodes[node];
+    xmin = n.aabb[0]; xmax = n.aabb[1];
+    ymin = n.aabb[2]; ymax = n.aabb[3];
+    zmin = n.aabb[4]; zmax = n.aabb[5];
+    return n.end;
+}
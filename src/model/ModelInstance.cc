@@ -2,19 +2,51 @@
 
 using namespace OGDT;
 
-struct ModelInstance::_impl
+// The playback state of a single animation.
+struct anim_state
 {
-    const Model& model;
-
     const Animation* anim;
-    bool animation_active;
+    bool active;
     bool loop;
     float t;
+
+    anim_state () : anim (nullptr), active (false), loop (false), t (0.0f) {}
+
+    void set (const Animation* a, bool _loop) {
+        anim = a;
+        active = a != nullptr;
+        loop = _loop;
+        t = 0.0f;
+    }
+
+    void advance (float dt) {
+        if (active) {
+            t += dt;
+            if (loop) {
+                if (t > anim->duration) {
+                    t = t - anim->duration;
+                }
+            }
+            else if (t > anim->duration - 1) {
+                    t = anim->duration - 1;
+                    active = false;
+            }
+        }
+    }
+};
+
+struct ModelInstance::_impl
+{
+    const Model& model;
+
+    anim_state cur;
+    anim_state prev; // The animation fading out.
+    float fade;      // Time into the cross fade.
+    float fade_duration;
     float speed;
 
     _impl (const Model& _model)
-        : model (_model), anim (nullptr), animation_active (false)
-        , loop (false), t (0.0f), speed (1.0f) {}
+        : model (_model), fade (0.0f), fade_duration (0.0f), speed (1.0f) {}
 };
 
 ModelInstance::ModelInstance (const Model& model)
@@ -25,33 +57,47 @@ ModelInstance::~ModelInstance () {
 }
 
 void ModelInstance::update (float dt) {
-    if (impl->animation_active) {
-        dt *= impl->speed;
-        impl->t += dt;
-        if (impl->loop) {
-            if (impl->t > impl->anim->duration) {
-                impl->t = impl->t - impl->anim->duration;
-            }
-        }
-        else if (impl->t > impl->anim->duration - 1) {
-                impl->t = impl->anim->duration - 1;
-                impl->animation_active = false;
-        }
+    if (impl->fade_duration > 0.0f) {
+        impl->fade += dt;
+        if (impl->fade >= impl->fade_duration) impl->fade_duration = 0.0f;
+        else impl->prev.advance (dt * impl->speed);
     }
+    impl->cur.advance (dt * impl->speed);
 }
 
 void ModelInstance::setAnimation (const char* name, bool loop) {
-    impl->anim = impl->model.getAnimation(name);
-    if (impl->anim) {
-        impl->animation_active = true;
-        impl->loop = loop;
-        impl->t = 0.0f;
+    impl->cur.set (impl->model.getAnimation(name), loop);
+    impl->fade_duration = 0.0f;
+}
+
+void ModelInstance::setAnimation (const Animation& anim, bool loop) {
+    impl->cur.set (&anim, loop);
+    impl->fade_duration = 0.0f;
+}
+
+void ModelInstance::crossFade (const char* name, float duration, bool loop) {
+    const Animation* anim = impl->model.getAnimation (name);
+    if (anim) crossFade (*anim, duration, loop);
+    else setAnimation (name, loop);
+}
+
+void ModelInstance::crossFade (const Animation& anim, float duration, bool loop) {
+    if (!impl->cur.anim || duration <= 0.0f) {
+        setAnimation (anim, loop);
+        return;
     }
-    else impl->animation_active = false;
+    impl->prev = impl->cur;
+    impl->cur.set (&anim, loop);
+    impl->fade = 0.0f;
+    impl->fade_duration = duration;
+}
+
+bool ModelInstance::isFading () const {
+    return impl->fade_duration > 0.0f;
 }
 
 const char* ModelInstance::getAnimation () const {
-    if (impl->anim) return impl->anim->name;
+    if (impl->cur.anim) return impl->cur.anim->name;
     else return "";
 }
 
@@ -60,7 +106,7 @@ void ModelInstance::setAnimationSpeed (float speed) {
 }
 
 bool ModelInstance::isAnimationDone () const {
-    return !impl->animation_active;
+    return !impl->cur.active;
 }
 
 bool ModelInstance::isAnimated () const {
@@ -68,8 +114,13 @@ bool ModelInstance::isAnimated () const {
 }
 
 void ModelInstance::render () const {
+    unsigned lod = impl->model.selectLod ();
     if (impl->model.isAnimated()) {
-        impl->model.render (impl->t, impl->anim);
+        if (impl->fade_duration > 0.0f) {
+            float w = impl->fade / impl->fade_duration;
+            impl->model.render (impl->prev.t, impl->prev.anim, impl->cur.t, impl->cur.anim, w, lod);
+        }
+        else impl->model.render (impl->cur.t, impl->cur.anim, lod);
     }
-    else impl->model.render ();
+    else impl->model.render (0.0f, nullptr, lod);
 }
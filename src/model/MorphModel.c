@@ -19,12 +19,15 @@ static void safe_free (void* ptr) {
 }
 
 void model_free (MorphModel* model) {
+    unsigned i;
+    for (i = 1; i < model->numLods; ++i) safe_free (model->lods[i]);
     safe_free (model->vertices);
     safe_free (model->normals);
     safe_free (model->texCoords);
     safe_free (model->triangles);
     safe_free (model->skins);
     safe_free (model->animations);
+    safe_free (model->animationIndex);
 }
 
 void model_scale (MorphModel* model, float sx, float sy, float sz) {
@@ -157,15 +160,39 @@ void model_compute_aabb_se
 void model_compute_anim_aabb
 (MorphModel* model, const char* anim_name, float* xmin, float* xmax
 ,float* ymin, float* ymax, float* zmin, float* zmax) {
+    animation* a = model_find_animation (model, anim_name);
+    if (a) {
+        model_compute_aabb_se
+            (model, a->start, a->end, xmin, xmax, ymin, ymax, zmin, zmax);
+    }
+}
+
+// FNV-1a over an animation name. MD2 names are at most 16 characters.
+static unsigned hash_name (const char* name) {
+    unsigned h = 2166136261u;
     unsigned i;
-    unsigned n = model->numAnimations;
-    animation* a = model->animations;
-    for (i = 0; i < n; ++i, ++a) {
-        if (strcmp (a->name, anim_name) == 0) {
-            model_compute_aabb_se
-                (model, a->start, a->end, xmin, xmax, ymin, ymax, zmin, zmax);
-            break;
-        }
+    for (i = 0; i < 16 && name[i]; ++i) {
+        h ^= (unsigned char) name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void model_index_animations (MorphModel* model) {
+    unsigned i;
+    unsigned size = 4;
+    safe_free (model->animationIndex);
+    model->animationIndex = 0;
+    model->animationIndexSize = 0;
+    // Keep the load factor at or below one half.
+    while (size < 2 * model->numAnimations) size *= 2;
+    model->animationIndex = (unsigned*) calloc (size, sizeof(unsigned));
+    if (!model->animationIndex) return;
+    model->animationIndexSize = size;
+    for (i = 0; i < model->numAnimations; ++i) {
+        unsigned slot = hash_name (model->animations[i].name) & (size - 1);
+        while (model->animationIndex[slot]) slot = (slot + 1) & (size - 1);
+        model->animationIndex[slot] = i + 1;
     }
 }
 
@@ -173,6 +200,18 @@ animation* model_find_animation (MorphModel* model, const char* name) {
     unsigned i;
     unsigned n = model->numAnimations;
     animation* anim = model->animations;
+    if (model->animationIndex) {
+        unsigned mask = model->animationIndexSize - 1;
+        unsigned slot = hash_name (name) & mask;
+        while ((i = model->animationIndex[slot]) != 0) {
+            anim = &model->animations[i-1];
+            // Names that fill all 16 characters are not null-terminated.
+            if (strncmp (anim->name, name, 16) == 0
+                && (anim->name[15] == 0 || name[16] == 0)) return anim;
+            slot = (slot + 1) & mask;
+        }
+        return 0;
+    }
     for (i = 0; i < n; ++i, ++anim) {
         if (strcmp (anim->name, name) == 0) return anim;
     }
@@ -41,6 +41,10 @@ typedef struct
 animation;
 
 
+/// Maximum number of levels of detail, the full model included.
+#define MORPH_MAX_LODS 4
+
+
 typedef struct
 {
     vec3*       vertices;   // One array per frame.
@@ -49,6 +53,8 @@ typedef struct
     triangle*   triangles;  // One array for all frames.
     skin*       skins;      // Holds the model's texture files.
     animation*  animations; // Holds the model's animations.
+    unsigned*   animationIndex; // Hash table of animation indices + 1, keyed by name; 0 marks an empty slot.
+    triangle*   lods[MORPH_MAX_LODS]; // Triangles per level of detail; lods[0] is 'triangles'.
     
     unsigned int numFrames;
     unsigned int numVertices;   // Number of vertices per frame.
@@ -56,6 +62,9 @@ typedef struct
     unsigned int numTexCoords;  // Number of texture coordinates in one frame.
     unsigned int numSkins;
     unsigned int numAnimations;
+    unsigned int animationIndexSize; // Number of slots in animationIndex; a power of two.
+    unsigned int lodTriangles[MORPH_MAX_LODS]; // Number of triangles per level of detail.
+    unsigned int numLods;       // Number of levels of detail, the full model included.
 }
 MorphModel;
 
@@ -109,6 +118,10 @@ void model_compute_anim_aabb
 (MorphModel*, const char* animation, float* xmin, float* xmax
 ,float* ymin, float* ymax, float* zmin, float* zmax);
 
+/// Build the hash table used by model_find_animation.
+/// Lookups fall back to a linear scan if the table cannot be allocated.
+void model_index_animations (MorphModel*);
+
 animation* model_find_animation (MorphModel*, const char* name);
 
 #ifdef __cplusplus
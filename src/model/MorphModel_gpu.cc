@@ -0,0 +1,405 @@
+#include "MorphModel_gpu.h"
+#include <OGDT/gl_utils.h>
+#include <OGDT/types.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace OGDT;
+using namespace std;
+
+static const char* instanced_vs =
+    "#version 330 compatibility\n"
+    "uniform samplerBuffer frames;\n"
+    "uniform int num_corners;\n"
+    "in vec2 texcoord;\n"
+    "in mat4 transform;\n"
+    "in vec3 frame;\n" // frame1, frame2, p
+    "out vec2 uv;\n"
+    "out vec3 normal;\n"
+    "out vec4 color;\n"
+    "void main () {\n"
+    "    int i1 = 2 * (int(frame.x) * num_corners + gl_VertexID);\n"
+    "    int i2 = 2 * (int(frame.y) * num_corners + gl_VertexID);\n"
+    "    vec4 pos = mix (texelFetch (frames, i1), texelFetch (frames, i2), frame.z);\n"
+    "    vec3 n = mix (texelFetch (frames, i1+1).xyz, texelFetch (frames, i2+1).xyz, frame.z);\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * transform * pos;\n"
+    "    normal = gl_NormalMatrix * mat3 (transform) * n;\n"
+    "    uv = texcoord;\n"
+    "    color = gl_Color;\n"
+    "}\n";
+
+// Interpolates two frame streams, or blends four when BLEND is defined.
+static const char* morph_vs =
+    "attribute vec2 texcoord;\n"
+    "attribute vec4 pos1;\n"
+    "attribute vec4 normal1;\n"
+    "attribute vec4 pos2;\n"
+    "attribute vec4 normal2;\n"
+    "#ifdef BLEND\n"
+    "attribute vec4 pos3;\n"
+    "attribute vec4 normal3;\n"
+    "attribute vec4 pos4;\n"
+    "attribute vec4 normal4;\n"
+    "uniform vec4 w;\n"
+    "#else\n"
+    "uniform float p;\n"
+    "#endif\n"
+    "varying vec2 uv;\n"
+    "varying vec3 normal;\n"
+    "varying vec4 color;\n"
+    "void main () {\n"
+    "#ifdef BLEND\n"
+    "    vec4 pos = w.x * pos1 + w.y * pos2 + w.z * pos3 + w.w * pos4;\n"
+    "    vec3 n = (w.x * normal1 + w.y * normal2 + w.z * normal3 + w.w * normal4).xyz;\n"
+    "#else\n"
+    "    vec4 pos = mix (pos1, pos2, p);\n"
+    "    vec3 n = mix (normal1.xyz, normal2.xyz, p);\n"
+    "#endif\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * pos;\n"
+    "    normal = gl_NormalMatrix * n;\n"
+    "    uv = texcoord;\n"
+    "    color = gl_Color;\n"
+    "}\n";
+
+// Approximates the fixed-function state the immediate mode path relies on:
+// the current colour, texture unit 0 and light 0.
+static const char* morph_fs =
+    "#version 120\n"
+    "uniform sampler2D tex;\n"
+    "uniform bool textured;\n"
+    "uniform bool lit;\n"
+    "varying vec2 uv;\n"
+    "varying vec3 normal;\n"
+    "varying vec4 color;\n"
+    "void main () {\n"
+    "    vec4 c = color;\n"
+    "    if (lit) {\n"
+    "        vec3 l = normalize (gl_LightSource[0].position.xyz);\n"
+    "        float d = max (dot (normalize (normal), l), 0.0);\n"
+    "        c.rgb *= gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb\n"
+    "               + d * gl_LightSource[0].diffuse.rgb;\n"
+    "    }\n"
+    "    if (textured) c *= texture2D (tex, uv);\n"
+    "    gl_FragColor = c;\n"
+    "}\n";
+
+struct instanced_program
+{
+    GLuint prog;
+    GLint frames;
+    GLint num_corners;
+    GLint tex;
+    GLint textured;
+    GLint lit;
+    GLint texcoord;
+    GLint transform;
+    GLint frame;
+};
+
+struct morph_program
+{
+    GLuint prog;
+    GLint weights; // p, or w when blending.
+    GLint tex;
+    GLint textured;
+    GLint lit;
+    GLint texcoord;
+    GLint pos[4];
+    GLint normal[4];
+};
+
+// Per-instance vertex attributes, as streamed to the GPU.
+struct instance_attribs
+{
+    float transform[16];
+    float frame[3];
+};
+
+struct MorphModel_gpu_programs
+{
+    instanced_program instanced;
+    morph_program morph[2]; // Interpolating and blending.
+    GLuint instance_buffer;
+    vector<instance_attribs> staging; // Instance attributes before upload.
+};
+
+// Each frame stores a position and a normal per corner, both as vec4.
+static const unsigned corner_size = 8 * sizeof(float);
+
+static GLuint build_program (const char* vs_code, const char* fs_code) {
+    GLuint vs = create_shader (vs_code, GL_VERTEX_SHADER);
+    GLuint fs = create_shader (fs_code, GL_FRAGMENT_SHADER);
+    GLuint prog = create_program (vs, fs);
+    glDeleteShader (vs);
+    glDeleteShader (fs);
+    return prog;
+}
+
+static MorphModel_gpu_programs& get_programs (MorphModel_gpu* gpu) {
+    if (!gpu->programs) gpu->programs = new MorphModel_gpu_programs ();
+    return *gpu->programs;
+}
+
+static const instanced_program& get_program (MorphModel_gpu* gpu) {
+    MorphModel_gpu_programs& programs = get_programs (gpu);
+    instanced_program& program = programs.instanced;
+    if (!program.prog) {
+        GLuint prog = build_program (instanced_vs, morph_fs);
+        program.frames      = get_uniform (prog, "frames");
+        program.num_corners = get_uniform (prog, "num_corners");
+        program.tex         = get_uniform (prog, "tex");
+        program.textured    = get_uniform (prog, "textured");
+        program.lit         = get_uniform (prog, "lit");
+        program.texcoord    = get_attribute (prog, "texcoord");
+        program.transform   = get_attribute (prog, "transform");
+        program.frame       = get_attribute (prog, "frame");
+        program.prog = prog;
+        glGenBuffers (1, &programs.instance_buffer);
+    }
+    return program;
+}
+
+static const morph_program& get_morph_program (MorphModel_gpu* gpu, bool blend) {
+    morph_program& m = get_programs (gpu).morph[blend];
+    if (!m.prog) {
+        string vs = blend ? "#version 120\n#define BLEND\n" : "#version 120\n";
+        vs += morph_vs;
+        GLuint prog = build_program (vs.c_str(), morph_fs);
+        unsigned n = blend ? 4 : 2;
+        char name[16];
+        m.weights  = get_uniform (prog, blend ? "w" : "p");
+        m.tex      = get_uniform (prog, "tex");
+        m.textured = get_uniform (prog, "textured");
+        m.lit      = get_uniform (prog, "lit");
+        m.texcoord = get_attribute (prog, "texcoord");
+        for (unsigned i = 0; i < n; ++i) {
+            snprintf (name, sizeof(name), "pos%u", i+1);
+            m.pos[i] = get_attribute (prog, name);
+            snprintf (name, sizeof(name), "normal%u", i+1);
+            m.normal[i] = get_attribute (prog, name);
+        }
+        m.prog = prog;
+    }
+    return m;
+}
+
+void MorphModel_gpu_create (const MorphModel* model, MorphModel_gpu* gpu) {
+    unsigned nt = model->numTriangles;
+    unsigned nv = model->numVertices;
+
+    // Merge corners sharing both a vertex and a texture coordinate. Coarser
+    // levels of detail only use corners of the full model.
+    vector<U32> keys (3 * nt);
+    for (unsigned i = 0; i < nt; ++i) {
+        for (unsigned j = 0; j < 3; ++j) {
+            const triangle& t = model->triangles[i];
+            keys[3*i + j] = ((U32) t.vertexIndices[j] << 16) | t.textureIndices[j];
+        }
+    }
+    vector<U32> corners (keys);
+    sort (corners.begin(), corners.end());
+    corners.erase (unique (corners.begin(), corners.end()), corners.end());
+    unsigned nc = corners.size();
+
+    vector<U32> indices;
+    for (unsigned l = 0; l < model->numLods; ++l) {
+        gpu->lodFirst[l] = indices.size();
+        gpu->lodCount[l] = 3 * model->lodTriangles[l];
+        const triangle* t = model->lods[l];
+        for (unsigned i = 0; i < model->lodTriangles[l]; ++i) {
+            for (unsigned j = 0; j < 3; ++j) {
+                U32 key = ((U32) t[i].vertexIndices[j] << 16) | t[i].textureIndices[j];
+                indices.push_back (lower_bound (corners.begin(), corners.end(), key) - corners.begin());
+            }
+        }
+    }
+    gpu->numLods = model->numLods;
+
+    vector<texCoord> texCoords (nc);
+    for (unsigned c = 0; c < nc; ++c) texCoords[c] = model->texCoords[corners[c] & 0xFFFF];
+
+    vector<float> frames (8 * nc * model->numFrames);
+    float* out = frames.empty() ? nullptr : &frames[0];
+    for (unsigned f = 0; f < model->numFrames; ++f) {
+        const vec3* v = model->vertices + f * nv;
+        const vec3* n = model->normals + f * nv;
+        for (unsigned c = 0; c < nc; ++c, out += 8) {
+            unsigned i = corners[c] >> 16;
+            out[0] = v[i].x; out[1] = v[i].y; out[2] = v[i].z; out[3] = 1.0f;
+            out[4] = n[i].x; out[5] = n[i].y; out[6] = n[i].z; out[7] = 0.0f;
+        }
+    }
+
+    GLuint buffers[3];
+    glGenBuffers (3, buffers);
+    gpu->frames    = buffers[0];
+    gpu->texCoords = buffers[1];
+    gpu->indices   = buffers[2];
+
+    glBindBuffer (GL_ARRAY_BUFFER, gpu->frames);
+    glBufferData (GL_ARRAY_BUFFER, frames.size() * sizeof(float), frames.empty() ? nullptr : &frames[0], GL_STATIC_DRAW);
+    glBindBuffer (GL_ARRAY_BUFFER, gpu->texCoords);
+    glBufferData (GL_ARRAY_BUFFER, nc * sizeof(texCoord), texCoords.empty() ? nullptr : &texCoords[0], GL_STATIC_DRAW);
+    glBindBuffer (GL_ARRAY_BUFFER, 0);
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, gpu->indices);
+    glBufferData (GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(U32), indices.empty() ? nullptr : &indices[0], GL_STATIC_DRAW);
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    gpu->framesTex = 0;
+    if (GLEW_VERSION_3_1) {
+        glGenTextures (1, &gpu->framesTex);
+        glBindTexture (GL_TEXTURE_BUFFER, gpu->framesTex);
+        glTexBuffer (GL_TEXTURE_BUFFER, GL_RGBA32F, gpu->frames);
+        glBindTexture (GL_TEXTURE_BUFFER, 0);
+    }
+
+    gpu->numFrames  = model->numFrames;
+    gpu->numCorners = nc;
+    gpu->programs   = nullptr;
+
+    gpu->instancing = false;
+    if (GLEW_VERSION_3_3 && gpu->framesTex) {
+        GLint max_texels;
+        glGetIntegerv (GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+        gpu->instancing = (GLint64) 2 * nc * model->numFrames <= max_texels;
+    }
+}
+
+void MorphModel_gpu_free (MorphModel_gpu* gpu) {
+    GLuint buffers[3] = { gpu->frames, gpu->texCoords, gpu->indices };
+    glDeleteBuffers (3, buffers);
+    if (gpu->framesTex) glDeleteTextures (1, &gpu->framesTex);
+    if (gpu->programs) {
+        MorphModel_gpu_programs* p = gpu->programs;
+        GLuint progs[3] = { p->instanced.prog, p->morph[0].prog, p->morph[1].prog };
+        for (GLuint prog : progs) if (prog) glDeleteProgram (prog);
+        if (p->instance_buffer) glDeleteBuffers (1, &p->instance_buffer);
+        delete p;
+    }
+    memset (gpu, 0, sizeof(MorphModel_gpu));
+}
+
+bool MorphModel_gpu_instancing_supported (const MorphModel_gpu* gpu) {
+    return gpu->instancing;
+}
+
+void MorphModel_gpu_render_instanced
+(MorphModel_gpu* gpu, const float* transforms, const FramePair* frames, unsigned count, unsigned lod) {
+    if (count == 0) return;
+    const instanced_program& p = get_program (gpu);
+    vector<instance_attribs>& staging = gpu->programs->staging;
+
+    staging.resize (count);
+    for (unsigned i = 0; i < count; ++i) {
+        instance_attribs& a = staging[i];
+        memcpy (a.transform, transforms + 16*i, sizeof(a.transform));
+        a.frame[0] = frames ? (float) frames[i].frame1 : 0.0f;
+        a.frame[1] = frames ? (float) frames[i].frame2 : 0.0f;
+        a.frame[2] = frames ? frames[i].p : 0.0f;
+    }
+
+    GLboolean textured = glIsEnabled (GL_TEXTURE_2D);
+    GLboolean lit = glIsEnabled (GL_LIGHTING);
+
+    GLint previous;
+    glGetIntegerv (GL_CURRENT_PROGRAM, &previous);
+    glUseProgram (p.prog);
+    glUniform1i (p.frames, 1);
+    glUniform1i (p.tex, 0);
+    glUniform1i (p.num_corners, gpu->numCorners);
+    glUniform1i (p.textured, textured);
+    glUniform1i (p.lit, lit);
+
+    glActiveTexture (GL_TEXTURE1);
+    glBindTexture (GL_TEXTURE_BUFFER, gpu->framesTex);
+    glActiveTexture (GL_TEXTURE0);
+
+    glBindBuffer (GL_ARRAY_BUFFER, gpu->texCoords);
+    glEnableVertexAttribArray (p.texcoord);
+    glVertexAttribPointer (p.texcoord, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+    // Orphan the previous contents so the driver need not wait on them.
+    glBindBuffer (GL_ARRAY_BUFFER, gpu->programs->instance_buffer);
+    glBufferData (GL_ARRAY_BUFFER, count * sizeof(instance_attribs), nullptr, GL_STREAM_DRAW);
+    glBufferSubData (GL_ARRAY_BUFFER, 0, count * sizeof(instance_attribs), &staging[0]);
+    GLsizei stride = sizeof(instance_attribs);
+    for (GLint col = 0; col < 4; ++col) {
+        glEnableVertexAttribArray (p.transform + col);
+        glVertexAttribPointer (p.transform + col, 4, GL_FLOAT, GL_FALSE, stride, (void*) (col * 4 * sizeof(float)));
+        glVertexAttribDivisor (p.transform + col, 1);
+    }
+    glEnableVertexAttribArray (p.frame);
+    glVertexAttribPointer (p.frame, 3, GL_FLOAT, GL_FALSE, stride, (void*) offsetof (instance_attribs, frame));
+    glVertexAttribDivisor (p.frame, 1);
+
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, gpu->indices);
+    lod = min (lod, gpu->numLods - 1);
+    glDrawElementsInstanced (GL_TRIANGLES, gpu->lodCount[lod], GL_UNSIGNED_INT,
+                             (void*) (gpu->lodFirst[lod] * sizeof(U32)), count);
+
+    // Leave the attribute state as the fixed-function paths expect it.
+    for (GLint col = 0; col < 4; ++col) {
+        glVertexAttribDivisor (p.transform + col, 0);
+        glDisableVertexAttribArray (p.transform + col);
+    }
+    glVertexAttribDivisor (p.frame, 0);
+    glDisableVertexAttribArray (p.frame);
+    glDisableVertexAttribArray (p.texcoord);
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer (GL_ARRAY_BUFFER, 0);
+    glActiveTexture (GL_TEXTURE1);
+    glBindTexture (GL_TEXTURE_BUFFER, 0);
+    glActiveTexture (GL_TEXTURE0);
+    glUseProgram (previous);
+}
+
+bool MorphModel_gpu_morphing_supported () {
+    return GLEW_VERSION_2_0;
+}
+
+void MorphModel_gpu_render
+(MorphModel_gpu* gpu, const unsigned* frames, const float* weights, unsigned count, unsigned lod) {
+    bool blend = count > 2;
+    const morph_program& m = get_morph_program (gpu, blend);
+
+    GLint previous;
+    glGetIntegerv (GL_CURRENT_PROGRAM, &previous);
+    glUseProgram (m.prog);
+    if (blend) glUniform4fv (m.weights, 1, weights);
+    else glUniform1f (m.weights, weights[1]);
+    glUniform1i (m.tex, 0);
+    glUniform1i (m.textured, glIsEnabled (GL_TEXTURE_2D));
+    glUniform1i (m.lit, glIsEnabled (GL_LIGHTING));
+
+    glBindBuffer (GL_ARRAY_BUFFER, gpu->texCoords);
+    glEnableVertexAttribArray (m.texcoord);
+    glVertexAttribPointer (m.texcoord, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+    // Every frame is already on the GPU; selecting frames only moves the
+    // attribute pointers, so the CPU cost does not depend on the vertex count.
+    glBindBuffer (GL_ARRAY_BUFFER, gpu->frames);
+    for (unsigned i = 0; i < count; ++i) {
+        size_t offset = (size_t) frames[i] * gpu->numCorners * corner_size;
+        glEnableVertexAttribArray (m.pos[i]);
+        glEnableVertexAttribArray (m.normal[i]);
+        glVertexAttribPointer (m.pos[i], 4, GL_FLOAT, GL_FALSE, corner_size, (void*) offset);
+        glVertexAttribPointer (m.normal[i], 4, GL_FLOAT, GL_FALSE, corner_size, (void*) (offset + 4 * sizeof(float)));
+    }
+
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, gpu->indices);
+    lod = min (lod, gpu->numLods - 1);
+    glDrawElements (GL_TRIANGLES, gpu->lodCount[lod], GL_UNSIGNED_INT, (void*) (gpu->lodFirst[lod] * sizeof(U32)));
+
+    for (unsigned i = 0; i < count; ++i) {
+        glDisableVertexAttribArray (m.pos[i]);
+        glDisableVertexAttribArray (m.normal[i]);
+    }
+    glDisableVertexAttribArray (m.texcoord);
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer (GL_ARRAY_BUFFER, 0);
+    glUseProgram (previous);
+}
@@ -0,0 +1,63 @@
+#ifndef _MORPHMODEL_GPU_H
+#define _MORPHMODEL_GPU_H
+
+#include "MorphModel.h"
+#include <OGDT/gl.h>
+#include <OGDT/model.h>
+
+struct MorphModel_gpu_programs;
+
+/// A MorphModel uploaded to OpenGL buffers.
+///
+/// Triangle corners sharing both a vertex and a texture coordinate are merged
+/// into one corner, and every frame is stored per corner. The same element
+/// index then addresses a corner's texture coordinate and its position and
+/// normal in any frame.
+///
+/// The shaders, the instance buffer and its staging copy are owned by the
+/// model too, so nothing outlives the context the model was uploaded to and
+/// models rendered on different threads share no state.
+typedef struct
+{
+    GLuint frames;     // numFrames * numCorners * {vec4 position, vec4 normal}.
+    GLuint texCoords;  // numCorners * vec2.
+    GLuint indices;    // U32, three per triangle, every level of detail one after the other.
+    GLuint framesTex;  // Buffer texture over 'frames'.
+    unsigned numFrames;
+    unsigned numCorners;
+    unsigned numLods;
+    unsigned lodFirst[MORPH_MAX_LODS]; // First index of each level of detail.
+    unsigned lodCount[MORPH_MAX_LODS]; // Number of indices of each level of detail.
+    bool instancing;                   // Whether MorphModel_gpu_render_instanced can run.
+    MorphModel_gpu_programs* programs; // Built on first render.
+}
+MorphModel_gpu;
+
+/// Upload the given model. Must be called on the GL thread.
+void MorphModel_gpu_create (const MorphModel*, MorphModel_gpu*);
+
+/// Delete the model's GL objects, shaders included. The 'gpu' pointer itself
+/// is not freed. Must be called on the GL thread, with the model's context current.
+void MorphModel_gpu_free (MorphModel_gpu*);
+
+/// Return true if the context can run MorphModel_gpu_render_instanced.
+/// Decided once, when the model is uploaded.
+bool MorphModel_gpu_instancing_supported (const MorphModel_gpu*);
+
+/// Render 'count' instances of the model with a single instanced draw call.
+/// 'transforms' holds a column-major 4x4 matrix per instance, applied on top of
+/// the current modelview matrix. 'frames' holds the frames to interpolate per
+/// instance, or null to render every instance at frame 0. 'lod' selects the
+/// level of detail and is clamped to the model's levels.
+void MorphModel_gpu_render_instanced
+(MorphModel_gpu*, const float* transforms, const OGDT::FramePair* frames, unsigned count, unsigned lod);
+
+/// Return true if the context can run MorphModel_gpu_render.
+bool MorphModel_gpu_morphing_supported ();
+
+/// Render the model blending 'count' (2 or 4) frames with the given weights.
+/// Frames are interpolated in a vertex shader. 'lod' is as above.
+void MorphModel_gpu_render
+(MorphModel_gpu*, const unsigned* frames, const float* weights, unsigned count, unsigned lod);
+
+#endif // _MORPHMODEL_GPU_H
@@ -0,0 +1,74 @@
+#include "MorphModel_lod.h"
+#include "MeshSimplify.h"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+void MorphModel_build_lods (MorphModel* model, unsigned levels) {
+    for (unsigned i = 1; i < model->numLods; ++i) {
+        free (model->lods[i]);
+        model->lods[i] = nullptr;
+        model->lodTriangles[i] = 0;
+    }
+    model->numLods = 1;
+    levels = min (levels, (unsigned) MORPH_MAX_LODS - 1);
+    unsigned nt = model->numTriangles;
+    if (levels == 0 || nt == 0) return;
+
+    // Corners are the distinct (vertex, texture coordinate) pairs, so that
+    // positions on texture seams are kept.
+    vector<U32> keys (3 * nt);
+    for (unsigned i = 0; i < nt; ++i) {
+        const triangle& t = model->triangles[i];
+        for (unsigned j = 0; j < 3; ++j) {
+            keys[3*i + j] = ((U32) t.vertexIndices[j] << 16) | t.textureIndices[j];
+        }
+    }
+    vector<U32> corners (keys);
+    sort (corners.begin(), corners.end());
+    corners.erase (unique (corners.begin(), corners.end()), corners.end());
+
+    vector<U32> cornerPositions (corners.size());
+    for (size_t c = 0; c < corners.size(); ++c) cornerPositions[c] = corners[c] >> 16;
+
+    vector<U32> tris (3 * nt);
+    for (unsigned i = 0; i < 3 * nt; ++i) {
+        tris[i] = lower_bound (corners.begin(), corners.end(), keys[i]) - corners.begin();
+    }
+
+    simplify_mesh mesh;
+    mesh.positions       = (const float*) model->vertices;
+    mesh.numPositions    = model->numVertices;
+    mesh.numFrames       = model->numFrames;
+    mesh.cornerPositions = &cornerPositions[0];
+    mesh.numCorners      = corners.size();
+    mesh.triangles       = &tris[0];
+    mesh.numTriangles    = nt;
+    mesh.locked          = nullptr;
+
+    unsigned targets[MORPH_MAX_LODS];
+    vector<U32> out[MORPH_MAX_LODS];
+    for (unsigned i = 0; i < levels; ++i) targets[i] = nt >> (i+1);
+    mesh_simplify (mesh, targets, levels, out);
+
+    unsigned prev = nt;
+    for (unsigned i = 0; i < levels; ++i) {
+        unsigned n = out[i].size() / 3;
+        if (n == 0 || n > prev * 9 / 10) break;
+        triangle* t = (triangle*) malloc (n * sizeof(triangle));
+        if (!t) break;
+        for (unsigned k = 0; k < n; ++k) {
+            for (unsigned j = 0; j < 3; ++j) {
+                U32 key = corners[out[i][3*k + j]];
+                t[k].vertexIndices[j]  = key >> 16;
+                t[k].textureIndices[j] = key & 0xFFFF;
+            }
+        }
+        unsigned l = model->numLods++;
+        model->lods[l] = t;
+        model->lodTriangles[l] = n;
+        prev = n;
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef _MORPHMODEL_LOD_H
+#define _MORPHMODEL_LOD_H
+
+#include "MorphModel.h"
+
+/// Replace the model's levels of detail with up to 'levels' coarser ones,
+/// each with about half the triangles of the previous. Levels that would
+/// barely simplify the previous one are dropped.
+///
+/// Levels share the model's vertices and texture coordinates, so they are
+/// valid in every frame.
+void MorphModel_build_lods (MorphModel*, unsigned levels);
+
+#endif // _MORPHMODEL_LOD_H
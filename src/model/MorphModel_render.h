@@ -13,9 +13,16 @@ extern "C" {
 /// The model is interpolated between frames 'frame1' and 'frame2'.
 void MorphModel_render (const MorphModel* model, unsigned frame1, unsigned frame2, float p);
 
+/// Renders the given MD2 model blending 'count' (2 or 4) frames with the given weights.
+/// All frames are blended in a single pass over the vertices, so blending two
+/// animation states (four frames) costs one pass rather than two.
+/// 'lod' selects the level of detail; it is clamped to the model's levels.
+void MorphModel_render_frames
+(const MorphModel* model, const unsigned* frames, const float* weights, unsigned count, unsigned lod);
+
 /// Renders the given MD2 model.
-/// The model is rendered at frame 'currentFrame'.
-void MorphModel_render_static (const MorphModel* model, unsigned int currentFrame);
+/// The model is rendered at frame 'currentFrame' and level of detail 'lod'.
+void MorphModel_render_static (const MorphModel* model, unsigned int currentFrame, unsigned lod);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,457 @@
+#include "StaticModel.h"
+#include "MeshSimplify.h"
+#include <assimp/scene.h>
+#include <assimp/matrix4x4.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+#include <map>
+
+using namespace std;
+
+namespace {
+
+struct batch_key
+{
+    unsigned material;
+    GLenum mode;
+    unsigned attribs;
+
+    bool operator< (const batch_key& k) const {
+        if (material != k.material) return material < k.material;
+        if (mode != k.mode) return mode < k.mode;
+        return attribs < k.attribs;
+    }
+};
+
+struct bucket
+{
+    vector<static_vertex> vertices;
+    vector<U32> indices;
+};
+
+typedef map<batch_key, bucket> bucket_map;
+
+GLenum face_mode (unsigned num_indices) {
+    switch (num_indices) {
+    case 1:  return GL_POINTS;
+    case 2:  return GL_LINES;
+    default: return GL_TRIANGLES;
+    }
+}
+
+U8 to_u8 (float x) {
+    if (x <= 0.0f) return 0;
+    if (x >= 1.0f) return 255;
+    return (U8) (x * 255.0f + 0.5f);
+}
+
+// Copy the mesh's vertices, transformed to world space, into the bucket.
+// Return the index of the first one.
+U32 add_vertices
+(bucket& b, const aiMesh* mesh, const aiMatrix4x4& transf, const aiMatrix3x3& normal_transf) {
+    U32 base = b.vertices.size();
+    b.vertices.resize (base + mesh->mNumVertices);
+    static_vertex* out = &b.vertices[base];
+
+    bool normals = mesh->HasNormals();
+    bool uvs = mesh->HasTextureCoords(0);
+    bool colors = mesh->HasVertexColors(0);
+
+    for (unsigned i = 0; i < mesh->mNumVertices; ++i) {
+        static_vertex& v = out[i];
+
+        aiVector3D p = transf * mesh->mVertices[i];
+        v.pos[0] = p.x; v.pos[1] = p.y; v.pos[2] = p.z;
+
+        if (normals) {
+            aiVector3D n = normal_transf * mesh->mNormals[i];
+            n.Normalize ();
+            v.normal[0] = n.x; v.normal[1] = n.y; v.normal[2] = n.z;
+        }
+        else v.normal[0] = v.normal[1] = v.normal[2] = 0.0f;
+
+        if (uvs) {
+            v.uv[0] = mesh->mTextureCoords[0][i].x;
+            v.uv[1] = mesh->mTextureCoords[0][i].y;
+        }
+        else v.uv[0] = v.uv[1] = 0.0f;
+
+        if (colors) {
+            const aiColor4D& c = mesh->mColors[0][i];
+            v.color[0] = to_u8 (c.r);
+            v.color[1] = to_u8 (c.g);
+            v.color[2] = to_u8 (c.b);
+            v.color[3] = to_u8 (c.a);
+        }
+        else v.color[0] = v.color[1] = v.color[2] = v.color[3] = 255;
+    }
+    return base;
+}
+
+void add_mesh
+(bucket_map& buckets, const aiMesh* mesh, const aiMatrix4x4& transf, const aiMatrix3x3& normal_transf) {
+    unsigned attribs = 0;
+    if (mesh->HasNormals()) attribs |= Static_Normals;
+    if (mesh->HasTextureCoords(0)) attribs |= Static_TexCoords;
+    if (mesh->HasVertexColors(0)) attribs |= Static_Colors;
+
+    // A mesh may mix primitive types. Its vertices are copied once into
+    // each batch it contributes to.
+    bucket* bs[3] = { nullptr, nullptr, nullptr };
+    U32 base[3] = { 0, 0, 0 };
+
+    for (unsigned f = 0; f < mesh->mNumFaces; ++f) {
+        const aiFace& face = mesh->mFaces[f];
+        if (face.mNumIndices == 0) continue;
+
+        GLenum mode = face_mode (face.mNumIndices);
+        unsigned k = mode == GL_POINTS ? 0 : mode == GL_LINES ? 1 : 2;
+        if (!bs[k]) {
+            batch_key key = { mesh->mMaterialIndex, mode, attribs };
+            bs[k] = &buckets[key];
+            base[k] = add_vertices (*bs[k], mesh, transf, normal_transf);
+        }
+        vector<U32>& indices = bs[k]->indices;
+        const unsigned* idx = face.mIndices;
+
+        // Polygons are split into a triangle fan.
+        if (mode == GL_TRIANGLES) {
+            for (unsigned i = 2; i < face.mNumIndices; ++i) {
+                indices.push_back (base[k] + idx[0]);
+                indices.push_back (base[k] + idx[i-1]);
+                indices.push_back (base[k] + idx[i]);
+            }
+        }
+        else {
+            for (unsigned i = 0; i < face.mNumIndices; ++i) indices.push_back (base[k] + idx[i]);
+        }
+    }
+}
+
+void aabb_clear (float* aabb) {
+    for (int k = 0; k < 3; ++k) {
+        aabb[2*k] = FLT_MAX;
+        aabb[2*k+1] = -FLT_MAX;
+    }
+}
+
+void aabb_union (float* aabb, const float* other) {
+    for (int k = 0; k < 3; ++k) {
+        aabb[2*k] = min (aabb[2*k], other[2*k]);
+        aabb[2*k+1] = max (aabb[2*k+1], other[2*k+1]);
+    }
+}
+
+// Bounds of the box transformed by m (Arvo's method).
+void aabb_transform (const float* aabb, const aiMatrix4x4& m, float* out) {
+    const float rows[3][4] = {
+        { m.a1, m.a2, m.a3, m.a4 },
+        { m.b1, m.b2, m.b3, m.b4 },
+        { m.c1, m.c2, m.c3, m.c4 } };
+    for (int i = 0; i < 3; ++i) {
+        float lo = rows[i][3], hi = rows[i][3];
+        for (int j = 0; j < 3; ++j) {
+            float a = rows[i][j] * aabb[2*j];
+            float b = rows[i][j] * aabb[2*j+1];
+            lo += min (a, b);
+            hi += max (a, b);
+        }
+        out[2*i] = lo;
+        out[2*i+1] = hi;
+    }
+}
+
+struct build_state
+{
+    const aiScene* scene;
+    bucket_map buckets;
+    vector<static_node>& nodes;
+    vector<float> mesh_bounds; // Local bounds, six per mesh.
+
+    build_state (const aiScene* _scene, vector<static_node>& _nodes)
+        : scene (_scene), nodes (_nodes), mesh_bounds (6 * _scene->mNumMeshes) {
+        for (unsigned i = 0; i < scene->mNumMeshes; ++i) {
+            const aiMesh* mesh = scene->mMeshes[i];
+            float* aabb = &mesh_bounds[6*i];
+            aabb_clear (aabb);
+            for (unsigned v = 0; v < mesh->mNumVertices; ++v) {
+                const aiVector3D& p = mesh->mVertices[v];
+                float box[6] = { p.x, p.x, p.y, p.y, p.z, p.z };
+                aabb_union (aabb, box);
+            }
+        }
+    }
+};
+
+void add_node (build_state& state, const aiNode* node, const aiMatrix4x4& parent) {
+    aiMatrix4x4 transf = parent * node->mTransformation;
+    aiMatrix3x3 normal_transf (transf);
+    normal_transf.Inverse().Transpose();
+
+    unsigned index = state.nodes.size();
+    state.nodes.push_back (static_node());
+    float aabb[6];
+    aabb_clear (aabb);
+
+    for (unsigned i = 0; i < node->mNumMeshes; ++i) {
+        unsigned m = node->mMeshes[i];
+        const aiMesh* mesh = state.scene->mMeshes[m];
+        add_mesh (state.buckets, mesh, transf, normal_transf);
+        if (mesh->mNumVertices > 0) {
+            float world[6];
+            aabb_transform (&state.mesh_bounds[6*m], transf, world);
+            aabb_union (aabb, world);
+        }
+    }
+    for (unsigned i = 0; i < node->mNumChildren; ++i) {
+        unsigned child = state.nodes.size();
+        add_node (state, node->mChildren[i], transf);
+        aabb_union (aabb, state.nodes[child].aabb);
+    }
+
+    static_node& n = state.nodes[index];
+    n.end = state.nodes.size();
+    for (int k = 0; k < 6; ++k) n.aabb[k] = aabb[k];
+}
+
+} // namespace
+
+void StaticModel_build (const aiScene* scene, StaticModel* model) {
+    model->nodes.clear ();
+    build_state state (scene, model->nodes);
+    if (scene->mRootNode) add_node (state, scene->mRootNode, aiMatrix4x4());
+    bucket_map& buckets = state.buckets;
+
+    size_t nverts = 0, nindices = 0;
+    for (auto& b : buckets) {
+        nverts += b.second.vertices.size();
+        nindices += b.second.indices.size();
+    }
+    model->vertices.clear ();
+    model->indices.clear ();
+    model->batches.clear ();
+    model->lods.clear ();
+    model->vertices.reserve (nverts);
+    model->indices.reserve (nindices);
+
+    // Concatenate the buckets; they come out sorted by material.
+    for (auto& b : buckets) {
+        if (b.second.indices.empty()) continue;
+        static_batch batch;
+        batch.material = b.first.material;
+        batch.mode = b.first.mode;
+        batch.attribs = b.first.attribs;
+        batch.firstIndex = model->indices.size();
+        batch.numIndices = b.second.indices.size();
+        batch.firstVertex = model->vertices.size();
+        batch.numVertices = b.second.vertices.size();
+
+        U32 base = batch.firstVertex;
+        for (U32 i : b.second.indices) model->indices.push_back (base + i);
+        model->vertices.insert (model->vertices.end(), b.second.vertices.begin(), b.second.vertices.end());
+        model->batches.push_back (batch);
+    }
+}
+
+void StaticModel_upload (StaticModel* model) {
+    GLuint buffers[2];
+    glGenBuffers (2, buffers);
+    model->vbo = buffers[0];
+    model->ibo = buffers[1];
+
+    glBindBuffer (GL_ARRAY_BUFFER, model->vbo);
+    glBufferData (GL_ARRAY_BUFFER, model->vertices.size() * sizeof(static_vertex),
+                  model->vertices.empty() ? nullptr : &model->vertices[0], GL_STATIC_DRAW);
+    glBindBuffer (GL_ARRAY_BUFFER, 0);
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, model->ibo);
+    glBufferData (GL_ELEMENT_ARRAY_BUFFER, model->indices.size() * sizeof(U32),
+                  model->indices.empty() ? nullptr : &model->indices[0], GL_STATIC_DRAW);
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    vector<static_vertex>().swap (model->vertices);
+    vector<U32>().swap (model->indices);
+}
+
+namespace {
+
+// Simplify a triangle batch into 'levels' levels of decreasing size.
+void simplify_batch
+(const StaticModel* model, const static_batch& batch, unsigned levels, vector<U32>* out) {
+    // Weld vertices by position. Positions shared by several vertices lie on
+    // seams between normals, texture coordinates or colours and are kept.
+    const static_vertex* verts = &model->vertices[batch.firstVertex];
+    unsigned nv = batch.numVertices;
+    vector<U32> order (nv);
+    for (U32 i = 0; i < nv; ++i) order[i] = i;
+    auto less_pos = [verts] (U32 a, U32 b) {
+        return lexicographical_compare (verts[a].pos, verts[a].pos + 3, verts[b].pos, verts[b].pos + 3);
+    };
+    sort (order.begin(), order.end(), less_pos);
+
+    vector<U32> cornerPositions (nv);
+    vector<float> positions;
+    for (U32 i = 0; i < nv; ++i) {
+        if (i == 0 || less_pos (order[i-1], order[i])) {
+            positions.insert (positions.end(), verts[order[i]].pos, verts[order[i]].pos + 3);
+        }
+        cornerPositions[order[i]] = positions.size() / 3 - 1;
+    }
+
+    unsigned nt = batch.numIndices / 3;
+    vector<U32> tris (3 * nt);
+    for (unsigned i = 0; i < 3 * nt; ++i) {
+        tris[i] = model->indices[batch.firstIndex + i] - batch.firstVertex;
+    }
+
+    simplify_mesh mesh;
+    mesh.positions       = &positions[0];
+    mesh.numPositions    = positions.size() / 3;
+    mesh.numFrames       = 1;
+    mesh.cornerPositions = &cornerPositions[0];
+    mesh.numCorners      = nv;
+    mesh.triangles       = &tris[0];
+    mesh.numTriangles    = nt;
+    mesh.locked          = nullptr;
+
+    vector<unsigned> targets (levels);
+    for (unsigned i = 0; i < levels; ++i) targets[i] = nt >> (i+1);
+    mesh_simplify (mesh, &targets[0], levels, out);
+}
+
+} // namespace
+
+void StaticModel_build_lods (StaticModel* model, unsigned levels) {
+    // Read the geometry back if it has been uploaded.
+    bool uploaded = model->vbo != 0;
+    if (uploaded) {
+        GLint size;
+        glBindBuffer (GL_ARRAY_BUFFER, model->vbo);
+        glGetBufferParameteriv (GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+        model->vertices.resize (size / sizeof(static_vertex));
+        if (size) glGetBufferSubData (GL_ARRAY_BUFFER, 0, size, &model->vertices[0]);
+        glBindBuffer (GL_ARRAY_BUFFER, 0);
+        glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, model->ibo);
+        glGetBufferParameteriv (GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+        model->indices.resize (size / sizeof(U32));
+        if (size) glGetBufferSubData (GL_ELEMENT_ARRAY_BUFFER, 0, size, &model->indices[0]);
+        glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    // Drop the indices of previous levels; they follow those of level 0.
+    size_t base = 0;
+    for (const static_batch& batch : model->batches) {
+        base = max (base, (size_t) batch.firstIndex + batch.numIndices);
+    }
+    model->indices.resize (base);
+    model->lods.clear ();
+
+    vector<vector<U32> > out (levels);
+    vector<vector<static_batch> > lods (levels, model->batches);
+    for (size_t b = 0; b < model->batches.size(); ++b) {
+        const static_batch& batch = model->batches[b];
+        if (batch.mode != GL_TRIANGLES) continue;
+        simplify_batch (model, batch, levels, &out[0]);
+        for (unsigned l = 0; l < levels; ++l) {
+            static_batch& lod = lods[l][b];
+            lod.firstIndex = model->indices.size();
+            lod.numIndices = out[l].size();
+            for (U32 i : out[l]) model->indices.push_back (batch.firstVertex + i);
+        }
+    }
+
+    // Keep the levels that noticeably simplify the previous one.
+    unsigned prev = 0;
+    for (const static_batch& batch : model->batches) {
+        if (batch.mode == GL_TRIANGLES) prev += batch.numIndices;
+    }
+    for (unsigned l = 0; l < levels; ++l) {
+        unsigned n = 0;
+        for (const static_batch& batch : lods[l]) {
+            if (batch.mode == GL_TRIANGLES) n += batch.numIndices;
+        }
+        if (n == 0 || n > prev * 9 / 10) break;
+        lods[l].erase (remove_if (lods[l].begin(), lods[l].end(),
+                                  [] (const static_batch& b) { return b.numIndices == 0; }),
+                       lods[l].end());
+        model->lods.push_back (lods[l]);
+        prev = n;
+    }
+
+    // Trim the indices of dropped levels.
+    for (const vector<static_batch>& lod : model->lods) {
+        for (const static_batch& batch : lod) base = max (base, (size_t) batch.firstIndex + batch.numIndices);
+    }
+    model->indices.resize (base);
+
+    if (uploaded) {
+        GLuint buffers[2] = { model->vbo, model->ibo };
+        glDeleteBuffers (2, buffers);
+        StaticModel_upload (model);
+    }
+}
+
+#define OFFSET(field) ((const GLvoid*) offsetof (static_vertex, field))
+
+void StaticModel_render (const StaticModel* model, const vector<GLuint>& textures, unsigned lod) {
+    lod = min (lod, (unsigned) model->lods.size());
+    const vector<static_batch>& batches = lod ? model->lods[lod-1] : model->batches;
+    if (batches.empty()) return;
+
+    glPushClientAttrib (GL_CLIENT_VERTEX_ARRAY_BIT);
+    glBindBuffer (GL_ARRAY_BUFFER, model->vbo);
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, model->ibo);
+
+    const GLsizei stride = sizeof (static_vertex);
+    glEnableClientState (GL_VERTEX_ARRAY);
+    glVertexPointer (3, GL_FLOAT, stride, OFFSET(pos));
+    glNormalPointer (GL_FLOAT, stride, OFFSET(normal));
+    glTexCoordPointer (2, GL_FLOAT, stride, OFFSET(uv));
+    glColorPointer (4, GL_UNSIGNED_BYTE, stride, OFFSET(color));
+
+    unsigned attribs = 0;
+    for (const static_batch& batch : batches) {
+        // Toggle only the arrays that change between batches.
+        unsigned diff = attribs ^ batch.attribs;
+        if (diff & Static_Normals) {
+            if (batch.attribs & Static_Normals) glEnableClientState (GL_NORMAL_ARRAY);
+            else glDisableClientState (GL_NORMAL_ARRAY);
+        }
+        if (diff & Static_TexCoords) {
+            if (batch.attribs & Static_TexCoords) glEnableClientState (GL_TEXTURE_COORD_ARRAY);
+            else glDisableClientState (GL_TEXTURE_COORD_ARRAY);
+        }
+        if (diff & Static_Colors) {
+            if (batch.attribs & Static_Colors) glEnableClientState (GL_COLOR_ARRAY);
+            else glDisableClientState (GL_COLOR_ARRAY);
+        }
+        attribs = batch.attribs;
+
+        GLuint tex = batch.material < textures.size() ? textures[batch.material] : 0;
+        glBindTexture (GL_TEXTURE_2D, tex);
+        glDrawRangeElements (batch.mode, batch.firstVertex, batch.firstVertex + batch.numVertices - 1,
+                             batch.numIndices, GL_UNSIGNED_INT,
+                             (const GLvoid*) (batch.firstIndex * sizeof(U32)));
+    }
+
+    glBindTexture (GL_TEXTURE_2D, 0);
+    glBindBuffer (GL_ARRAY_BUFFER, 0);
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+    glPopClientAttrib ();
+}
+
+bool StaticModel_aabb (const StaticModel* model, unsigned node, float* aabb) {
+    if (node >= model->nodes.size()) return false;
+    const float* bounds = model->nodes[node].aabb;
+    if (bounds[0] > bounds[1]) return false;
+    for (int k = 0; k < 6; ++k) aabb[k] = bounds[k];
+    return true;
+}
+
+void StaticModel_free (StaticModel* model) {
+    if (model->vbo) glDeleteBuffers (1, &model->vbo);
+    if (model->ibo) glDeleteBuffers (1, &model->ibo);
+    model->vbo = model->ibo = 0;
+    model->batches.clear ();
+    model->lods.clear ();
+}
@@ -0,0 +1,93 @@
+#ifndef _STATICMODEL_H
+#define _STATICMODEL_H
+
+#include <OGDT/gl.h>
+#include <OGDT/types.h>
+#include <vector>
+
+struct aiScene;
+
+/// An interleaved static vertex.
+typedef struct
+{
+    float pos[3];
+    float normal[3];
+    float uv[2];
+    U8    color[4];
+}
+static_vertex;
+
+/// Attributes present in a batch besides the position.
+enum
+{
+    Static_Normals   = 1,
+    Static_TexCoords = 2,
+    Static_Colors    = 4
+};
+
+/// Geometry sharing a material, primitive type and set of attributes,
+/// drawn with a single call.
+typedef struct
+{
+    unsigned material;
+    GLenum   mode;       // GL_POINTS, GL_LINES or GL_TRIANGLES.
+    unsigned attribs;    // Static_* flags.
+    unsigned firstIndex; // Offset into the index buffer.
+    unsigned numIndices;
+    unsigned firstVertex;
+    unsigned numVertices;
+}
+static_batch;
+
+/// A node of the source scene, kept for its bounds.
+typedef struct
+{
+    unsigned end;  // One past the node's last descendant.
+    float aabb[6]; // xmin, xmax, ymin, ymax, zmin, zmax in world space, of the
+                   // node and its descendants. min > max if they are empty.
+}
+static_node;
+
+/// A static model with its node hierarchy flattened and node transforms
+/// baked into the vertices. Owns everything needed to render the model, so
+/// the source scene can be released once the model is built.
+struct StaticModel
+{
+    std::vector<static_vertex> vertices; // Freed once uploaded.
+    std::vector<U32> indices;            // Freed once uploaded.
+    std::vector<static_batch> batches;
+    std::vector<std::vector<static_batch> > lods; // Coarser levels of detail, from level 1.
+    std::vector<static_node> nodes;      // Depth first; the root is node 0.
+    GLuint vbo;
+    GLuint ibo;
+
+    StaticModel () : vbo (0), ibo (0) {}
+};
+
+/// Flatten the given scene into batches and compute its node bounds.
+/// Does not touch OpenGL and keeps no reference to the scene.
+void StaticModel_build (const aiScene*, StaticModel*);
+
+/// Upload the model's vertices and indices and free the CPU copies.
+/// Must be called on the GL thread.
+void StaticModel_upload (StaticModel*);
+
+/// Build up to 'levels' coarser levels of detail, each with about half the
+/// triangles of the previous. Triangles are simplified within each batch
+/// and only index onto the model's vertices; points and lines are kept.
+/// If the model is already uploaded its buffers are read back and replaced,
+/// so this must then be called on the GL thread.
+void StaticModel_build_lods (StaticModel*, unsigned levels);
+
+/// Render the model. 'textures' holds one texture per material; 0 for none.
+/// 'lod' selects the level of detail; it is clamped to the model's levels.
+void StaticModel_render (const StaticModel*, const std::vector<GLuint>& textures, unsigned lod);
+
+/// Get the world-space bounds of the given node and its descendants.
+/// Return false if the node does not exist or holds no geometry.
+bool StaticModel_aabb (const StaticModel*, unsigned node, float* aabb);
+
+/// Delete the model's GL objects.
+void StaticModel_free (StaticModel*);
+
+#endif // _STATICMODEL_H
@@ -0,0 +1,35 @@
+#ifndef _OGDT_PAK_H
+#define _OGDT_PAK_H
+
+#include <OGDT/types.h>
+#include <string>
+
+// Layout of a pak file. All integers are little-endian.
+//
+// Header, 32 bytes:
+//   char magic[8]    "OGDTPAK1"
+//   U32 version      1
+//   U32 count        Number of files.
+//   U64 index        Offset of the index.
+//   U64 index_size   Size of the index in bytes.
+//
+// File contents follow, each at an offset that is a multiple of 16.
+//
+// The index holds one record per file:
+//   U64 offset       Offset of the stored contents.
+//   U64 stored       Size of the stored contents.
+//   U64 size         Size of the file, uncompressed.
+//   U32 flags        pak_lz4 if the contents are an LZ4 block.
+//   U32 name_length  Followed by the name, without a terminator.
+
+const char pak_magic[8] = { 'O', 'G', 'D', 'T', 'P', 'A', 'K', '1' };
+const U32 pak_version = 1;
+const size_t pak_header_size = 32;
+const size_t pak_alignment = 16;
+const U32 pak_lz4 = 1;
+
+/// Return the given path with slashes for separators and "." and ".."
+/// components resolved. A leading slash is kept.
+std::string normalize_path (const char* path);
+
+#endif // _OGDT_PAK_H
@@ -0,0 +1,10 @@
+#include "parallel.h"
+#include <OGDT/ThreadPool.h>
+
+using namespace OGDT;
+
+void pool_parallel_for (unsigned n, unsigned grain, parallel_range_fn fn, void* data) {
+    ThreadPool::global().parallel_for (n, [fn, data] (unsigned begin, unsigned end) {
+        fn (data, begin, end);
+    }, grain);
+}
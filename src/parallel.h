@@ -0,0 +1,21 @@
+#ifndef _OGDT_PARALLEL_H
+#define _OGDT_PARALLEL_H
+
+// C interface to the library-wide ThreadPool.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A function over the index range [begin, end).
+typedef void (*parallel_range_fn) (void* data, unsigned begin, unsigned end);
+
+/// Run 'fn' over [0, n) on ThreadPool::global() in chunks of at least 'grain' indices.
+/// The caller takes part in the work and returns once every chunk is done.
+void pool_parallel_for (unsigned n, unsigned grain, parallel_range_fn fn, void* data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _OGDT_PARALLEL_H
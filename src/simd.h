@@ -0,0 +1,50 @@
+#ifndef _OGDT_SIMD_H
+#define _OGDT_SIMD_H
+
+// SSE2 is part of the x86-64 baseline. Other targets take the scalar paths.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OGDT_SSE2
+#endif
+
+#ifdef OGDT_SSE2
+
+#include <emmintrin.h>
+
+#if defined(_MSC_VER) && !defined(__cplusplus)
+#define inline __inline
+#endif
+
+/// Load 4 packed xyz triples (12 floats) and transpose them into x, y and z vectors.
+static inline void simd_load_xyz4 (const float* p, __m128* x, __m128* y, __m128* z)
+{
+    __m128 a = _mm_loadu_ps (p);     // x0 y0 z0 x1
+    __m128 b = _mm_loadu_ps (p + 4); // y1 z1 x2 y2
+    __m128 c = _mm_loadu_ps (p + 8); // z2 x3 y3 z3
+    __m128 xa = _mm_shuffle_ps (a, a, _MM_SHUFFLE(3,3,0,0));
+    __m128 xb = _mm_shuffle_ps (b, c, _MM_SHUFFLE(1,1,2,2));
+    __m128 ya = _mm_shuffle_ps (a, b, _MM_SHUFFLE(0,0,1,1));
+    __m128 yb = _mm_shuffle_ps (b, c, _MM_SHUFFLE(2,2,3,3));
+    __m128 za = _mm_shuffle_ps (a, b, _MM_SHUFFLE(1,1,2,2));
+    __m128 zb = _mm_shuffle_ps (c, c, _MM_SHUFFLE(3,3,0,0));
+    *x = _mm_shuffle_ps (xa, xb, _MM_SHUFFLE(2,0,2,0));
+    *y = _mm_shuffle_ps (ya, yb, _MM_SHUFFLE(2,0,2,0));
+    *z = _mm_shuffle_ps (za, zb, _MM_SHUFFLE(2,0,2,0));
+}
+
+/// Transpose x, y and z vectors back into 4 packed xyz triples and store them.
+static inline void simd_store_xyz4 (float* p, __m128 x, __m128 y, __m128 z)
+{
+    __m128 xy0 = _mm_unpacklo_ps (x, y);                      // x0 y0 x1 y1
+    __m128 zx0 = _mm_shuffle_ps (z, x, _MM_SHUFFLE(1,1,0,0)); // z0 z0 x1 x1
+    __m128 yz1 = _mm_shuffle_ps (y, z, _MM_SHUFFLE(1,1,1,1)); // y1 y1 z1 z1
+    __m128 xy2 = _mm_shuffle_ps (x, y, _MM_SHUFFLE(2,2,2,2)); // x2 x2 y2 y2
+    __m128 zx2 = _mm_shuffle_ps (z, x, _MM_SHUFFLE(3,3,2,2)); // z2 z2 x3 x3
+    __m128 yz3 = _mm_shuffle_ps (y, z, _MM_SHUFFLE(3,3,3,3)); // y3 y3 z3 z3
+    _mm_storeu_ps (p,     _mm_shuffle_ps (xy0, zx0, _MM_SHUFFLE(2,0,1,0)));
+    _mm_storeu_ps (p + 4, _mm_shuffle_ps (yz1, xy2, _MM_SHUFFLE(2,0,2,0)));
+    _mm_storeu_ps (p + 8, _mm_shuffle_ps (zx2, yz3, _MM_SHUFFLE(2,0,2,0)));
+}
+
+#endif // OGDT_SSE2
+
+#endif // _OGDT_SIMD_H
@@ -0,0 +1,182 @@
+#include "texture_data.h"
+#include <OGDT/CompressedImage.h>
+#include <OGDT/Image.h>
+#include <OGDT/MipChain.h>
+#include <OGDT/gl_utils.h>
+#include "texture_formats.h"
+#include "upload_ring.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace OGDT;
+using namespace std;
+
+static bool is_power_of_two (int x) {
+    return x > 0 && (x & (x-1)) == 0;
+}
+
+// Without NPOT texture support, images of other sizes are rescaled by
+// create_texture (const Image&), which builds its own mipmaps.
+static bool needs_rescale (const Image& image) {
+    if (GLEW_ARB_texture_non_power_of_two) return false;
+    return !is_power_of_two (image.width()) || !is_power_of_two (image.height());
+}
+
+texture_data::texture_data ()
+    : image (nullptr), mips (nullptr), compressed (nullptr), texture (0), level (0), row (0) {}
+
+texture_data::~texture_data () {
+    clear ();
+}
+
+void texture_data::decode (const char* path) {
+    clear ();
+    texture = 0;
+    level = 0;
+    row = 0;
+    if (CompressedImage::is_container (path)) {
+        compressed = new CompressedImage;
+        CompressedImage::from_file (path, *compressed);
+        if (compressed->canFlip()) compressed->flipVertically ();
+    }
+    else {
+        image = new Image;
+        Image::from_file (path, *image, true);
+        mips = new MipChain (*image);
+    }
+}
+
+GLuint texture_data::upload () const {
+    if (compressed) return create_texture (*compressed);
+    else if (needs_rescale (*image)) return create_texture (*image);
+    else return create_texture (*mips);
+}
+
+// Create the texture and allocate every level, leaving them undefined.
+static GLuint allocate (const MipChain* mips, const CompressedImage* compressed, GLenum compressed_format) {
+    // A NULL pointer is an offset while a pixel buffer is bound.
+    GLint buffer;
+    glGetIntegerv (GL_PIXEL_UNPACK_BUFFER_BINDING, &buffer);
+    glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+    GLuint tex;
+    glGenTextures (1, &tex);
+    glBindTexture (GL_TEXTURE_2D, tex);
+    unsigned n;
+    if (compressed) {
+        n = compressed->numLevels();
+        for (unsigned i = 0; i < n; ++i) {
+            glCompressedTexImage2D (GL_TEXTURE_2D, i, compressed_format, compressed->levelWidth(i),
+                                    compressed->levelHeight(i), 0, compressed->levelSize(i), nullptr);
+        }
+    }
+    else {
+        n = mips->numLevels();
+        for (unsigned i = 0; i < n; ++i) {
+            const Image& l = mips->level(i);
+            glTexImage2D (GL_TEXTURE_2D, i, texture_internal_format (l), l.width(), l.height(), 0,
+                          texture_format (l.numComponents()), texture_type (l.dataType()), nullptr);
+        }
+    }
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, n ? n-1 : 0);
+    set_texture_filtering ();
+    glBindBuffer (GL_PIXEL_UNPACK_BUFFER, buffer);
+    return tex;
+}
+
+bool texture_data::upload_part (upload_ring& ring, size_t& budget, bool first) {
+    bool supported = true;
+    GLenum format = compressed ? compressed_texture_format (compressed->format(), supported) : 0;
+    if (!supported || (image && needs_rescale (*image))) {
+        // Formats decompressed on the CPU or rejected, and images to be
+        // rescaled, go the slow way, from client memory.
+        GLint buffer = 0;
+        if (ring.mapped()) {
+            glGetIntegerv (GL_PIXEL_UNPACK_BUFFER_BINDING, &buffer);
+            glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        try {
+            texture = upload ();
+        }
+        catch (...) {
+            if (buffer) glBindBuffer (GL_PIXEL_UNPACK_BUFFER, buffer);
+            throw;
+        }
+        if (buffer) glBindBuffer (GL_PIXEL_UNPACK_BUFFER, buffer);
+        return true;
+    }
+    if (texture == 0) texture = allocate (mips, compressed, format);
+    else glBindTexture (GL_TEXTURE_2D, texture);
+
+    GLint alignment;
+    glGetIntegerv (GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    unsigned n = compressed ? compressed->numLevels() : mips->numLevels();
+    for (; level < n; ++level, row = 0) {
+        // A level is a run of rows: pixel rows, or rows of 4x4 blocks.
+        int w, h, rows;
+        size_t row_size;
+        const U8* data;
+        GLenum pixel_format = 0, type = 0;
+        if (compressed) {
+            w = compressed->levelWidth (level);
+            h = compressed->levelHeight (level);
+            rows = (h + 3) / 4;
+            row_size = compressed->levelSize (level) / rows;
+            data = compressed->levelData (level);
+        }
+        else {
+            const Image& l = mips->level (level);
+            w = l.width();
+            h = rows = l.height();
+            row_size = (size_t) w * l.numComponents() * l.dataSize();
+            data = l;
+            pixel_format = texture_format (l.numComponents());
+            type = texture_type (l.dataType());
+        }
+        while (row < rows) {
+            int count = min ((size_t) (rows - row), budget / row_size);
+            if (count == 0) {
+                if (!first) break;
+                count = 1;
+            }
+            size_t bytes = count * row_size;
+            const U8* src = data + row * row_size;
+            size_t offset;
+            U8* staged = ring.reserve (bytes, offset);
+            GLint buffer = -1;
+            if (staged) {
+                memcpy (staged, src, bytes);
+                src = (const U8*) offset;
+            }
+            else if (ring.mapped()) {
+                // The segment is full; carry on next frame. Rows larger than
+                // a whole segment are uploaded from client memory.
+                if (bytes <= ring.segmentSize()) break;
+                glGetIntegerv (GL_PIXEL_UNPACK_BUFFER_BINDING, &buffer);
+                glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+            }
+            if (compressed) {
+                glCompressedTexSubImage2D (GL_TEXTURE_2D, level, 0, row * 4, w, min (count * 4, h - row * 4),
+                                           format, bytes, src);
+            }
+            else glTexSubImage2D (GL_TEXTURE_2D, level, 0, row, w, count, pixel_format, type, src);
+            if (buffer >= 0) glBindBuffer (GL_PIXEL_UNPACK_BUFFER, buffer);
+            row += count;
+            budget -= min (budget, bytes);
+            first = false;
+        }
+        if (row < rows) break;
+    }
+    glPixelStorei (GL_UNPACK_ALIGNMENT, alignment);
+    glBindTexture (GL_TEXTURE_2D, 0);
+    return level == n;
+}
+
+void texture_data::clear () {
+    if (compressed) delete compressed;
+    if (mips) delete mips;
+    if (image) delete image;
+    compressed = nullptr;
+    mips = nullptr;
+    image = nullptr;
+}
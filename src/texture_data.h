@@ -0,0 +1,63 @@
+#ifndef _OGDT_TEXTURE_DATA_H
+#define _OGDT_TEXTURE_DATA_H
+
+#include <OGDT/gl.h>
+#include <cstddef>
+
+namespace OGDT
+{
+class Image;
+class MipChain;
+class CompressedImage;
+}
+
+class upload_ring;
+
+/// A texture read and prepared on the CPU, waiting to be uploaded.
+///
+/// Images are flipped vertically for OpenGL and their mipmaps built; the
+/// image is kept as level 0 of the chain.
+/// Compressed images are flipped when their format allows it and keep
+/// their stored mipmaps.
+struct texture_data
+{
+    OGDT::Image* image;
+    OGDT::MipChain* mips;
+    OGDT::CompressedImage* compressed;
+
+    texture_data ();
+    ~texture_data ();
+
+    /// Read the texture at the given path. Does not touch OpenGL.
+    void decode (const char* path);
+
+    /// Create the OpenGL texture. Must be called on the GL thread. Images
+    /// whose sizes are not powers of two are rescaled when the context
+    /// lacks NPOT textures.
+    GLuint upload () const;
+
+    /// Upload part of the texture, continuing where the last call stopped,
+    /// and return true once every level is uploaded. The texture is created
+    /// on the first call. Must be called on the GL thread. Images to be
+    /// rescaled are uploaded whole, as with upload.
+    ///
+    /// Whole rows, or rows of blocks for compressed images, are staged
+    /// through the ring, or uploaded from client memory if it is not mapped,
+    /// until the budget is spent; budget is decreased by the bytes uploaded.
+    /// If first is set, one row is uploaded even if it exceeds the budget.
+    bool upload_part (upload_ring& ring, size_t& budget, bool first);
+
+    GLuint texture; // Created by upload_part.
+    unsigned level; // Next level upload_part uploads.
+    int row;        // Next row, or row of blocks, of that level.
+
+    /// Free the CPU copies.
+    void clear ();
+
+private:
+
+    texture_data (const texture_data&);
+    texture_data& operator= (const texture_data&);
+};
+
+#endif // _OGDT_TEXTURE_DATA_H
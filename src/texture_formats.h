@@ -0,0 +1,27 @@
+#ifndef _OGDT_TEXTURE_FORMATS_H
+#define _OGDT_TEXTURE_FORMATS_H
+
+#include <OGDT/CompressedImage.h>
+#include <OGDT/Image.h>
+#include <OGDT/gl.h>
+
+// How images map to OpenGL texture formats, shared by create_texture and
+// the streamed uploads of texture_data.
+
+/// Return the pixel format of an image with the given number of components.
+GLenum texture_format (int components);
+
+/// Return the internal format textures of the given image are created with.
+GLint texture_internal_format (const OGDT::Image& image);
+
+/// Return the pixel type of the given data type.
+GLenum texture_type (OGDT::Image::DataType type);
+
+/// Return the internal format of the given block compression format, and
+/// whether the context can sample it.
+GLenum compressed_texture_format (OGDT::CompressedImage::Format format, bool& supported);
+
+/// Set the filtering of the texture bound to GL_TEXTURE_2D.
+void set_texture_filtering ();
+
+#endif // _OGDT_TEXTURE_FORMATS_H
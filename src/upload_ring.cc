@@ -0,0 +1,59 @@
+#include "upload_ring.h"
+
+upload_ring::upload_ring (size_t size, unsigned n)
+    : segment_size ((size + 15) & ~(size_t) 15), num_segments (n), buffer (0), map (nullptr),
+      fences (new GLsync[n]), current (n - 1), used (0) {
+    for (unsigned i = 0; i < n; ++i) fences[i] = 0;
+    if (!GLEW_ARB_buffer_storage || !GLEW_ARB_sync) return;
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers (1, &buffer);
+    glBindBuffer (GL_PIXEL_UNPACK_BUFFER, buffer);
+    glBufferStorage (GL_PIXEL_UNPACK_BUFFER, segment_size * n, nullptr, flags);
+    map = (U8*) glMapBufferRange (GL_PIXEL_UNPACK_BUFFER, 0, segment_size * n, flags);
+    glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!map) {
+        glDeleteBuffers (1, &buffer);
+        buffer = 0;
+    }
+}
+
+upload_ring::~upload_ring () {
+    for (unsigned i = 0; i < num_segments; ++i) {
+        if (fences[i]) glDeleteSync (fences[i]);
+    }
+    delete[] fences;
+    if (buffer) {
+        glBindBuffer (GL_PIXEL_UNPACK_BUFFER, buffer);
+        glUnmapBuffer (GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers (1, &buffer);
+    }
+}
+
+void upload_ring::begin () {
+    current = (current + 1) % num_segments;
+    used = 0;
+    if (!map) return;
+    GLsync& fence = fences[current];
+    if (fence) {
+        // Flush on the first wait so the fence is sure to be signalled.
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while (glClientWaitSync (fence, flags, 1000000000) == GL_TIMEOUT_EXPIRED) flags = 0;
+        glDeleteSync (fence);
+        fence = 0;
+    }
+    glBindBuffer (GL_PIXEL_UNPACK_BUFFER, buffer);
+}
+
+U8* upload_ring::reserve (size_t n, size_t& offset) {
+    if (!map || used + n > segment_size) return nullptr;
+    offset = current * segment_size + used;
+    used = (used + n + 15) & ~(size_t) 15;
+    return map + offset;
+}
+
+void upload_ring::end () {
+    if (!map) return;
+    if (used) fences[current] = glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+}
@@ -0,0 +1,63 @@
+#ifndef _OGDT_UPLOAD_RING_H
+#define _OGDT_UPLOAD_RING_H
+
+#include <OGDT/gl.h>
+#include <OGDT/types.h>
+#include <cstddef>
+
+/// Staging memory for texture uploads: a pixel buffer object split into
+/// segments that are written in turn, one per frame.
+///
+/// The buffer is created with glBufferStorage and stays mapped, so staging
+/// is a plain memcpy and glTexSubImage2D sources the pixels from the buffer
+/// without blocking. Every frame's uploads are followed by a fence, which is
+/// waited on before that frame's segment is written again, so with three
+/// segments the GPU has two frames to consume the uploads before the CPU
+/// catches up with it.
+///
+/// Without ARB_buffer_storage and ARB_sync, nothing can be reserved and
+/// callers upload from client memory instead.
+///
+/// Must be created, used and destroyed on the GL thread.
+class upload_ring
+{
+public:
+
+    /// Create a ring of num_segments segments of segment_size bytes each.
+    upload_ring (size_t segment_size, unsigned num_segments = 3);
+
+    ~upload_ring ();
+
+    /// Return true if the ring is backed by a mapped buffer.
+    bool mapped () const { return map != nullptr; }
+
+    /// Return the size of one segment.
+    size_t segmentSize () const { return segment_size; }
+
+    /// Move to the next segment, waiting until the GPU is done with it, and
+    /// bind the buffer to GL_PIXEL_UNPACK_BUFFER.
+    void begin ();
+
+    /// Reserve n bytes in the current segment, aligned to 16 bytes. Returns
+    /// the memory to write to and sets offset to the value to pass to GL as
+    /// the pixel pointer, or returns null if the segment is full.
+    U8* reserve (size_t n, size_t& offset);
+
+    /// Fence the uploads staged in the current segment and unbind the buffer.
+    void end ();
+
+private:
+
+    upload_ring (const upload_ring&);
+    upload_ring& operator= (const upload_ring&);
+
+    size_t segment_size;
+    unsigned num_segments;
+    GLuint buffer;
+    U8* map;
+    GLsync* fences;
+    unsigned current;
+    size_t used;
+};
+
+#endif // _OGDT_UPLOAD_RING_H
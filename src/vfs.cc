@@ -0,0 +1,153 @@
+#include <OGDT/vfs.h>
+#include <OGDT/Archive.h>
+#include "mapped_file.h"
+#include "pak.h"
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace OGDT;
+using namespace std;
+
+namespace {
+
+struct mount
+{
+    string archive_path;
+    string prefix; // The normalised mount point followed by a slash, or empty.
+    shared_ptr<const Archive> archive;
+};
+
+// Loose files smaller than this are read rather than mapped; for small
+// files a read costs less than setting up and tearing down a mapping.
+const long small_file_size = 64 << 10;
+
+mutex mounts_mutex;
+vector<mount> mounts; // In mount order; later mounts take precedence.
+
+// Find the archive and entry a path resolves to.
+bool resolve (const char* path, shared_ptr<const Archive>& archive, int& entry) {
+    string p = normalize_path (path);
+    lock_guard<mutex> lock (mounts_mutex);
+    for (size_t i = mounts.size(); i-- > 0; ) {
+        const mount& m = mounts[i];
+        if (p.compare (0, m.prefix.size(), m.prefix) != 0) continue;
+        int e = m.archive->find (p.c_str() + m.prefix.size());
+        if (e >= 0) {
+            archive = m.archive;
+            entry = e;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+struct FileData::_impl
+{
+    const U8* data;
+    size_t size;
+    shared_ptr<const Archive> archive; // Keeps in-place archive data mapped.
+    mapped_file file;
+    vector<U8> buffer;
+
+    _impl () : data (nullptr), size (0) {}
+};
+
+FileData::FileData () : impl (new _impl) {}
+
+FileData::~FileData () {
+    delete impl;
+}
+
+const U8* FileData::data () const {
+    return impl->data;
+}
+
+size_t FileData::size () const {
+    return impl->size;
+}
+
+void FileData::clear () {
+    impl->data = nullptr;
+    impl->size = 0;
+    impl->archive.reset ();
+    impl->file.close ();
+    vector<U8> ().swap (impl->buffer);
+}
+
+void OGDT::vfs_mount (const char* archive, const char* mount_point) {
+    mount m;
+    m.archive_path = archive;
+    m.prefix = normalize_path (mount_point);
+    if (!m.prefix.empty()) m.prefix += '/';
+    m.archive = make_shared<Archive> (archive);
+    lock_guard<mutex> lock (mounts_mutex);
+    mounts.push_back (m);
+}
+
+void OGDT::vfs_unmount (const char* archive) {
+    lock_guard<mutex> lock (mounts_mutex);
+    for (size_t i = mounts.size(); i-- > 0; ) {
+        if (mounts[i].archive_path == archive) mounts.erase (mounts.begin() + i);
+    }
+}
+
+void OGDT::vfs_unmount_all () {
+    lock_guard<mutex> lock (mounts_mutex);
+    mounts.clear ();
+}
+
+bool OGDT::vfs_exists (const char* path) {
+    shared_ptr<const Archive> archive;
+    int entry;
+    if (resolve (path, archive, entry)) return true;
+    FILE* f = fopen (path, "rb");
+    if (f) fclose (f);
+    return f != nullptr;
+}
+
+bool OGDT::vfs_read (const char* path, FileData& file) {
+    file.clear ();
+    FileData::_impl* impl = file.impl;
+    shared_ptr<const Archive> archive;
+    int entry;
+    if (resolve (path, archive, entry)) {
+        impl->size = archive->size (entry);
+        if (archive->compressed (entry)) {
+            impl->buffer.resize (impl->size);
+            if (impl->size) archive->read (entry, &impl->buffer[0]);
+            impl->data = impl->size ? &impl->buffer[0] : nullptr;
+        }
+        else {
+            impl->data = impl->size ? archive->data (entry) : nullptr;
+            impl->archive = archive;
+        }
+        return true;
+    }
+    FILE* f = fopen (path, "rb");
+    if (!f) return false;
+    long n = fseek (f, 0, SEEK_END) == 0 ? ftell (f) : -1;
+    if (n >= 0 && n < small_file_size) {
+        impl->buffer.resize (n);
+        // Reading past the end also fails on directories.
+        bool ok = fseek (f, 0, SEEK_SET) == 0 && (n == 0 || fread (&impl->buffer[0], 1, n, f) == (size_t) n)
+               && fgetc (f) == EOF && !ferror (f);
+        fclose (f);
+        if (!ok) {
+            file.clear ();
+            return false;
+        }
+        impl->data = n ? &impl->buffer[0] : nullptr;
+        impl->size = n;
+        return true;
+    }
+    fclose (f);
+    if (!impl->file.open (path)) return false;
+    impl->data = impl->file.data;
+    impl->size = impl->file.size;
+    return true;
+}
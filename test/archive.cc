@@ -0,0 +1,212 @@
+#define BOOST_TEST_MODULE Archive
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <OGDT/Archive.h>
+#include <OGDT/CompressedImage.h>
+#include <OGDT/Image.h>
+#include <OGDT/vfs.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace OGDT;
+
+void write_file (const char* path, const std::vector<U8>& data)
+{
+    FILE* f = fopen (path, "wb");
+    if (!data.empty()) fwrite (&data[0], 1, data.size(), f);
+    fclose (f);
+}
+
+std::vector<U8> random_bytes (size_t n)
+{
+    std::vector<U8> v (n);
+    for (size_t i = 0; i < n; ++i) v[i] = rand() % 256;
+    return v;
+}
+
+std::vector<U8> repetitive_bytes (size_t n)
+{
+    std::vector<U8> v (n);
+    const char* text = "uniform sampler2D tex; varying vec2 uv; ";
+    for (size_t i = 0; i < n; ++i) v[i] = text[i % strlen (text)] + (i / 4096) % 3;
+    return v;
+}
+
+bool same (const U8* p, size_t n, const std::vector<U8>& v)
+{
+    return n == v.size() && (n == 0 || memcmp (p, &v[0], n) == 0);
+}
+
+BOOST_AUTO_TEST_CASE (archive_roundtrip)
+{
+    srand (1);
+    std::vector<std::vector<U8>> contents;
+    contents.push_back (random_bytes (10000));
+    contents.push_back (repetitive_bytes (100000));
+    contents.push_back (std::vector<U8> ());
+    contents.push_back (repetitive_bytes (7));
+    const char* files[] = { "a.bin", "b.bin", "c.bin", "d.bin" };
+    const char* names[] = { "noise.bin", "shaders\\lit.frag", "./empty", "dir/../tiny" };
+    for (int i = 0; i < 4; ++i) write_file (files[i], contents[i]);
+
+    for (int compress = 0; compress < 2; ++compress) {
+        write_archive ("test.pak", names, files, 4, compress != 0);
+        Archive pak ("test.pak");
+        BOOST_REQUIRE_EQUAL (pak.numEntries (), 4u);
+        BOOST_CHECK_EQUAL (pak.name (1), std::string ("shaders/lit.frag"));
+        BOOST_CHECK_EQUAL (pak.name (2), std::string ("empty"));
+        BOOST_CHECK_EQUAL (pak.find ("tiny"), 3);
+        BOOST_CHECK_EQUAL (pak.find ("missing"), -1);
+        // Only data that shrinks is compressed.
+        BOOST_CHECK (!pak.compressed (0));
+        BOOST_CHECK_EQUAL (pak.compressed (1), compress != 0);
+        BOOST_CHECK (!pak.compressed (3));
+        for (int i = 0; i < 4; ++i) {
+            BOOST_REQUIRE_EQUAL (pak.size (i), contents[i].size());
+            std::vector<U8> out (contents[i].size() + 1);
+            pak.read (i, &out[0]);
+            BOOST_CHECK (same (&out[0], pak.size (i), contents[i]));
+            if (!pak.compressed (i)) {
+                BOOST_CHECK (same (pak.data (i), pak.size (i), contents[i]));
+                BOOST_CHECK_EQUAL ((size_t) pak.data (i) % 16, 0u);
+            }
+            else BOOST_CHECK (pak.data (i) == nullptr);
+        }
+    }
+    for (int i = 0; i < 4; ++i) remove (files[i]);
+    remove ("test.pak");
+}
+
+BOOST_AUTO_TEST_CASE (archive_rejects_bad_files)
+{
+    BOOST_CHECK_THROW (Archive ("no-such.pak"), std::exception);
+    write_file ("bad.pak", random_bytes (100));
+    BOOST_CHECK_THROW (Archive ("bad.pak"), std::exception);
+
+    // A corrupt compressed entry fails to read instead of overrunning: the
+    // first token, right after the 32-byte header, claims a huge literal run.
+    std::vector<U8> data = repetitive_bytes (50000);
+    write_file ("a.bin", data);
+    const char* files[] = { "a.bin" };
+    write_archive ("bad.pak", files, files, 1);
+    FILE* f = fopen ("bad.pak", "r+b");
+    fseek (f, 32, SEEK_SET);
+    fputc (0xFF, f);
+    fputc (0xFF, f);
+    fputc (0xFF, f);
+    fclose (f);
+    Archive pak ("bad.pak");
+    BOOST_REQUIRE (pak.compressed (0));
+    std::vector<U8> out (pak.size (0));
+    BOOST_CHECK_THROW (pak.read (0, &out[0]), std::exception);
+
+    // Truncated archives are rejected when opened.
+    write_archive ("bad.pak", files, files, 1);
+    FILE* in = fopen ("bad.pak", "rb");
+    std::vector<U8> whole (200000);
+    whole.resize (fread (&whole[0], 1, whole.size(), in));
+    fclose (in);
+    whole.resize (whole.size() - 3);
+    write_file ("bad.pak", whole);
+    BOOST_CHECK_THROW (Archive ("bad.pak"), std::exception);
+    remove ("bad.pak");
+    remove ("a.bin");
+}
+
+BOOST_AUTO_TEST_CASE (vfs_mounts)
+{
+    std::vector<U8> one = repetitive_bytes (3000), two = random_bytes (500), disk = random_bytes (64);
+    write_file ("one.bin", one);
+    write_file ("two.bin", two);
+    write_file ("disk.bin", disk);
+    const char* names[] = { "tex/a.bin", "tex/b.bin" };
+    const char* first[] = { "one.bin", "one.bin" };
+    const char* second[] = { "two.bin" };
+    write_archive ("first.pak", names, first, 2);
+    write_archive ("second.pak", names, second, 1);
+
+    vfs_mount ("first.pak", "data");
+    FileData file;
+    BOOST_REQUIRE (vfs_read ("data/tex/a.bin", file));
+    BOOST_CHECK (same (file.data(), file.size(), one));
+    BOOST_REQUIRE (vfs_read ("data\\models\\..\\tex\\.\\b.bin", file));
+    BOOST_CHECK (same (file.data(), file.size(), one));
+    BOOST_CHECK (!vfs_read ("tex/a.bin", file));
+    BOOST_CHECK (vfs_exists ("data/tex/b.bin"));
+    BOOST_CHECK (!vfs_exists ("data/tex/c.bin"));
+
+    // Later mounts take precedence; unmounted files stay readable while held.
+    vfs_mount ("second.pak", "data");
+    BOOST_REQUIRE (vfs_read ("data/tex/a.bin", file));
+    BOOST_CHECK (same (file.data(), file.size(), two));
+    FileData held;
+    BOOST_REQUIRE (vfs_read ("data/tex/b.bin", held));
+    vfs_unmount ("second.pak");
+    BOOST_REQUIRE (vfs_read ("data/tex/a.bin", file));
+    BOOST_CHECK (same (file.data(), file.size(), one));
+    vfs_unmount_all ();
+    BOOST_CHECK (same (held.data(), held.size(), one));
+    BOOST_CHECK (!vfs_read ("data/tex/a.bin", file));
+
+    // Files not in an archive come from disk: small ones are read, large
+    // ones mapped.
+    BOOST_REQUIRE (vfs_read ("disk.bin", file));
+    BOOST_CHECK (same (file.data(), file.size(), disk));
+    std::vector<U8> large = random_bytes (200000);
+    write_file ("large.bin", large);
+    write_file ("empty.bin", std::vector<U8> ());
+    BOOST_REQUIRE (vfs_read ("large.bin", file));
+    BOOST_CHECK (same (file.data(), file.size(), large));
+    BOOST_REQUIRE (vfs_read ("empty.bin", file));
+    BOOST_CHECK_EQUAL (file.size(), 0u);
+    BOOST_CHECK (!vfs_read ("no-such-file", file));
+    BOOST_CHECK (!vfs_read (".", file));
+    BOOST_CHECK_EQUAL (file.size(), 0u);
+    BOOST_CHECK_THROW (vfs_mount ("no-such.pak"), std::exception);
+
+    remove ("one.bin");
+    remove ("two.bin");
+    remove ("disk.bin");
+    remove ("large.bin");
+    remove ("empty.bin");
+    remove ("first.pak");
+    remove ("second.pak");
+}
+
+BOOST_AUTO_TEST_CASE (vfs_images)
+{
+    Image rgba (33, 17, 4, Image::Image_U8);
+    for (int i = 0; i < 33 * 17 * 4; ++i) rgba.ith<U8>(i) = (U8) (i * 7);
+    write_tga (rgba, "pak.tga");
+    write_ppm (rgba, "pak.ppm");
+    CompressedImage bc1;
+    CompressedImage::encode (rgba, CompressedImage::Compressed_BC1, bc1);
+    write_dds (bc1, "pak.dds");
+    const char* files[] = { "pak.tga", "pak.ppm", "pak.dds" };
+    const char* names[] = { "img/a.tga", "img/b.ppm", "img/c.dds" };
+    write_archive ("images.pak", names, files, 3);
+    for (int i = 0; i < 3; ++i) remove (files[i]);
+
+    vfs_mount ("images.pak", "assets");
+    Image tga, ppm;
+    Image::from_file ("assets/img/a.tga", tga);
+    Image::from_file ("assets/img/b.ppm", ppm);
+    BOOST_REQUIRE_EQUAL (tga.numComponents (), 4);
+    BOOST_REQUIRE_EQUAL (ppm.numComponents (), 3);
+    for (int i = 0; i < 33 * 17; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            BOOST_REQUIRE_EQUAL (tga.ith<U8>(i*4 + k), rgba.ith<U8>(i*4 + k));
+            BOOST_REQUIRE_EQUAL (ppm.ith<U8>(i*3 + k), rgba.ith<U8>(i*4 + k));
+        }
+    }
+    CompressedImage dds;
+    CompressedImage::from_file ("assets/img/c.dds", dds);
+    BOOST_REQUIRE_EQUAL (dds.numLevels (), bc1.numLevels ());
+    BOOST_CHECK (memcmp (dds.levelData (0), bc1.levelData (0), bc1.levelSize (0)) == 0);
+    BOOST_CHECK_THROW (Image::from_file ("assets/img/none.png", tga), std::exception);
+    vfs_unmount_all ();
+    remove ("images.pak");
+}
@@ -0,0 +1,146 @@
+#define BOOST_TEST_MODULE Atlas
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <OGDT/Atlas.h>
+#include <OGDT/Image.h>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace OGDT;
+
+void fill_random (Image& image)
+{
+    int n = image.width() * image.height() * image.numComponents();
+    for (int i = 0; i < n; ++i) image.ith<U8>(i) = rand() % 256;
+}
+
+// Check that no two regions, grown by the given gutter, overlap, and that
+// all of them lie within the atlas.
+void check_disjoint (const Atlas& atlas, int gutter)
+{
+    int W = atlas.width(), H = atlas.height();
+    std::vector<bool> used ((size_t) W * H, false);
+    for (unsigned i = 0; i < atlas.numRegions(); ++i) {
+        const Atlas::Region& r = atlas.region (i);
+        BOOST_REQUIRE (r.x - gutter >= 0 && r.y - gutter >= 0);
+        BOOST_REQUIRE (r.x + r.width + gutter <= W && r.y + r.height + gutter <= H);
+        for (int y = r.y - gutter; y < r.y + r.height + gutter; ++y) {
+            for (int x = r.x - gutter; x < r.x + r.width + gutter; ++x) {
+                BOOST_REQUIRE (!used[(size_t) y * W + x]);
+                used[(size_t) y * W + x] = true;
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (atlas_packing_density)
+{
+    // Sprite-like sizes: mostly small, some wide or tall.
+    srand (1);
+    Atlas atlas (0);
+    for (int i = 0; i < 2000; ++i) {
+        int w = 8 + rand() % 40;
+        int h = rand() % 4 ? 8 + rand() % 40 : 4 + rand() % 12;
+        atlas.add (w, h);
+    }
+    atlas.pack ();
+    check_disjoint (atlas, 0);
+
+    // The atlas is rounded up to a power of two, so judge the packer by the
+    // area below its highest rectangle.
+    int top = 0;
+    double used = 0;
+    for (unsigned i = 0; i < atlas.numRegions(); ++i) {
+        const Atlas::Region& r = atlas.region (i);
+        top = std::max (top, r.y + r.height);
+        used += r.width * r.height;
+    }
+    double density = used / ((double) atlas.width() * top);
+    BOOST_TEST_MESSAGE ("2000 rectangles in " << atlas.width() << "x" << atlas.height()
+                        << ", occupancy " << atlas.occupancy() << ", density " << density);
+    BOOST_CHECK_GT (density, 0.9);
+    BOOST_CHECK_GT (atlas.occupancy(), 0.5f);
+
+    // Equal squares tile perfectly.
+    Atlas squares (0);
+    for (int i = 0; i < 256; ++i) squares.add (16, 16);
+    squares.pack ();
+    check_disjoint (squares, 0);
+    BOOST_CHECK_EQUAL (squares.width(), 256);
+    BOOST_CHECK_EQUAL (squares.height(), 256);
+    BOOST_CHECK_EQUAL (squares.occupancy(), 1.0f);
+}
+
+BOOST_AUTO_TEST_CASE (atlas_gutters_and_uvs)
+{
+    srand (2);
+    std::vector<std::unique_ptr<Image>> images;
+    Atlas atlas (3);
+    for (int i = 0; i < 40; ++i) {
+        images.emplace_back (new Image (3 + rand() % 30, 3 + rand() % 30, 4, Image::Image_U8));
+        fill_random (*images.back());
+        atlas.add (*images.back());
+    }
+    atlas.build ();
+    check_disjoint (atlas, 3);
+    const Image& img = atlas.image();
+    BOOST_REQUIRE_EQUAL (img.width(), atlas.width());
+    BOOST_REQUIRE_EQUAL (img.height(), atlas.height());
+
+    TImage<U8,4> dst = img.coerce<U8,4>();
+    for (unsigned i = 0; i < images.size(); ++i) {
+        const Atlas::Region& r = atlas.region (i);
+        const Image& src = *images[i];
+        BOOST_REQUIRE_EQUAL (r.width, src.width());
+        BOOST_REQUIRE_EQUAL (r.height, src.height());
+        BOOST_CHECK_CLOSE (r.u0, (float) r.x / atlas.width(), 1e-4);
+        BOOST_CHECK_CLOSE (r.v1, (float) (r.y + r.height) / atlas.height(), 1e-4);
+
+        // Pixels and gutter: the gutter repeats the nearest edge pixel.
+        TImage<U8,4> s = src.coerce<U8,4>();
+        for (int y = -3; y < r.height + 3; ++y) {
+            for (int x = -3; x < r.width + 3; ++x) {
+                int sy = std::min (std::max (y, 0), r.height - 1);
+                int sx = std::min (std::max (x, 0), r.width - 1);
+                for (int k = 0; k < 4; ++k) {
+                    BOOST_REQUIRE_EQUAL (dst.row (r.y + y)[(r.x + x) * 4 + k], s.row (sy)[sx * 4 + k]);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (atlas_alignment)
+{
+    srand (3);
+    Atlas atlas (1, 8);
+    for (int i = 0; i < 100; ++i) atlas.add (1 + rand() % 20, 1 + rand() % 20);
+    atlas.pack ();
+    check_disjoint (atlas, 1);
+    for (unsigned i = 0; i < atlas.numRegions(); ++i) {
+        const Atlas::Region& r = atlas.region (i);
+        BOOST_CHECK_EQUAL ((r.x - 1) % 8, 0);
+        BOOST_CHECK_EQUAL ((r.y - 1) % 8, 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (atlas_errors)
+{
+    Image rgba (4, 4, 4, Image::Image_U8);
+    Image rgb (4, 4, 3, Image::Image_U8);
+    Atlas atlas;
+    atlas.add (rgba);
+    BOOST_CHECK_THROW (atlas.add (rgb), std::exception);
+    BOOST_CHECK_THROW (atlas.add (0, 5), std::exception);
+
+    Atlas big (0);
+    big.add (100, 100);
+    BOOST_CHECK_THROW (big.pack (64), std::exception);
+    Atlas many (0);
+    for (int i = 0; i < 5; ++i) many.add (32, 32);
+    BOOST_CHECK_THROW (many.pack (64), std::exception);
+
+    BOOST_CHECK_THROW (Atlas (2, 3), std::exception);
+}
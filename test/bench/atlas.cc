@@ -0,0 +1,62 @@
+// Packing 5000 sprite-sized images into one atlas.
+//
+// Usage: atlas-bench [images] [iterations]
+
+#include <OGDT/Atlas.h>
+#include <OGDT/Image.h>
+#include <OGDT/Timer.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace OGDT;
+
+int main (int argc, char** argv)
+{
+    int n     = argc > 1 ? atoi (argv[1]) : 5000;
+    int iters = argc > 2 ? atoi (argv[2]) : 10;
+
+    // Icons and sprites: 8 to 64 pixels a side, a quarter of them squares.
+    srand (1);
+    std::vector<Image*> images;
+    for (int i = 0; i < n; ++i) {
+        int w = 8 + rand() % 57;
+        int h = rand() % 4 ? 8 + rand() % 57 : w;
+        Image* image = new Image (w, h, 4, Image::Image_U8);
+        for (int j = 0; j < w * h * 4; ++j) image->ith<U8>(j) = (U8) (j * 13 + i);
+        images.push_back (image);
+    }
+
+    Timer timer;
+    timer.start ();
+    double pack = 0, build = 0;
+    int W = 0, H = 0, top = 0;
+    float occupancy = 0;
+    for (int it = 0; it < iters; ++it) {
+        Atlas atlas;
+        for (Image* image : images) atlas.add (*image);
+        timer.tick ();
+        atlas.pack (8192);
+        timer.tick ();
+        pack += timer.getDelta();
+        atlas.build (8192);
+        timer.tick ();
+        build += timer.getDelta();
+        W = atlas.width();
+        H = atlas.height();
+        occupancy = atlas.occupancy();
+        top = 0;
+        for (unsigned i = 0; i < atlas.numRegions(); ++i) {
+            top = std::max (top, atlas.region(i).y + atlas.region(i).height + 2);
+        }
+    }
+
+    printf ("%d images into %dx%d, %.1f%% occupied, %.1f%% below the highest image\n",
+            n, W, H, 100.0f * occupancy, 100.0f * occupancy * H / top);
+    printf ("  pack  %8.3f ms\n", 1000.0 * pack / iters);
+    printf ("  build %8.3f ms (pack and copy with gutters)\n", 1000.0 * build / iters);
+
+    for (Image* image : images) delete image;
+    return 0;
+}
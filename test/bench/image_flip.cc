@@ -0,0 +1,82 @@
+// Vertical flip of a 4K image: in place, and while loading.
+//
+// Usage: image-flip-bench [width] [height] [iterations]
+
+#include <OGDT/Image.h>
+#include <OGDT/Timer.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace OGDT;
+
+// The previous implementation, for reference: a heap line buffer and three copies per row pair.
+void flip_copy (U8* pixels, int w, int h, int c)
+{
+    int line_size = w * c;
+    U8* top = pixels;
+    U8* bot = pixels + (h-1) * line_size;
+    U8* tmp = new U8[line_size];
+    for (; top < bot; top += line_size, bot -= line_size) {
+        memcpy (tmp, top, line_size);
+        memcpy (top, bot, line_size);
+        memcpy (bot, tmp, line_size);
+    }
+    delete[] tmp;
+}
+
+int main (int argc, char** argv)
+{
+    int w     = argc > 1 ? atoi (argv[1]) : 3840;
+    int h     = argc > 2 ? atoi (argv[2]) : 2160;
+    int iters = argc > 3 ? atoi (argv[3]) : 50;
+
+    Image image (w, h, 4, Image::Image_U8);
+    U8* pixels = &image.ith<U8>(0);
+    for (int i = 0; i < w * h * 4; ++i) pixels[i] = (U8) i;
+
+    Timer timer;
+    timer.start ();
+
+    timer.tick ();
+    for (int i = 0; i < iters; ++i) flip_copy (pixels, w, h, 4);
+    timer.tick ();
+    float copy = 1000.0f * timer.getDelta() / iters;
+
+    timer.tick ();
+    for (int i = 0; i < iters; ++i) image.flipVertically ();
+    timer.tick ();
+    float swap = 1000.0f * timer.getDelta() / iters;
+
+    printf ("%dx%d RGBA flip: %.2f ms with a line buffer, %.2f ms in place\n", w, h, copy, swap);
+
+    // Loading: flip after decoding versus flip while decoding.
+    const char* path = "bench.ppm";
+    FILE* f = fopen (path, "wb");
+    fprintf (f, "P6\n%d %d\n255\n", w, h);
+    fwrite (pixels, 1, (size_t) w * h * 3, f);
+    fclose (f);
+
+    int loads = iters / 5 + 1;
+    timer.tick ();
+    for (int i = 0; i < loads; ++i) {
+        Image img;
+        Image::from_file (path, img);
+        img.flipVertically ();
+    }
+    timer.tick ();
+    float after = 1000.0f * timer.getDelta() / loads;
+
+    timer.tick ();
+    for (int i = 0; i < loads; ++i) {
+        Image img;
+        Image::from_file (path, img, true);
+    }
+    timer.tick ();
+    float during = 1000.0f * timer.getDelta() / loads;
+
+    printf ("%dx%d PPM load: %.2f ms flipping after, %.2f ms flipping on load\n", w, h, after, during);
+
+    remove (path);
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Image kernels against the per-pixel accessor loops they replace.
+//
+// Usage: image-ops-bench [width] [height] [iterations]
+
+#include <OGDT/Image.h>
+#include <OGDT/Timer.h>
+#include <OGDT/image_ops.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace OGDT;
+
+Timer timer;
+int iters;
+
+template <class F>
+float time_ms (F f)
+{
+    timer.tick ();
+    for (int i = 0; i < iters; ++i) f ();
+    timer.tick ();
+    return 1000.0f * timer.getDelta() / iters;
+}
+
+void report (const char* name, float loop, float kernel)
+{
+    printf ("  %-18s %7.3f ms per pixel, %7.3f ms kernel, %5.1fx\n", name, loop, kernel, loop / kernel);
+}
+
+int main (int argc, char** argv)
+{
+    int w = argc > 1 ? atoi (argv[1]) : 1920;
+    int h = argc > 2 ? atoi (argv[2]) : 1080;
+    iters = argc > 3 ? atoi (argv[3]) : 20;
+
+    Image rgb (w, h, 3, Image::Image_U8);
+    Image rgba (w, h, 4, Image::Image_U8);
+    Image rgba_f (w, h, 4, Image::Image_F32);
+    Image half (w/2, h/2, 4, Image::Image_U8);
+    for (int i = 0; i < w * h * 3; ++i) rgb.ith<U8>(i) = (U8) (i * 7);
+    for (int i = 0; i < w * h * 4; ++i) rgba.ith<U8>(i) = (U8) (i * 13);
+    const U8* src3 = rgb;
+    const U8* src4 = rgba;
+    U8* dst4 = &rgba.ith<U8>(0);
+    float* dstf = &rgba_f.ith<float>(0);
+    size_t s3 = w * 3, s4 = w * 4, sf = w * 4 * sizeof(float);
+    timer.start ();
+
+    printf ("%dx%d:\n", w, h);
+
+    report ("rgb_to_rgba", time_ms ([&] {
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                rgba.r<U8>(y, x) = rgb.r<U8>(y, x);
+                rgba.g<U8>(y, x) = rgb.g<U8>(y, x);
+                rgba.b<U8>(y, x) = rgb.b<U8>(y, x);
+                rgba.a<U8>(y, x) = 255;
+            }
+        }
+    }), time_ms ([&] { rgb_to_rgba (src3, s3, dst4, s4, w, h); }));
+
+    report ("u8_to_f32", time_ms ([&] {
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                rgba_f.r<float>(y, x) = rgba.r<U8>(y, x) / 255.0f;
+                rgba_f.g<float>(y, x) = rgba.g<U8>(y, x) / 255.0f;
+                rgba_f.b<float>(y, x) = rgba.b<U8>(y, x) / 255.0f;
+                rgba_f.a<float>(y, x) = rgba.a<U8>(y, x) / 255.0f;
+            }
+        }
+    }), time_ms ([&] { u8_to_f32 (src4, s4, dstf, sf, w, h, 4); }));
+
+    report ("premultiply_alpha", time_ms ([&] {
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                int a = rgba.a<U8>(y, x);
+                rgba.r<U8>(y, x) = (U8) ((rgba.r<U8>(y, x) * a + 127) / 255);
+                rgba.g<U8>(y, x) = (U8) ((rgba.g<U8>(y, x) * a + 127) / 255);
+                rgba.b<U8>(y, x) = (U8) ((rgba.b<U8>(y, x) * a + 127) / 255);
+            }
+        }
+    }), time_ms ([&] { premultiply_alpha (dst4, s4, w, h); }));
+
+    const int bgra[] = { 2, 1, 0, 3 };
+    report ("swizzle", time_ms ([&] {
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                U8 r = rgba.r<U8>(y, x);
+                rgba.r<U8>(y, x) = rgba.b<U8>(y, x);
+                rgba.b<U8>(y, x) = r;
+            }
+        }
+    }), time_ms ([&] { swizzle (src4, s4, dst4, s4, w, h, bgra); }));
+
+    auto decode = [] (U8 c) {
+        float v = c / 255.0f;
+        return v <= 0.04045f ? v / 12.92f : powf ((v + 0.055f) / 1.055f, 2.4f);
+    };
+    report ("srgb_to_linear", time_ms ([&] {
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                rgba_f.r<float>(y, x) = decode (rgba.r<U8>(y, x));
+                rgba_f.g<float>(y, x) = decode (rgba.g<U8>(y, x));
+                rgba_f.b<float>(y, x) = decode (rgba.b<U8>(y, x));
+                rgba_f.a<float>(y, x) = rgba.a<U8>(y, x) / 255.0f;
+            }
+        }
+    }), time_ms ([&] { srgb_to_linear (src4, s4, dstf, sf, w, h, 4); }));
+
+    auto encode = [] (float v) {
+        v = v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;
+        float s = v <= 0.0031308f ? 12.92f * v : 1.055f * powf (v, 1.0f / 2.4f) - 0.055f;
+        return (U8) (s * 255.0f + 0.5f);
+    };
+    report ("linear_to_srgb", time_ms ([&] {
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                rgba.r<U8>(y, x) = encode (rgba_f.r<float>(y, x));
+                rgba.g<U8>(y, x) = encode (rgba_f.g<float>(y, x));
+                rgba.b<U8>(y, x) = encode (rgba_f.b<float>(y, x));
+                rgba.a<U8>(y, x) = (U8) (rgba_f.a<float>(y, x) * 255.0f + 0.5f);
+            }
+        }
+    }), time_ms ([&] { linear_to_srgb (dstf, sf, dst4, s4, w, h, 4); }));
+
+    report ("downscale2", time_ms ([&] {
+        for (int y = 0; y < h/2; ++y) {
+            for (int x = 0; x < w/2; ++x) {
+                for (int k = 0; k < 4; ++k) {
+                    int sum = rgba.ith<U8>(((2*y) * w + 2*x) * 4 + k) + rgba.ith<U8>(((2*y) * w + 2*x+1) * 4 + k)
+                            + rgba.ith<U8>(((2*y+1) * w + 2*x) * 4 + k) + rgba.ith<U8>(((2*y+1) * w + 2*x+1) * 4 + k);
+                    half.ith<U8>((y * (w/2) + x) * 4 + k) = (U8) ((sum + 2) / 4);
+                }
+            }
+        }
+    }), time_ms ([&] { downscale2 (src4, s4, &half.ith<U8>(0), (w/2) * 4, w, h, 4); }));
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+// Batch image loading with and without an ImagePool: every image is
+// decoded, used once and thrown away, as load_texture does.
+//
+// Usage: image-pool-bench [images] [size]
+
+#include <OGDT/Image.h>
+#include <OGDT/ImagePool.h>
+#include <OGDT/Timer.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace OGDT;
+
+Timer timer;
+
+float load_all (const std::vector<std::string>& paths)
+{
+    unsigned sum = 0;
+    timer.tick ();
+    for (const std::string& path : paths) {
+        Image image;
+        Image::from_file (path.c_str(), image, true);
+        sum += image.ith<U8>(0); // Stand-in for the upload.
+    }
+    timer.tick ();
+    if (sum == 1) printf (" ");
+    return 1000.0f * timer.getDelta();
+}
+
+int main (int argc, char** argv)
+{
+    int n    = argc > 1 ? atoi (argv[1]) : 200;
+    int size = argc > 2 ? atoi (argv[2]) : 1024;
+
+    // A few distinct files, loaded round-robin.
+    std::vector<std::string> files;
+    const char* exts[] = { "tga", "ppm" };
+    for (int i = 0; i < 4; ++i) {
+        Image image (size, size, i % 2 ? 3 : 4, Image::Image_U8);
+        for (int j = 0; j < size * size * image.numComponents(); ++j) image.ith<U8>(j) = (U8) (j * 7 + i);
+        char name[64];
+        sprintf (name, "pool_%d.%s", i, exts[i % 2]);
+        if (i % 2) write_ppm (image, name);
+        else write_tga (image, name);
+        files.push_back (name);
+    }
+    std::vector<std::string> paths;
+    for (int i = 0; i < n; ++i) paths.push_back (files[i % files.size()]);
+
+    timer.start ();
+    load_all (paths); // Warm the file cache.
+    float plain = load_all (paths);
+
+    ImagePool pool;
+    Image::setAllocator (&pool);
+    float pooled = load_all (paths);
+    Image::setAllocator (nullptr);
+
+    printf ("%d images of %dx%d, tga and ppm:\n", n, size, size);
+    printf ("  malloc     %8.2f ms\n", plain);
+    printf ("  ImagePool  %8.2f ms, %u hits, %u misses\n", pooled,
+            (unsigned) pool.hits(), (unsigned) pool.misses());
+
+    for (const std::string& f : files) remove (f.c_str());
+    return 0;
+}
@@ -0,0 +1,64 @@
+// Writing many debug captures: the per-pixel fwrite loop that write_ppm
+// used to run against the block writer.
+//
+// Usage: image-write-bench [width] [height] [captures]
+
+#include <OGDT/Image.h>
+#include <OGDT/Timer.h>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace OGDT;
+
+// The previous write_ppm, for reference.
+void write_ppm_per_pixel (const Image& image, const char* file)
+{
+    FILE* f = fopen (file, "w");
+    fprintf (f, "P6 %d %d 255\n", image.width(), image.height());
+    const U8* p = image;
+    size_t n = (size_t) image.width() * image.height();
+    size_t stride = image.numComponents() * image.dataSize();
+    for (size_t i = 0; i < n; ++i, p += stride) {
+        if (image.dataType() == Image::Image_U8) fwrite (p, 1, 3, f);
+        else {
+            U8 bytes[3];
+            for (int j = 0; j < 3; ++j) bytes[j] = (U8) (((const float*) p)[j] * 255.0f);
+            fwrite (bytes, 1, 3, f);
+        }
+    }
+    fclose (f);
+}
+
+float time_writes (const Image& image, int captures, void (*write) (const Image&, const char*))
+{
+    Timer timer;
+    timer.start ();
+    timer.tick ();
+    for (int i = 0; i < captures; ++i) write (image, "bench_capture");
+    timer.tick ();
+    remove ("bench_capture");
+    return 1000.0f * timer.getDelta() / captures;
+}
+
+int main (int argc, char** argv)
+{
+    int w        = argc > 1 ? atoi (argv[1]) : 640;
+    int h        = argc > 2 ? atoi (argv[2]) : 360;
+    int captures = argc > 3 ? atoi (argv[3]) : 200;
+
+    Image u8 (w, h, 4, Image::Image_U8);
+    Image f32 (w, h, 4, Image::Image_F32);
+    for (int i = 0; i < w * h * 4; ++i) {
+        u8.ith<U8>(i) = (U8) i;
+        f32.ith<float>(i) = (i % 1000) / 999.0f;
+    }
+
+    printf ("%dx%d RGBA, ms per capture:\n", w, h);
+    printf ("  ppm from U8:  %.3f per pixel, %.3f blocks\n",
+            time_writes (u8, captures, write_ppm_per_pixel), time_writes (u8, captures, write_ppm));
+    printf ("  ppm from F32: %.3f per pixel, %.3f blocks\n",
+            time_writes (f32, captures, write_ppm_per_pixel), time_writes (f32, captures, write_ppm));
+    printf ("  pgm %.3f, pfm %.3f, tga %.3f\n", time_writes (u8, captures, write_pgm),
+            time_writes (f32, captures, write_pfm), time_writes (u8, captures, write_tga));
+    return 0;
+}
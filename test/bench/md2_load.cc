@@ -0,0 +1,36 @@
+// Load-time benchmark over a large synthetic MD2 model.
+//
+// Usage: md2-load-bench [frames] [vertices] [triangles] [iterations]
+
+#include "../md2_synth.h"
+#include <OGDT/Timer.h>
+#include <OGDT/model.h>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace OGDT;
+
+int main (int argc, char** argv)
+{
+    int frames = argc > 1 ? atoi (argv[1]) : 512;
+    int verts  = argc > 2 ? atoi (argv[2]) : 2048;
+    int tris   = argc > 3 ? atoi (argv[3]) : 4096;
+    int iters  = argc > 4 ? atoi (argv[4]) : 10;
+
+    const char* path = "bench.md2";
+    write_md2 (path, frames, verts, tris);
+
+    Timer timer;
+    timer.start ();
+    timer.tick ();
+    for (int i = 0; i < iters; ++i) {
+        Model model (path);
+    }
+    timer.tick ();
+
+    printf ("%d frames, %d vertices, %d triangles: %.2f ms per load\n",
+            frames, verts, tris, 1000.0f * timer.getDelta() / iters);
+
+    remove (path);
+    return 0;
+}
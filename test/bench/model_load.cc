@@ -0,0 +1,195 @@
+// Load-time benchmark of the assimp import presets.
+//
+// Usage: model-load-bench [iterations] [model...]
+//
+// Loads each model with every preset and reports the time per load, the
+// upload included. Without models, a synthetic OBJ and 3DS pair is written
+// and loaded: a 256x256 grid of quads split into 16 objects. Renders
+// offscreen through EGL, so it also runs headless:
+// EGL_PLATFORM=surfaceless ./model-load-bench 5 level.obj crate.3ds
+
+#include <OGDT/Timer.h>
+#include <OGDT/gl.h>
+#include <OGDT/model.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <assimp/postprocess.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+using namespace OGDT;
+
+bool create_context ()
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress ("eglGetPlatformDisplayEXT");
+    if (!get_display) return false;
+    EGLDisplay d = get_display (EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (!eglInitialize (d, NULL, NULL)) return false;
+    eglBindAPI (EGL_OPENGL_API);
+    EGLContext c = eglCreateContext (d, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, NULL);
+    if (c == EGL_NO_CONTEXT) return false;
+    if (!eglMakeCurrent (d, EGL_NO_SURFACE, EGL_NO_SURFACE, c)) return false;
+    glewExperimental = GL_TRUE;
+    glewInit ();
+    return true;
+}
+
+const int grid = 256;    // Quads per side.
+const int objects = 16;  // Horizontal bands, one object each.
+
+// Write a grid of quads with normals and texture coordinates.
+void write_obj (const char* path)
+{
+    FILE* f = fopen (path, "w");
+    for (int y = 0; y <= grid; ++y) {
+        for (int x = 0; x <= grid; ++x) {
+            fprintf (f, "v %d %d %f\n", x, y, 0.1f * ((x * 7 + y * 13) % 10));
+            fprintf (f, "vt %f %f\n", (float) x / grid, (float) y / grid);
+        }
+    }
+    fprintf (f, "vn 0 0 1\n");
+    int rows = grid / objects;
+    for (int o = 0; o < objects; ++o) {
+        fprintf (f, "o band%d\n", o);
+        for (int y = o * rows; y < (o+1) * rows; ++y) {
+            for (int x = 0; x < grid; ++x) {
+                int a = y * (grid+1) + x + 1, b = a + 1, c = b + grid + 1, d = a + grid + 1;
+                fprintf (f, "f %d/%d/1 %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, b, b, c, c, d, d);
+            }
+        }
+    }
+    fclose (f);
+}
+
+// 3DS files are trees of chunks: a 16-bit id and a 32-bit length that
+// includes the 6-byte header.
+struct chunk_writer
+{
+    std::vector<unsigned char> data;
+    std::vector<size_t> open;
+
+    void u16 (unsigned v) { data.push_back (v & 0xFF); data.push_back (v >> 8); }
+    void u32 (unsigned v) { u16 (v & 0xFFFF); u16 (v >> 16); }
+    void f32 (float v) { unsigned u; memcpy (&u, &v, 4); u32 (u); }
+    void begin (unsigned id) { u16 (id); open.push_back (data.size()); u32 (0); }
+    void end () {
+        size_t at = open.back();
+        open.pop_back ();
+        unsigned n = data.size() - at + 2;
+        for (int k = 0; k < 4; ++k) data[at+k] = (n >> (8*k)) & 0xFF;
+    }
+};
+
+// Write the same grid as write_obj, one mesh object per band. 3DS indices
+// are 16 bits, so every band has its own vertices.
+void write_3ds (const char* path)
+{
+    chunk_writer w;
+    int rows = grid / objects;
+    w.begin (0x4D4D);     // Main.
+    w.begin (0x0002);     // Version.
+    w.u32 (3);
+    w.end ();
+    w.begin (0x3D3D);     // Editor.
+    for (int o = 0; o < objects; ++o) {
+        w.begin (0x4000); // Object.
+        std::string name = "band" + std::to_string (o);
+        w.data.insert (w.data.end(), name.begin(), name.end() + 1);
+        w.begin (0x4100); // Triangle mesh.
+        w.begin (0x4110); // Vertices.
+        w.u16 ((rows+1) * (grid+1));
+        for (int y = o * rows; y <= (o+1) * rows; ++y) {
+            for (int x = 0; x <= grid; ++x) {
+                w.f32 (x); w.f32 (y); w.f32 (0.1f * ((x * 7 + y * 13) % 10));
+            }
+        }
+        w.end ();
+        w.begin (0x4140); // Texture coordinates.
+        w.u16 ((rows+1) * (grid+1));
+        for (int y = o * rows; y <= (o+1) * rows; ++y) {
+            for (int x = 0; x <= grid; ++x) {
+                w.f32 ((float) x / grid); w.f32 ((float) y / grid);
+            }
+        }
+        w.end ();
+        w.begin (0x4120); // Faces.
+        w.u16 (2 * rows * grid);
+        for (int y = 0; y < rows; ++y) {
+            for (int x = 0; x < grid; ++x) {
+                unsigned a = y * (grid+1) + x, b = a + 1, c = b + grid + 1, d = a + grid + 1;
+                w.u16 (a); w.u16 (b); w.u16 (c); w.u16 (0);
+                w.u16 (a); w.u16 (c); w.u16 (d); w.u16 (0);
+            }
+        }
+        w.end ();
+        w.end ();
+        w.end ();
+    }
+    w.end ();
+    w.end ();
+    FILE* f = fopen (path, "wb");
+    fwrite (&w.data[0], 1, w.data.size(), f);
+    fclose (f);
+}
+
+struct preset
+{
+    const char* name;
+    ImportPreset preset;
+    unsigned flags;
+};
+
+int main (int argc, char** argv)
+{
+    int iters = argc > 1 ? atoi (argv[1]) : 5;
+    if (iters < 1) iters = 1;
+    std::vector<const char*> paths (argv + std::min (argc, 2), argv + argc);
+    bool synthetic = paths.empty();
+    if (synthetic) {
+        write_obj ("bench.obj");
+        write_3ds ("bench.3ds");
+        paths.push_back ("bench.obj");
+        paths.push_back ("bench.3ds");
+    }
+
+    if (!create_context ()) {
+        fprintf (stderr, "Failed creating an OpenGL context\n");
+        return 1;
+    }
+
+    const preset presets[] = {
+        { "fast",    Import_Fast,    0 },
+        { "quality", Import_Quality, 0 },
+        { "minimal", Import_Custom,  aiProcess_Triangulate },
+    };
+
+    Timer timer;
+    timer.start ();
+    for (const char* path : paths) {
+        for (const preset& p : presets) {
+            try {
+                timer.tick ();
+                for (int i = 0; i < iters; ++i) {
+                    Model model (path, p.preset, p.flags);
+                }
+                timer.tick ();
+                printf ("%s, %s: %.2f ms per load\n",
+                        path, p.name, 1000.0f * timer.getDelta() / iters);
+            }
+            catch (const std::exception& e) {
+                printf ("%s, %s: %s\n", path, p.name, e.what());
+            }
+        }
+    }
+    if (synthetic) {
+        remove ("bench.obj");
+        remove ("bench.3ds");
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+// A level load of many small files, from loose files on disk and from a
+// mounted pak: icons decoded with Image::from_file and shader sources read
+// through vfs_read.
+//
+// Usage: pak-load-bench [files] [icon size]
+
+#include <OGDT/Archive.h>
+#include <OGDT/Image.h>
+#include <OGDT/Timer.h>
+#include <OGDT/vfs.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace OGDT;
+
+Timer timer;
+
+float load_all (const std::vector<std::string>& paths)
+{
+    unsigned sum = 0;
+    timer.tick ();
+    for (const std::string& path : paths) {
+        if (path.compare (path.size() - 4, 4, ".tga") == 0) {
+            Image image;
+            Image::from_file (path.c_str(), image);
+            sum += image.ith<U8>(0);
+        }
+        else {
+            FileData file;
+            if (!vfs_read (path.c_str(), file)) {
+                fprintf (stderr, "Missing %s\n", path.c_str());
+                exit (1);
+            }
+            sum += file.size();
+        }
+    }
+    timer.tick ();
+    if (sum == 1) printf (" ");
+    return 1000.0f * timer.getDelta();
+}
+
+int main (int argc, char** argv)
+{
+    int n    = argc > 1 ? atoi (argv[1]) : 2000;
+    int size = argc > 2 ? atoi (argv[2]) : 32;
+
+    // Half icons, half shader sources.
+    std::vector<std::string> files, names, disk, packed;
+    Image icon (size, size, 4, Image::Image_U8);
+    std::string source;
+    while (source.size() < 4096) source += "uniform sampler2D tex;\nvarying vec2 uv;\n";
+    for (int i = 0; i < n; ++i) {
+        char name[64];
+        if (i % 2) {
+            sprintf (name, "pak_bench_%d.glsl", i);
+            FILE* f = fopen (name, "wb");
+            fprintf (f, "// %d\n%s", i, source.c_str());
+            fclose (f);
+        }
+        else {
+            for (int j = 0; j < size * size * 4; ++j) icon.ith<U8>(j) = (U8) (j * 7 + i);
+            sprintf (name, "pak_bench_%d.tga", i);
+            write_tga (icon, name);
+        }
+        files.push_back (name);
+        names.push_back (std::string ("level/") + name);
+    }
+    std::vector<const char*> file_ptrs, name_ptrs;
+    for (int i = 0; i < n; ++i) {
+        file_ptrs.push_back (files[i].c_str());
+        name_ptrs.push_back (names[i].c_str());
+    }
+
+    timer.start ();
+    write_archive ("pak_bench.pak", &name_ptrs[0], &file_ptrs[0], n);
+    timer.tick ();
+    float build = 1000.0f * timer.getDelta();
+
+    load_all (files); // Warm the file cache.
+    float loose = load_all (files);
+    vfs_mount ("pak_bench.pak");
+    float pak = load_all (names);
+    vfs_unmount_all ();
+
+    printf ("%d files, %dx%d icons and 4 KB shaders:\n", n, size, size);
+    printf ("  write pak    %8.2f ms\n", build);
+    printf ("  loose files  %8.2f ms\n", loose);
+    printf ("  pak          %8.2f ms\n", pak);
+
+    for (const std::string& f : files) remove (f.c_str());
+    remove ("pak_bench.pak");
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Per-frame cost of background texture loading, uploading whole textures
+// and streaming them under a byte budget.
+//
+// Usage: texture-stream-bench [textures] [size]
+//
+// Every frame calls Loader::update and glFinish, and the time spent in
+// them is recorded. Renders offscreen through EGL, so it also runs headless:
+// EGL_PLATFORM=surfaceless ./texture-stream-bench 32 1024
+
+#include <OGDT/Image.h>
+#include <OGDT/Loader.h>
+#include <OGDT/Timer.h>
+#include <OGDT/gl.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace OGDT;
+
+bool create_context ()
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress ("eglGetPlatformDisplayEXT");
+    if (!get_display) return false;
+    EGLDisplay d = get_display (EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (!eglInitialize (d, NULL, NULL)) return false;
+    eglBindAPI (EGL_OPENGL_API);
+    EGLContext c = eglCreateContext (d, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, NULL);
+    if (c == EGL_NO_CONTEXT) return false;
+    if (!eglMakeCurrent (d, EGL_NO_SURFACE, EGL_NO_SURFACE, c)) return false;
+    glewExperimental = GL_TRUE;
+    glewInit ();
+    return true;
+}
+
+void run (const std::vector<std::string>& paths, size_t budget)
+{
+    Timer timer;
+    timer.start ();
+    Loader loader;
+    loader.setUploadBudget (budget);
+    std::vector<AsyncTexture> textures;
+    timer.tick ();
+    for (const std::string& path : paths) textures.push_back (loader.loadTexture (path.c_str()));
+
+    std::vector<float> frames;
+    while (loader.numPending () > 0) {
+        timer.tick ();
+        loader.update ();
+        glFinish ();
+        timer.tick ();
+        frames.push_back (1000.0f * timer.getDelta());
+    }
+    float total = 0, worst = 0;
+    for (float f : frames) {
+        total += f;
+        worst = std::max (worst, f);
+    }
+    // Frames that only waited for the workers cost nothing; count the busy ones.
+    std::vector<float> busy;
+    for (float f : frames) if (f > 0.05f) busy.push_back (f);
+    std::sort (busy.begin(), busy.end());
+    float median = busy.empty() ? 0.0f : busy[busy.size() / 2];
+    if (budget) printf ("  %5u KB/frame", (unsigned) (budget >> 10));
+    else printf ("  whole textures");
+    printf ("  %5u busy frames, median %7.2f ms, worst %7.2f ms, total %8.2f ms\n",
+            (unsigned) busy.size(), median, worst, total);
+
+    for (AsyncTexture& t : textures) {
+        GLuint tex = t.get ();
+        glDeleteTextures (1, &tex);
+    }
+}
+
+int main (int argc, char** argv)
+{
+    int n    = argc > 1 ? atoi (argv[1]) : 32;
+    int size = argc > 2 ? atoi (argv[2]) : 1024;
+
+    if (!create_context ()) {
+        fprintf (stderr, "Failed creating an OpenGL context\n");
+        return 1;
+    }
+
+    std::vector<std::string> paths;
+    for (int i = 0; i < 4; ++i) {
+        Image image (size, size, 4, Image::Image_U8);
+        for (int j = 0; j < size * size * 4; ++j) image.ith<U8>(j) = (U8) (j * 7 + i);
+        char name[64];
+        sprintf (name, "stream_%d.tga", i);
+        write_tga (image, name);
+        paths.push_back (name);
+    }
+    std::vector<std::string> all;
+    for (int i = 0; i < n; ++i) all.push_back (paths[i % paths.size()]);
+
+    printf ("%d textures of %dx%d RGBA:\n", n, size, size);
+    size_t budgets[] = { 0, 4 << 20, 1 << 20, 256 << 10 };
+    for (size_t budget : budgets) run (all, budget);
+
+    for (const std::string& p : paths) remove (p.c_str());
+    return 0;
+}
@@ -0,0 +1,183 @@
+#define BOOST_TEST_MODULE CompressedImage
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <OGDT/CompressedImage.h>
+#include <OGDT/Image.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Everything here runs on the CPU; no GL context is needed.
+
+using namespace OGDT;
+
+// A smooth image with some detail, RGB or RGBA.
+void fill (Image& image)
+{
+    int c = image.numComponents();
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            U8* p = &image.ith<U8>((y * image.width() + x) * c);
+            p[0] = 4 * x;
+            p[1] = 255 - 3 * y;
+            p[2] = (U8) (128 + 100 * sin (0.2 * x) * cos (0.15 * y));
+            if (c == 4) p[3] = 2 * x + y;
+        }
+    }
+}
+
+// Root mean square error of the given component.
+double rmse (const Image& image, const std::vector<U8>& rgba, int k)
+{
+    int n = image.width() * image.height();
+    int c = image.numComponents();
+    double sum = 0.0;
+    for (int i = 0; i < n; ++i) {
+        double d = (double) image.ith<U8>(i * c + k) - rgba[4*i + k];
+        sum += d * d;
+    }
+    return sqrt (sum / n);
+}
+
+BOOST_AUTO_TEST_CASE (compressed_bc1_roundtrip)
+{
+    Image image (64, 48, 3, Image::Image_U8);
+    fill (image);
+    CompressedImage bc1;
+    CompressedImage::encode (image, CompressedImage::Compressed_BC1, bc1);
+    BOOST_CHECK_EQUAL (bc1.numLevels (), 7u);
+    BOOST_CHECK_EQUAL (bc1.levelSize (0), 16u * 12u * 8u);
+    std::vector<U8> rgba (64 * 48 * 4);
+    bc1.decode (0, &rgba[0]);
+    for (int k = 0; k < 3; ++k) BOOST_CHECK_LT (rmse (image, rgba, k), 4.0);
+    for (size_t i = 3; i < rgba.size(); i += 4) BOOST_REQUIRE_EQUAL (rgba[i], 255);
+}
+
+BOOST_AUTO_TEST_CASE (compressed_bc3_roundtrip)
+{
+    Image image (64, 48, 4, Image::Image_U8);
+    fill (image);
+    CompressedImage bc3;
+    CompressedImage::encode (image, CompressedImage::Compressed_BC3, bc3, false);
+    BOOST_CHECK_EQUAL (bc3.numLevels (), 1u);
+    std::vector<U8> rgba (64 * 48 * 4);
+    bc3.decode (0, &rgba[0]);
+    for (int k = 0; k < 4; ++k) BOOST_CHECK_LT (rmse (image, rgba, k), 4.0);
+}
+
+BOOST_AUTO_TEST_CASE (compressed_bc1_punch_through_alpha)
+{
+    Image image (8, 8, 4, Image::Image_U8);
+    fill (image);
+    for (int i = 0; i < 64; ++i) image.ith<U8>(4*i + 3) = (i / 8 + i % 8) % 3 ? 255 : 0;
+    CompressedImage bc1;
+    CompressedImage::encode (image, CompressedImage::Compressed_BC1, bc1, false);
+    std::vector<U8> rgba (8 * 8 * 4);
+    bc1.decode (0, &rgba[0]);
+    for (int i = 0; i < 64; ++i) BOOST_REQUIRE_EQUAL (rgba[4*i + 3], image.ith<U8>(4*i + 3));
+}
+
+BOOST_AUTO_TEST_CASE (compressed_dds_roundtrip)
+{
+    Image image (40, 24, 4, Image::Image_U8);
+    fill (image);
+    CompressedImage bc3;
+    CompressedImage::encode (image, CompressedImage::Compressed_BC3, bc3);
+    write_dds (bc3, "compressed.dds");
+    BOOST_CHECK (CompressedImage::is_container ("compressed.dds"));
+
+    CompressedImage read;
+    CompressedImage::from_file ("compressed.dds", read);
+    remove ("compressed.dds");
+    BOOST_CHECK_EQUAL (read.format (), CompressedImage::Compressed_BC3);
+    BOOST_CHECK_EQUAL (read.width (), 40);
+    BOOST_CHECK_EQUAL (read.height (), 24);
+    BOOST_REQUIRE_EQUAL (read.numLevels (), bc3.numLevels ());
+    for (unsigned l = 0; l < read.numLevels(); ++l) {
+        BOOST_REQUIRE_EQUAL (read.levelSize (l), bc3.levelSize (l));
+        BOOST_CHECK (memcmp (read.levelData (l), bc3.levelData (l), bc3.levelSize (l)) == 0);
+    }
+}
+
+void put_u32 (std::vector<U8>& buf, U32 x, bool big)
+{
+    for (int i = 0; i < 4; ++i) buf.push_back (big ? x >> (24 - 8*i) : x >> (8*i));
+}
+
+// Wrap the image's levels in a KTX file written in either byte order.
+std::vector<U8> make_ktx (const CompressedImage& image, bool big)
+{
+    const U8 id[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+    std::vector<U8> buf (id, id + 12);
+    U32 header[13] = { 0x04030201, 0, 1, 0, 0x83F1, 0x1908, (U32) image.width(), (U32) image.height(),
+                       0, 0, 1, image.numLevels(), 8 };
+    for (int i = 0; i < 13; ++i) put_u32 (buf, header[i], big);
+    for (int i = 0; i < 8; ++i) buf.push_back (0); // Key/value data, skipped.
+    for (unsigned l = 0; l < image.numLevels(); ++l) {
+        put_u32 (buf, image.levelSize (l), big);
+        buf.insert (buf.end(), image.levelData (l), image.levelData (l) + image.levelSize (l));
+    }
+    return buf;
+}
+
+BOOST_AUTO_TEST_CASE (compressed_ktx_both_endians)
+{
+    Image image (32, 16, 3, Image::Image_U8);
+    fill (image);
+    CompressedImage bc1;
+    CompressedImage::encode (image, CompressedImage::Compressed_BC1, bc1);
+    for (int big = 0; big < 2; ++big) {
+        std::vector<U8> ktx = make_ktx (bc1, big != 0);
+        CompressedImage read;
+        CompressedImage::from_mem (&ktx[0], ktx.size(), read);
+        BOOST_CHECK_EQUAL (read.format (), CompressedImage::Compressed_BC1);
+        BOOST_REQUIRE_EQUAL (read.numLevels (), bc1.numLevels ());
+        for (unsigned l = 0; l < read.numLevels(); ++l) {
+            BOOST_CHECK (memcmp (read.levelData (l), bc1.levelData (l), bc1.levelSize (l)) == 0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (compressed_flip_matches_decoded_flip)
+{
+    Image image (16, 8, 4, Image::Image_U8);
+    fill (image);
+    CompressedImage::Format formats[] = { CompressedImage::Compressed_BC1, CompressedImage::Compressed_BC3 };
+    for (CompressedImage::Format format : formats) {
+        CompressedImage c;
+        CompressedImage::encode (image, format, c);
+        std::vector<std::vector<U8> > before (c.numLevels());
+        for (unsigned l = 0; l < c.numLevels(); ++l) {
+            before[l].resize (c.levelWidth (l) * c.levelHeight (l) * 4);
+            c.decode (l, &before[l][0]);
+        }
+        BOOST_REQUIRE (c.canFlip ());
+        c.flipVertically ();
+        for (unsigned l = 0; l < c.numLevels(); ++l) {
+            int w = c.levelWidth (l), h = c.levelHeight (l);
+            std::vector<U8> after (w * h * 4);
+            c.decode (l, &after[0]);
+            for (int y = 0; y < h; ++y) {
+                BOOST_REQUIRE (memcmp (&after[y * w * 4], &before[l][(h-1-y) * w * 4], w * 4) == 0);
+            }
+        }
+    }
+
+    Image odd (16, 6, 3, Image::Image_U8);
+    fill (odd);
+    CompressedImage c;
+    CompressedImage::encode (odd, CompressedImage::Compressed_BC1, c);
+    BOOST_CHECK (!c.canFlip ());
+    BOOST_CHECK_THROW (c.flipVertically (), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE (compressed_rejects_bad_files)
+{
+    U8 junk[256];
+    memset (junk, 0, sizeof(junk));
+    CompressedImage c;
+    BOOST_CHECK_THROW (CompressedImage::from_mem (junk, sizeof(junk), c), std::exception);
+    memcpy (junk, "DDS ", 4);
+    BOOST_CHECK_THROW (CompressedImage::from_mem (junk, sizeof(junk), c), std::exception);
+}
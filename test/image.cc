@@ -0,0 +1,541 @@
+#define BOOST_TEST_MODULE Image
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <OGDT/Image.h>
+#include <OGDT/ImagePool.h>
+#include <OGDT/image_ops.h>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace OGDT;
+
+void fill (Image& image)
+{
+    size_t n = (size_t) image.width() * image.height() * image.numComponents() * image.dataSize();
+    for (size_t i = 0; i < n; ++i) image.ith<U8>(i) = (U8) (i * 31 + i / 7);
+}
+
+// Check that b holds a's rows in reverse order.
+void check_flipped (const Image& a, const Image& b)
+{
+    BOOST_REQUIRE_EQUAL (a.width(), b.width());
+    BOOST_REQUIRE_EQUAL (a.height(), b.height());
+    BOOST_REQUIRE_EQUAL (a.numComponents(), b.numComponents());
+    size_t row = (size_t) a.width() * a.numComponents() * a.dataSize();
+    int h = a.height();
+    const U8* p = a;
+    const U8* q = b;
+    for (int y = 0; y < h; ++y) {
+        BOOST_REQUIRE (memcmp (p + y * row, q + (h-1-y) * row, row) == 0);
+    }
+}
+
+void write_file (const char* path, const std::vector<U8>& data)
+{
+    FILE* f = fopen (path, "wb");
+    fwrite (&data[0], 1, data.size(), f);
+    fclose (f);
+}
+
+BOOST_AUTO_TEST_CASE (image_flip_in_place)
+{
+    // Row sizes around the 16 and 64 byte SIMD steps, odd and even heights.
+    int widths[] = { 1, 5, 16, 37, 64, 100 };
+    for (int w : widths) {
+        for (int h = 1; h <= 6; ++h) {
+            Image a (w, h, 3, Image::Image_U8);
+            Image b (w, h, 3, Image::Image_U8);
+            fill (a);
+            fill (b);
+            b.flipVertically ();
+            check_flipped (a, b);
+            b.flipVertically ();
+            BOOST_REQUIRE (memcmp ((const U8*) a, (const U8*) b, w * h * 3) == 0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (image_flip_float)
+{
+    Image a (13, 7, 3, Image::Image_F32);
+    Image b (13, 7, 3, Image::Image_F32);
+    fill (a);
+    fill (b);
+    b.flipVertically ();
+    check_flipped (a, b);
+}
+
+BOOST_AUTO_TEST_CASE (image_flip_on_load_binary_pnm)
+{
+    const char* headers[] = { "P5\n7 5\n255\n", "P6\n7 5\n255\n" };
+    int sizes[] = { 7 * 5, 7 * 5 * 3 };
+    for (int k = 0; k < 2; ++k) {
+        std::vector<U8> data (headers[k], headers[k] + strlen (headers[k]));
+        for (int i = 0; i < sizes[k]; ++i) data.push_back ((U8) (i * 13 + 1));
+        const char* path = k == 0 ? "flip.pgm" : "flip.ppm";
+        write_file (path, data);
+
+        Image a, b;
+        Image::from_file (path, a);
+        Image::from_file (path, b, true);
+        remove (path);
+        check_flipped (a, b);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (image_flip_on_load_stb)
+{
+    // An uncompressed 24-bit TGA, stored bottom row first.
+    int w = 9, h = 4;
+    U8 header[18] = { 0, 0, 2, 0,0,0,0,0, 0,0,0,0, (U8) w, 0, (U8) h, 0, 24, 0 };
+    std::vector<U8> data (header, header + 18);
+    for (int i = 0; i < w * h * 3; ++i) data.push_back ((U8) (i * 7 + 3));
+
+    Image a, b;
+    Image::from_mem (&data[0], data.size(), a);
+    Image::from_mem (&data[0], data.size(), b, true);
+    check_flipped (a, b);
+
+    write_file ("flip.tga", data);
+    Image c;
+    Image::from_file ("flip.tga", c, true);
+    remove ("flip.tga");
+    BOOST_CHECK (memcmp ((const U8*) b, (const U8*) c, w * h * 3) == 0);
+}
+
+// Write a pnm file from a header and raw bytes.
+void write_pnm (const char* path, const char* header, const std::vector<U8>& pixels)
+{
+    std::vector<U8> data (header, header + strlen (header));
+    data.insert (data.end(), pixels.begin(), pixels.end());
+    write_file (path, data);
+}
+
+BOOST_AUTO_TEST_CASE (image_read_ascii_pnm)
+{
+    const char* pgm = "P2\n# A comment\n3 2\n# Another\n15\n0 15 7\n\n 1   2\t3";
+    Image a;
+    Image::from_mem ((const U8*) pgm, strlen (pgm), a);
+    BOOST_REQUIRE_EQUAL (a.width (), 3);
+    BOOST_REQUIRE_EQUAL (a.height (), 2);
+    BOOST_REQUIRE_EQUAL (a.numComponents (), 1);
+    U8 expected[] = { 0, 255, 119, 17, 34, 51 };
+    for (int i = 0; i < 6; ++i) BOOST_CHECK_EQUAL (a.ith<U8>(i), expected[i]);
+
+    const char* ppm = "P3 2 1 255 1 2 3 250 251 252\n";
+    Image b;
+    Image::from_mem ((const U8*) ppm, strlen (ppm), b, true);
+    BOOST_REQUIRE_EQUAL (b.numComponents (), 3);
+    U8 rgb[] = { 1, 2, 3, 250, 251, 252 };
+    for (int i = 0; i < 6; ++i) BOOST_CHECK_EQUAL (b.ith<U8>(i), rgb[i]);
+
+    // Truncated pixel data and junk used to hang or read garbage.
+    const char* bad[] = { "P2\n3 2\n255\n0 1 2 3 4", "P2\n3 2\n255\n0 1 x 3 4 5", "P3\n1 1\n", "P7\n1 1\n255\n" };
+    for (const char* s : bad) {
+        Image c;
+        BOOST_CHECK_THROW (Image::from_mem ((const U8*) s, strlen (s), c), std::exception);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (image_read_binary_pnm)
+{
+    // Pixel data starting with whitespace bytes.
+    std::vector<U8> pixels;
+    for (int i = 0; i < 4 * 3; ++i) pixels.push_back (i == 0 ? 10 : i == 1 ? 32 : (U8) (i * 20));
+    write_pnm ("space.pgm", "P5 4 3 255\n", pixels);
+    Image a;
+    Image::from_file ("space.pgm", a);
+    remove ("space.pgm");
+    BOOST_CHECK (memcmp ((const U8*) a, &pixels[0], pixels.size()) == 0);
+
+    // 16-bit samples are scaled down to 8 bits.
+    U8 wide[] = { 0x00, 0x00, 0x80, 0x00, 0xFF, 0xFF };
+    write_pnm ("wide.pgm", "P5\n3 1\n65535\n", std::vector<U8> (wide, wide + 6));
+    Image b;
+    Image::from_file ("wide.pgm", b);
+    remove ("wide.pgm");
+    BOOST_CHECK_EQUAL (b.ith<U8>(0), 0);
+    BOOST_CHECK_EQUAL (b.ith<U8>(1), 128);
+    BOOST_CHECK_EQUAL (b.ith<U8>(2), 255);
+
+    write_pnm ("short.ppm", "P6\n4 4\n255\n", pixels);
+    Image c;
+    BOOST_CHECK_THROW (Image::from_file ("short.ppm", c), std::exception);
+    remove ("short.ppm");
+}
+
+BOOST_AUTO_TEST_CASE (image_map_file)
+{
+    std::vector<U8> pixels;
+    for (int i = 0; i < 5 * 4 * 3; ++i) pixels.push_back ((U8) (i * 7));
+    write_pnm ("map.ppm", "P6\n5 4\n255\n", pixels);
+
+    Image a;
+    Image::map_file ("map.ppm", a);
+    BOOST_CHECK (a.mapped ());
+    BOOST_CHECK_EQUAL (a.width (), 5);
+    BOOST_CHECK_EQUAL (a.height (), 4);
+    BOOST_CHECK_EQUAL (a.dataType (), Image::Image_U8);
+    BOOST_CHECK (memcmp ((const U8*) a, &pixels[0], pixels.size()) == 0);
+
+    // Writes stay private to the image.
+    a.flipVertically ();
+    Image b;
+    Image::from_file ("map.ppm", b);
+    BOOST_CHECK (memcmp ((const U8*) b, &pixels[0], pixels.size()) == 0);
+    check_flipped (a, b);
+    remove ("map.ppm");
+
+    // Samples that need scaling are copied.
+    write_pnm ("map.pgm", "P5\n5 4\n127\n", pixels);
+    Image c;
+    Image::map_file ("map.pgm", c);
+    remove ("map.pgm");
+    BOOST_CHECK (!c.mapped ());
+    BOOST_CHECK_EQUAL (c.ith<U8>(2), 28);
+}
+
+BOOST_AUTO_TEST_CASE (image_map_pfm)
+{
+    // Little-endian machines read files with a negative scale as they are.
+    const U16 one = 1;
+    const char* header = *(const U8*) &one ? "Pf\n3 2\n-1.00000\n" : "Pf\n3 2\n1.000000\n";
+    BOOST_REQUIRE_EQUAL (strlen (header) % 4, 0u);
+    float values[] = { 0.0f, 0.5f, 1.0f, 2.5f, -3.0f, 1e6f };
+    write_pnm ("map.pfm", header, std::vector<U8> ((U8*) values, (U8*) (values + 6)));
+
+    // pfm rows are stored bottom first, so only a flipped image is mapped.
+    Image a;
+    Image::map_file ("map.pfm", a, true);
+    BOOST_CHECK (a.mapped ());
+    BOOST_CHECK_EQUAL (a.dataType (), Image::Image_F32);
+    BOOST_CHECK_EQUAL (a.dataSize (), 4);
+    BOOST_CHECK (memcmp ((const U8*) a, values, sizeof(values)) == 0);
+
+    Image b;
+    Image::map_file ("map.pfm", b);
+    remove ("map.pfm");
+    BOOST_CHECK (!b.mapped ());
+    BOOST_CHECK_EQUAL (b.dataType (), Image::Image_F32);
+    check_flipped (a, b);
+}
+
+BOOST_AUTO_TEST_CASE (image_read_pfm_byte_orders)
+{
+    // An RGB pfm in both byte orders, with a scale of 2.
+    int w = 7, h = 3, n = w * h * 3;
+    std::vector<float> values;
+    for (int i = 0; i < n; ++i) values.push_back (0.25f * i - 3.0f);
+    for (int big = 0; big < 2; ++big) {
+        std::vector<U8> pixels;
+        for (float v : values) {
+            U32 bits;
+            memcpy (&bits, &v, 4);
+            for (int k = 0; k < 4; ++k) pixels.push_back ((U8) (bits >> (big ? 24 - 8*k : 8*k)));
+        }
+        write_pnm ("order.pfm", big ? "PF\n7 3\n2.0\n" : "PF\n7 3\n-2.0\n", pixels);
+        Image a;
+        Image::from_file ("order.pfm", a, true);
+        remove ("order.pfm");
+        BOOST_REQUIRE_EQUAL (a.numComponents (), 3);
+        BOOST_REQUIRE_EQUAL (a.dataType (), Image::Image_F32);
+        for (int i = 0; i < n; ++i) BOOST_REQUIRE_EQUAL (a.ith<float>(i), 2.0f * values[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (image_write_read_back)
+{
+    Image rgba (37, 5, 4, Image::Image_U8);
+    fill (rgba);
+
+    write_ppm (rgba, "out.ppm");
+    write_pgm (rgba, "out.pgm");
+    write_tga (rgba, "out.tga");
+    Image ppm, pgm, tga;
+    Image::from_file ("out.ppm", ppm);
+    Image::from_file ("out.pgm", pgm);
+    Image::from_file ("out.tga", tga);
+    remove ("out.ppm");
+    remove ("out.pgm");
+    remove ("out.tga");
+
+    BOOST_REQUIRE_EQUAL (ppm.numComponents (), 3);
+    BOOST_REQUIRE_EQUAL (pgm.numComponents (), 1);
+    BOOST_REQUIRE_EQUAL (tga.numComponents (), 4);
+    for (int i = 0; i < 37 * 5; ++i) {
+        for (int k = 0; k < 3; ++k) BOOST_REQUIRE_EQUAL (ppm.ith<U8>(3*i + k), rgba.ith<U8>(4*i + k));
+        for (int k = 0; k < 4; ++k) BOOST_REQUIRE_EQUAL (tga.ith<U8>(4*i + k), rgba.ith<U8>(4*i + k));
+        BOOST_REQUIRE_EQUAL (pgm.ith<U8>(i), rgba.ith<U8>(4*i));
+    }
+
+    write_pfm (rgba, "out.pfm");
+    Image pfm;
+    Image::from_file ("out.pfm", pfm);
+    remove ("out.pfm");
+    BOOST_REQUIRE_EQUAL (pfm.numComponents (), 3);
+    BOOST_REQUIRE_EQUAL (pfm.dataType (), Image::Image_F32);
+    for (int i = 0; i < 37 * 5; ++i) {
+        for (int k = 0; k < 3; ++k) BOOST_REQUIRE_EQUAL (pfm.ith<float>(3*i + k), rgba.ith<U8>(4*i + k) / 255.0f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (image_write_clamps_floats)
+{
+    // Enough pixels for the vectorised path and a scalar tail.
+    int w = 23;
+    Image image (w, 1, 3, Image::Image_F32);
+    for (int i = 0; i < w * 3; ++i) image.ith<float>(i) = (i % 5 - 1) * 0.5f; // -0.5 .. 1.5
+    image.ith<float>(4) = std::numeric_limits<float>::quiet_NaN ();
+    image.ith<float>(w * 3 - 1) = std::numeric_limits<float>::quiet_NaN ();
+    write_ppm (image, "clamp.ppm");
+    Image read;
+    Image::from_file ("clamp.ppm", read);
+    remove ("clamp.ppm");
+    for (int i = 0; i < w * 3; ++i) {
+        float v = image.ith<float>(i);
+        int expected = v != v || v <= 0.0f ? 0 : v >= 1.0f ? 255 : 128;
+        BOOST_REQUIRE_EQUAL (read.ith<U8>(i), expected);
+    }
+}
+
+// Decode failures on other threads must not change the reported reason.
+BOOST_AUTO_TEST_CASE (image_errors_per_thread)
+{
+    const U8 garbage[64] = { 'x' };
+    const U8 jpeg[] = { 0xFF, 0xD8, 0xFF, 0xC0, 0, 4, 1, 2 };
+    bool wrong[2] = { false, false };
+    auto decode = [&] (int k) {
+        Image img;
+        for (int i = 0; i < 2000; ++i) {
+            try {
+                if (k == 0) Image::from_mem (garbage, sizeof(garbage), img);
+                else Image::from_mem (jpeg, sizeof(jpeg), img);
+            }
+            catch (const std::exception& e) {
+                std::string what = e.what ();
+                if (what.find (k == 0 ? "unknown image type" : "bad SOF len") == std::string::npos) wrong[k] = true;
+            }
+        }
+    };
+    std::thread other (decode, 1);
+    decode (0);
+    other.join ();
+    BOOST_CHECK (!wrong[0]);
+    BOOST_CHECK (!wrong[1]);
+}
+
+BOOST_AUTO_TEST_CASE (image_write_bad_path)
+{
+    Image image (2, 2, 3, Image::Image_U8);
+    fill (image);
+    BOOST_CHECK_THROW (write_ppm (image, "no/such/dir/out.ppm"), std::exception);
+    Image gray (2, 2, 1, Image::Image_U8);
+    BOOST_CHECK_THROW (write_ppm (gray, "gray.ppm"), std::exception);
+
+    // TGA headers hold 16-bit sizes; larger images are not truncated.
+    Image wide (65536, 1, 1, Image::Image_U8);
+    BOOST_CHECK_THROW (write_tga (wide, "wide.tga"), std::exception);
+    BOOST_CHECK (fopen ("wide.tga", "rb") == nullptr);
+    Image widest (65535, 1, 1, Image::Image_U8);
+    write_tga (widest, "wide.tga");
+    Image read;
+    Image::from_file ("wide.tga", read);
+    remove ("wide.tga");
+    BOOST_CHECK_EQUAL (read.width (), 65535);
+}
+
+BOOST_AUTO_TEST_CASE (image_typed_addressing)
+{
+    Image image (5, 3, 3, Image::Image_U8);
+    fill (image);
+    TImage<U8,3> rgb = image.coerce<U8,3>();
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 5; ++col) {
+            int i = (row * 5 + col) * 3;
+            BOOST_CHECK_EQUAL (rgb(row,col), image.ith<U8>(i));
+            BOOST_CHECK_EQUAL (rgb.g(row,col), image.ith<U8>(i+1));
+            BOOST_CHECK_EQUAL (rgb.b(row,col), image.ith<U8>(i+2));
+            BOOST_CHECK_EQUAL (image.elem<U8>(row,col), image.ith<U8>(i));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (image_view_addressing)
+{
+    Image atlas (16, 8, 4, Image::Image_U8);
+    fill (atlas);
+    ImageView tile = atlas.view (3, 2, 5, 4);
+    BOOST_CHECK_EQUAL (tile.width(), 5);
+    BOOST_CHECK_EQUAL (tile.height(), 4);
+    BOOST_CHECK_EQUAL (tile.stride(), 16 * 4);
+    BOOST_CHECK (!tile.contiguous());
+    TImage<U8,4> whole = atlas.coerce<U8,4>();
+    TImage<U8,4> part = tile.coerce<U8,4>();
+    for (int row = 0; row < 4; ++row) {
+        for (int col = 0; col < 5; ++col) {
+            BOOST_CHECK_EQUAL (part.a(row,col), whole.a(row+2,col+3));
+            BOOST_CHECK_EQUAL (tile.pixel<U8>(row,col), &whole.r(row+2,col+3));
+        }
+    }
+    ImageView inner = tile.sub (1, 1, 2, 2);
+    BOOST_CHECK_EQUAL (inner.row(0), &whole.r(3,4));
+    BOOST_CHECK (atlas.view().contiguous());
+
+    BOOST_CHECK_THROW (atlas.view (12, 0, 5, 1), std::exception);
+    BOOST_CHECK_THROW (tile.sub (0, 0, 5, 5), std::exception);
+    BOOST_CHECK_THROW (tile.sub (-1, 0, 1, 1), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE (image_view_copy)
+{
+    Image tile (4, 3, 2, Image::Image_F32);
+    for (int i = 0; i < 4 * 3 * 2; ++i) tile.ith<float>(i) = i * 0.5f;
+    Image atlas (10, 10, 2, Image::Image_F32);
+    memset (atlas.view().row(0), 0, 10 * 10 * 2 * sizeof(float));
+    tile.view().copyTo (atlas.view (6, 7, 4, 3));
+    for (int row = 0; row < 10; ++row) {
+        for (int col = 0; col < 10; ++col) {
+            bool inside = row >= 7 && col >= 6;
+            for (int k = 0; k < 2; ++k) {
+                float want = inside ? tile.ith<float>(((row-7) * 4 + col-6) * 2 + k) : 0.0f;
+                BOOST_CHECK_EQUAL (atlas.ith<float>((row * 10 + col) * 2 + k), want);
+            }
+        }
+    }
+    BOOST_CHECK_THROW (tile.view().copyTo (atlas.view (0, 0, 3, 3)), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE (image_view_iteration)
+{
+    Image image (8, 6, 3, Image::Image_U8);
+    int spans = 0;
+    size_t bytes = 0;
+    image.view().forEachSpan ([&] (const U8*, size_t n) { spans++; bytes += n; });
+    BOOST_CHECK_EQUAL (spans, 1);
+    BOOST_CHECK_EQUAL (bytes, 8 * 6 * 3);
+
+    ImageView part = image.view (2, 1, 4, 3);
+    spans = 0;
+    bytes = 0;
+    part.forEachSpan ([&] (const U8* p, size_t n) {
+        BOOST_CHECK_EQUAL (p, part.row (spans));
+        spans++;
+        bytes += n;
+    });
+    BOOST_CHECK_EQUAL (spans, 3);
+    BOOST_CHECK_EQUAL (bytes, 4 * 3 * 3);
+
+    int rows = 0;
+    part.forEachRow ([&] (const U8* p, int y) {
+        BOOST_CHECK_EQUAL (p, part.row (y));
+        rows++;
+    });
+    BOOST_CHECK_EQUAL (rows, 3);
+}
+
+BOOST_AUTO_TEST_CASE (image_view_kernels)
+{
+    // Kernels given a view's rows and stride leave the rest of the image alone.
+    Image image (9, 5, 4, Image::Image_U8);
+    fill (image);
+    Image before (9, 5, 4, Image::Image_U8);
+    image.view().copyTo (before.view());
+    ImageView tile = image.view (2, 1, 5, 3);
+    premultiply_alpha (tile.row(0), tile.stride(), tile.width(), tile.height());
+    TImage<U8,4> a = image.coerce<U8,4>();
+    TImage<U8,4> b = before.coerce<U8,4>();
+    for (int row = 0; row < 5; ++row) {
+        for (int col = 0; col < 9; ++col) {
+            bool inside = row >= 1 && row < 4 && col >= 2 && col < 7;
+            int want = inside ? (b.r(row,col) * b.a(row,col) + 127) / 255 : b.r(row,col);
+            BOOST_CHECK_EQUAL (a.r(row,col), want);
+            BOOST_CHECK_EQUAL (a.a(row,col), b.a(row,col));
+        }
+    }
+}
+
+// Counts what it hands out, to check that every buffer comes back.
+struct CountingAllocator : public ImageAllocator
+{
+    int blocks;
+    size_t bytes;
+
+    CountingAllocator () : blocks (0), bytes (0) {}
+
+    void* allocate (size_t size) {
+        blocks++;
+        bytes += size;
+        return malloc (size);
+    }
+
+    void deallocate (void* block, size_t size) {
+        blocks--;
+        bytes -= size;
+        free (block);
+    }
+};
+
+BOOST_AUTO_TEST_CASE (image_allocator_hook)
+{
+    Image rgba (40, 30, 4, Image::Image_U8);
+    fill (rgba);
+    write_tga (rgba, "alloc.tga");
+    write_ppm (rgba, "alloc.ppm");
+
+    CountingAllocator counter;
+    Image::setAllocator (&counter);
+    BOOST_CHECK (Image::allocator() == &counter);
+    {
+        Image made (16, 16, 3, Image::Image_U8);
+        Image tga, ppm;
+        Image::from_file ("alloc.tga", tga, true); // Decoded by stb_image.
+        Image::from_file ("alloc.ppm", ppm);
+        BOOST_CHECK_EQUAL (counter.blocks, 3);
+        BOOST_CHECK_GE (counter.bytes, (size_t) 16 * 16 * 3 + 40 * 30 * 4 + 40 * 30 * 3);
+
+        // Buffers go back to the allocator they came from.
+        Image::setAllocator (nullptr);
+        Image plain (8, 8, 1, Image::Image_U8);
+        BOOST_CHECK_EQUAL (counter.blocks, 3);
+        check_flipped (rgba, tga);
+    }
+    BOOST_CHECK_EQUAL (counter.blocks, 0);
+    BOOST_CHECK_EQUAL (counter.bytes, 0u);
+    remove ("alloc.tga");
+    remove ("alloc.ppm");
+}
+
+BOOST_AUTO_TEST_CASE (image_pool_reuse)
+{
+    ImagePool pool (1 << 20, 1024);
+    Image::setAllocator (&pool);
+    const U8* first;
+    {
+        Image a (60, 64, 4, Image::Image_U8);
+        first = a;
+    }
+    BOOST_CHECK_EQUAL (pool.misses(), 1u);
+    BOOST_CHECK_GE (pool.cachedBytes(), (size_t) 60 * 64 * 4);
+    {
+        // Sizes within the same class share buffers.
+        Image b (64, 63, 4, Image::Image_U8);
+        BOOST_CHECK ((const U8*) b == first);
+        BOOST_CHECK_EQUAL (pool.hits(), 1u);
+        BOOST_CHECK_EQUAL (pool.cachedBytes(), 0u);
+        Image c (64, 64, 4, Image::Image_U8);
+        BOOST_CHECK_EQUAL (pool.misses(), 2u);
+    }
+    {
+        // Small blocks and blocks beyond the cache limit are not kept.
+        Image small (4, 4, 4, Image::Image_U8);
+        Image big (1024, 1024, 4, Image::Image_U8);
+    }
+    BOOST_CHECK_LE (pool.cachedBytes(), (size_t) 1 << 20);
+    pool.trim ();
+    BOOST_CHECK_EQUAL (pool.cachedBytes(), 0u);
+    Image::setAllocator (nullptr);
+}
@@ -0,0 +1,175 @@
+#define BOOST_TEST_MODULE ImageOps
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <OGDT/image_ops.h>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+// The kernels are checked against plain per-pixel code on widths around
+// the vectorised steps, with padded strides.
+
+using namespace OGDT;
+
+const int widths[] = { 1, 3, 4, 5, 7, 8, 15, 16, 17, 33 };
+const int height = 3;
+const int pad = 12; // Extra bytes per row.
+
+std::vector<U8> random_bytes (size_t n)
+{
+    std::vector<U8> v (n);
+    for (size_t i = 0; i < n; ++i) v[i] = rand() % 256;
+    return v;
+}
+
+BOOST_AUTO_TEST_CASE (ops_rgb_to_rgba)
+{
+    for (int w : widths) {
+        size_t ss = 3*w + pad, ds = 4*w + pad;
+        std::vector<U8> src = random_bytes (ss * height);
+        std::vector<U8> dst (ds * height, 7);
+        rgb_to_rgba (&src[0], ss, &dst[0], ds, w, height, 200);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < w; ++x) {
+                for (int k = 0; k < 3; ++k) BOOST_REQUIRE_EQUAL (dst[y*ds + 4*x + k], src[y*ss + 3*x + k]);
+                BOOST_REQUIRE_EQUAL (dst[y*ds + 4*x + 3], 200);
+            }
+            for (int i = 4*w; i < (int) ds; ++i) BOOST_REQUIRE_EQUAL (dst[y*ds + i], 7); // Padding untouched.
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (ops_u8_f32_roundtrip)
+{
+    for (int w : widths) {
+        size_t ss = 3*w + pad, fs = 3*w*sizeof(float) + pad;
+        std::vector<U8> src = random_bytes (ss * height);
+        std::vector<U8> f (fs * height);
+        std::vector<U8> back (ss * height);
+        u8_to_f32 (&src[0], ss, (float*) &f[0], fs, w, height, 3);
+        f32_to_u8 ((const float*) &f[0], fs, &back[0], ss, w, height, 3);
+        for (int y = 0; y < height; ++y) {
+            const float* row = (const float*) &f[y*fs];
+            for (int i = 0; i < 3*w; ++i) {
+                BOOST_REQUIRE_EQUAL (row[i], src[y*ss + i] / 255.0f);
+                BOOST_REQUIRE_EQUAL (back[y*ss + i], src[y*ss + i]);
+            }
+        }
+    }
+
+    float odd[] = { -1.0f, 2.0f, std::numeric_limits<float>::quiet_NaN (), 0.5f };
+    U8 out[4];
+    f32_to_u8 (odd, 0, out, 0, 4, 1, 1);
+    BOOST_CHECK_EQUAL (out[0], 0);
+    BOOST_CHECK_EQUAL (out[1], 255);
+    BOOST_CHECK_EQUAL (out[2], 0);
+    BOOST_CHECK_EQUAL (out[3], 128);
+}
+
+BOOST_AUTO_TEST_CASE (ops_premultiply_alpha)
+{
+    for (int w : widths) {
+        size_t s = 4*w + pad;
+        std::vector<U8> src = random_bytes (s * height);
+        std::vector<U8> p = src;
+        premultiply_alpha (&p[0], s, w, height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < w; ++x) {
+                const U8* a = &src[y*s + 4*x];
+                const U8* b = &p[y*s + 4*x];
+                for (int k = 0; k < 3; ++k) {
+                    BOOST_REQUIRE_EQUAL (b[k], (int) floor (a[k] * a[3] / 255.0 + 0.5));
+                }
+                BOOST_REQUIRE_EQUAL (b[3], a[3]);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (ops_swizzle)
+{
+    const int orders[][4] = { {2,1,0,3}, {3,2,1,0}, {0,0,0,3}, {1,2,3,0} };
+    for (const int* order : orders) {
+        for (int w : widths) {
+            size_t s = 4*w + pad;
+            std::vector<U8> src = random_bytes (s * height);
+            std::vector<U8> dst (s * height);
+            swizzle (&src[0], s, &dst[0], s, w, height, order);
+            std::vector<U8> in_place = src;
+            swizzle (&in_place[0], s, &in_place[0], s, w, height, order);
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    for (int k = 0; k < 4; ++k) {
+                        U8 expected = src[y*s + 4*x + order[k]];
+                        BOOST_REQUIRE_EQUAL (dst[y*s + 4*x + k], expected);
+                        BOOST_REQUIRE_EQUAL (in_place[y*s + 4*x + k], expected);
+                    }
+                }
+            }
+        }
+    }
+}
+
+double srgb_encode (double v)
+{
+    return v <= 0.0031308 ? 12.92 * v : 1.055 * pow (v, 1.0 / 2.4) - 0.055;
+}
+
+BOOST_AUTO_TEST_CASE (ops_srgb)
+{
+    // Every code decodes and encodes back to itself.
+    U8 codes[256];
+    for (int i = 0; i < 256; ++i) codes[i] = i;
+    float linear[256];
+    U8 back[256];
+    srgb_to_linear (codes, 0, linear, 0, 256, 1, 1);
+    linear_to_srgb (linear, 0, back, 0, 256, 1, 1);
+    for (int i = 0; i < 256; ++i) {
+        BOOST_REQUIRE_EQUAL (back[i], i);
+        BOOST_REQUIRE_CLOSE (srgb_encode (linear[i]) * 255.0, (double) i, 1e-3);
+    }
+
+    // Arbitrary values round to the nearest code.
+    const int n = 10000;
+    std::vector<float> v (n);
+    std::vector<U8> c (n);
+    for (int i = 0; i < n; ++i) v[i] = (float) i / (n - 1);
+    linear_to_srgb (&v[0], 0, &c[0], 0, n, 1, 1);
+    for (int i = 0; i < n; ++i) {
+        BOOST_REQUIRE_LE (fabs (c[i] - srgb_encode (v[i]) * 255.0), 0.5 + 1e-3);
+    }
+
+    // Alpha stays linear.
+    U8 rgba[4] = { 128, 128, 128, 128 };
+    float f[4];
+    srgb_to_linear (rgba, 0, f, 0, 1, 1, 4);
+    BOOST_CHECK_LT (f[0], 0.25f);
+    BOOST_CHECK_EQUAL (f[3], 128 / 255.0f);
+}
+
+BOOST_AUTO_TEST_CASE (ops_downscale2)
+{
+    for (int c = 1; c <= 4; ++c) {
+        for (int w : widths) {
+            for (int h = 1; h <= 5; ++h) {
+                int dw = std::max (1, w / 2), dh = std::max (1, h / 2);
+                size_t ss = w*c + pad, ds = dw*c + pad;
+                std::vector<U8> src = random_bytes (ss * h);
+                std::vector<U8> dst (ds * dh);
+                downscale2 (&src[0], ss, &dst[0], ds, w, h, c);
+                for (int y = 0; y < dh; ++y) {
+                    int y0 = std::min (2*y, h-1), y1 = std::min (2*y + 1, h-1);
+                    for (int x = 0; x < dw; ++x) {
+                        int x0 = std::min (2*x, w-1), x1 = std::min (2*x + 1, w-1);
+                        for (int k = 0; k < c; ++k) {
+                            int sum = src[y0*ss + x0*c + k] + src[y0*ss + x1*c + k]
+                                    + src[y1*ss + x0*c + k] + src[y1*ss + x1*c + k];
+                            BOOST_REQUIRE_EQUAL (dst[y*ds + x*c + k], (sum + 2) / 4);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
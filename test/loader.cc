@@ -0,0 +1,103 @@
+#define BOOST_TEST_MODULE Loader
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include "md2_synth.h"
+#include <OGDT/Loader.h>
+#include <OGDT/model.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// MD2 models and failed requests never reach OpenGL, so these run without a
+// context.
+
+using namespace OGDT;
+
+std::vector<char> read_file (const char* path)
+{
+    FILE* f = fopen (path, "rb");
+    std::vector<char> data;
+    char buf[4096];
+    size_t n;
+    while ((n = fread (buf, 1, sizeof(buf), f)) > 0) data.insert (data.end(), buf, buf + n);
+    fclose (f);
+    return data;
+}
+
+void write_file (const char* path, const std::vector<char>& data)
+{
+    FILE* f = fopen (path, "wb");
+    if (!data.empty()) fwrite (&data[0], 1, data.size(), f);
+    fclose (f);
+}
+
+// Write broken copies of a valid model: cut short at various points, with a
+// bad magic number, and with a triangle indexing a missing vertex.
+std::vector<std::string> write_bad_md2s ()
+{
+    write_md2 ("good.md2", 20, 50, 40);
+    std::vector<char> good = read_file ("good.md2");
+    remove ("good.md2");
+    std::vector<std::string> paths;
+    size_t cuts[] = { 0, 10, sizeof(md2_header), sizeof(md2_header) + 100, good.size() / 2, good.size() - 1 };
+    for (size_t cut : cuts) {
+        char name[64];
+        sprintf (name, "cut_%u.md2", (unsigned) cut);
+        write_file (name, std::vector<char> (good.begin(), good.begin() + cut));
+        paths.push_back (name);
+    }
+    std::vector<char> bad = good;
+    bad[0] = 'X';
+    write_file ("magic.md2", bad);
+    paths.push_back ("magic.md2");
+    bad = good;
+    md2_header h;
+    memcpy (&h, &good[0], sizeof(h));
+    unsigned short index = 50;
+    memcpy (&bad[h.offsetTriangles], &index, 2);
+    write_file ("index.md2", bad);
+    paths.push_back ("index.md2");
+    return paths;
+}
+
+BOOST_AUTO_TEST_CASE (model_rejects_bad_md2)
+{
+    BOOST_CHECK_THROW (Model ("no-such.md2"), std::exception);
+    std::vector<std::string> paths = write_bad_md2s ();
+    for (const std::string& path : paths) {
+        BOOST_TEST_MESSAGE (path);
+        BOOST_CHECK_THROW (Model (path.c_str()), std::exception);
+        remove (path.c_str());
+    }
+}
+
+BOOST_AUTO_TEST_CASE (loader_reports_failures)
+{
+    write_md2 ("loader.md2", 40, 100, 80);
+    std::vector<std::string> paths = write_bad_md2s ();
+    paths.push_back ("no-such.md2");
+
+    Loader loader (2);
+    AsyncModel good = loader.loadModel ("loader.md2");
+    std::vector<AsyncModel> bad;
+    for (const std::string& path : paths) bad.push_back (loader.loadModel (path.c_str()));
+    AsyncTexture tex = loader.loadTexture ("no-such.png");
+    loader.finish ();
+    BOOST_CHECK_EQUAL (loader.numPending (), 0u);
+
+    BOOST_REQUIRE (good.isReady ());
+    std::unique_ptr<Model> model (good.get ());
+    BOOST_REQUIRE (model);
+    BOOST_CHECK (model->getAnimation ("animb"));
+    BOOST_CHECK (!good.get ()); // Already taken.
+
+    for (AsyncModel& m : bad) {
+        BOOST_REQUIRE (m.isReady ());
+        BOOST_CHECK_THROW (m.get (), std::exception);
+    }
+    BOOST_REQUIRE (tex.isReady ());
+    BOOST_CHECK_THROW (tex.get (), std::exception);
+
+    remove ("loader.md2");
+    for (const std::string& path : paths) remove (path.c_str());
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+// Writes synthetic MD2 files for tests and benchmarks.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct md2_header
+{
+    int magic, version, skinWidth, skinHeight, frameSize;
+    int numSkins, numVertices, numTexCoords, numTriangles, numGlCommands, numFrames;
+    int offsetSkins, offsetTexCoords, offsetTriangles, offsetFrames, offsetGlCommands, offsetEnd;
+};
+
+// Write a model with the given dimensions. Vertices drift a little from
+// frame to frame, and frames are grouped into animations of 20 frames each.
+inline void write_md2 (const char* path, int frames, int verts, int tris)
+{
+    md2_header h;
+    memset (&h, 0, sizeof(h));
+    h.magic = 0x32504449;
+    h.version = 8;
+    h.skinWidth = h.skinHeight = 256;
+    h.frameSize = 40 + 4 * verts;
+    h.numVertices = verts;
+    h.numTexCoords = verts;
+    h.numTriangles = tris;
+    h.numFrames = frames;
+    h.offsetSkins = sizeof(h);
+    h.offsetTexCoords = h.offsetSkins;
+    h.offsetTriangles = h.offsetTexCoords + 4 * verts;
+    h.offsetFrames = h.offsetTriangles + 12 * tris;
+    h.offsetGlCommands = h.offsetFrames + h.frameSize * frames;
+    h.offsetEnd = h.offsetGlCommands;
+
+    std::vector<char> buf (h.offsetEnd);
+    memcpy (&buf[0], &h, sizeof(h));
+
+    short* st = (short*) &buf[h.offsetTexCoords];
+    for (int i = 0; i < verts; ++i) {
+        st[2*i] = rand() % 256;
+        st[2*i+1] = rand() % 256;
+    }
+
+    unsigned short* t = (unsigned short*) &buf[h.offsetTriangles];
+    for (int i = 0; i < tris; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            unsigned short v = (i + j * 7 + rand() % 3) % verts;
+            t[6*i + j] = v;
+            t[6*i + 3 + j] = v;
+        }
+    }
+
+    for (int f = 0; f < frames; ++f) {
+        char* frame = &buf[h.offsetFrames + f * h.frameSize];
+        float scale[3] = { 0.1f, 0.1f, 0.1f };
+        float translate[3] = { -12.8f, -12.8f, -12.8f };
+        memcpy (frame, scale, 12);
+        memcpy (frame + 12, translate, 12);
+        snprintf (frame + 24, 16, "anim%c%02d", 'a' + (f / 20) % 26, f % 20);
+        unsigned char* v = (unsigned char*) frame + 40;
+        for (int i = 0; i < verts; ++i) {
+            v[4*i]   = (i * 37 + f) % 256;
+            v[4*i+1] = (i * 91 + 2*f) % 256;
+            v[4*i+2] = (i * 53 + 3*f) % 256;
+            v[4*i+3] = 0;
+        }
+    }
+
+    FILE* file = fopen (path, "wb");
+    fwrite (&buf[0], 1, buf.size(), file);
+    fclose (file);
+}
+
+// Write an n by n grid of vertices forming a rippling sheet in the xy plane,
+// a closer match to real meshes than the model above.
+inline void write_md2_grid (const char* path, int frames, int n)
+{
+    int verts = n * n;
+    int tris = 2 * (n-1) * (n-1);
+    md2_header h;
+    memset (&h, 0, sizeof(h));
+    h.magic = 0x32504449;
+    h.version = 8;
+    h.skinWidth = h.skinHeight = 256;
+    h.frameSize = 40 + 4 * verts;
+    h.numVertices = verts;
+    h.numTexCoords = verts;
+    h.numTriangles = tris;
+    h.numFrames = frames;
+    h.offsetSkins = sizeof(h);
+    h.offsetTexCoords = h.offsetSkins;
+    h.offsetTriangles = h.offsetTexCoords + 4 * verts;
+    h.offsetFrames = h.offsetTriangles + 12 * tris;
+    h.offsetGlCommands = h.offsetFrames + h.frameSize * frames;
+    h.offsetEnd = h.offsetGlCommands;
+
+    std::vector<char> buf (h.offsetEnd);
+    memcpy (&buf[0], &h, sizeof(h));
+
+    short* st = (short*) &buf[h.offsetTexCoords];
+    for (int i = 0; i < verts; ++i) {
+        st[2*i] = 255 * (i % n) / (n-1);
+        st[2*i+1] = 255 * (i / n) / (n-1);
+    }
+
+    unsigned short* t = (unsigned short*) &buf[h.offsetTriangles];
+    for (int y = 0; y < n-1; ++y) {
+        for (int x = 0; x < n-1; ++x) {
+            unsigned short v = y*n + x;
+            unsigned short q[6] = { v, (unsigned short) (v+1), (unsigned short) (v+n),
+                                    (unsigned short) (v+1), (unsigned short) (v+n+1), (unsigned short) (v+n) };
+            for (int k = 0; k < 2; ++k) {
+                memcpy (t, q + 3*k, 6);
+                memcpy (t + 3, q + 3*k, 6);
+                t += 6;
+            }
+        }
+    }
+
+    for (int f = 0; f < frames; ++f) {
+        char* frame = &buf[h.offsetFrames + f * h.frameSize];
+        float scale[3] = { 0.1f, 0.1f, 0.1f };
+        float translate[3] = { -12.8f, -12.8f, -12.8f };
+        memcpy (frame, scale, 12);
+        memcpy (frame + 12, translate, 12);
+        snprintf (frame + 24, 16, "anim%c%02d", 'a' + (f / 20) % 26, f % 20);
+        unsigned char* v = (unsigned char*) frame + 40;
+        for (int i = 0; i < verts; ++i) {
+            int x = i % n, y = i / n;
+            v[4*i]   = 255 * x / (n-1);
+            v[4*i+1] = 255 * y / (n-1);
+            v[4*i+2] = 128 + (int) (60.0 * sin (0.4 * x + 0.1 * f) * cos (0.3 * y));
+            v[4*i+3] = 0;
+        }
+    }
+
+    FILE* file = fopen (path, "wb");
+    fwrite (&buf[0], 1, buf.size(), file);
+    fclose (file);
+}
@@ -0,0 +1,112 @@
+#define BOOST_TEST_MODULE MipChain
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <OGDT/MipChain.h>
+#include <OGDT/Image.h>
+#include <cstdlib>
+
+using namespace OGDT;
+
+void fill_random (Image& image)
+{
+    int n = image.width() * image.height() * image.numComponents();
+    for (int i = 0; i < n; ++i) image.ith<U8>(i) = rand() % 256;
+}
+
+BOOST_AUTO_TEST_CASE (mipchain_level_sizes)
+{
+    Image image (37, 8, 3, Image::Image_U8);
+    fill_random (image);
+    MipChain mips (image);
+    int sizes[][2] = { {37,8}, {18,4}, {9,2}, {4,1}, {2,1}, {1,1} };
+    BOOST_REQUIRE_EQUAL (mips.numLevels (), 6u);
+    for (unsigned i = 0; i < 6; ++i) {
+        BOOST_CHECK_EQUAL (mips.level(i).width (), sizes[i][0]);
+        BOOST_CHECK_EQUAL (mips.level(i).height (), sizes[i][1]);
+    }
+    BOOST_CHECK (&mips.level(0) == &image);
+}
+
+// The vectorised paths must match a plain 2x2 average.
+BOOST_AUTO_TEST_CASE (mipchain_box_matches_reference)
+{
+    int components[] = { 1, 2, 3, 4 };
+    for (int c : components) {
+        Image image (70, 45, c, Image::Image_U8);
+        fill_random (image);
+        MipChain mips (image);
+        const Image& src = mips.level(0);
+        const Image& dst = mips.level(1);
+        for (int y = 0; y < dst.height(); ++y) {
+            for (int x = 0; x < dst.width(); ++x) {
+                for (int k = 0; k < c; ++k) {
+                    int sum = 0;
+                    for (int j = 0; j < 4; ++j) {
+                        int sx = 2*x + (j & 1), sy = 2*y + (j >> 1);
+                        sum += src.ith<U8>((sy * src.width() + sx) * c + k);
+                    }
+                    BOOST_REQUIRE_EQUAL ((int) dst.ith<U8>((y * dst.width() + x) * c + k), (sum + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (mipchain_kaiser_keeps_flat_images)
+{
+    Image image (64, 48, 4, Image::Image_U8);
+    for (int i = 0; i < 64 * 48 * 4; ++i) image.ith<U8>(i) = 10 * (i % 4) + 77;
+    MipChain mips (image, MipChain::Mip_Kaiser);
+    BOOST_REQUIRE_EQUAL (mips.numLevels (), 7u);
+    for (unsigned l = 1; l < mips.numLevels(); ++l) {
+        const Image& level = mips.level(l);
+        int n = level.width() * level.height() * 4;
+        for (int i = 0; i < n; ++i) BOOST_REQUIRE_EQUAL ((int) level.ith<U8>(i), 10 * (i % 4) + 77);
+    }
+}
+
+// On smooth images both filters agree away from the borders.
+BOOST_AUTO_TEST_CASE (mipchain_kaiser_follows_gradients)
+{
+    Image image (64, 64, 1, Image::Image_U8);
+    for (int y = 0; y < 64; ++y) {
+        for (int x = 0; x < 64; ++x) image.ith<U8>(y * 64 + x) = 2*x + y;
+    }
+    MipChain box (image);
+    MipChain kaiser (image, MipChain::Mip_Kaiser);
+    for (int y = 4; y < 28; ++y) {
+        for (int x = 4; x < 28; ++x) {
+            int i = y * 32 + x;
+            BOOST_REQUIRE_LE (std::abs (box.level(1).ith<U8>(i) - kaiser.level(1).ith<U8>(i)), 1);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (mipchain_float_images)
+{
+    // HDR values pass through unclamped, for 3 and 4 components.
+    for (int c = 3; c <= 4; ++c) {
+        Image image (6, 4, c, Image::Image_F32);
+        int n = 6 * 4 * c;
+        for (int i = 0; i < n; ++i) image.ith<float>(i) = 0.5f * i * i;
+        MipChain mips (image);
+        BOOST_REQUIRE_EQUAL (mips.numLevels (), 3u);
+        const Image& level = mips.level(1);
+        BOOST_CHECK_EQUAL (level.dataType (), Image::Image_F32);
+        for (int y = 0; y < 2; ++y) {
+            for (int x = 0; x < 3; ++x) {
+                for (int k = 0; k < c; ++k) {
+                    float sum = 0.0f;
+                    for (int j = 0; j < 4; ++j) {
+                        int sx = 2*x + j%2, sy = 2*y + j/2;
+                        sum += image.ith<float>((sy * 6 + sx) * c + k);
+                    }
+                    BOOST_CHECK_CLOSE (level.ith<float>((y * 3 + x) * c + k), 0.25f * sum, 1e-4);
+                }
+            }
+        }
+
+        MipChain kaiser (image, MipChain::Mip_Kaiser);
+        BOOST_CHECK_GT (kaiser.level(1).ith<float>(3 * c), 255.0f);
+    }
+}
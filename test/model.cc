@@ -0,0 +1,134 @@
+#define BOOST_TEST_MODULE Model
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include "md2_synth.h"
+#include <OGDT/model.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+// CPU-side model tests; nothing here needs an OpenGL context.
+
+using namespace OGDT;
+
+// Write a model with one animation of two frames per given name. MD2 frame
+// names are 16 bytes and only terminated when shorter.
+void write_md2_named (const char* path, const std::vector<std::string>& names)
+{
+    int frames = 2 * names.size();
+    write_md2 (path, frames, 10, 8);
+    FILE* f = fopen (path, "r+b");
+    md2_header h;
+    fread (&h, sizeof(h), 1, f);
+    for (int i = 0; i < frames; ++i) {
+        char name[16] = { 0 };
+        memcpy (name, names[i/2].c_str(), std::min (names[i/2].size(), (size_t) 16));
+        fseek (f, h.offsetFrames + i * h.frameSize + 24, SEEK_SET);
+        fwrite (name, 1, 16, f);
+    }
+    fclose (f);
+}
+
+// The linear search model_find_animation used before it was hashed.
+int linear_find (const std::vector<std::string>& names, const std::string& name)
+{
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (names[i].substr (0, 16) == name) return i;
+    }
+    return -1;
+}
+
+BOOST_AUTO_TEST_CASE (animation_lookup_matches_linear_search)
+{
+    // Letters only: digits and underscores end a name when frames are grouped.
+    srand (5);
+    std::vector<std::string> names;
+    names.push_back ("stand");
+    names.push_back ("run");
+    names.push_back ("abcdefghijklmnop"); // Fills all 16 bytes.
+    names.push_back ("abcdefghijklmno");  // Its 15-character prefix.
+    names.push_back ("walk");
+    names.push_back ("run");              // A duplicate; the first one wins.
+    for (int i = 0; i < 60; ++i) {
+        std::string s;
+        int n = 1 + rand() % 16;
+        for (int k = 0; k < n; ++k) s += (char) ('a' + rand() % 26);
+        names.push_back (s);
+    }
+    names.push_back ("walk");
+    write_md2_named ("names.md2", names);
+    Model model ("names.md2");
+    remove ("names.md2");
+
+    std::vector<std::string> queries = names;
+    queries.push_back ("");
+    queries.push_back ("ru");
+    queries.push_back ("runs");
+    queries.push_back ("abcdefghijklmnopq");
+    queries.push_back ("abcdefghijklmn");
+    queries.push_back ("nosuchanimation");
+    for (const std::string& q : queries) {
+        int expected = linear_find (names, q);
+        const Animation* anim = model.getAnimation (q.c_str());
+        BOOST_TEST_MESSAGE (q);
+        if (expected < 0) BOOST_CHECK (!anim);
+        else {
+            BOOST_REQUIRE (anim);
+            BOOST_CHECK_EQUAL (anim->id, (unsigned) expected);
+            BOOST_CHECK_EQUAL (anim->start, 2u * expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (instance_pool_simd_matches_scalar)
+{
+    write_md2 ("pool.md2", 60, 10, 8);
+    Model model ("pool.md2");
+    remove ("pool.md2");
+    const Animation* anims[] = { model.getAnimation ("anima"), model.getAnimation ("animb"),
+                                 model.getAnimation ("animc") };
+    for (const Animation* a : anims) BOOST_REQUIRE (a);
+
+    // Speeds include negative ones and, with the larger steps below, steps
+    // of many whole animations per update.
+    srand (7);
+    const unsigned n = 32;
+    InstancePool simd (model, n);
+    std::vector<std::unique_ptr<InstancePool>> scalar;
+    for (unsigned i = 0; i < n; ++i) {
+        const Animation& a = *anims[i % 3];
+        bool loop = i % 4 != 3;
+        float speed = (rand() % 2 ? 1 : -1) * (0.1f + (rand() % 1000) / 10.0f);
+        simd.add ();
+        simd.setAnimation (i, a, loop);
+        simd.setAnimationSpeed (i, speed);
+        // Pools of fewer than 4 instances take the scalar path only.
+        scalar.emplace_back (new InstancePool (model));
+        scalar[i]->add ();
+        scalar[i]->setAnimation (0, a, loop);
+        scalar[i]->setAnimationSpeed (0, speed);
+    }
+
+    float steps[] = { 0.016f, 0.1f, 1.0f, 7.3f, 123.4f, 0.0f, 1e5f };
+    for (int k = 0; k < 200; ++k) {
+        float dt = steps[k % 7];
+        simd.update (dt);
+        for (unsigned i = 0; i < n; ++i) {
+            scalar[i]->update (dt);
+            const FramePair& a = simd.frames()[i];
+            const FramePair& b = scalar[i]->frames()[0];
+            const Animation& anim = *anims[i % 3];
+            unsigned last = anim.start + (unsigned) anim.duration - 1;
+            BOOST_REQUIRE_EQUAL (a.frame1, b.frame1);
+            BOOST_REQUIRE_EQUAL (a.frame2, b.frame2);
+            BOOST_REQUIRE_EQUAL (a.p, b.p);
+            BOOST_REQUIRE_EQUAL (simd.isAnimationDone (i), scalar[i]->isAnimationDone (0));
+            BOOST_REQUIRE (a.frame1 >= anim.start && a.frame1 <= last);
+            BOOST_REQUIRE (a.frame2 >= anim.start && a.frame2 <= last);
+            BOOST_REQUIRE (a.p >= 0.0f && a.p < 1.0f);
+        }
+    }
+    // Animations that do not loop have run off one end or the other.
+    for (unsigned i = 3; i < n; i += 4) BOOST_CHECK (simd.isAnimationDone (i));
+}
@@ -0,0 +1,512 @@
+#define BOOST_TEST_MODULE Render
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include "md2_synth.h"
+#include <OGDT/Archive.h>
+#include <OGDT/CompressedImage.h>
+#include <OGDT/gl.h>
+#include <OGDT/gl_utils.h>
+#include <OGDT/Image.h>
+#include <OGDT/Loader.h>
+#include <OGDT/MipChain.h>
+#include <OGDT/model.h>
+#include <OGDT/vfs.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Renders offscreen through EGL, so it runs headless on Mesa's software
+// renderer: EGL_PLATFORM=surfaceless LIBGL_ALWAYS_SOFTWARE=1 ./render-test
+
+using namespace OGDT;
+
+const int W = 256;
+const int H = 256;
+
+EGLDisplay open_display ()
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress ("eglGetPlatformDisplayEXT");
+    BOOST_REQUIRE (get_display);
+    EGLDisplay d = get_display (EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    BOOST_REQUIRE (eglInitialize (d, NULL, NULL));
+    eglBindAPI (EGL_OPENGL_API);
+    return d;
+}
+
+EGLDisplay display ()
+{
+    static EGLDisplay d = open_display ();
+    return d;
+}
+
+EGLContext create_context ()
+{
+    EGLDisplay d = display ();
+    EGLint attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE };
+    EGLContext c = eglCreateContext (d, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+    BOOST_REQUIRE (c != EGL_NO_CONTEXT);
+    BOOST_REQUIRE (eglMakeCurrent (d, EGL_NO_SURFACE, EGL_NO_SURFACE, c));
+    glewExperimental = GL_TRUE;
+    glewInit ();
+    return c;
+}
+
+// Binds an offscreen framebuffer and sets up the projection and state the
+// tests draw with.
+void setup_framebuffer ()
+{
+    GLuint fbo, rb[2];
+    glGenFramebuffers (1, &fbo);
+    glGenRenderbuffers (2, rb);
+    glBindRenderbuffer (GL_RENDERBUFFER, rb[0]);
+    glRenderbufferStorage (GL_RENDERBUFFER, GL_RGBA8, W, H);
+    glBindRenderbuffer (GL_RENDERBUFFER, rb[1]);
+    glRenderbufferStorage (GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, W, H);
+    glBindFramebuffer (GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rb[0]);
+    glFramebufferRenderbuffer (GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rb[1]);
+    BOOST_REQUIRE (glCheckFramebufferStatus (GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+    glViewport (0, 0, W, H);
+    glMatrixMode (GL_PROJECTION);
+    glLoadIdentity ();
+    glOrtho (-100, 100, -100, 100, -1000, 1000);
+    glMatrixMode (GL_MODELVIEW);
+    glLoadIdentity ();
+    glEnable (GL_DEPTH_TEST);
+    glColor3f (1, 1, 1);
+}
+
+struct Context
+{
+    Context ()
+    {
+        static EGLContext context = create_context ();
+        BOOST_REQUIRE (eglMakeCurrent (display (), EGL_NO_SURFACE, EGL_NO_SURFACE, context));
+        setup_framebuffer ();
+    }
+};
+
+std::vector<unsigned char> read_pixels ()
+{
+    std::vector<unsigned char> pixels (W * H * 4);
+    glReadPixels (0, 0, W, H, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+    return pixels;
+}
+
+void clear ()
+{
+    glClearColor (0, 0, 0, 1);
+    glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// Coverage must match up to rasterisation differences along edges.
+void check_same_coverage (const std::vector<unsigned char>& expected,
+                          const std::vector<unsigned char>& actual)
+{
+    unsigned covered = 0, mismatched = 0;
+    for (size_t i = 0; i < expected.size(); i += 4) {
+        if (expected[i]) covered++;
+        if (expected[i] != actual[i]) mismatched++;
+    }
+    BOOST_REQUIRE (covered > W * H / 20);
+    BOOST_CHECK_LE (mismatched, covered / 100);
+}
+
+BOOST_FIXTURE_TEST_CASE (instanced_matches_per_instance, Context)
+{
+    write_md2 ("instancing.md2", 60, 300, 200);
+    Model model ("instancing.md2");
+    remove ("instancing.md2");
+
+    // A 4x4 grid of small instances, each at a different point of an animation.
+    const unsigned n = 16;
+    InstancePool pool (model, n);
+    const Animation* anim = model.getAnimation ("animb");
+    BOOST_REQUIRE (anim);
+    std::vector<float> transforms (16 * n, 0.0f);
+    for (unsigned i = 0; i < n; ++i) {
+        pool.add ();
+        pool.setAnimation (i, *anim);
+        pool.setAnimationSpeed (i, 0.3f + 0.1f * i);
+        float* m = &transforms[16*i];
+        m[0] = m[5] = m[10] = 1.5f;
+        m[12] = -75.0f + 50.0f * (i % 4) - 19.0f;
+        m[13] = -75.0f + 50.0f * (i / 4) - 19.0f;
+        m[15] = 1.0f;
+    }
+    pool.update (3.7f);
+
+    // Reference: one immediate mode draw per instance.
+    model.setHardwareMorphing (false);
+    clear ();
+    for (unsigned i = 0; i < n; ++i) {
+        glPushMatrix ();
+        glMultMatrixf (&transforms[16*i]);
+        pool.render (i);
+        glPopMatrix ();
+    }
+    std::vector<unsigned char> expected = read_pixels ();
+
+    clear ();
+    model.renderInstanced (&transforms[0], pool.frames(), n);
+    BOOST_REQUIRE (glGetError () == GL_NO_ERROR);
+    check_same_coverage (expected, read_pixels ());
+}
+
+BOOST_FIXTURE_TEST_CASE (hardware_morphing_matches_cpu, Context)
+{
+    write_md2 ("morph.md2", 60, 300, 200);
+    Model model ("morph.md2");
+    remove ("morph.md2");
+    const Animation* a = model.getAnimation ("animb");
+    const Animation* b = model.getAnimation ("animc");
+    BOOST_REQUIRE (a && b);
+
+    glPushMatrix ();
+    glScalef (6, 6, 6);
+    glTranslatef (-12, -12, 0);
+
+    // Interpolating two frames.
+    model.setHardwareMorphing (false);
+    clear ();
+    model.render (7.3f, a);
+    std::vector<unsigned char> expected = read_pixels ();
+    model.setHardwareMorphing (true);
+    clear ();
+    model.render (7.3f, a);
+    BOOST_REQUIRE (glGetError () == GL_NO_ERROR);
+    check_same_coverage (expected, read_pixels ());
+
+    // Cross fading between two animations.
+    model.setHardwareMorphing (false);
+    clear ();
+    model.render (3.6f, a, 11.2f, b, 0.4f);
+    expected = read_pixels ();
+    model.setHardwareMorphing (true);
+    clear ();
+    model.render (3.6f, a, 11.2f, b, 0.4f);
+    BOOST_REQUIRE (glGetError () == GL_NO_ERROR);
+    check_same_coverage (expected, read_pixels ());
+
+    // The caller's program is bound again afterwards.
+    GLuint vs = create_shader ("void main () { gl_Position = ftransform (); }\n", GL_VERTEX_SHADER);
+    GLuint fs = create_shader ("void main () { gl_FragColor = vec4 (1.0); }\n", GL_FRAGMENT_SHADER);
+    GLuint program = create_program (vs, fs);
+    glUseProgram (program);
+    model.render (7.3f, a);
+    float transform[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+    model.renderInstanced (transform, nullptr, 1);
+    GLint current;
+    glGetIntegerv (GL_CURRENT_PROGRAM, &current);
+    BOOST_CHECK_EQUAL ((GLuint) current, program);
+    glUseProgram (0);
+    glDeleteProgram (program);
+    glDeleteShader (vs);
+    glDeleteShader (fs);
+
+    glPopMatrix ();
+}
+
+BOOST_FIXTURE_TEST_CASE (models_in_a_second_context, Context)
+{
+    write_md2 ("contexts.md2", 60, 300, 200);
+    float transform[16] = { 6,0,0,0, 0,6,0,0, 0,0,6,0, -72,-72,0,1 };
+    FramePair frames = { 23, 24, 0.5f };
+    {
+        Model first ("contexts.md2");
+        first.setHardwareMorphing (true);
+        first.renderFrames (23, 24, 0.5f);
+        first.renderInstanced (transform, &frames, 1);
+    }
+
+    // Shaders built for the first context must not be reused in another one.
+    EGLContext context = create_context ();
+    setup_framebuffer ();
+    {
+        Model second ("contexts.md2");
+        glPushMatrix ();
+        glMultMatrixf (transform);
+        second.setHardwareMorphing (false);
+        clear ();
+        second.renderFrames (23, 24, 0.5f);
+        std::vector<unsigned char> expected = read_pixels ();
+        glPopMatrix ();
+
+        clear ();
+        second.renderInstanced (transform, &frames, 1);
+        BOOST_REQUIRE (glGetError () == GL_NO_ERROR);
+        check_same_coverage (expected, read_pixels ());
+
+        glPushMatrix ();
+        glMultMatrixf (transform);
+        second.setHardwareMorphing (true);
+        clear ();
+        second.renderFrames (23, 24, 0.5f);
+        BOOST_REQUIRE (glGetError () == GL_NO_ERROR);
+        check_same_coverage (expected, read_pixels ());
+        glPopMatrix ();
+    }
+    eglMakeCurrent (display (), EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext (display (), context);
+    remove ("contexts.md2");
+}
+
+BOOST_FIXTURE_TEST_CASE (lods_keep_coverage, Context)
+{
+    write_md2_grid ("lods.md2", 20, 32);
+    Model model ("lods.md2");
+    remove ("lods.md2");
+    model.buildLods (3);
+    BOOST_REQUIRE_EQUAL (model.numLods (), 4u);
+
+    glPushMatrix ();
+    glScalef (6, 6, 6);
+
+    // Borders are kept, so every level covers the same pixels.
+    clear ();
+    model.renderFrames (5, 6, 0.5f);
+    std::vector<unsigned char> expected = read_pixels ();
+    for (unsigned lod = 1; lod < 4; ++lod) {
+        for (int hw = 0; hw < 2; ++hw) {
+            model.setHardwareMorphing (hw != 0);
+            clear ();
+            model.renderFrames (5, 6, 0.5f, lod);
+            BOOST_REQUIRE (glGetError () == GL_NO_ERROR);
+            check_same_coverage (expected, read_pixels ());
+        }
+    }
+
+    // The bounding sphere is about 290 pixels across.
+    model.setLodThreshold (512.0f);
+    BOOST_CHECK_EQUAL (model.selectLod (), 1u);
+    glScalef (0.1f, 0.1f, 0.1f);
+    BOOST_CHECK_EQUAL (model.selectLod (), 3u);
+    glScalef (100.0f, 100.0f, 100.0f);
+    BOOST_CHECK_EQUAL (model.selectLod (), 0u);
+
+    glPopMatrix ();
+}
+
+BOOST_FIXTURE_TEST_CASE (update_texture_from_view, Context)
+{
+    Image blank (16, 16, 3, Image::Image_U8);
+    blank.view().forEachSpan ([] (U8* p, size_t n) { memset (p, 0, n); });
+    GLuint tex = create_texture (blank);
+
+    // Upload a 5x4 tile of a larger image, whose rows are padded, and an
+    // RGB tile whose stride is not a whole number of pixels.
+    Image atlas (20, 10, 3, Image::Image_U8);
+    for (int i = 0; i < 20 * 10 * 3; ++i) atlas.ith<U8>(i) = (U8) (i * 7 + 1);
+    ImageView tile = atlas.view (6, 3, 5, 4);
+    update_texture (tex, 0, 2, 1, tile);
+    std::vector<U8> odd (4 * 7 + 1);
+    for (size_t i = 0; i < odd.size(); ++i) odd[i] = (U8) (200 + i);
+    update_texture (tex, 0, 9, 9, ImageView (&odd[0], 2, 4, 3, Image::Image_U8, 7));
+
+    std::vector<U8> pixels (16 * 16 * 3);
+    glBindTexture (GL_TEXTURE_2D, tex);
+    glPixelStorei (GL_PACK_ALIGNMENT, 1);
+    glGetTexImage (GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+    glBindTexture (GL_TEXTURE_2D, 0);
+    glDeleteTextures (1, &tex);
+
+    GLint row_length;
+    glGetIntegerv (GL_UNPACK_ROW_LENGTH, &row_length);
+    BOOST_CHECK_EQUAL (row_length, 0);
+    for (int row = 0; row < 16; ++row) {
+        for (int col = 0; col < 16; ++col) {
+            const U8* want = 0;
+            static const U8 zero[3] = { 0, 0, 0 };
+            if (row >= 1 && row < 5 && col >= 2 && col < 7) want = tile.pixel<U8> (row-1, col-2);
+            else if (row >= 9 && row < 13 && col >= 9 && col < 11) want = &odd[(row-9) * 7 + (col-9) * 3];
+            else want = zero;
+            BOOST_CHECK (memcmp (&pixels[(row * 16 + col) * 3], want, 3) == 0);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE (model_and_shaders_from_archive, Context)
+{
+    write_md2 ("packed.md2", 20, 300, 200);
+    FILE* f = fopen ("packed.vert", "w");
+    fputs ("void main () { gl_Position = ftransform (); }\n", f);
+    fclose (f);
+    f = fopen ("packed.frag", "w");
+    fputs ("void main () { gl_FragColor = vec4 (1.0, 0.0, 0.0, 1.0); }\n", f);
+    fclose (f);
+    const char* files[] = { "packed.md2", "packed.vert", "packed.frag" };
+    const char* names[] = { "models/packed.md2", "shaders/red.vert", "shaders/red.frag" };
+    write_archive ("render.pak", names, files, 3);
+
+    glPushMatrix ();
+    glScalef (6, 6, 6);
+    glTranslatef (-12, -12, 0);
+    Model disk ("packed.md2");
+    clear ();
+    disk.renderFrames (3, 4, 0.5f);
+    std::vector<unsigned char> expected = read_pixels ();
+    for (int i = 0; i < 3; ++i) remove (files[i]);
+
+    vfs_mount ("render.pak", "data");
+    Model packed ("data/models/packed.md2");
+    clear ();
+    packed.renderFrames (3, 4, 0.5f);
+    check_same_coverage (expected, read_pixels ());
+
+    GLuint program = create_program_from_files ("data/shaders/red.vert", "data/shaders/red.frag");
+    BOOST_REQUIRE (program);
+    glUseProgram (program);
+    clear ();
+    packed.renderFrames (3, 4, 0.5f);
+    glUseProgram (0);
+    std::vector<unsigned char> red = read_pixels ();
+    BOOST_REQUIRE (glGetError () == GL_NO_ERROR);
+    for (size_t i = 0; i < red.size(); i += 4) {
+        if (expected[i]) BOOST_REQUIRE (red[i] == 255 && red[i+1] == 0);
+    }
+    glDeleteProgram (program);
+    glPopMatrix ();
+
+    vfs_unmount_all ();
+    remove ("render.pak");
+}
+
+// Every level of the two textures must hold the same data.
+void check_same_texture (GLuint expected, GLuint actual, bool compressed)
+{
+    GLint levels = 0;
+    glBindTexture (GL_TEXTURE_2D, expected);
+    glGetTexParameteriv (GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &levels);
+    BOOST_REQUIRE (levels > 0);
+    for (GLint i = 0; i <= levels; ++i) {
+        // Rescaled textures keep the default max level; stop at the last one.
+        GLint present = 0;
+        glBindTexture (GL_TEXTURE_2D, expected);
+        glGetTexLevelParameteriv (GL_TEXTURE_2D, i, GL_TEXTURE_WIDTH, &present);
+        if (present == 0) break;
+        std::vector<unsigned char> a, b;
+        for (int k = 0; k < 2; ++k) {
+            std::vector<unsigned char>& out = k ? b : a;
+            glBindTexture (GL_TEXTURE_2D, k ? actual : expected);
+            GLint w = 0, h = 0, size = 0;
+            glGetTexLevelParameteriv (GL_TEXTURE_2D, i, GL_TEXTURE_WIDTH, &w);
+            glGetTexLevelParameteriv (GL_TEXTURE_2D, i, GL_TEXTURE_HEIGHT, &h);
+            if (compressed) {
+                glGetTexLevelParameteriv (GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+                out.resize (size);
+                glGetCompressedTexImage (GL_TEXTURE_2D, i, &out[0]);
+            }
+            else {
+                out.resize (w * h * 4);
+                glPixelStorei (GL_PACK_ALIGNMENT, 1);
+                glGetTexImage (GL_TEXTURE_2D, i, GL_RGBA, GL_UNSIGNED_BYTE, &out[0]);
+            }
+        }
+        BOOST_REQUIRE_EQUAL (a.size(), b.size());
+        BOOST_REQUIRE (a == b);
+    }
+    glBindTexture (GL_TEXTURE_2D, 0);
+}
+
+BOOST_FIXTURE_TEST_CASE (streamed_textures_match_load_texture, Context)
+{
+    Image rgba (300, 200, 4, Image::Image_U8);
+    Image rgb (128, 64, 3, Image::Image_U8);
+    for (int i = 0; i < 300 * 200 * 4; ++i) rgba.ith<U8>(i) = (U8) (i * 7 + i / 1200);
+    for (int i = 0; i < 128 * 64 * 3; ++i) rgb.ith<U8>(i) = (U8) (i * 13);
+    CompressedImage bc3;
+    CompressedImage::encode (rgba, CompressedImage::Compressed_BC3, bc3);
+    write_tga (rgba, "stream.tga");
+    write_ppm (rgb, "stream.ppm");
+    write_dds (bc3, "stream.dds");
+    const char* paths[] = { "stream.tga", "stream.ppm", "stream.dds" };
+    GLuint expected[3];
+    for (int i = 0; i < 3; ++i) expected[i] = load_texture (paths[i]);
+
+    // A budget of a few rows, and one smaller than a row.
+    size_t budgets[] = { 16 << 10, 1000 };
+    for (size_t budget : budgets) {
+        Loader loader (2);
+        loader.setUploadBudget (budget);
+        AsyncTexture tex[3];
+        for (int i = 0; i < 3; ++i) tex[i] = loader.loadTexture (paths[i]);
+        unsigned frames = 0;
+        while (loader.numPending () > 0) {
+            loader.update ();
+            frames++;
+        }
+        BOOST_REQUIRE (glGetError () == GL_NO_ERROR);
+        // The first level alone is 234 KB, unless it is rescaled and
+        // uploaded whole.
+        if (GLEW_ARB_texture_non_power_of_two) {
+            BOOST_CHECK_GT (frames, 240000 / std::max (budget, (size_t) 1200));
+        }
+        for (int i = 0; i < 3; ++i) {
+            BOOST_REQUIRE (tex[i].isReady ());
+            GLuint t = tex[i].get ();
+            check_same_texture (expected[i], t, i == 2);
+            glDeleteTextures (1, &t);
+        }
+    }
+    glDeleteTextures (3, expected);
+    for (int i = 0; i < 3; ++i) remove (paths[i]);
+}
+
+BOOST_FIXTURE_TEST_CASE (two_component_textures, Context)
+{
+    Image la (64, 32, 2, Image::Image_U8);
+    for (int i = 0; i < 64 * 32 * 2; ++i) la.ith<U8>(i) = (U8) (i * 11 + i / 64);
+    GLuint tex[2] = { create_texture (la), create_texture (MipChain (la)) };
+    std::vector<U8> pixels (64 * 32 * 2);
+    for (GLuint t : tex) {
+        glBindTexture (GL_TEXTURE_2D, t);
+        glPixelStorei (GL_PACK_ALIGNMENT, 1);
+        glGetTexImage (GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, &pixels[0]);
+        glPixelStorei (GL_PACK_ALIGNMENT, 4);
+        BOOST_REQUIRE (glGetError () == GL_NO_ERROR);
+        BOOST_CHECK (memcmp (&pixels[0], (const U8*) la, pixels.size()) == 0);
+    }
+    glBindTexture (GL_TEXTURE_2D, 0);
+    glDeleteTextures (2, tex);
+}
+
+BOOST_FIXTURE_TEST_CASE (npot_textures_fit_the_context, Context)
+{
+    Image rgb (300, 200, 3, Image::Image_U8);
+    for (int i = 0; i < 300 * 200 * 3; ++i) rgb.ith<U8>(i) = (U8) (i * 5);
+    write_tga (rgb, "npot.tga");
+
+    // Rescaled to powers of two unless the context takes any size.
+    Loader loader (1);
+    loader.setUploadBudget (16 << 10);
+    AsyncTexture streamed = loader.loadTexture ("npot.tga");
+    while (loader.numPending () > 0) loader.update ();
+    BOOST_REQUIRE (streamed.isReady ());
+    GLuint tex[2] = { load_texture ("npot.tga"), streamed.get () };
+    for (GLuint t : tex) {
+        GLint w, h;
+        glBindTexture (GL_TEXTURE_2D, t);
+        glGetTexLevelParameteriv (GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+        glGetTexLevelParameteriv (GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+        if (GLEW_ARB_texture_non_power_of_two) {
+            BOOST_CHECK_EQUAL (w, 300);
+            BOOST_CHECK_EQUAL (h, 200);
+        }
+        else {
+            BOOST_CHECK (w > 0 && (w & (w-1)) == 0);
+            BOOST_CHECK (h > 0 && (h & (h-1)) == 0);
+        }
+    }
+    BOOST_REQUIRE (glGetError () == GL_NO_ERROR);
+    glBindTexture (GL_TEXTURE_2D, 0);
+    glDeleteTextures (2, tex);
+    remove ("npot.tga");
+}
@@ -0,0 +1,242 @@
+#define BOOST_TEST_MODULE StaticModel
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include "../src/model/StaticModel.h"
+#include <OGDT/Exception.h>
+#include <OGDT/model.h>
+#include "md2_synth.h"
+#include <assimp/scene.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Builds scenes by hand, with the ownership assimp expects, so the tests need
+// neither files nor an OpenGL context.
+
+using namespace OGDT;
+
+aiMesh* make_mesh (const std::vector<aiVector3D>& vertices,
+                   const std::vector<std::vector<unsigned>>& faces,
+                   unsigned material, bool normals)
+{
+    aiMesh* mesh = new aiMesh;
+    mesh->mMaterialIndex = material;
+    mesh->mNumVertices = vertices.size();
+    mesh->mVertices = new aiVector3D[vertices.size()];
+    std::copy (vertices.begin(), vertices.end(), mesh->mVertices);
+    if (normals) {
+        mesh->mNormals = new aiVector3D[vertices.size()];
+        for (size_t i = 0; i < vertices.size(); ++i) mesh->mNormals[i] = aiVector3D (0, 0, 1);
+    }
+    mesh->mNumFaces = faces.size();
+    mesh->mFaces = new aiFace[faces.size()];
+    for (size_t f = 0; f < faces.size(); ++f) {
+        mesh->mFaces[f].mNumIndices = faces[f].size();
+        mesh->mFaces[f].mIndices = new unsigned[faces[f].size()];
+        std::copy (faces[f].begin(), faces[f].end(), mesh->mFaces[f].mIndices);
+    }
+    return mesh;
+}
+
+aiNode* make_node (const aiMatrix4x4& transform, const std::vector<unsigned>& meshes,
+                   const std::vector<aiNode*>& children)
+{
+    aiNode* node = new aiNode;
+    node->mTransformation = transform;
+    node->mNumMeshes = meshes.size();
+    if (!meshes.empty()) {
+        node->mMeshes = new unsigned[meshes.size()];
+        std::copy (meshes.begin(), meshes.end(), node->mMeshes);
+    }
+    node->mNumChildren = children.size();
+    if (!children.empty()) {
+        node->mChildren = new aiNode*[children.size()];
+        for (size_t i = 0; i < children.size(); ++i) {
+            node->mChildren[i] = children[i];
+            children[i]->mParent = node;
+        }
+    }
+    return node;
+}
+
+void set_meshes (aiScene& scene, const std::vector<aiMesh*>& meshes)
+{
+    scene.mNumMeshes = meshes.size();
+    scene.mMeshes = new aiMesh*[meshes.size()];
+    std::copy (meshes.begin(), meshes.end(), scene.mMeshes);
+}
+
+aiMatrix4x4 translation (float x, float y, float z)
+{
+    return aiMatrix4x4 (1,0,0,x, 0,1,0,y, 0,0,1,z, 0,0,0,1);
+}
+
+// Bounds of the given points transformed by m.
+void transformed_bounds (const std::vector<aiVector3D>& points, const aiMatrix4x4& m, float* aabb)
+{
+    aabb[0] = aabb[2] = aabb[4] = FLT_MAX;
+    aabb[1] = aabb[3] = aabb[5] = -FLT_MAX;
+    for (const aiVector3D& p : points) {
+        aiVector3D q = m * p;
+        float c[3] = { q.x, q.y, q.z };
+        for (int k = 0; k < 3; ++k) {
+            aabb[2*k] = std::min (aabb[2*k], c[k]);
+            aabb[2*k+1] = std::max (aabb[2*k+1], c[k]);
+        }
+    }
+}
+
+void check_bounds (const float* actual, const float* expected)
+{
+    for (int k = 0; k < 6; ++k) BOOST_CHECK_CLOSE_FRACTION (actual[k] + 100.0f, expected[k] + 100.0f, 1e-5f);
+}
+
+BOOST_AUTO_TEST_CASE (node_bounds_follow_transforms)
+{
+    // A tetrahedron whose bounding box corners are not vertices, so the
+    // bounds of its transformed box are larger than those of its vertices.
+    std::vector<aiVector3D> box;
+    for (int i = 0; i < 8; ++i) box.push_back (aiVector3D (i & 1 ? 3 : -1, i & 2 ? 2 : -2, i & 4 ? 5 : 1));
+    std::vector<aiVector3D> tetra = { aiVector3D (-1,-2,1), aiVector3D (3,2,1), aiVector3D (3,-2,5), aiVector3D (-1,2,5) };
+
+    // Rotation about z by 30 degrees, with scale and translation, under a
+    // parent rotated about x by 90 degrees and translated.
+    const float c = 0.8660254f, s = 0.5f;
+    aiMatrix4x4 local (2*c,-2*s,0,10, 2*s,2*c,0,-4, 0,0,2,7, 0,0,0,1);
+    aiMatrix4x4 parent (1,0,0,1, 0,0,-1,2, 0,1,0,3, 0,0,0,1);
+
+    aiScene scene;
+    set_meshes (scene, { make_mesh (tetra, { { 0, 1, 2 }, { 0, 2, 3 } }, 0, false) });
+    aiNode* leaf = make_node (local, { 0 }, {});
+    aiNode* empty = make_node (translation (50, 50, 50), {}, {});
+    aiNode* middle = make_node (aiMatrix4x4 (), {}, { leaf, empty });
+    scene.mRootNode = make_node (parent, { 0 }, { middle });
+
+    StaticModel model;
+    StaticModel_build (&scene, &model);
+
+    // Depth first: root, middle, leaf, empty.
+    BOOST_REQUIRE_EQUAL (model.nodes.size(), 4u);
+    BOOST_CHECK_EQUAL (model.nodes[0].end, 4u);
+    BOOST_CHECK_EQUAL (model.nodes[1].end, 4u);
+    BOOST_CHECK_EQUAL (model.nodes[2].end, 3u);
+    BOOST_CHECK_EQUAL (model.nodes[3].end, 4u);
+
+    float at_leaf[6], at_root[6], aabb[6];
+    transformed_bounds (box, parent * local, at_leaf);
+    transformed_bounds (box, parent, at_root);
+    BOOST_REQUIRE (StaticModel_aabb (&model, 2, aabb));
+    check_bounds (aabb, at_leaf);
+    BOOST_REQUIRE (StaticModel_aabb (&model, 1, aabb));
+    check_bounds (aabb, at_leaf);
+
+    float both[6];
+    for (int k = 0; k < 3; ++k) {
+        both[2*k] = std::min (at_leaf[2*k], at_root[2*k]);
+        both[2*k+1] = std::max (at_leaf[2*k+1], at_root[2*k+1]);
+    }
+    BOOST_REQUIRE (StaticModel_aabb (&model, 0, aabb));
+    check_bounds (aabb, both);
+
+    // Nodes without geometry have empty bounds.
+    BOOST_CHECK (model.nodes[3].aabb[0] > model.nodes[3].aabb[1]);
+    BOOST_CHECK (!StaticModel_aabb (&model, 3, aabb));
+    BOOST_CHECK (!StaticModel_aabb (&model, 4, aabb));
+
+    // Vertices are baked into world space.
+    aiVector3D p = parent * local * tetra[1];
+    bool found = false;
+    for (const static_vertex& v : model.vertices) {
+        found |= fabs (v.pos[0] - p.x) < 1e-4f && fabs (v.pos[1] - p.y) < 1e-4f && fabs (v.pos[2] - p.z) < 1e-4f;
+    }
+    BOOST_CHECK (found);
+}
+
+BOOST_AUTO_TEST_CASE (normals_follow_the_inverse_transpose)
+{
+    // The plane x + y = 1 stretched along x becomes x/2 + y = 1, whose
+    // normal is (1, 2, 0)/sqrt(5), not the stretched normal (2, 1, 0).
+    std::vector<aiVector3D> tri = { aiVector3D (1,0,0), aiVector3D (0,1,0), aiVector3D (0,1,1) };
+    aiMesh* mesh = make_mesh (tri, { { 0, 1, 2 } }, 0, true);
+    for (int i = 0; i < 3; ++i) mesh->mNormals[i] = aiVector3D (0.70710678f, 0.70710678f, 0);
+    aiScene scene;
+    set_meshes (scene, { mesh });
+    aiMatrix4x4 stretch (2,0,0,5, 0,1,0,0, 0,0,1,0, 0,0,0,1);
+    scene.mRootNode = make_node (aiMatrix4x4 (), {}, { make_node (stretch, { 0 }, {}) });
+
+    StaticModel model;
+    StaticModel_build (&scene, &model);
+    BOOST_REQUIRE_EQUAL (model.vertices.size(), 3u);
+    const float n[3] = { 0.4472136f, 0.8944272f, 0.0f };
+    for (const static_vertex& v : model.vertices) {
+        for (int k = 0; k < 3; ++k) BOOST_CHECK_SMALL (v.normal[k] - n[k], 1e-5f);
+    }
+    BOOST_CHECK_CLOSE (model.vertices[0].pos[0], 7.0f, 1e-4f);
+}
+
+BOOST_AUTO_TEST_CASE (batches_merge_by_material_and_attributes)
+{
+    std::vector<aiVector3D> quad = { aiVector3D (0,0,0), aiVector3D (1,0,0), aiVector3D (1,1,0), aiVector3D (0,1,0) };
+    aiScene scene;
+    set_meshes (scene, {
+        make_mesh (quad, { { 0, 1, 2 } }, 1, true),                     // 0
+        make_mesh (quad, { { 0, 1, 2, 3 } }, 1, true),                  // 1: fan of two triangles
+        make_mesh (quad, { { 0, 2, 3 } }, 0, true),                     // 2: other material
+        make_mesh (quad, { { 0, 1, 3 } }, 1, false),                    // 3: other attributes
+        make_mesh (quad, { { 0 }, { 0, 1 }, { 1, 2, 3 }, { 2 } }, 1, true) // 4: mixed primitives
+    });
+    aiNode* a = make_node (translation (10, 0, 0), { 0, 2 }, {});
+    aiNode* b = make_node (translation (0, 10, 0), { 1, 0 }, {});
+    scene.mRootNode = make_node (aiMatrix4x4 (), { 3, 4 }, { a, b });
+
+    StaticModel model;
+    StaticModel_build (&scene, &model);
+
+    // Material 0 triangles; material 1 points, lines, triangles with normals
+    // and triangles without.
+    BOOST_REQUIRE_EQUAL (model.batches.size(), 5u);
+    unsigned triangles_with_normals = 0, triangles_without = 0, points = 0, lines = 0;
+    for (size_t i = 0; i < model.batches.size(); ++i) {
+        const static_batch& batch = model.batches[i];
+        if (i > 0) BOOST_CHECK_LE (model.batches[i-1].material, batch.material);
+        BOOST_REQUIRE_LE (batch.firstIndex + batch.numIndices, model.indices.size());
+        BOOST_REQUIRE_LE (batch.firstVertex + batch.numVertices, model.vertices.size());
+        for (unsigned k = 0; k < batch.numIndices; ++k) {
+            U32 index = model.indices[batch.firstIndex + k];
+            BOOST_REQUIRE (index >= batch.firstVertex && index < batch.firstVertex + batch.numVertices);
+        }
+        if (batch.material == 0) {
+            BOOST_CHECK_EQUAL (batch.mode, (GLenum) GL_TRIANGLES);
+            BOOST_CHECK_EQUAL (batch.numIndices, 3u);
+            // Mesh 2 is placed under node a.
+            const static_vertex& v = model.vertices[model.indices[batch.firstIndex + 1]];
+            BOOST_CHECK_CLOSE (v.pos[0], 11.0f, 1e-4f);
+            BOOST_CHECK_CLOSE (v.pos[1], 1.0f, 1e-4f);
+            continue;
+        }
+        switch (batch.mode) {
+        case GL_POINTS: points += batch.numIndices; break;
+        case GL_LINES: lines += batch.numIndices; break;
+        default:
+            if (batch.attribs & Static_Normals) triangles_with_normals += batch.numIndices / 3;
+            else triangles_without += batch.numIndices / 3;
+        }
+    }
+    // Mesh 0 twice, the two halves of mesh 1's quad and mesh 4's triangle.
+    BOOST_CHECK_EQUAL (triangles_with_normals, 5u);
+    BOOST_CHECK_EQUAL (triangles_without, 1u);
+    BOOST_CHECK_EQUAL (points, 2u);
+    BOOST_CHECK_EQUAL (lines, 2u);
+}
+
+BOOST_AUTO_TEST_CASE (node_bounds_of_md2_models_throw)
+{
+    write_md2 ("nodes.md2", 4, 10, 8);
+    Model model ("nodes.md2");
+    remove ("nodes.md2");
+    BOOST_CHECK_EQUAL (model.numNodes (), 0u);
+    float b[6];
+    BOOST_CHECK_THROW (model.computeNodeAABB (0, b[0], b[1], b[2], b[3], b[4], b[5]), Exception);
+}
@@ -0,0 +1,81 @@
+#define BOOST_TEST_MODULE TextureCache
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <OGDT/TextureCache.h>
+#include <OGDT/Exception.h>
+#include <cstdio>
+
+// Only decoding is exercised; release never touches OpenGL for entries that
+// were not uploaded.
+
+using namespace OGDT;
+
+void write_pgm (const char* path, int value)
+{
+    FILE* file = fopen (path, "wb");
+    fprintf (file, "P5\n2 2\n255\n");
+    for (int i = 0; i < 4; ++i) fputc (value, file);
+    fclose (file);
+}
+
+BOOST_AUTO_TEST_CASE (texture_cache_shares_entries)
+{
+    write_pgm ("cache_a.pgm", 100);
+    TextureCache cache;
+
+    texture_entry* a = cache.decode ("cache_a.pgm");
+    texture_entry* b = cache.decode ("./cache_a.pgm");
+    BOOST_CHECK (a == b);
+    BOOST_CHECK_EQUAL (cache.misses (), 1u);
+    BOOST_CHECK_EQUAL (cache.hits (), 1u);
+    BOOST_CHECK_EQUAL (cache.size (), 1u);
+
+    cache.release (a);
+    BOOST_CHECK_EQUAL (cache.size (), 1u);
+    cache.release (b);
+    BOOST_CHECK_EQUAL (cache.size (), 0u);
+
+    // Released images are decoded again.
+    texture_entry* c = cache.decode ("cache_a.pgm");
+    BOOST_CHECK_EQUAL (cache.misses (), 2u);
+    cache.release (c);
+    remove ("cache_a.pgm");
+}
+
+BOOST_AUTO_TEST_CASE (texture_cache_content_hashing)
+{
+    write_pgm ("cache_a.pgm", 100);
+    write_pgm ("cache_b.pgm", 100);
+    write_pgm ("cache_c.pgm", 200);
+    TextureCache cache;
+    cache.setContentHashing (true);
+
+    texture_entry* a = cache.decode ("cache_a.pgm");
+    texture_entry* b = cache.decode ("cache_b.pgm");
+    texture_entry* c = cache.decode ("cache_c.pgm");
+    BOOST_CHECK (a == b);
+    BOOST_CHECK (a != c);
+    BOOST_CHECK_EQUAL (cache.misses (), 2u);
+    BOOST_CHECK_EQUAL (cache.hits (), 1u);
+    BOOST_CHECK_EQUAL (cache.size (), 2u);
+
+    cache.resetCounters ();
+    BOOST_CHECK_EQUAL (cache.hits (), 0u);
+
+    cache.release (a);
+    cache.release (b);
+    cache.release (c);
+    BOOST_CHECK_EQUAL (cache.size (), 0u);
+    remove ("cache_a.pgm");
+    remove ("cache_b.pgm");
+    remove ("cache_c.pgm");
+}
+
+BOOST_AUTO_TEST_CASE (texture_cache_failure_is_not_cached)
+{
+    TextureCache cache;
+    BOOST_CHECK_THROW (cache.decode ("cache_missing.pgm"), Exception);
+    BOOST_CHECK_EQUAL (cache.size (), 0u);
+    BOOST_CHECK_THROW (cache.decode ("cache_missing.pgm"), Exception);
+    BOOST_CHECK_EQUAL (cache.misses (), 2u);
+}
@@ -0,0 +1,43 @@
+#define BOOST_TEST_MODULE ThreadPool
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <OGDT/ThreadPool.h>
+#include <atomic>
+#include <vector>
+
+using namespace OGDT;
+
+BOOST_AUTO_TEST_CASE (threadpool_submit_wait)
+{
+    ThreadPool pool (4);
+    std::atomic<int> count (0);
+    for (int i = 0; i < 1000; ++i) pool.submit ([&count] () { count++; });
+    pool.wait ();
+    BOOST_REQUIRE (count == 1000);
+}
+
+BOOST_AUTO_TEST_CASE (threadpool_parallel_for_covers_range)
+{
+    ThreadPool pool (4);
+    std::vector<int> hits (10007, 0);
+    pool.parallel_for (hits.size(), [&hits] (unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; ++i) hits[i]++;
+    }, 64);
+    for (size_t i = 0; i < hits.size(); ++i) BOOST_REQUIRE (hits[i] == 1);
+}
+
+BOOST_AUTO_TEST_CASE (threadpool_nested_parallel_for)
+{
+    // Nested calls from inside a worker must not deadlock, even when
+    // every worker is busy with an outer chunk.
+    ThreadPool pool (2);
+    std::atomic<int> count (0);
+    pool.parallel_for (8, [&pool, &count] (unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; ++i) {
+            pool.parallel_for (100, [&count] (unsigned b, unsigned e) {
+                count += e - b;
+            });
+        }
+    });
+    BOOST_REQUIRE (count == 800);
+}